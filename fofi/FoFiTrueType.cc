@@ -180,6 +180,33 @@ constexpr int t42GlyfTable = 2;
 constexpr int t42VheaTable = 9;
 constexpr int t42VmtxTable = 10;
 
+// Composite glyph flags.
+constexpr int glyfArg1And2AreWords = 0x0001;
+constexpr int glyfHaveAScale = 0x0008;
+constexpr int glyfMoreComponents = 0x0020;
+constexpr int glyfHaveAnXAndYScale = 0x0040;
+constexpr int glyfHaveATwoByTwo = 0x0080;
+
+// Returns the GIDs shown by the codes set in <usedCodes>, mapped with
+// <codeToGID> (or the identity if it is empty), or NULL if <usedCodes>
+// is NULL.
+static std::optional<std::vector<bool>> mapUsedCodes(const std::vector<bool> *usedCodes, const std::vector<int> &codeToGID, int nGlyphs)
+{
+    if (!usedCodes) {
+        return {};
+    }
+    std::vector<bool> usedGlyphs(std::max(nGlyphs, 0), false);
+    for (size_t code = 0; code < usedCodes->size(); ++code) {
+        if ((*usedCodes)[code]) {
+            const int gid = codeToGID.empty() ? static_cast<int>(code) : code < codeToGID.size() ? codeToGID[code] : -1;
+            if (gid >= 0 && gid < nGlyphs) {
+                usedGlyphs[gid] = true;
+            }
+        }
+    }
+    return usedGlyphs;
+}
+
 //------------------------------------------------------------------------
 
 // Glyph names in some arbitrary standard order that Apple uses for
@@ -698,7 +725,7 @@ int FoFiTrueType::getEmbeddingRights() const
     return 3;
 }
 
-void FoFiTrueType::convertToType42(const std::string &psName, const std::array<const char *, 256> *encoding, const std::vector<int> &codeToGID, FoFiOutputFunc outputFunc, void *outputStream) const
+void FoFiTrueType::convertToType42(const std::string &psName, const std::array<const char *, 256> *encoding, const std::vector<int> &codeToGID, const std::vector<bool> *usedCodes, FoFiOutputFunc outputFunc, void *outputStream) const
 {
     int maxUsedGlyph;
     bool ok;
@@ -726,7 +753,8 @@ void FoFiTrueType::convertToType42(const std::string &psName, const std::array<c
     // write the guts of the dictionary
     cvtEncoding(encoding, outputFunc, outputStream);
     cvtCharStrings(encoding, codeToGID, outputFunc, outputStream);
-    cvtSfnts(outputFunc, outputStream, std::nullopt, false, &maxUsedGlyph);
+    const std::optional<std::vector<bool>> usedGlyphs = mapUsedCodes(usedCodes, codeToGID, nGlyphs);
+    cvtSfnts(outputFunc, outputStream, std::nullopt, false, usedGlyphs ? &usedGlyphs.value() : nullptr, &maxUsedGlyph);
 
     // end the dictionary and define the font
     (*outputFunc)(outputStream, "FontName currentdict end definefont pop\n");
@@ -745,7 +773,7 @@ void FoFiTrueType::convertToType1(const char *psName, FoFiOutputFunc outputFunc,
     ff->convertToType1(psName, outputFunc, outputStream);
 }
 
-void FoFiTrueType::convertToCIDType2(const std::string &psName, const std::vector<int> &cidMap, bool needVerticalMetrics, FoFiOutputFunc outputFunc, void *outputStream) const
+void FoFiTrueType::convertToCIDType2(const std::string &psName, const std::vector<int> &cidMap, const std::vector<bool> *usedCIDs, bool needVerticalMetrics, FoFiOutputFunc outputFunc, void *outputStream) const
 {
     bool ok;
 
@@ -771,16 +799,27 @@ void FoFiTrueType::convertToCIDType2(const std::string &psName, const std::vecto
     (*outputFunc)(outputStream, "  /Supplement 0 def\n");
     (*outputFunc)(outputStream, "  end def\n");
     (*outputFunc)(outputStream, "/GDBytes 2 def\n");
+    // when subsetting, CIDs after the last one used are left out
+    int nCIDs = !cidMap.empty() ? static_cast<int>(cidMap.size()) : nGlyphs;
+    if (usedCIDs) {
+        int lastCID = 0;
+        for (int i = 1; i < nCIDs && i < static_cast<int>(usedCIDs->size()); ++i) {
+            if ((*usedCIDs)[i]) {
+                lastCID = i;
+            }
+        }
+        nCIDs = std::min(nCIDs, lastCID + 1);
+    }
     if (!cidMap.empty()) {
-        buf = GooString::format("/CIDCount {0:d} def\n", static_cast<int>(cidMap.size()));
+        buf = GooString::format("/CIDCount {0:d} def\n", nCIDs);
         (*outputFunc)(outputStream, buf);
-        if (cidMap.size() > 32767) {
+        if (nCIDs > 32767) {
             (*outputFunc)(outputStream, "/CIDMap [");
-            for (size_t i = 0; i < cidMap.size(); i += 32768 - 16) {
+            for (int i = 0; i < nCIDs; i += 32768 - 16) {
                 (*outputFunc)(outputStream, "<\n");
-                for (size_t j = 0; j < 32768 - 16 && i + j < cidMap.size(); j += 16) {
+                for (int j = 0; j < 32768 - 16 && i + j < nCIDs; j += 16) {
                     (*outputFunc)(outputStream, "  ");
-                    for (size_t k = 0; k < 16 && i + j + k < cidMap.size(); ++k) {
+                    for (int k = 0; k < 16 && i + j + k < nCIDs; ++k) {
                         const int cid = cidMap[i + j + k];
                         buf = GooString::format("{0:02x}{1:02x}", (cid >> 8) & 0xff, cid & 0xff);
                         (*outputFunc)(outputStream, buf);
@@ -793,9 +832,9 @@ void FoFiTrueType::convertToCIDType2(const std::string &psName, const std::vecto
             (*outputFunc)(outputStream, "] def\n");
         } else {
             (*outputFunc)(outputStream, "/CIDMap <\n");
-            for (size_t i = 0; i < cidMap.size(); i += 16) {
+            for (int i = 0; i < nCIDs; i += 16) {
                 (*outputFunc)(outputStream, "  ");
-                for (size_t j = 0; j < 16 && i + j < cidMap.size(); ++j) {
+                for (int j = 0; j < 16 && i + j < nCIDs; ++j) {
                     const int cid = cidMap[i + j];
                     buf = GooString::format("{0:02x}{1:02x}", (cid >> 8) & 0xff, cid & 0xff);
                     (*outputFunc)(outputStream, buf);
@@ -806,12 +845,12 @@ void FoFiTrueType::convertToCIDType2(const std::string &psName, const std::vecto
         }
     } else {
         // direct mapping - just fill the string(s) with s[i]=i
-        buf = GooString::format("/CIDCount {0:d} def\n", nGlyphs);
+        buf = GooString::format("/CIDCount {0:d} def\n", nCIDs);
         (*outputFunc)(outputStream, buf);
-        if (nGlyphs > 32767) {
+        if (nCIDs > 32767) {
             (*outputFunc)(outputStream, "/CIDMap [\n");
-            for (int i = 0; i < nGlyphs; i += 32767) {
-                const int j = nGlyphs - i < 32767 ? nGlyphs - i : 32767;
+            for (int i = 0; i < nCIDs; i += 32767) {
+                const int j = nCIDs - i < 32767 ? nCIDs - i : 32767;
                 buf = GooString::format("  {0:d} string 0 1 {1:d} {{\n", 2 * j, j - 1);
                 (*outputFunc)(outputStream, buf);
                 buf = GooString::format("    2 copy dup 2 mul exch {0:d} add -8 bitshift put\n", i);
@@ -824,9 +863,9 @@ void FoFiTrueType::convertToCIDType2(const std::string &psName, const std::vecto
             }
             (*outputFunc)(outputStream, "] def\n");
         } else {
-            buf = GooString::format("/CIDMap {0:d} string\n", 2 * nGlyphs);
+            buf = GooString::format("/CIDMap {0:d} string\n", 2 * nCIDs);
             (*outputFunc)(outputStream, buf);
-            buf = GooString::format("  0 1 {0:d} {{\n", nGlyphs - 1);
+            buf = GooString::format("  0 1 {0:d} {{\n", nCIDs - 1);
             (*outputFunc)(outputStream, buf);
             (*outputFunc)(outputStream, "    2 copy dup 2 mul exch -8 bitshift put\n");
             (*outputFunc)(outputStream, "    1 index exch dup 2 mul 1 add exch 255 and put\n");
@@ -845,13 +884,14 @@ void FoFiTrueType::convertToCIDType2(const std::string &psName, const std::vecto
 
     // write the guts of the dictionary
     int unusedMaxUsedGlyph;
-    cvtSfnts(outputFunc, outputStream, std::nullopt, needVerticalMetrics, &unusedMaxUsedGlyph);
+    const std::optional<std::vector<bool>> usedGlyphs = mapUsedCodes(usedCIDs, cidMap, nGlyphs);
+    cvtSfnts(outputFunc, outputStream, std::nullopt, needVerticalMetrics, usedGlyphs ? &usedGlyphs.value() : nullptr, &unusedMaxUsedGlyph);
 
     // end the dictionary and define the font
     (*outputFunc)(outputStream, "CIDFontName currentdict end /CIDFont defineresource pop\n");
 }
 
-void FoFiTrueType::convertToCIDType0(const std::string &psName, const std::vector<int> &cidMap, FoFiOutputFunc outputFunc, void *outputStream) const
+void FoFiTrueType::convertToCIDType0(const std::string &psName, const std::vector<int> &cidMap, const std::vector<bool> *usedCIDs, FoFiOutputFunc outputFunc, void *outputStream) const
 {
     auto cffBlock = getCFFBlock();
     if (!cffBlock) {
@@ -861,10 +901,10 @@ void FoFiTrueType::convertToCIDType0(const std::string &psName, const std::vecto
     if (!ff) {
         return;
     }
-    ff->convertToCIDType0(psName, cidMap, outputFunc, outputStream);
+    ff->convertToCIDType0(psName, cidMap, usedCIDs, outputFunc, outputStream);
 }
 
-void FoFiTrueType::convertToType0(const std::string &psName, const std::vector<int> &cidMap, bool needVerticalMetrics, int *maxValidGlyph, FoFiOutputFunc outputFunc, void *outputStream) const
+void FoFiTrueType::convertToType0(const std::string &psName, const std::vector<int> &cidMap, const std::vector<bool> *usedCIDs, bool needVerticalMetrics, int *maxValidGlyph, FoFiOutputFunc outputFunc, void *outputStream) const
 {
     int maxUsedGlyph, n, i, j;
 
@@ -876,7 +916,8 @@ void FoFiTrueType::convertToType0(const std::string &psName, const std::vector<i
 
     // write the Type 42 sfnts array
     const std::string sfntsName = psName + "_sfnts";
-    cvtSfnts(outputFunc, outputStream, sfntsName, needVerticalMetrics, &maxUsedGlyph);
+    const std::optional<std::vector<bool>> usedGlyphs = mapUsedCodes(usedCIDs, cidMap, nGlyphs);
+    cvtSfnts(outputFunc, outputStream, sfntsName, needVerticalMetrics, usedGlyphs ? &usedGlyphs.value() : nullptr, &maxUsedGlyph);
 
     // write the descendant Type 42 fonts
     // (The following is a kludge: nGlyphs is the glyph count from the
@@ -963,7 +1004,7 @@ void FoFiTrueType::convertToType0(const std::string &psName, const std::vector<i
     (*outputFunc)(outputStream, "FontName currentdict end definefont pop\n");
 }
 
-void FoFiTrueType::convertToType0(const std::string &psName, const std::vector<int> &cidMap, FoFiOutputFunc outputFunc, void *outputStream) const
+void FoFiTrueType::convertToType0(const std::string &psName, const std::vector<int> &cidMap, const std::vector<bool> *usedCIDs, FoFiOutputFunc outputFunc, void *outputStream) const
 {
     auto cffBlock = getCFFBlock();
     if (!cffBlock) {
@@ -973,7 +1014,7 @@ void FoFiTrueType::convertToType0(const std::string &psName, const std::vector<i
     if (!ff) {
         return;
     }
-    ff->convertToType0(psName, cidMap, outputFunc, outputStream);
+    ff->convertToType0(psName, cidMap, usedCIDs, outputFunc, outputStream);
 }
 
 void FoFiTrueType::cvtEncoding(const std::array<const char *, 256> *encoding, FoFiOutputFunc outputFunc, void *outputStream)
@@ -1049,7 +1090,7 @@ err:
     (*outputFunc)(outputStream, "end readonly def\n");
 }
 
-void FoFiTrueType::cvtSfnts(FoFiOutputFunc outputFunc, void *outputStream, const std::optional<std::string> &name, bool needVerticalMetrics, int *maxUsedGlyph) const
+void FoFiTrueType::cvtSfnts(FoFiOutputFunc outputFunc, void *outputStream, const std::optional<std::string> &name, bool needVerticalMetrics, const std::vector<bool> *usedGlyphs, int *maxUsedGlyph) const
 {
     std::array<unsigned char, 54> headData;
     std::vector<unsigned char> locaData;
@@ -1133,6 +1174,62 @@ void FoFiTrueType::cvtSfnts(FoFiOutputFunc outputFunc, void *outputStream, const
     }
     locaTable[nGlyphs].len = 0;
     std::ranges::sort(locaTable, cmpTrueTypeLocaIdxFunctor());
+
+    // when subsetting, drop the description of the glyphs that are not
+    // used, keeping .notdef and the components of the used composite
+    // glyphs -- the GIDs don't change, so loca keeps all its entries
+    std::vector<bool> keepGlyphs;
+    if (usedGlyphs) {
+        keepGlyphs.resize(nGlyphs, false);
+        std::vector<int> todo;
+        for (i = 0; i < nGlyphs; ++i) {
+            if (i == 0 || (i < static_cast<int>(usedGlyphs->size()) && (*usedGlyphs)[i])) {
+                keepGlyphs[i] = true;
+                todo.push_back(i);
+            }
+        }
+        glyfPos = tables[seekTable("glyf")].offset;
+        while (!todo.empty()) {
+            const int gid = todo.back();
+            todo.pop_back();
+            // composite glyphs have a negative number of contours
+            pos = glyfPos + locaTable[gid].origOffset;
+            const int end = pos + locaTable[gid].len;
+            bool compOk = true;
+            if (locaTable[gid].len < 10 || getS16BE(pos, &compOk) >= 0 || !compOk) {
+                continue;
+            }
+            pos += 10;
+            while (pos + 4 <= end) {
+                const int flags = getU16BE(pos, &compOk);
+                const int comp = getU16BE(pos + 2, &compOk);
+                if (!compOk) {
+                    break;
+                }
+                if (comp < nGlyphs && !keepGlyphs[comp]) {
+                    keepGlyphs[comp] = true;
+                    todo.push_back(comp);
+                }
+                pos += (flags & glyfArg1And2AreWords) ? 8 : 6;
+                if (flags & glyfHaveAScale) {
+                    pos += 2;
+                } else if (flags & glyfHaveAnXAndYScale) {
+                    pos += 4;
+                } else if (flags & glyfHaveATwoByTwo) {
+                    pos += 8;
+                }
+                if (!(flags & glyfMoreComponents)) {
+                    break;
+                }
+            }
+        }
+        for (i = 0; i < nGlyphs; ++i) {
+            if (!keepGlyphs[i]) {
+                locaTable[i].len = 0;
+            }
+        }
+    }
+
     pos = 0;
     for (i = 0; i <= nGlyphs; ++i) {
         locaTable[i].newOffset = pos;
@@ -1146,7 +1243,8 @@ void FoFiTrueType::cvtSfnts(FoFiOutputFunc outputFunc, void *outputStream, const
                 pos += 4 - (pos & 3);
             }
         }
-        if (locaTable[i].len > 0) {
+        // (a used glyph may have an empty description, e.g. a space)
+        if (locaTable[i].len > 0 || (i < nGlyphs && !keepGlyphs.empty() && keepGlyphs[i])) {
             *maxUsedGlyph = i;
         }
     }
@@ -111,8 +111,10 @@ public:
     // <encoding> array specifies the mapping from char codes to names.
     // If <encoding> is NULL, the encoding is unknown or undefined.  The
     // <codeToGID> array specifies the mapping from char codes to GIDs.
-    // (Not useful for OpenType CFF fonts.)
-    void convertToType42(const std::string &psName, const std::array<const char *, 256> *encoding, const std::vector<int> &codeToGID, FoFiOutputFunc outputFunc, void *outputStream) const;
+    // If <usedCodes> is non-NULL, only the glyphs of the char codes set
+    // in it are written, see cvtSfnts().  (Not useful for OpenType CFF
+    // fonts.)
+    void convertToType42(const std::string &psName, const std::array<const char *, 256> *encoding, const std::vector<int> &codeToGID, const std::vector<bool> *usedCodes, FoFiOutputFunc outputFunc, void *outputStream) const;
 
     // Convert to a Type 1 font, suitable for embedding in a PostScript
     // file.  This is only useful with 8-bit fonts.  <psName> is
@@ -124,25 +126,30 @@ public:
     // PostScript file.  <psName> will be used as the PostScript font
     // name (so we don't need to depend on the 'name' table in the
     // font).  The <cidMap> array maps CIDs to GIDs; it has <nCIDs>
-    // entries.  (Not useful for OpenType CFF fonts.)
-    void convertToCIDType2(const std::string &psName, const std::vector<int> &cidMap, bool needVerticalMetrics, FoFiOutputFunc outputFunc, void *outputStream) const;
+    // entries.  If <usedCIDs> is non-NULL, only the glyphs of the CIDs
+    // set in it are written.  (Not useful for OpenType CFF fonts.)
+    void convertToCIDType2(const std::string &psName, const std::vector<int> &cidMap, const std::vector<bool> *usedCIDs, bool needVerticalMetrics, FoFiOutputFunc outputFunc, void *outputStream) const;
 
     // Convert to a Type 0 CIDFont, suitable for embedding in a
     // PostScript file.  <psName> will be used as the PostScript font
-    // name.  (Only useful for OpenType CFF fonts.)
-    void convertToCIDType0(const std::string &psName, const std::vector<int> &cidMap, FoFiOutputFunc outputFunc, void *outputStream) const;
+    // name.  If <usedCIDs> is non-NULL, only the glyphs of the CIDs set
+    // in it are written.  (Only useful for OpenType CFF fonts.)
+    void convertToCIDType0(const std::string &psName, const std::vector<int> &cidMap, const std::vector<bool> *usedCIDs, FoFiOutputFunc outputFunc, void *outputStream) const;
 
     // Convert to a Type 0 (but non-CID) composite font, suitable for
     // embedding in a PostScript file.  <psName> will be used as the
     // PostScript font name (so we don't need to depend on the 'name'
     // table in the font).  The <cidMap> array maps CIDs to GIDs; it has
-    // <nCIDs> entries.  (Not useful for OpenType CFF fonts.)
-    void convertToType0(const std::string &psName, const std::vector<int> &cidMap, bool needVerticalMetrics, int *maxValidGlyph, FoFiOutputFunc outputFunc, void *outputStream) const;
+    // <nCIDs> entries.  If <usedCIDs> is non-NULL, only the glyphs of the
+    // CIDs set in it are written.  (Not useful for OpenType CFF fonts.)
+    void convertToType0(const std::string &psName, const std::vector<int> &cidMap, const std::vector<bool> *usedCIDs, bool needVerticalMetrics, int *maxValidGlyph, FoFiOutputFunc outputFunc, void *outputStream) const;
 
     // Convert to a Type 0 (but non-CID) composite font, suitable for
     // embedding in a PostScript file.  <psName> will be used as the
-    // PostScript font name.  (Only useful for OpenType CFF fonts.)
-    void convertToType0(const std::string &psName, const std::vector<int> &cidMap, FoFiOutputFunc outputFunc, void *outputStream) const;
+    // PostScript font name.  If <usedCIDs> is non-NULL, only the glyphs
+    // of the CIDs set in it are written.  (Only useful for OpenType CFF
+    // fonts.)
+    void convertToType0(const std::string &psName, const std::vector<int> &cidMap, const std::vector<bool> *usedCIDs, FoFiOutputFunc outputFunc, void *outputStream) const;
 
     // Returns a pointer to the CFF font embedded in this OpenType font.
     // If successful, sets *<start> and *<length>, and returns true.
@@ -158,7 +165,7 @@ public:
 private:
     static void cvtEncoding(const std::array<const char *, 256> *encoding, FoFiOutputFunc outputFunc, void *outputStream);
     void cvtCharStrings(const std::array<const char *, 256> *encoding, const std::vector<int> &codeToGID, FoFiOutputFunc outputFunc, void *outputStream) const;
-    void cvtSfnts(FoFiOutputFunc outputFunc, void *outputStream, const std::optional<std::string> &name, bool needVerticalMetrics, int *maxUsedGlyph) const;
+    void cvtSfnts(FoFiOutputFunc outputFunc, void *outputStream, const std::optional<std::string> &name, bool needVerticalMetrics, const std::vector<bool> *usedGlyphs, int *maxUsedGlyph) const;
     static void dumpString(std::span<const unsigned char> s, FoFiOutputFunc outputFunc, void *outputStream);
     static unsigned int computeTableChecksum(std::span<const unsigned char> data);
     void parse();
@@ -29,6 +29,7 @@
 
 #include <config.h>
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 #include <cmath>
@@ -406,7 +407,7 @@ void FoFiType1C::convertToType1(const char *psName, FoFiOutputFunc outputFunc, v
     (*outputFunc)(outputStream, "cleartomark\n");
 }
 
-void FoFiType1C::convertToCIDType0(const std::string &psName, const std::vector<int> &codeMap, FoFiOutputFunc outputFunc, void *outputStream)
+void FoFiType1C::convertToCIDType0(const std::string &psName, const std::vector<int> &codeMap, const std::vector<bool> *usedCIDs, FoFiOutputFunc outputFunc, void *outputStream)
 {
     std::vector<int> cidMap;
     std::string charStrings;
@@ -446,6 +447,20 @@ void FoFiType1C::convertToCIDType0(const std::string &psName, const std::vector<
         }
     }
 
+    // drop the unused CIDs (but always keep CID 0, .notdef); CIDs after
+    // the last one used are left out of the font altogether
+    if (usedCIDs) {
+        size_t nCIDs = 1;
+        for (size_t i = 1; i < cidMap.size(); ++i) {
+            if (i < usedCIDs->size() && (*usedCIDs)[i]) {
+                nCIDs = i + 1;
+            } else {
+                cidMap[i] = -1;
+            }
+        }
+        cidMap.resize(std::min(nCIDs, cidMap.size()));
+    }
+
     // build the charstrings
     charStringOffsets = static_cast<int *>(gmallocn(cidMap.size() + 1, sizeof(int)));
     for (size_t i = 0; i < cidMap.size(); ++i) {
@@ -697,7 +712,7 @@ void FoFiType1C::convertToCIDType0(const std::string &psName, const std::vector<
     gfree(charStringOffsets);
 }
 
-void FoFiType1C::convertToType0(const std::string &psName, const std::vector<int> &codeMap, FoFiOutputFunc outputFunc, void *outputStream)
+void FoFiType1C::convertToType0(const std::string &psName, const std::vector<int> &codeMap, const std::vector<bool> *usedCIDs, FoFiOutputFunc outputFunc, void *outputStream)
 {
     std::vector<int> cidMap;
     Type1CIndex subrIdx;
@@ -735,6 +750,15 @@ void FoFiType1C::convertToType0(const std::string &psName, const std::vector<int
         }
     }
 
+    // drop the unused CIDs (but always keep CID 0, .notdef)
+    if (usedCIDs) {
+        for (size_t i = 1; i < cidMap.size(); ++i) {
+            if (i >= usedCIDs->size() || !(*usedCIDs)[i]) {
+                cidMap[i] = -1;
+            }
+        }
+    }
+
     if (privateDicts) {
         // write the descendant Type 1 fonts
         for (int i = 0; i < static_cast<int>(cidMap.size()); i += 256) {
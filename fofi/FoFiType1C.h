@@ -190,7 +190,9 @@ public:
     //     font's internal CID-to-GID mapping is used
     // (3) is <codeMap> is NULL and this is an 8-bit CFF font, then
     //     the identity CID-to-GID mapping is used
-    void convertToCIDType0(const std::string &psName, const std::vector<int> &codeMap, FoFiOutputFunc outputFunc, void *outputStream);
+    // If <usedCIDs> is non-NULL, only the glyphs of the CIDs set in it
+    // are written, and CIDCount stops after the last of them.
+    void convertToCIDType0(const std::string &psName, const std::vector<int> &codeMap, const std::vector<bool> *usedCIDs, FoFiOutputFunc outputFunc, void *outputStream);
 
     // Convert to a Type 0 (but non-CID) composite font, suitable for
     // embedding in a PostScript file.  <psName> will be used as the
@@ -201,7 +203,9 @@ public:
     //     font's internal CID-to-GID mapping is used
     // (3) is <codeMap> is NULL and this is an 8-bit CFF font, then
     //     the identity CID-to-GID mapping is used
-    void convertToType0(const std::string &psName, const std::vector<int> &codeMap, FoFiOutputFunc outputFunc, void *outputStream);
+    // If <usedCIDs> is non-NULL, only the glyphs of the CIDs set in it
+    // are written.
+    void convertToType0(const std::string &psName, const std::vector<int> &codeMap, const std::vector<bool> *usedCIDs, FoFiOutputFunc outputFunc, void *outputStream);
 
     explicit FoFiType1C(std::vector<unsigned char> &&fileA, PrivateTag /*unused*/ = {});
     explicit FoFiType1C(std::span<const unsigned char> data, PrivateTag /*unused*/ = {});
@@ -19,8 +19,12 @@
 #if ENABLE_LIBPNG
 
 #    include <zlib.h>
+#    include <algorithm>
+#    include <atomic>
 #    include <cstdlib>
 #    include <cstring>
+#    include <thread>
+#    include <vector>
 
 #    include "poppler/Error.h"
 #    include "goo/gmem.h"
@@ -38,11 +42,263 @@ struct PNGWriterPrivate
     int icc_data_size = 0;
     char *icc_name = nullptr;
     bool sRGB_profile = false;
+    int compressionLevel = Z_BEST_COMPRESSION;
+    PNGWriter::Filter filter = PNGWriter::FILTER_DEFAULT;
+
+    // With more than one thread the image data is not compressed by
+    // libpng: the rows are buffered and split into bands, which are
+    // filtered and deflated in parallel and written as IDAT chunks
+    // (see flushBands).
+    int nThreads = 1;
+    size_t rowBytes = 0; // bytes per row, without the filter type byte
+    size_t bpp = 1; // bytes per complete pixel, at least one
+    int height = 0;
+    int bandRows = 0; // rows per band
+    int contextRows = 0; // rows kept before a band to prime its dictionary
+    int pngFilter = -1; // PNG filter type for every row, -1 for adaptive
+    int firstRow = 0; // index of the first row in rows
+    int bandStart = 0; // index of the first row not compressed yet
+    int nextRow = 0; // index of the next row to be written
+    std::vector<unsigned char> rows; // raw rows firstRow .. nextRow - 1
+    uLong adler = 1; // adler32 of the filtered data compressed so far
+    bool headerWritten = false;
+
+    bool writeRowParallel(const unsigned char *row);
+    bool flushBands();
+    void compressBand(int start, int end, std::vector<unsigned char> *out, uLong *bandAdler) const;
 
     PNGWriterPrivate(const PNGWriterPrivate &) = delete;
     PNGWriterPrivate &operator=(const PNGWriterPrivate &) = delete;
 };
 
+// Rows are compressed in bands of about this many bytes.
+static constexpr size_t pngBandBytes = 256 * 1024;
+
+// The deflate window, the most a band can refer back into the previous
+// one.
+static constexpr size_t pngWindowBytes = 32768;
+
+// Apply the PNG filter type to bytes begin .. end - 1 of row, writing
+// the filtered bytes to out.  prev is the row above, all zeros for the
+// first row.  The first pixel, which has no left neighbour, is done
+// apart so that the main loops have no branches.
+static void applyFilter(int type, const unsigned char *row, const unsigned char *prev, size_t begin, size_t end, size_t bpp, unsigned char *out)
+{
+    const size_t first = std::clamp(bpp, begin, end);
+    switch (type) {
+    case PNG_FILTER_VALUE_NONE:
+        memcpy(out + begin, row + begin, end - begin);
+        break;
+    case PNG_FILTER_VALUE_SUB:
+        memcpy(out + begin, row + begin, first - begin);
+        for (size_t i = first; i < end; ++i) {
+            out[i] = row[i] - row[i - bpp];
+        }
+        break;
+    case PNG_FILTER_VALUE_UP:
+        for (size_t i = begin; i < end; ++i) {
+            out[i] = row[i] - prev[i];
+        }
+        break;
+    case PNG_FILTER_VALUE_AVG:
+        for (size_t i = begin; i < first; ++i) {
+            out[i] = row[i] - (prev[i] >> 1);
+        }
+        for (size_t i = first; i < end; ++i) {
+            out[i] = row[i] - ((row[i - bpp] + prev[i]) >> 1);
+        }
+        break;
+    case PNG_FILTER_VALUE_PAETH:
+        for (size_t i = begin; i < first; ++i) {
+            out[i] = row[i] - prev[i];
+        }
+        for (size_t i = first; i < end; ++i) {
+            const int a = row[i - bpp];
+            const int b = prev[i];
+            const int c = prev[i - bpp];
+            const int pa = abs(b - c);
+            const int pb = abs(a - c);
+            const int pc = abs(a + b - 2 * c);
+            const int pred = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+            out[i] = row[i] - pred;
+        }
+        break;
+    }
+}
+
+// Filter row into out: the filter type byte followed by rowBytes
+// filtered bytes.  With a type of -1 the filter is chosen as libpng
+// does: the one giving the smallest sum of the filtered bytes taken as
+// signed values.  A filter is given up as soon as its partial sum is
+// not smaller than the best one.  scratch holds rowBytes + 1 bytes.
+static void filterRow(int type, const unsigned char *row, const unsigned char *prev, size_t rowBytes, size_t bpp, unsigned char *out, unsigned char *scratch)
+{
+    if (type >= 0) {
+        out[0] = static_cast<unsigned char>(type);
+        applyFilter(type, row, prev, 0, rowBytes, bpp, out + 1);
+        return;
+    }
+    static constexpr size_t chunkBytes = 1024;
+    unsigned char *best = out;
+    unsigned char *trial = scratch;
+    unsigned long bestSum = 0;
+    for (int t = PNG_FILTER_VALUE_NONE; t < PNG_FILTER_VALUE_LAST; ++t) {
+        trial[0] = static_cast<unsigned char>(t);
+        unsigned long sum = 0;
+        size_t begin = 0;
+        for (; begin < rowBytes && (t == PNG_FILTER_VALUE_NONE || sum < bestSum); begin += chunkBytes) {
+            const size_t end = std::min(begin + chunkBytes, rowBytes);
+            applyFilter(t, row, prev, begin, end, bpp, trial + 1);
+            for (size_t i = begin + 1; i <= end; ++i) {
+                const unsigned char v = trial[i];
+                sum += std::min<unsigned char>(v, static_cast<unsigned char>(-v));
+            }
+        }
+        if (t == PNG_FILTER_VALUE_NONE || (begin >= rowBytes && sum < bestSum)) {
+            bestSum = sum;
+            std::swap(best, trial);
+        }
+    }
+    if (best != out) {
+        memcpy(out, best, rowBytes + 1);
+    }
+}
+
+static bool writeChunk(png_structp png_ptr, const char *name, const unsigned char *data, size_t size)
+{
+    if (setjmp(png_jmpbuf(png_ptr))) {
+        error(errInternal, -1, "Error during writing png {0:s} chunk", name);
+        return false;
+    }
+    png_write_chunk(png_ptr, reinterpret_cast<png_const_bytep>(name), data, size);
+    return true;
+}
+
+// Deflate rows start .. end - 1 as a raw deflate stream, primed with the
+// filtered data of the rows before start, and ended with a sync flush or,
+// for the last band of the image, as the final block.  This is how pigz
+// compresses in parallel: the band streams concatenate into one stream.
+void PNGWriterPrivate::compressBand(int start, int end, std::vector<unsigned char> *out, uLong *bandAdler) const
+{
+    const size_t filteredBytes = rowBytes + 1;
+    std::vector<unsigned char> zeros(rowBytes, 0);
+    std::vector<unsigned char> scratch(filteredBytes);
+    std::vector<unsigned char> filtered;
+    auto rowAt = [&](int y) { return y < 0 ? zeros.data() : rows.data() + static_cast<size_t>(y - firstRow) * rowBytes; };
+
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    // libpng uses Z_FILTERED whenever the rows are filtered
+    deflateInit2(&z, compressionLevel, Z_DEFLATED, -MAX_WBITS, 8, pngFilter == PNG_FILTER_VALUE_NONE ? Z_DEFAULT_STRATEGY : Z_FILTERED);
+
+    const int dictStart = std::max(0, start - (contextRows - 1));
+    if (dictStart < start) {
+        filtered.resize(static_cast<size_t>(start - dictStart) * filteredBytes);
+        for (int y = dictStart; y < start; ++y) {
+            filterRow(pngFilter, rowAt(y), rowAt(y - 1), rowBytes, bpp, filtered.data() + static_cast<size_t>(y - dictStart) * filteredBytes, scratch.data());
+        }
+        const size_t dictBytes = std::min(filtered.size(), pngWindowBytes);
+        deflateSetDictionary(&z, filtered.data() + filtered.size() - dictBytes, static_cast<uInt>(dictBytes));
+    }
+
+    filtered.resize(filteredBytes);
+    uLong a = adler32(0, nullptr, 0);
+    size_t used = 0;
+    for (int y = start; y < end; ++y) {
+        filterRow(pngFilter, rowAt(y), rowAt(y - 1), rowBytes, bpp, filtered.data(), scratch.data());
+        a = adler32(a, filtered.data(), static_cast<uInt>(filteredBytes));
+        int flush = Z_NO_FLUSH;
+        if (y == end - 1) {
+            flush = end == height ? Z_FINISH : Z_SYNC_FLUSH;
+        }
+        z.next_in = filtered.data();
+        z.avail_in = static_cast<uInt>(filteredBytes);
+        do {
+            const size_t chunk = std::max(filteredBytes, static_cast<size_t>(16384));
+            out->resize(used + chunk);
+            z.next_out = out->data() + used;
+            z.avail_out = static_cast<uInt>(chunk);
+            deflate(&z, flush);
+            used += chunk - z.avail_out;
+        } while (z.avail_out == 0);
+    }
+    out->resize(used);
+    deflateEnd(&z);
+    *bandAdler = a;
+}
+
+bool PNGWriterPrivate::writeRowParallel(const unsigned char *row)
+{
+    if (nextRow >= height) {
+        error(errInternal, -1, "PNGWriter: too many rows written");
+        return false;
+    }
+    rows.insert(rows.end(), row, row + rowBytes);
+    ++nextRow;
+    if (nextRow - bandStart < nThreads * bandRows && nextRow < height) {
+        return true;
+    }
+    return flushBands();
+}
+
+// Compress the buffered rows, one band per thread, and write them.  The
+// zlib header goes before the first band and the adler32 of the whole
+// filtered image after the last one.
+bool PNGWriterPrivate::flushBands()
+{
+    const int nBands = (nextRow - bandStart + bandRows - 1) / bandRows;
+    std::vector<std::vector<unsigned char>> out(nBands);
+    std::vector<uLong> bandAdlers(nBands);
+    std::atomic<int> nextBand = 0;
+    auto compressBands = [&]() {
+        int band;
+        while ((band = nextBand++) < nBands) {
+            const int start = bandStart + band * bandRows;
+            compressBand(start, std::min(start + bandRows, nextRow), &out[band], &bandAdlers[band]);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int i = 1; i < std::min(nThreads, nBands); ++i) {
+        threads.emplace_back(compressBands);
+    }
+    compressBands();
+    for (std::thread &t : threads) {
+        t.join();
+    }
+
+    if (!headerWritten) {
+        // CMF: deflate with a 32K window; FLG: FLEVEL as zlib sets it and
+        // FCHECK
+        const unsigned char cmf = 0x78;
+        unsigned char flg = compressionLevel < 2 ? 0 : compressionLevel < 6 ? 1 : compressionLevel == 6 ? 2 : 3;
+        flg <<= 6;
+        flg += 31 - ((cmf << 8) + flg) % 31;
+        out[0].insert(out[0].begin(), { cmf, flg });
+        headerWritten = true;
+    }
+    for (int band = 0; band < nBands; ++band) {
+        const int start = bandStart + band * bandRows;
+        const int end = std::min(start + bandRows, nextRow);
+        adler = adler32_combine(adler, bandAdlers[band], static_cast<z_off_t>(end - start) * static_cast<z_off_t>(rowBytes + 1));
+    }
+    if (nextRow == height) {
+        out[nBands - 1].insert(out[nBands - 1].end(),
+                               { static_cast<unsigned char>(adler >> 24), static_cast<unsigned char>(adler >> 16), static_cast<unsigned char>(adler >> 8), static_cast<unsigned char>(adler) });
+    }
+    for (const std::vector<unsigned char> &data : out) {
+        if (!writeChunk(png_ptr, "IDAT", data.data(), data.size())) {
+            return false;
+        }
+    }
+
+    // keep the rows the next band's dictionary is built from
+    const int keepFrom = std::max(firstRow, nextRow - contextRows);
+    rows.erase(rows.begin(), rows.begin() + static_cast<ptrdiff_t>(keepFrom - firstRow) * static_cast<ptrdiff_t>(rowBytes));
+    firstRow = keepFrom;
+    bandStart = nextRow;
+    return true;
+}
+
 PNGWriter::PNGWriter(Format formatA)
 {
     priv = new PNGWriterPrivate(formatA);
@@ -73,6 +329,16 @@ void PNGWriter::setSRGBProfile()
     priv->sRGB_profile = true;
 }
 
+void PNGWriter::setCompressionLevel(int level)
+{
+    priv->compressionLevel = std::clamp(level, 0, 9);
+}
+
+void PNGWriter::setFilter(Filter filter)
+{
+    priv->filter = filter;
+}
+
 bool PNGWriter::init(FILE *f, int width, int height, double hDPI, double vDPI)
 {
     const auto *icc_data_ptr = const_cast<png_const_bytep>(priv->icc_data);
@@ -115,7 +381,7 @@ bool PNGWriter::init(FILE *f, int width, int height, double hDPI, double vDPI)
     }
 
     // Set up the type of PNG image and the compression level
-    png_set_compression_level(priv->png_ptr, Z_BEST_COMPRESSION);
+    png_set_compression_level(priv->png_ptr, priv->compressionLevel);
 
     // Silence silly gcc
     png_byte bit_depth = -1;
@@ -154,6 +420,45 @@ bool PNGWriter::init(FILE *f, int width, int height, double hDPI, double vDPI)
         png_set_sRGB(priv->png_ptr, priv->info_ptr, PNG_sRGB_INTENT_RELATIVE);
     }
 
+    switch (priv->filter) {
+    case FILTER_DEFAULT:
+        priv->pngFilter = bit_depth < 8 ? PNG_FILTER_VALUE_NONE : -1;
+        break;
+    case FILTER_NONE:
+        priv->pngFilter = PNG_FILTER_VALUE_NONE;
+        break;
+    case FILTER_SUB:
+        priv->pngFilter = PNG_FILTER_VALUE_SUB;
+        break;
+    case FILTER_UP:
+        priv->pngFilter = PNG_FILTER_VALUE_UP;
+        break;
+    case FILTER_AVERAGE:
+        priv->pngFilter = PNG_FILTER_VALUE_AVG;
+        break;
+    case FILTER_PAETH:
+        priv->pngFilter = PNG_FILTER_VALUE_PAETH;
+        break;
+    case FILTER_ADAPTIVE:
+        priv->pngFilter = -1;
+        break;
+    }
+    if (priv->filter != FILTER_DEFAULT) {
+        png_set_filter(priv->png_ptr, PNG_FILTER_TYPE_BASE, priv->pngFilter < 0 ? PNG_ALL_FILTERS : (PNG_FILTER_NONE << priv->pngFilter));
+    }
+
+    priv->rowBytes = png_get_rowbytes(priv->png_ptr, priv->info_ptr);
+    priv->bpp = static_cast<size_t>(std::max(1, png_get_channels(priv->png_ptr, priv->info_ptr) * bit_depth / 8));
+    priv->height = height;
+    priv->bandRows = static_cast<int>(std::max(static_cast<size_t>(1), pngBandBytes / (priv->rowBytes + 1)));
+    priv->contextRows = static_cast<int>((pngWindowBytes + priv->rowBytes) / (priv->rowBytes + 1)) + 1;
+    // at least one thread, even for an empty image
+    priv->nThreads = std::clamp(static_cast<int>(std::thread::hardware_concurrency()), 1, std::max(1, (height + priv->bandRows - 1) / priv->bandRows));
+    priv->firstRow = priv->bandStart = priv->nextRow = 0;
+    priv->rows.clear();
+    priv->adler = adler32(0, nullptr, 0);
+    priv->headerWritten = false;
+
     png_write_info(priv->png_ptr, priv->info_ptr);
     if (setjmp(png_jmpbuf(priv->png_ptr))) {
         error(errInternal, -1, "error during writing png info bytes");
@@ -163,8 +468,17 @@ bool PNGWriter::init(FILE *f, int width, int height, double hDPI, double vDPI)
     return true;
 }
 
-bool PNGWriter::writePointers(unsigned char **rowPointers, int /*rowCount*/)
+bool PNGWriter::writePointers(unsigned char **rowPointers, int rowCount)
 {
+    if (priv->nThreads > 1) {
+        for (int y = 0; y < rowCount; ++y) {
+            if (!priv->writeRowParallel(rowPointers[y])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
     png_write_image(priv->png_ptr, rowPointers);
     /* write bytes */
     if (setjmp(png_jmpbuf(priv->png_ptr))) {
@@ -177,6 +491,10 @@ bool PNGWriter::writePointers(unsigned char **rowPointers, int /*rowCount*/)
 
 bool PNGWriter::writeRow(unsigned char **row)
 {
+    if (priv->nThreads > 1) {
+        return priv->writeRowParallel(*row);
+    }
+
     // Write the row to the file
     png_write_rows(priv->png_ptr, row, 1);
     if (setjmp(png_jmpbuf(priv->png_ptr))) {
@@ -189,6 +507,15 @@ bool PNGWriter::writeRow(unsigned char **row)
 
 bool PNGWriter::close()
 {
+    if (priv->nThreads > 1) {
+        if (priv->nextRow != priv->height) {
+            error(errInternal, -1, "PNGWriter: {0:d} of {1:d} rows written", priv->nextRow, priv->height);
+            return false;
+        }
+        // png_write_end would complain that libpng wrote no IDAT
+        return writeChunk(priv->png_ptr, "IEND", nullptr, 0);
+    }
+
     /* end write */
     png_write_end(priv->png_ptr, priv->info_ptr);
     if (setjmp(png_jmpbuf(priv->png_ptr))) {
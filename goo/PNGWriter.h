@@ -43,6 +43,22 @@ public:
         RGB48
     };
 
+    /* The filter applied to each row before compression.  FILTER_DEFAULT
+     * is FILTER_ADAPTIVE for 8 and 16 bit formats and FILTER_NONE for
+     * MONOCHROME, as libpng does.  FILTER_ADAPTIVE picks the filter per
+     * row.
+     */
+    enum Filter
+    {
+        FILTER_DEFAULT,
+        FILTER_NONE,
+        FILTER_SUB,
+        FILTER_UP,
+        FILTER_AVERAGE,
+        FILTER_PAETH,
+        FILTER_ADAPTIVE
+    };
+
     explicit PNGWriter(Format format = RGB);
     ~PNGWriter() override;
 
@@ -51,6 +67,9 @@ public:
 
     void setICCProfile(const char *name, unsigned char *data, int size);
     void setSRGBProfile();
+    // zlib compression level, 0 - 9.  Defaults to 9.
+    void setCompressionLevel(int level);
+    void setFilter(Filter filter);
 
     bool init(FILE *f, int width, int height, double hDPI, double vDPI) override;
 
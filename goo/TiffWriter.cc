@@ -16,7 +16,12 @@
 
 #if ENABLE_LIBTIFF
 
+#    include <zlib.h>
+#    include <algorithm>
+#    include <atomic>
 #    include <cstring>
+#    include <thread>
+#    include <vector>
 
 #    ifdef _WIN32
 #        include <io.h>
@@ -35,8 +40,87 @@ struct TiffWriterPrivate
     int curRow; // number of rows written
     const char *compressionString; // compression type
     TiffWriter::Format format; // format of image data
+
+    // Deflate compressed strips are compressed here, in parallel, rather
+    // than by libtiff: the rows of a batch of strips are buffered and the
+    // strips are written with TIFFWriteRawStrip.
+    int nThreads; // 1 if libtiff compresses the strips
+    uint32_t rowsPerStrip; // number of rows in a strip
+    size_t rowBytes; // bytes per row
+    int batchRows; // number of rows in a batch of strips
+    int batchStart; // index of the first buffered row
+    std::vector<unsigned char> rows; // buffered rows batchStart .. curRow - 1
+
+    bool writeRowParallel(const unsigned char *row);
+    bool flushStrips();
 };
 
+// Each thread compresses about this many bytes of strips per batch.
+static constexpr size_t tiffBatchBytesPerThread = 256 * 1024;
+
+bool TiffWriterPrivate::writeRowParallel(const unsigned char *row)
+{
+    if (curRow >= numRows) {
+        fprintf(stderr, "TiffWriter: Error writing tiff row %d\n", curRow);
+        return false;
+    }
+    rows.insert(rows.end(), row, row + rowBytes);
+    curRow++;
+    if (curRow - batchStart < batchRows && curRow < numRows) {
+        return true;
+    }
+    return flushStrips();
+}
+
+// Compress the buffered strips, each one to a zlib stream as libtiff's
+// deflate codec does, and write them in order.
+bool TiffWriterPrivate::flushStrips()
+{
+    const int nStrips = static_cast<int>((curRow - batchStart + rowsPerStrip - 1) / rowsPerStrip);
+    const uint32_t firstStrip = static_cast<uint32_t>(batchStart) / rowsPerStrip;
+    std::vector<std::vector<unsigned char>> out(nStrips);
+    std::atomic<int> nextStrip = 0;
+    auto compressStrips = [&]() {
+        z_stream z;
+        memset(&z, 0, sizeof(z));
+        deflateInit(&z, Z_DEFAULT_COMPRESSION);
+        int strip;
+        while ((strip = nextStrip++) < nStrips) {
+            const int start = strip * static_cast<int>(rowsPerStrip);
+            const int end = std::min(start + static_cast<int>(rowsPerStrip), curRow - batchStart);
+            const size_t size = static_cast<size_t>(end - start) * rowBytes;
+            deflateReset(&z);
+            out[strip].resize(deflateBound(&z, size));
+            z.next_in = rows.data() + static_cast<size_t>(start) * rowBytes;
+            z.avail_in = static_cast<uInt>(size);
+            z.next_out = out[strip].data();
+            z.avail_out = static_cast<uInt>(out[strip].size());
+            deflate(&z, Z_FINISH);
+            out[strip].resize(z.total_out);
+        }
+        deflateEnd(&z);
+    };
+    std::vector<std::thread> threads;
+    for (int i = 1; i < std::min(nThreads, nStrips); ++i) {
+        threads.emplace_back(compressStrips);
+    }
+    compressStrips();
+    for (std::thread &t : threads) {
+        t.join();
+    }
+
+    for (int strip = 0; strip < nStrips; ++strip) {
+        if (TIFFWriteRawStrip(f, firstStrip + strip, out[strip].data(), static_cast<tmsize_t>(out[strip].size())) < 0) {
+            fprintf(stderr, "TiffWriter: Error writing tiff strip %u\n", firstStrip + strip);
+            return false;
+        }
+    }
+
+    rows.clear();
+    batchStart = curRow;
+    return true;
+}
+
 TiffWriter::~TiffWriter()
 {
     delete priv;
@@ -50,6 +134,11 @@ TiffWriter::TiffWriter(Format formatA)
     priv->curRow = 0;
     priv->compressionString = nullptr;
     priv->format = formatA;
+    priv->nThreads = 1;
+    priv->rowsPerStrip = 1;
+    priv->rowBytes = 0;
+    priv->batchRows = 0;
+    priv->batchStart = 0;
 }
 
 // Set the compression type
@@ -185,7 +274,8 @@ bool TiffWriter::init(FILE *openedFile, int width, int height, double hDPI, doub
     TIFFSetField(priv->f, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
     TIFFSetField(priv->f, TIFFTAG_PHOTOMETRIC, photometric);
     TIFFSetField(priv->f, TIFFTAG_COMPRESSION, static_cast<uint16_t>(compression));
-    TIFFSetField(priv->f, TIFFTAG_ROWSPERSTRIP, TIFFDefaultStripSize(priv->f, rowsperstrip));
+    priv->rowsPerStrip = TIFFDefaultStripSize(priv->f, rowsperstrip);
+    TIFFSetField(priv->f, TIFFTAG_ROWSPERSTRIP, priv->rowsPerStrip);
     TIFFSetField(priv->f, TIFFTAG_XRESOLUTION, hDPI);
     TIFFSetField(priv->f, TIFFTAG_YRESOLUTION, vDPI);
     TIFFSetField(priv->f, TIFFTAG_RESOLUTIONUNIT, RESUNIT_INCH);
@@ -200,6 +290,21 @@ bool TiffWriter::init(FILE *openedFile, int width, int height, double hDPI, doub
         TIFFSetField(priv->f, TIFFTAG_NUMBEROFINKS, 4);
     }
 
+    // Compress deflate strips in parallel when the image has more than
+    // one batch of them
+    priv->rowBytes = static_cast<size_t>(TIFFScanlineSize(priv->f));
+    const size_t stripBytes = std::max(static_cast<size_t>(1), priv->rowsPerStrip * priv->rowBytes);
+    const auto stripsPerThread = static_cast<int>(std::max(static_cast<size_t>(1), tiffBatchBytesPerThread / stripBytes));
+    const int nStrips = static_cast<int>((static_cast<uint32_t>(height) + priv->rowsPerStrip - 1) / priv->rowsPerStrip);
+    priv->nThreads = 1;
+    if (compression == COMPRESSION_DEFLATE || compression == COMPRESSION_ADOBE_DEFLATE) {
+        // at least one thread, even for an empty image
+        priv->nThreads = std::clamp(static_cast<int>(std::thread::hardware_concurrency()), 1, std::max(1, (nStrips + stripsPerThread - 1) / stripsPerThread));
+    }
+    priv->batchRows = priv->nThreads * stripsPerThread * static_cast<int>(priv->rowsPerStrip);
+    priv->batchStart = 0;
+    priv->rows.clear();
+
     return true;
 }
 
@@ -207,6 +312,15 @@ bool TiffWriter::writePointers(unsigned char **rowPointers, int rowCount)
 {
     // Write all rows to the file
 
+    if (priv->nThreads > 1) {
+        for (int row = 0; row < rowCount; row++) {
+            if (!priv->writeRowParallel(rowPointers[row])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
     for (int row = 0; row < rowCount; row++) {
         if (TIFFWriteScanline(priv->f, rowPointers[row], row, 0) < 0) {
             fprintf(stderr, "TiffWriter: Error writing tiff row %d\n", row);
@@ -221,6 +335,10 @@ bool TiffWriter::writeRow(unsigned char **rowData)
 {
     // Add a single row
 
+    if (priv->nThreads > 1) {
+        return priv->writeRowParallel(*rowData);
+    }
+
     if (TIFFWriteScanline(priv->f, *rowData, priv->curRow, 0) < 0) {
         fprintf(stderr, "TiffWriter: Error writing tiff row %d\n", priv->curRow);
         return false;
@@ -50,6 +50,9 @@
 #include <config.h>
 
 #include <cstring>
+#include <functional>
+#include <mutex>
+#include <string_view>
 #include "CairoFontEngine.h"
 #include "CairoOutputDev.h"
 #include "GlobalParams.h"
@@ -173,9 +176,81 @@ CairoFreeTypeFont::CairoFreeTypeFont(Ref refA, cairo_font_face_t *cairo_font_fac
 
 CairoFreeTypeFont::~CairoFreeTypeFont() = default;
 
+// Process-wide cache of the FreeType faces created below, shared by the
+// CairoFontEngines of all documents so that a font file (or identical
+// embedded font data) is only loaded once.  Each entry holds a
+// reference to its cairo_font_face_t; the most recently used entry is at
+// the end of the vector.  The cache is bounded by its number of entries
+// and by the size of the embedded font data they keep alive, as set by
+// GlobalParams::setFontFaceCacheLimits.
+struct FreeTypeFontFaceCacheEntry
+{
+    FT_Library lib;
+    std::string filename;
+    size_t hash;
+    int faceIndex;
+    FreeTypeFontFace font_face;
+};
+
+static std::mutex ftFontFaceCacheMutex;
+static std::vector<FreeTypeFontFaceCacheEntry> ftFontFaceCache;
+static size_t ftFontFaceCacheDataUsed = 0;
+
+static size_t getFontDataSize(const FreeTypeFontFace &font_face)
+{
+    return static_cast<FreeTypeFontResource *>(cairo_font_face_get_user_data(font_face.cairo_font_face, &ft_cairo_key))->font_data.size();
+}
+
+// Drop the least recently used entries of the cache until there are at
+// most <maxFaces> of them, with at most <maxDataSize> bytes of embedded
+// font data.  ftFontFaceCacheMutex must be held.
+static void trimFtFontFaceCache(size_t maxFaces, size_t maxDataSize)
+{
+    size_t nEvicted = 0;
+    while (nEvicted < ftFontFaceCache.size() && (ftFontFaceCache.size() - nEvicted > maxFaces || ftFontFaceCacheDataUsed > maxDataSize)) {
+        const FreeTypeFontFace &evicted = ftFontFaceCache[nEvicted].font_face;
+        ftFontFaceCacheDataUsed -= getFontDataSize(evicted);
+        cairo_font_face_destroy(evicted.cairo_font_face);
+        ++nEvicted;
+    }
+    ftFontFaceCache.erase(ftFontFaceCache.begin(), ftFontFaceCache.begin() + nEvicted);
+}
+
 // Create a cairo_font_face_t for the given font filename OR font data.
 std::optional<FreeTypeFontFace> CairoFreeTypeFont::createFreeTypeFontFace(FT_Library lib, const std::string &filename, int faceIndex, std::vector<unsigned char> &&font_data)
 {
+    size_t hash = 0;
+    if (!font_data.empty()) {
+        hash = std::hash<std::string_view> {}(std::string_view(reinterpret_cast<const char *>(font_data.data()), font_data.size()));
+    }
+    const size_t maxFaces = globalParams->getFontFaceCacheSize();
+    const size_t maxDataSize = globalParams->getFontFaceCacheDataSize();
+
+    std::scoped_lock lock(ftFontFaceCacheMutex);
+
+    for (auto it = ftFontFaceCache.rbegin(); it != ftFontFaceCache.rend(); ++it) {
+        if (it->lib != lib || it->faceIndex != faceIndex) {
+            continue;
+        }
+        const auto *cached = static_cast<FreeTypeFontResource *>(cairo_font_face_get_user_data(it->font_face.cairo_font_face, &ft_cairo_key));
+        bool match;
+        if (font_data.empty()) {
+            match = cached->font_data.empty() && it->filename == filename;
+        } else {
+            match = it->hash == hash && cached->font_data == font_data;
+        }
+        if (match) {
+            FreeTypeFontFace font_face = it->font_face;
+            if (it != ftFontFaceCache.rbegin()) {
+                FreeTypeFontFaceCacheEntry entry = *it;
+                ftFontFaceCache.erase(std::next(it).base());
+                ftFontFaceCache.push_back(entry);
+            }
+            cairo_font_face_reference(font_face.cairo_font_face);
+            return font_face;
+        }
+    }
+
     auto *resource = new FreeTypeFontResource;
     FreeTypeFontFace font_face;
 
@@ -202,6 +277,17 @@ std::optional<FreeTypeFontFace> CairoFreeTypeFont::createFreeTypeFontFace(FT_Lib
     }
 
     font_face.face = resource->face;
+
+    const size_t size = resource->font_data.size();
+    if (maxFaces == 0 || size > maxDataSize) {
+        // not kept once unused
+        trimFtFontFaceCache(maxFaces, maxDataSize);
+        return font_face;
+    }
+    trimFtFontFaceCache(maxFaces - 1, maxDataSize - size);
+    cairo_font_face_reference(font_face.cairo_font_face);
+    ftFontFaceCache.push_back({ lib, filename, hash, faceIndex, font_face });
+    ftFontFaceCacheDataUsed += size;
     return font_face;
 }
 
@@ -254,24 +340,42 @@ CairoFreeTypeFont *CairoFreeTypeFont::create(const std::shared_ptr<GfxFont> &gfx
 
         const std::array<const char *, 256> &enc = std::static_pointer_cast<Gfx8BitFont>(gfxFont)->getEncoding();
 
+        // The face is shared through ftFontFaceCache and may be in use by
+        // cairo on other threads: query it under cairo's lock, which is
+        // taken through a scaled font.
+        cairo_matrix_t identity;
+        cairo_matrix_init_identity(&identity);
+        cairo_font_options_t *options = cairo_font_options_create();
+        cairo_scaled_font_t *scaled_font = cairo_scaled_font_create(font_face->cairo_font_face, &identity, &identity, options);
+        cairo_font_options_destroy(options);
+        FT_Face face = cairo_ft_scaled_font_lock_face(scaled_font);
+        if (!face) {
+            cairo_scaled_font_destroy(scaled_font);
+            cairo_font_face_destroy(font_face->cairo_font_face);
+            error(errSyntaxError, -1, "could not lock type1 face");
+            goto err2;
+        }
+
         codeToGID.resize(256);
         for (i = 0; i < 256; ++i) {
             codeToGID[i] = 0;
             if ((name = enc[i])) {
-                codeToGID[i] = FT_Get_Name_Index(font_face->face, name);
+                codeToGID[i] = FT_Get_Name_Index(face, name);
                 if (codeToGID[i] == 0) {
                     Unicode u;
                     u = globalParams->mapNameToUnicodeText(name);
-                    codeToGID[i] = FT_Get_Char_Index(font_face->face, u);
+                    codeToGID[i] = FT_Get_Char_Index(face, u);
                 }
                 if (codeToGID[i] == 0) {
                     name = GfxFont::getAlternateName(name);
                     if (name) {
-                        codeToGID[i] = FT_Get_Name_Index(font_face->face, name);
+                        codeToGID[i] = FT_Get_Name_Index(face, name);
                     }
                 }
             }
         }
+        cairo_ft_scaled_font_unlock_face(scaled_font);
+        cairo_scaled_font_destroy(scaled_font);
     } break;
     case fontCIDType2:
     case fontCIDType2OT:
@@ -558,6 +662,12 @@ CairoFontEngine::CairoFontEngine(FT_Library libA)
 
 CairoFontEngine::~CairoFontEngine() = default;
 
+void CairoFontEngine::clearFontFaceCache()
+{
+    std::scoped_lock lock(ftFontFaceCacheMutex);
+    trimFtFontFaceCache(0, 0);
+}
+
 std::shared_ptr<CairoFont> CairoFontEngine::getFont(const std::shared_ptr<GfxFont> &gfxFont, PDFDoc *doc, bool printing, XRef *xref)
 {
     std::scoped_lock lock(mutex);
@@ -122,6 +122,10 @@ public:
 
     std::shared_ptr<CairoFont> getFont(const std::shared_ptr<GfxFont> &gfxFont, PDFDoc *doc, bool printing, XRef *xref);
 
+    // Empty the process-wide cache of FreeType font faces: the faces no
+    // document uses any more are freed.
+    static void clearFontFaceCache();
+
 private:
     FT_Library lib;
     mutable std::mutex mutex;
@@ -160,6 +160,7 @@ CairoOutputDev::CairoOutputDev()
     currentFont = nullptr;
     printing = true;
     use_show_text_glyphs = false;
+    useGlyphRuns = false;
     inUncoloredPattern = false;
     t3_render_state = Type3RenderNone;
     t3_glyph_has_bbox = false;
@@ -1922,6 +1923,49 @@ void CairoOutputDev::drawChar(GfxState *state, double x, double y, double dx, do
     actualText->addChar(state, x, y, dx, dy, code, nBytes, u, uLen);
 }
 
+void CairoOutputDev::drawGlyphRun(GfxState *state, const OutputGlyphRun &run)
+{
+    std::optional<int> glyphIndex;
+
+    if (currentFont) {
+        for (const OutputGlyph &glyph : run.glyphs) {
+            glyphIndex = currentFont->getGlyph(glyph.code);
+            if (glyphIndex) {
+                glyphs[glyphCount].index = *glyphIndex;
+                glyphs[glyphCount].x = glyph.x - glyph.originX;
+                glyphs[glyphCount].y = glyph.y - glyph.originY;
+                glyphCount++;
+            }
+        }
+        if (use_show_text_glyphs) {
+            const UnicodeMap *utf8Map = globalParams->getUtf8Map();
+            // utf8 encoded characters can be up to 6 bytes
+            const int runMax = static_cast<int>(run.unicode.size()) * 6;
+            if (utf8Max - utf8Count < runMax) {
+                utf8Max = utf8Count + runMax;
+                utf8 = static_cast<char *>(grealloc(utf8, utf8Max));
+            }
+            for (const OutputGlyph &glyph : run.glyphs) {
+                clusters[clusterCount].num_bytes = 0;
+                for (int i = 0; i < glyph.uLen; i++) {
+                    int size = utf8Map->mapUnicode(glyph.u[i], utf8 + utf8Count, utf8Max - utf8Count);
+                    utf8Count += size;
+                    clusters[clusterCount].num_bytes += size;
+                }
+                clusters[clusterCount].num_glyphs = 1;
+                clusterCount++;
+            }
+        }
+    }
+
+    if (!textPage) {
+        return;
+    }
+    for (const OutputGlyph &glyph : run.glyphs) {
+        actualText->addChar(state, glyph.x, glyph.y, glyph.dx, glyph.dy, glyph.code, glyph.nBytes, glyph.u, glyph.uLen);
+    }
+}
+
 void CairoOutputDev::endString(GfxState *state)
 {
     int render;
@@ -119,6 +119,10 @@ public:
     // Does this device use drawChar() or drawString()?
     bool useDrawChar() override { return true; }
 
+    // Does this device use drawGlyphRun()?  Only if enabled with
+    // setUseDrawGlyphRun().
+    bool useDrawGlyphRun() override { return useGlyphRuns; }
+
     // Does this device use tilingPatternFill()?  If this returns false,
     // tiling pattern fills will be reduced to a series of other drawing
     // operations.
@@ -200,6 +204,7 @@ public:
     void beginString(GfxState *state, const std::string &s) override;
     void endString(GfxState *state) override;
     void drawChar(GfxState *state, double x, double y, double dx, double dy, double originX, double originY, CharCode code, int nBytes, const Unicode *u, int uLen) override;
+    void drawGlyphRun(GfxState *state, const OutputGlyphRun &run) override;
     void beginActualText(GfxState *state, const std::string &text) override;
     void endActualText(GfxState *state) override;
 
@@ -255,6 +260,10 @@ public:
     }
     static void copyAntialias(cairo_t *cr, cairo_t *source_cr);
     void setLogicalStructure(bool logStruct) { this->logicalStruct = logStruct; }
+    // Draw each string with one drawGlyphRun() call instead of one
+    // drawChar() call per glyph; subclasses overriding drawChar() must
+    // leave this off.  The default is false.
+    void setUseDrawGlyphRun(bool use) { useGlyphRuns = use; }
 
     enum Type3RenderType
     {
@@ -334,6 +343,7 @@ protected:
     bool needFontUpdate; // set when the font needs to be updated
     bool printing;
     bool use_show_text_glyphs;
+    bool useGlyphRuns;
     bool text_matrix_valid;
     cairo_glyph_t *glyphs;
     int glyphCount;
@@ -198,7 +198,67 @@ Page *Catalog::getPage(int i)
             return nullptr;
         }
     }
-    return pages[i - 1].first.get();
+    auto &[page, pageRef] = pages[i - 1];
+    if (!page) {
+        page = loadPage(i, pageRef);
+    }
+    return page.get();
+}
+
+void Catalog::releasePage(int i)
+{
+    catalogLocker();
+    if (i >= 1 && static_cast<std::size_t>(i) <= pages.size()) {
+        pages[i - 1].first.reset();
+    }
+}
+
+bool Catalog::isPageLoaded(int i)
+{
+    catalogLocker();
+    return i >= 1 && static_cast<std::size_t>(i) <= pages.size() && pages[i - 1].first;
+}
+
+// Load page <i> again from <pageRef>, with the attributes it inherits
+// from the Pages nodes found by following its Parent entries.  Those of
+// the last parent are kept, as pages are usually loaded in order and a
+// Pages node may have thousands of kids.
+std::unique_ptr<Page> Catalog::loadPage(int i, Ref pageRef)
+{
+    Object pageObj = xref->fetch(pageRef);
+    if (!pageObj.isDict()) {
+        error(errSyntaxError, -1, "Page object (page {0:d}) is wrong type ({1:s})", i, pageObj.getTypeName());
+        return nullptr;
+    }
+
+    Object parentRef = pageObj.dictLookupNF("Parent").copy();
+    const Ref firstParentRef = parentRef.isRef() ? parentRef.getRef() : Ref::INVALID();
+    if (firstParentRef == Ref::INVALID() || firstParentRef != loadedParentRef) {
+        std::vector<Object> ancestors;
+        RefRecursionChecker seen;
+        seen.insert(pageRef);
+        while (parentRef.isRef() && seen.insert(parentRef.getRef())) {
+            Object parent = xref->fetch(parentRef.getRef());
+            if (!parent.isDict()) {
+                break;
+            }
+            parentRef = parent.dictLookupNF("Parent").copy();
+            ancestors.push_back(std::move(parent));
+        }
+        loadedParentAttrs.reset();
+        for (auto it = ancestors.rbegin(); it != ancestors.rend(); ++it) {
+            loadedParentAttrs = std::make_unique<PageAttrs>(loadedParentAttrs.get(), it->getDict());
+        }
+        loadedParentRef = firstParentRef;
+    }
+
+    auto pageAttrs = std::make_unique<PageAttrs>(loadedParentAttrs.get(), pageObj.getDict());
+    auto p = std::make_unique<Page>(doc, i, std::move(pageObj), pageRef, std::move(pageAttrs));
+    if (!p->isOk()) {
+        error(errSyntaxError, -1, "Failed to create page (page {0:d})", i);
+        return nullptr;
+    }
+    return p;
 }
 
 Ref *Catalog::getPageRef(int i)
@@ -128,6 +128,14 @@ public:
     // Get a page.
     Page *getPage(int i);
 
+    // Free page <i> and its annotations, e.g. once a long document has
+    // been processed up to it.  The page is loaded again if it is needed
+    // later, so no pointer to it or to its annotations may be kept.
+    void releasePage(int i);
+
+    // Is page <i> loaded, i.e. not yet or no longer released?
+    bool isPageLoaded(int i);
+
     // Get the reference for a page object.
     Ref *getPageRef(int i);
 
@@ -287,6 +295,8 @@ private:
     std::vector<Object> *pagesList;
     std::vector<Ref> *pagesRefList;
     std::vector<std::unique_ptr<PageAttrs>> attrsList;
+    Ref loadedParentRef = Ref::INVALID(); // parent of the last page loaded by loadPage
+    std::unique_ptr<PageAttrs> loadedParentAttrs; // attributes inherited from it
     std::vector<int> *kidsIdxList;
     Form *form;
     ViewerPreferences *viewerPrefs;
@@ -314,6 +324,7 @@ private:
     bool cacheSubTree(); // called by cachePageTree.
     bool cachePageTree(int page); // Cache first <page> pages.
     std::size_t cachePageTreeForRef(Ref pageRef); // Cache until <pageRef>.
+    std::unique_ptr<Page> loadPage(int i, Ref pageRef); // Load a released page.
     Object *findDestInTree(Object *tree, GooString *name, Object *obj);
 
     Object *getNames();
@@ -67,6 +67,7 @@ static void str_term_source(j_decompress_ptr /*cinfo*/) { }
 DCTStream::DCTStream(std::unique_ptr<Stream> strA, int colorXformA, Dict *dict, int recursion) : OwnedFilterStream(std::move(strA))
 {
     colorXform = colorXformA;
+    scaleDenom = 1;
     if (dict != nullptr) {
         Object obj = dict->lookup("Width", recursion);
         err.width = (obj.isInt() && obj.getInt() <= JPEG_MAX_DIMENSION) ? obj.getInt() : 0;
@@ -110,6 +111,7 @@ void DCTStream::init()
     src.index = 0;
     current = nullptr;
     limit = nullptr;
+    headerRead = false;
 
     cinfo.err = &err.pub;
     if (!setjmp(err.setjmp_buffer)) {
@@ -119,13 +121,9 @@ void DCTStream::init()
     row_buffer = nullptr;
 }
 
-bool DCTStream::rewind()
+bool DCTStream::findStart()
 {
-    int row_stride;
-
-    bool success = str->rewind();
-
-    if (row_buffer) {
+    if (row_buffer || headerRead) {
         jpeg_destroy_decompress(&cinfo);
         init();
     }
@@ -157,36 +155,62 @@ bool DCTStream::rewind()
             }
         }
     }
+    return true;
+}
 
-    if (!setjmp(err.setjmp_buffer)) {
-        if (jpeg_read_header(&cinfo, TRUE) != JPEG_SUSPENDED) {
-            // figure out color transform
-            if (colorXform == -1 && !cinfo.saw_Adobe_marker) {
-                if (cinfo.num_components == 3) {
-                    if (cinfo.saw_JFIF_marker) {
-                        colorXform = 1;
-                    } else if (cinfo.cur_comp_info[0] && cinfo.cur_comp_info[1] && cinfo.cur_comp_info[2] && cinfo.cur_comp_info[0]->component_id == 82 && cinfo.cur_comp_info[1]->component_id == 71
-                               && cinfo.cur_comp_info[2]->component_id == 66) { // ASCII "RGB"
-                        colorXform = 0;
-                    } else {
-                        colorXform = 1;
-                    }
-                } else {
-                    colorXform = 0;
-                }
-            } else if (cinfo.saw_Adobe_marker) {
-                colorXform = cinfo.Adobe_transform;
-            }
+// Must be called with err.setjmp_buffer set up
+bool DCTStream::readHeader()
+{
+    headerRead = true;
+    if (jpeg_read_header(&cinfo, TRUE) == JPEG_SUSPENDED) {
+        return false;
+    }
 
-            switch (cinfo.num_components) {
-            case 3:
-                cinfo.jpeg_color_space = colorXform ? JCS_YCbCr : JCS_RGB;
-                break;
-            case 4:
-                cinfo.jpeg_color_space = colorXform ? JCS_YCCK : JCS_CMYK;
-                break;
+    // figure out color transform
+    if (colorXform == -1 && !cinfo.saw_Adobe_marker) {
+        if (cinfo.num_components == 3) {
+            if (cinfo.saw_JFIF_marker) {
+                colorXform = 1;
+            } else if (cinfo.cur_comp_info[0] && cinfo.cur_comp_info[1] && cinfo.cur_comp_info[2] && cinfo.cur_comp_info[0]->component_id == 82 && cinfo.cur_comp_info[1]->component_id == 71
+                       && cinfo.cur_comp_info[2]->component_id == 66) { // ASCII "RGB"
+                colorXform = 0;
+            } else {
+                colorXform = 1;
             }
+        } else {
+            colorXform = 0;
+        }
+    } else if (cinfo.saw_Adobe_marker) {
+        colorXform = cinfo.Adobe_transform;
+    }
+
+    switch (cinfo.num_components) {
+    case 3:
+        cinfo.jpeg_color_space = colorXform ? JCS_YCbCr : JCS_RGB;
+        break;
+    case 4:
+        cinfo.jpeg_color_space = colorXform ? JCS_YCCK : JCS_CMYK;
+        break;
+    }
+
+    // jpeg_read_header resets the scaling to 1/1
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = scaleDenom;
+    return true;
+}
+
+bool DCTStream::rewind()
+{
+    int row_stride;
+
+    bool success = str->rewind();
+
+    if (!findStart()) {
+        return false;
+    }
 
+    if (!setjmp(err.setjmp_buffer)) {
+        if (readHeader()) {
             jpeg_start_decompress(&cinfo);
 
             row_stride = cinfo.output_width * cinfo.output_components;
@@ -197,6 +221,44 @@ bool DCTStream::rewind()
     return success;
 }
 
+bool DCTStream::setDecodeSize(int targetWidth, int targetHeight, int *width, int *height, std::array<int, 4> *area)
+{
+    if (targetWidth < 1 || targetHeight < 1 || *width < 2 * targetWidth || *height < 2 * targetHeight) {
+        return false;
+    }
+
+    // We need the real size of the JPEG data, the one in the dictionary
+    // may be wrong and then the full size image is used
+    if (!str->rewind() || !findStart()) {
+        return false;
+    }
+
+    bool reduced = false;
+    if (!setjmp(err.setjmp_buffer)) {
+        if (readHeader() && static_cast<int>(cinfo.image_width) == *width && static_cast<int>(cinfo.image_height) == *height) {
+            // libjpeg can scale by 1/2, 1/4 and 1/8 while doing the IDCT
+            int denom = 8;
+            while (denom > 1 && (*width / denom < targetWidth || *height / denom < targetHeight)) {
+                denom /= 2;
+            }
+            if (denom > 1) {
+                // the whole image is always decoded
+                if (area) {
+                    *area = { 0, 0, *width, *height };
+                }
+                cinfo.scale_denom = denom;
+                jpeg_calc_output_dimensions(&cinfo);
+                scaleDenom = denom;
+                *width = cinfo.output_width;
+                *height = cinfo.output_height;
+                reduced = true;
+            }
+        }
+    }
+
+    return reduced;
+}
+
 bool DCTStream::readLine()
 {
     if (cinfo.output_scanline < cinfo.output_height) {
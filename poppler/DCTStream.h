@@ -56,15 +56,20 @@ public:
     int lookChar() override;
     std::optional<std::string> getPSFilter(int psLevel, const char *indent) override;
     bool isBinary(bool last = true) const override;
+    bool setDecodeSize(int targetWidth, int targetHeight, int *width, int *height, std::array<int, 4> *area = nullptr) override;
 
 private:
     void init();
+    bool findStart();
+    bool readHeader();
 
     bool hasGetChars() override { return true; }
     bool readLine();
     int getChars(int nChars, unsigned char *buffer) override;
 
     int colorXform;
+    int scaleDenom;
+    bool headerRead;
     JSAMPLE *current;
     JSAMPLE *limit;
     struct jpeg_decompress_struct cinfo;
@@ -290,23 +290,31 @@ bool Decrypt::makeFileKey2(int encRevision, int keyLength, const GooString *owne
 BaseCryptStream::BaseCryptStream(Stream &strA, const unsigned char *fileKey, CryptAlgorithm algoA, int keyLength, Ref refA) : FilterStream(&strA)
 {
     algo = algoA;
+    objKeyLength = makeObjectKey(fileKey, algo, keyLength, refA, objKey);
+
+    charactersRead = 0;
+    nextCharBuff = EOF;
+}
+
+int BaseCryptStream::makeObjectKey(const unsigned char *fileKey, CryptAlgorithm algo, int keyLength, Ref ref, unsigned char *objKey)
+{
+    int objKeyLength = 0;
 
-    // construct object key
     for (int i = 0; i < keyLength; ++i) {
         objKey[i] = fileKey[i];
     }
-    for (std::size_t i = keyLength; i < sizeof(objKey); ++i) {
+    for (int i = keyLength; i < objKeySize; ++i) {
         objKey[i] = 0;
     }
 
     switch (algo) {
     case cryptRC4:
-        if (likely(static_cast<size_t>(keyLength) < sizeof(objKey) - 4)) {
-            objKey[keyLength] = refA.num & 0xff;
-            objKey[keyLength + 1] = (refA.num >> 8) & 0xff;
-            objKey[keyLength + 2] = (refA.num >> 16) & 0xff;
-            objKey[keyLength + 3] = refA.gen & 0xff;
-            objKey[keyLength + 4] = (refA.gen >> 8) & 0xff;
+        if (likely(keyLength < objKeySize - 4)) {
+            objKey[keyLength] = ref.num & 0xff;
+            objKey[keyLength + 1] = (ref.num >> 8) & 0xff;
+            objKey[keyLength + 2] = (ref.num >> 16) & 0xff;
+            objKey[keyLength + 3] = ref.gen & 0xff;
+            objKey[keyLength + 4] = (ref.gen >> 8) & 0xff;
             md5(objKey, keyLength + 5, objKey);
         }
         if ((objKeyLength = keyLength + 5) > 16) {
@@ -314,11 +322,11 @@ BaseCryptStream::BaseCryptStream(Stream &strA, const unsigned char *fileKey, Cry
         }
         break;
     case cryptAES:
-        objKey[keyLength] = refA.num & 0xff;
-        objKey[keyLength + 1] = (refA.num >> 8) & 0xff;
-        objKey[keyLength + 2] = (refA.num >> 16) & 0xff;
-        objKey[keyLength + 3] = refA.gen & 0xff;
-        objKey[keyLength + 4] = (refA.gen >> 8) & 0xff;
+        objKey[keyLength] = ref.num & 0xff;
+        objKey[keyLength + 1] = (ref.num >> 8) & 0xff;
+        objKey[keyLength + 2] = (ref.num >> 16) & 0xff;
+        objKey[keyLength + 3] = ref.gen & 0xff;
+        objKey[keyLength + 4] = (ref.gen >> 8) & 0xff;
         objKey[keyLength + 5] = 0x73; // 's'
         objKey[keyLength + 6] = 0x41; // 'A'
         objKey[keyLength + 7] = 0x6c; // 'l'
@@ -334,9 +342,13 @@ BaseCryptStream::BaseCryptStream(Stream &strA, const unsigned char *fileKey, Cry
     case cryptNone:
         break;
     }
+    return objKeyLength;
+}
 
-    charactersRead = 0;
-    nextCharBuff = EOF;
+bool BaseCryptStream::hasObjectKey(const unsigned char *fileKey, CryptAlgorithm algoA, int keyLength, Ref ref) const
+{
+    unsigned char key[objKeySize];
+    return algoA == algo && makeObjectKey(fileKey, algoA, keyLength, ref, key) == objKeyLength && memcmp(key, objKey, objKeyLength) == 0;
 }
 
 BaseCryptStream::BaseCryptStream(std::unique_ptr<Stream> strA, const unsigned char *fileKey, CryptAlgorithm algoA, int keyLength, Ref refA) : BaseCryptStream(*strA, fileKey, algoA, keyLength, refA)
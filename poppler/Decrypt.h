@@ -105,10 +105,18 @@ public:
     bool isBinary(bool last) const override;
     Stream *getUndecodedStream() override { return this; }
 
+    // Whether this stream uses the key that encrypting object ref with the
+    // given file key gives, i.e. whether its raw data can be copied as is.
+    bool hasObjectKey(const unsigned char *fileKey, CryptAlgorithm algoA, int keyLength, Ref ref) const;
+
 protected:
+    static constexpr int objKeySize = 32;
+    // Fills objKey (objKeySize bytes) and returns its length.
+    static int makeObjectKey(const unsigned char *fileKey, CryptAlgorithm algo, int keyLength, Ref ref, unsigned char *objKey);
+
     CryptAlgorithm algo;
     int objKeyLength;
-    unsigned char objKey[32];
+    unsigned char objKey[objKeySize];
     Goffset charactersRead; // so that getPos() can be correct
     int nextCharBuff; // EOF means not read yet
     std::unique_ptr<Stream> ownedStream;
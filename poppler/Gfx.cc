@@ -4025,6 +4025,14 @@ void Gfx::doShowText(const std::string &s)
         parser = oldParser;
 
     } else if (out->useDrawChar()) {
+        const bool drawGlyphRun = ocState && out->useDrawGlyphRun();
+        if (drawGlyphRun) {
+            if (!glyphRun) {
+                glyphRun = std::make_unique<OutputGlyphRun>();
+            }
+            glyphRun->glyphs.clear();
+            glyphRun->unicode.clear();
+        }
         p = s.c_str();
         len = s.size();
         while (len > 0) {
@@ -4047,13 +4055,36 @@ void Gfx::doShowText(const std::string &s)
             originX *= state->getFontSize();
             originY *= state->getFontSize();
             state->textTransformDelta(originX, originY, &tOriginX, &tOriginY);
-            if (ocState) {
+            if (drawGlyphRun) {
+                OutputGlyph &glyph = glyphRun->glyphs.emplace_back();
+                glyph.x = state->getCurTextX() + riseX;
+                glyph.y = state->getCurTextY() + riseY;
+                glyph.dx = tdx;
+                glyph.dy = tdy;
+                glyph.originX = tOriginX;
+                glyph.originY = tOriginY;
+                state->transform(glyph.x - tOriginX, glyph.y - tOriginY, &glyph.devX, &glyph.devY);
+                glyph.code = code;
+                glyph.nBytes = n;
+                glyph.uLen = uLen;
+                // u may point to a buffer that is reused for the next
+                // char, so the run keeps a copy
+                glyphRun->unicode.insert(glyphRun->unicode.end(), u, u + uLen);
+            } else if (ocState) {
                 out->drawChar(state, state->getCurTextX() + riseX, state->getCurTextY() + riseY, tdx, tdy, tOriginX, tOriginY, code, n, u, uLen);
             }
             state->textShiftWithUserCoords(tdx, tdy);
             p += n;
             len -= n;
         }
+        if (drawGlyphRun && !glyphRun->glyphs.empty()) {
+            const Unicode *runU = glyphRun->unicode.data();
+            for (OutputGlyph &glyph : glyphRun->glyphs) {
+                glyph.u = glyph.uLen > 0 ? runU : nullptr;
+                runU += glyph.uLen;
+            }
+            out->drawGlyphRun(state, *glyphRun);
+        }
     } else {
         dx = dy = 0;
         p = s.c_str();
@@ -4227,17 +4258,7 @@ void Gfx::doImage(Object *ref, Stream *str, bool inlineImg)
     bool hasAlpha;
     Stream *maskStr;
     int i, n;
-
-    // get info from the stream
-    bits = 0;
-    csMode = streamCSNone;
-#if ENABLE_LIBOPENJPEG
-    if (str->getKind() == strJPX && out->supportJPXtransparency()) {
-        auto *jpxStream = dynamic_cast<JPXStream *>(str);
-        jpxStream->setSupportJPXtransparency(true);
-    }
-#endif
-    str->getImageParams(&bits, &csMode, &hasAlpha);
+    bool decodeAreaStateSaved = false;
 
     // get stream dict
     dict = str->getDict();
@@ -4283,6 +4304,71 @@ void Gfx::doImage(Object *ref, Stream *str, bool inlineImg)
         goto err1;
     }
 
+#if ENABLE_LIBOPENJPEG
+    if (str->getKind() == strJPX && out->supportJPXtransparency()) {
+        auto *jpxStream = dynamic_cast<JPXStream *>(str);
+        jpxStream->setSupportJPXtransparency(true);
+    }
+#endif
+
+    // let the decoder produce fewer pixels if the image is drawn at much
+    // less than its size or is mostly clipped away; this has to happen
+    // before the stream is read
+    if (!inlineImg && !singular_matrix && out->useReducedImageDecoding() && !dict->lookup("SMask").isStream() && !dict->lookup("Mask").isStream()) {
+        obj1 = dict->lookup("ImageMask");
+        if (!obj1.isBool() || !obj1.getBool()) {
+            const double targetWidth = std::hypot(ctm[0], ctm[1]);
+            const double targetHeight = std::hypot(ctm[2], ctm[3]);
+
+            // visible part of the image, in image pixels (row 0 is at the top)
+            double xMin, yMin, xMax, yMax;
+            state->getClipBBox(&xMin, &yMin, &xMax, &yMax);
+            double uMin = 1, vMin = 1, uMax = 0, vMax = 0;
+            for (const auto &[x, y] : { std::pair { xMin, yMin }, std::pair { xMin, yMax }, std::pair { xMax, yMin }, std::pair { xMax, yMax } }) {
+                const double u = (ctm[3] * (x - ctm[4]) - ctm[2] * (y - ctm[5])) / det;
+                const double v = (ctm[0] * (y - ctm[5]) - ctm[1] * (x - ctm[4])) / det;
+                uMin = std::min(uMin, u);
+                uMax = std::max(uMax, u);
+                vMin = std::min(vMin, v);
+                vMax = std::max(vMax, v);
+            }
+            std::array<int, 4> area = { 0, 0, width, height };
+            if (uMin < uMax && vMin < vMax) {
+                // keep a pixel of margin for the image scaling filters
+                area[0] = static_cast<int>(std::clamp(floor(uMin * width) - 1, 0.0, static_cast<double>(width)));
+                area[2] = static_cast<int>(std::clamp(ceil(uMax * width) + 1, 0.0, static_cast<double>(width)));
+                area[1] = static_cast<int>(std::clamp(floor((1 - vMax) * height) - 1, 0.0, static_cast<double>(height)));
+                area[3] = static_cast<int>(std::clamp(ceil((1 - vMin) * height) + 1, 0.0, static_cast<double>(height)));
+            }
+            const std::array<int, 4> fullArea = { 0, 0, width, height };
+            const bool clipped = area != fullArea && area[0] < area[2] && area[1] < area[3];
+
+            if ((2 * targetWidth <= width && 2 * targetHeight <= height) || clipped) {
+                const int fullWidth = width;
+                const int fullHeight = height;
+                if (str->setDecodeSize(std::max(1, static_cast<int>(ceil(std::min(targetWidth, static_cast<double>(width))))), std::max(1, static_cast<int>(ceil(std::min(targetHeight, static_cast<double>(height))))), &width, &height,
+                                       clipped ? &area : nullptr)
+                    && clipped && area != fullArea) {
+                    // the stream only produces <area>, map it to the
+                    // right part of the unit square
+                    const double sx = static_cast<double>(area[2] - area[0]) / fullWidth;
+                    const double sy = static_cast<double>(area[3] - area[1]) / fullHeight;
+                    const double tx = static_cast<double>(area[0]) / fullWidth;
+                    const double ty = 1 - static_cast<double>(area[3]) / fullHeight;
+                    saveState();
+                    decodeAreaStateSaved = true;
+                    state->concatCTM(sx, 0, 0, sy, tx, ty);
+                    out->updateCTM(state, sx, 0, 0, sy, tx, ty);
+                }
+            }
+        }
+    }
+
+    // get info from the stream
+    bits = 0;
+    csMode = streamCSNone;
+    str->getImageParams(&bits, &csMode, &hasAlpha);
+
     // image interpolation
     obj1 = dict->lookup("Interpolate");
     if (obj1.isNull()) {
@@ -4689,9 +4775,15 @@ void Gfx::doImage(Object *ref, Stream *str, bool inlineImg)
     }
     updateLevel += i;
 
+    if (decodeAreaStateSaved) {
+        restoreState();
+    }
     return;
 
 err1:
+    if (decodeAreaStateSaved) {
+        restoreState();
+    }
     error(errSyntaxError, getPos(), "Bad image parameters");
 }
 
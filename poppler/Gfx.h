@@ -43,6 +43,7 @@
 #include "Object.h"
 #include "PopplerCache.h"
 
+#include <memory>
 #include <stack>
 #include <vector>
 
@@ -54,6 +55,7 @@ class Parser;
 class Dict;
 class Function;
 class OutputDev;
+struct OutputGlyphRun;
 class GfxFontDict;
 class GfxFont;
 class GfxPattern;
@@ -242,6 +244,8 @@ private:
 
     std::set<int> formsDrawing; // the forms/patterns that are being drawn
     std::set<int> charProcDrawing; // the charProc that are being drawn
+    std::unique_ptr<OutputGlyphRun> glyphRun; // glyphs of the current string,
+                                              //   for OutputDev::drawGlyphRun
 
     bool // callback to check for an abort
             (*abortCheckCbk)(void *data);
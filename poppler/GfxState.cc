@@ -3715,12 +3715,25 @@ int GfxUnivariateShading::getColor(double t, GfxColor *color)
             out[i] = ix * l[i] + x * u[i];
         }
     } else {
-        for (int i = 0; i < nComps; ++i) {
-            out[i] = 0;
-        }
-        for (int i = 0; i < getNFuncs(); ++i) {
-            funcs[i]->transform(&t, &out[i]);
-        }
+        return getColorUncached(t, color);
+    }
+
+    for (int i = 0; i < nComps; ++i) {
+        color->c[i] = dblToCol(out[i]);
+    }
+    return nComps;
+}
+
+int GfxUnivariateShading::getColorUncached(double t, GfxColor *color) const
+{
+    double out[gfxColorMaxComps];
+
+    const int nComps = getNFuncs() * funcs[0]->getOutputSize();
+    for (int i = 0; i < nComps; ++i) {
+        out[i] = 0;
+    }
+    for (int i = 0; i < getNFuncs(); ++i) {
+        funcs[i]->transform(&t, &out[i]);
     }
 
     for (int i = 0; i < nComps; ++i) {
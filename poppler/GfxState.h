@@ -963,6 +963,9 @@ public:
     // returns the nComps of the shading
     // i.e. how many positions of color have been set
     int getColor(double t, GfxColor *color);
+    // same as getColor, but always evaluates the functions instead of
+    // interpolating in the cache set up by setupCache
+    int getColorUncached(double t, GfxColor *color) const;
 
     void setupCache(const Matrix *ctm, double xMin, double yMin, double xMax, double yMax);
 
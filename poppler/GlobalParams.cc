@@ -438,6 +438,8 @@ GlobalParams::GlobalParams(std::string customPopplerDataDir) : popplerDataDir(st
     printCommands = false;
     profileCommands = false;
     errQuiet = false;
+    fontFaceCacheSize = 64;
+    fontFaceCacheDataSize = 32 * 1024 * 1024;
 
     cidToUnicodeCache = std::make_unique<CharCodeToUnicodeCache>(cidToUnicodeCacheSize);
     unicodeToUnicodeCache = std::make_unique<CharCodeToUnicodeCache>(unicodeToUnicodeCacheSize);
@@ -1457,6 +1459,18 @@ bool GlobalParams::getErrQuiet() const
     return errQuiet;
 }
 
+size_t GlobalParams::getFontFaceCacheSize()
+{
+    globalParamsLocker();
+    return fontFaceCacheSize;
+}
+
+size_t GlobalParams::getFontFaceCacheDataSize()
+{
+    globalParamsLocker();
+    return fontFaceCacheDataSize;
+}
+
 std::shared_ptr<CharCodeToUnicode> GlobalParams::getCIDToUnicode(const std::string &collection)
 {
     std::shared_ptr<CharCodeToUnicode> ctu;
@@ -1544,6 +1558,13 @@ void GlobalParams::setErrQuiet(bool errQuietA)
     errQuiet = errQuietA;
 }
 
+void GlobalParams::setFontFaceCacheLimits(size_t nFaces, size_t dataSize)
+{
+    globalParamsLocker();
+    fontFaceCacheSize = nFaces;
+    fontFaceCacheDataSize = dataSize;
+}
+
 #ifdef ANDROID
 void GlobalParams::setFontDir(const std::string &fontDir)
 {
@@ -148,6 +148,8 @@ public:
     bool getPrintCommands();
     bool getProfileCommands();
     bool getErrQuiet() const;
+    size_t getFontFaceCacheSize();
+    size_t getFontFaceCacheDataSize();
 
     std::shared_ptr<CharCodeToUnicode> getCIDToUnicode(const std::string &collection);
     const UnicodeMap *getUnicodeMap(const std::string &encodingName);
@@ -164,6 +166,11 @@ public:
     void setPrintCommands(bool printCommandsA);
     void setProfileCommands(bool profileCommandsA);
     void setErrQuiet(bool errQuietA);
+    // Limit the font faces the Splash and Cairo backends keep loaded once
+    // no document uses them, to <nFaces> faces and <dataSize> bytes of
+    // embedded font data.  The faces over the limits are freed the next
+    // time a face is given back.  0 faces disables the caches.
+    void setFontFaceCacheLimits(size_t nFaces, size_t dataSize);
 #ifdef ANDROID
     static void setFontDir(const std::string &fontDir);
 #endif
@@ -214,6 +221,8 @@ private:
     bool printCommands; // print the drawing commands
     bool profileCommands; // profile the drawing commands
     bool errQuiet; // suppress error messages?
+    size_t fontFaceCacheSize; // number of unused font faces kept loaded
+    size_t fontFaceCacheDataSize; // size of their embedded font data
 
     std::unique_ptr<CharCodeToUnicodeCache> cidToUnicodeCache;
     std::unique_ptr<CharCodeToUnicodeCache> unicodeToUnicodeCache;
@@ -672,6 +672,7 @@ public:
     void clearPixel(int x, int y) { data[y * line + (x >> 3)] &= 0x7f7f >> (x & 7); }
     void getPixelPtr(int x, int y, JBIG2BitmapPtr *ptr);
     int nextPixel(JBIG2BitmapPtr *ptr) const;
+    unsigned int getRowBits(int x, int y) const;
     void duplicateRow(int yDest, int ySrc);
     void combine(const JBIG2Bitmap &bitmap, int x, int y, unsigned int combOp);
     unsigned char *getDataPtr() { return data; }
@@ -736,7 +737,6 @@ JBIG2Bitmap::~JBIG2Bitmap()
     gfree(data);
 }
 
-//~ optimize this
 std::unique_ptr<JBIG2Bitmap> JBIG2Bitmap::getSlice(unsigned int x, unsigned int y, unsigned int wA, unsigned int hA)
 {
     if (!data) {
@@ -748,11 +748,16 @@ std::unique_ptr<JBIG2Bitmap> JBIG2Bitmap::getSlice(unsigned int x, unsigned int
         return {};
     }
 
-    slice->clearToZero();
+    // copy 32 pixels at a time, keeping the padding bits at 0
     for (unsigned int yy = 0; yy < hA; ++yy) {
-        for (unsigned int xx = 0; xx < wA; ++xx) {
-            if (getPixel(x + xx, y + yy)) {
-                slice->setPixel(xx, yy);
+        unsigned char *dest = slice->data + yy * slice->line;
+        for (unsigned int xx = 0; xx < wA; xx += 32) {
+            unsigned int bits = getRowBits(x + xx, y + yy);
+            if (wA - xx < 32) {
+                bits &= 0xffffffffU << (32 - (wA - xx));
+            }
+            for (unsigned int i = 0; i < 32 && xx + i < wA; i += 8) {
+                *dest++ = (bits >> (24 - i)) & 0xff;
             }
         }
     }
@@ -831,6 +836,28 @@ inline int JBIG2Bitmap::nextPixel(JBIG2BitmapPtr *ptr) const
     return pix;
 }
 
+// Returns the 32 pixels of row <y> starting at column <x> (which may be
+// negative), left-most pixel in the most significant bit.  Pixels outside
+// of the bitmap are 0.
+unsigned int JBIG2Bitmap::getRowBits(int x, int y) const
+{
+    if (y < 0 || y >= h || x >= w || x <= -32) {
+        return 0;
+    }
+    const unsigned char *row = data + y * line;
+    const int byteX = x >> 3;
+    unsigned long long bits = 0;
+    for (int b = byteX; b < byteX + 5; ++b) {
+        bits = (bits << 8) | ((b >= 0 && b < line) ? row[b] : 0);
+    }
+    unsigned int result = static_cast<unsigned int>(bits >> (8 - (x & 7)));
+    const long long pixelsLeft = static_cast<long long>(w) - x;
+    if (pixelsLeft < 32) {
+        result &= 0xffffffffU << (32 - pixelsLeft);
+    }
+    return result;
+}
+
 void JBIG2Bitmap::duplicateRow(int yDest, int ySrc)
 {
     memcpy(data + yDest * line, data + ySrc * line, line);
@@ -3844,6 +3871,61 @@ std::unique_ptr<JBIG2Bitmap> JBIG2Stream::readGenericRefinementRegion(int w, int
         ltpCX = 0x0010;
     }
 
+    if (!tpgrOn) {
+        // Without typical prediction every pixel is decoded, so the
+        // contexts can be built from 32-pixel windows of the rows they
+        // use, fetched once per 8 pixels.  Only the pixels of the current
+        // row, which are being decoded, are tracked one by one.
+        const bool atCurrentRow = !templ && aty[0] == 0;
+        for (y = 0; y < h; ++y) {
+            unsigned char *pp = bitmap->getDataPtr() + y * bitmap->getLineSize();
+            unsigned int prevPix = 0;
+            for (int x0 = 0; x0 < w; x0 += 8, ++pp) {
+                if (templ) {
+                    const unsigned int w0 = bitmap->getRowBits(x0 - 1, y - 1);
+                    const unsigned int w2 = refBitmap->getRowBits(x0 - refDX, y - 1 - refDY);
+                    const unsigned int w3 = refBitmap->getRowBits(x0 - 1 - refDX, y - refDY);
+                    const unsigned int w4 = refBitmap->getRowBits(x0 - refDX, y + 1 - refDY);
+                    for (int i = 0; i < 8 && x0 + i < w; ++i) {
+                        // build the context
+                        cx = (((w0 >> (29 - i)) & 7) << 7) | (prevPix << 6) | (((w2 >> (31 - i)) & 1) << 5) | (((w3 >> (29 - i)) & 7) << 2) | ((w4 >> (30 - i)) & 3);
+
+                        // decode the pixel
+                        prevPix = arithDecoder->decodeBit(cx, refinementRegionStats.get());
+                        if (prevPix) {
+                            *pp |= 0x80 >> i;
+                        }
+                        if (unlikely(arithDecoder->getReadPastEndOfStream())) {
+                            return nullptr;
+                        }
+                    }
+                } else {
+                    const unsigned int w0 = bitmap->getRowBits(x0, y - 1);
+                    const unsigned int w2 = refBitmap->getRowBits(x0 - refDX, y - 1 - refDY);
+                    const unsigned int w3 = refBitmap->getRowBits(x0 - 1 - refDX, y - refDY);
+                    const unsigned int w4 = refBitmap->getRowBits(x0 - 1 - refDX, y + 1 - refDY);
+                    const unsigned int w5 = atCurrentRow ? 0 : bitmap->getRowBits(x0 + atx[0], y + aty[0]);
+                    const unsigned int w6 = refBitmap->getRowBits(x0 + atx[1] - refDX, y + aty[1] - refDY);
+                    for (int i = 0; i < 8 && x0 + i < w; ++i) {
+                        // build the context
+                        const unsigned int pix5 = atCurrentRow ? bitmap->getPixel(x0 + i + atx[0], y) : (w5 >> (31 - i)) & 1;
+                        cx = (((w0 >> (30 - i)) & 3) << 11) | (prevPix << 10) | (((w2 >> (30 - i)) & 3) << 8) | (((w3 >> (29 - i)) & 7) << 5) | (((w4 >> (29 - i)) & 7) << 2) | (pix5 << 1) | ((w6 >> (31 - i)) & 1);
+
+                        // decode the pixel
+                        prevPix = arithDecoder->decodeBit(cx, refinementRegionStats.get());
+                        if (prevPix) {
+                            *pp |= 0x80 >> i;
+                        }
+                        if (unlikely(arithDecoder->getReadPastEndOfStream())) {
+                            return nullptr;
+                        }
+                    }
+                }
+            }
+        }
+        return bitmap;
+    }
+
     ltp = false;
     for (y = 0; y < h; ++y) {
 
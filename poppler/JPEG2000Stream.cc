@@ -24,6 +24,9 @@
 #include "JPEG2000Stream.h"
 #include <openjpeg.h>
 
+#include <algorithm>
+#include <thread>
+
 struct JPXStreamPrivate
 {
     opj_image_t *image = nullptr;
@@ -32,6 +35,17 @@ struct JPXStreamPrivate
     int npixels = 0;
     int ncomps = 0;
     bool inited = false;
+    // requested output size and area (see setDecodeSize), only used if
+    // the codestream is fullWidth x fullHeight
+    int targetWidth = 0;
+    int targetHeight = 0;
+    int fullWidth = 0;
+    int fullHeight = 0;
+    bool hasArea = false;
+    std::array<int, 4> area = {};
+    // resolution reduction and area actually used
+    int reduce = 0;
+    bool areaApplied = false;
     void init2(OPJ_CODEC_FORMAT format, const unsigned char *buf, int length, bool indexed);
 };
 
@@ -181,6 +195,38 @@ void JPXStream::getImageParams(int *bitsPerComponent, StreamColorSpaceMode *csMo
     }
 }
 
+bool JPXStream::setDecodeSize(int targetWidth, int targetHeight, int *width, int *height, std::array<int, 4> *area)
+{
+    if (priv->inited || targetWidth < 1 || targetHeight < 1) {
+        return false;
+    }
+    const bool wantArea = area && (*area)[0] >= 0 && (*area)[1] >= 0 && (*area)[2] <= *width && (*area)[3] <= *height && (*area)[0] < (*area)[2] && (*area)[1] < (*area)[3]
+            && *area != std::array<int, 4> { 0, 0, *width, *height };
+    if (!wantArea && (*width < 2 * targetWidth || *height < 2 * targetHeight)) {
+        return false;
+    }
+
+    priv->targetWidth = targetWidth;
+    priv->targetHeight = targetHeight;
+    priv->fullWidth = *width;
+    priv->fullHeight = *height;
+    priv->hasArea = wantArea;
+    if (wantArea) {
+        priv->area = *area;
+    }
+    init();
+
+    if (!priv->image || (priv->reduce == 0 && !priv->areaApplied)) {
+        return false;
+    }
+    *width = priv->image->comps[0].w;
+    *height = priv->image->comps[0].h;
+    if (area) {
+        *area = priv->areaApplied ? priv->area : std::array<int, 4> { 0, 0, priv->fullWidth, priv->fullHeight };
+    }
+    return true;
+}
+
 static void libopenjpeg_error_callback(const char *msg, void * /*client_data*/)
 {
     error(errSyntaxError, -1, "{0:s}", msg);
@@ -366,6 +412,13 @@ void JPXStreamPrivate::init2(OPJ_CODEC_FORMAT format, const unsigned char *buf,
         goto error;
     }
 
+#if OPJ_VERSION_MAJOR > 2 || (OPJ_VERSION_MAJOR == 2 && OPJ_VERSION_MINOR >= 3)
+    /* Decode code-blocks of big images in parallel */
+    if (opj_has_thread_support()) {
+        opj_codec_set_threads(decoder, std::max(1, static_cast<int>(std::thread::hardware_concurrency())));
+    }
+#endif
+
     /* Decode the stream and fill the image structure */
     image = nullptr;
     if (!opj_read_header(stream, decoder, &image)) {
@@ -373,8 +426,40 @@ void JPXStreamPrivate::init2(OPJ_CODEC_FORMAT format, const unsigned char *buf,
         goto error;
     }
 
+    /* Drop resolution levels that would be downsampled away anyway and
+     * tiles outside of the visible area, only if the codestream has the
+     * size the caller expects */
+    reduce = 0;
+    areaApplied = false;
+    if (targetWidth > 0 && targetHeight > 0 && static_cast<int>(image->x1 - image->x0) == fullWidth && static_cast<int>(image->y1 - image->y0) == fullHeight) {
+        int r = 0;
+        while (r < 5 && (fullWidth >> (r + 1)) >= targetWidth && (fullHeight >> (r + 1)) >= targetHeight) {
+            ++r;
+        }
+        // fails if the codestream has fewer resolution levels
+        while (r > 0 && !opj_set_decoded_resolution_factor(decoder, r)) {
+            --r;
+        }
+        reduce = r;
+
+        if (hasArea) {
+            // align the area to the reduced pixel grid so that it maps
+            // exactly to the decoded pixels
+            const int mask = (1 << reduce) - 1;
+            area[0] &= ~mask;
+            area[1] &= ~mask;
+            area[2] = std::min((area[2] + mask) & ~mask, fullWidth);
+            area[3] = std::min((area[3] + mask) & ~mask, fullHeight);
+            if (!opj_set_decode_area(decoder, image, image->x0 + area[0], image->y0 + area[1], image->x0 + area[2], image->y0 + area[3])) {
+                error(errSyntaxWarning, -1, "Unable to set JPX decode area");
+                goto error;
+            }
+            areaApplied = true;
+        }
+    }
+
     /* Optional if you want decode the entire image */
-    if (!opj_set_decode_area(decoder, image, parameters.DA_x0, parameters.DA_y0, parameters.DA_x1, parameters.DA_y1)) {
+    if (!areaApplied && !opj_set_decode_area(decoder, image, parameters.DA_x0, parameters.DA_y0, parameters.DA_x1, parameters.DA_y1)) {
         error(errSyntaxWarning, -1, "X2");
         goto error;
     }
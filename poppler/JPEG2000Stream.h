@@ -43,6 +43,7 @@ public:
     std::optional<std::string> getPSFilter(int psLevel, const char *indent) override;
     bool isBinary(bool last = true) const override;
     void getImageParams(int *bitsPerComponent, StreamColorSpaceMode *csMode, bool *hasAlpha) override;
+    bool setDecodeSize(int targetWidth, int targetHeight, int *width, int *height, std::array<int, 4> *area = nullptr) override;
 
     // Whether this JPX Stream should handle transparency (usually set when OutputDev also supports it)
     void setSupportJPXtransparency(bool val) { handleJPXtransparency = val; }
@@ -49,6 +49,7 @@
 #include <memory>
 #include <unordered_map>
 #include <string>
+#include <vector>
 
 class Annot;
 class Dict;
@@ -60,6 +61,35 @@ class Catalog;
 class Page;
 class Function;
 
+//------------------------------------------------------------------------
+// OutputGlyphRun
+//------------------------------------------------------------------------
+
+// One glyph of an OutputGlyphRun.  <x>, <y>, <dx>, <dy>, <originX> and
+// <originY> are the drawChar() arguments, in user space.  (<devX>,
+// <devY>) is the glyph origin, i.e. (<x> - <originX>, <y> - <originY>),
+// transformed to device space.
+struct OutputGlyph
+{
+    double x, y;
+    double dx, dy;
+    double originX, originY;
+    double devX, devY;
+    CharCode code;
+    int nBytes;
+    const Unicode *u;
+    int uLen;
+};
+
+// The glyphs of one string of a show-text operator.  The Unicode
+// values of all glyphs are kept in <unicode>; OutputGlyph::u points
+// into it.
+struct OutputGlyphRun
+{
+    std::vector<OutputGlyph> glyphs;
+    std::vector<Unicode> unicode;
+};
+
 //------------------------------------------------------------------------
 // OutputDev
 //------------------------------------------------------------------------
@@ -82,6 +112,13 @@ public:
     // Does this device use drawChar() or drawString()?
     virtual bool useDrawChar() = 0;
 
+    // Does this device use drawGlyphRun()?  Only checked if useDrawChar()
+    // is true.  If this returns false, drawChar() is called per glyph.
+    // A device that others derive from should return true only when its
+    // user asks for it, so that a subclass overriding drawChar() still
+    // gets the glyphs.
+    virtual bool useDrawGlyphRun() { return false; }
+
     // Does this device use tilingPatternFill()?  If this returns false,
     // tiling pattern fills will be reduced to a series of other drawing
     // operations.
@@ -116,6 +153,11 @@ public:
     // Does this device supports transparency (alpha channel) in JPX streams?
     virtual bool supportJPXtransparency() { return false; }
 
+    // Does this device want images drawn much smaller than their size to
+    // be decoded at a lower resolution when the decoder supports it (see
+    // Stream::setDecodeSize)?
+    virtual bool useReducedImageDecoding() { return false; }
+
     //----- initialization and control
 
     // Set default transform matrix.
@@ -285,6 +327,11 @@ public:
     //           but it may also have larger values, for example for ligatures.
     virtual void drawChar(GfxState * /*state*/, double /*x*/, double /*y*/, double /*dx*/, double /*dy*/, double /*originX*/, double /*originY*/, CharCode /*code*/, int /*nBytes*/, const Unicode * /*u*/, int /*uLen*/) { }
     virtual void drawString(GfxState * /*state*/, const std::string & /*s*/) { }
+    // Draw all glyphs of a string at once, in place of one drawChar()
+    // call per glyph.  This is called after the text position has been
+    // advanced past the string, so the glyph positions must be taken
+    // from <run>.
+    virtual void drawGlyphRun(GfxState * /*state*/, const OutputGlyphRun & /*run*/) { }
     virtual bool beginType3Char(GfxState * /*state*/, double /*x*/, double /*y*/, double /*dx*/, double /*dy*/, CharCode /*code*/, const Unicode * /*u*/, int /*uLen*/);
     virtual void endType3Char(GfxState * /*state*/) { }
     virtual void beginTextObject(GfxState * /*state*/) { }
@@ -83,6 +83,9 @@
 #include <regex>
 #include <sstream>
 #include <sys/stat.h>
+#include <atomic>
+#include <functional>
+#include <thread>
 #include "CryptoSignBackend.h"
 #include "goo/GooString.h"
 #include "goo/gfile.h"
@@ -818,7 +821,7 @@ Hints *PDFDoc::getHints()
     return hints;
 }
 
-int PDFDoc::savePageAs(const std::string &name, int pageNo)
+int PDFDoc::savePageAs(const std::string &name, int pageNo, PDFWriteMode mode)
 {
     FILE *f;
 
@@ -847,7 +850,7 @@ int PDFDoc::savePageAs(const std::string &name, int pageNo)
     }
     replacePageDict(pageNo, getCatalog()->getPage(pageNo)->getRotate(), getCatalog()->getPage(pageNo)->getMediaBox(), cropBox);
     Ref *refPage = getCatalog()->getPageRef(pageNo);
-    Object page = getXRef()->fetch(*refPage);
+    Object page = fetchPageObject(*refPage);
 
     if (!(f = openFile(name.c_str(), "wb"))) {
         error(errIO, -1, "Couldn't open file '{0:r}'", &name);
@@ -868,7 +871,12 @@ int PDFDoc::savePageAs(const std::string &name, int pageNo)
         markPageObjects(trailerObj->getDict(), yRef.get(), countRef.get(), 0, refPage->num, rootNum + 2);
     }
     yRef->add(0, 65535, 0, false);
-    writeHeader(outStr.get(), getPDFMajorVersion(), getPDFMinorVersion());
+    const bool useObjectStreams = mode == writeForceRewriteCompressed;
+    int minorVersion = getPDFMinorVersion();
+    if (useObjectStreams && getPDFMajorVersion() == 1) {
+        minorVersion = std::max(minorVersion, 5); // object streams need PDF 1.5
+    }
+    writeHeader(outStr.get(), getPDFMajorVersion(), minorVersion);
 
     // get and mark info dict
     Object infoObj = getXRef()->getDocInfo();
@@ -893,6 +901,10 @@ int PDFDoc::savePageAs(const std::string &name, int pageNo)
         error(errSyntaxError, -1, "XRef's Catalog is not a dictionary");
         return errOpenFile;
     }
+    if (modifiedPageObjects) {
+        // markAcroForm changes the fields of a direct AcroForm dict
+        catObj = catObj.deepCopy();
+    }
     Dict *catDict = catObj.getDict();
     Object pagesObj = catDict->lookup("Pages");
     if (!pagesObj.isDict()) {
@@ -931,7 +943,12 @@ int PDFDoc::savePageAs(const std::string &name, int pageNo)
         markAnnotations(&annotsObj, yRef.get(), countRef.get(), 0, refPage->num, rootNum + 2);
     }
     yRef->markUnencrypted();
-    writePageObjects(outStr.get(), yRef.get(), 0);
+    std::unique_ptr<ObjectStreamWriter> objStms;
+    if (useObjectStreams) {
+        // the catalog, page tree and page are written below as rootNum .. rootNum + 2
+        objStms = std::make_unique<ObjectStreamWriter>(outStr.get(), yRef.get(), rootNum + 3, fileKey, encAlgorithm, keyLength);
+    }
+    writePageObjects(outStr.get(), yRef.get(), 0, false, objStms.get(), nullptr, modifiedPageObjects);
 
     yRef->add(rootNum, 0, outStr->getPos(), true);
     outStr->printf("%d 0 obj\n", rootNum);
@@ -982,13 +999,96 @@ int PDFDoc::savePageAs(const std::string &name, int pageNo)
     ref.num = rootNum;
     ref.gen = 0;
     Object trailerDict = createTrailerDict(rootNum + 3, false, 0, &ref, getXRef(), name.c_str(), uxrefOffset);
-    writeXRefTableTrailer(std::move(trailerDict), yRef.get(), false /* do not write unnecessary entries */, uxrefOffset, outStr.get(), getXRef());
+    if (objStms) {
+        objStms->writeTrailer(std::move(trailerDict), getXRef());
+    } else {
+        writeXRefTableTrailer(std::move(trailerDict), yRef.get(), false /* do not write unnecessary entries */, uxrefOffset, outStr.get(), getXRef());
+    }
 
     outStr->close();
 
     return errNone;
 }
 
+int PDFDoc::savePagesAs(const std::vector<std::pair<int, std::string>> &pages, PDFWriteMode mode, int nThreads)
+{
+    if (file && file->modificationTimeChangedSinceOpen()) {
+        return errFileChangedSinceOpen;
+    }
+
+    // The pages are shared out between threads, each reading the file
+    // with a PDFDoc of its own
+    std::vector<std::unique_ptr<PDFDoc>> docs;
+    if (fileName && !isEncrypted()) {
+        const size_t maxThreads = nThreads > 0 ? static_cast<size_t>(nThreads) : std::max(1U, std::thread::hardware_concurrency());
+        for (size_t i = 1; i < std::min(maxThreads, pages.size()); i++) {
+            auto doc = std::make_unique<PDFDoc>(fileName->copy());
+            if (!doc->isOk()) {
+                break;
+            }
+            docs.push_back(std::move(doc));
+        }
+    }
+
+    std::atomic<size_t> next { 0 };
+    std::atomic<int> firstError { errNone };
+    auto worker = [&](PDFDoc *doc) {
+        for (size_t i = next++; i < pages.size() && firstError == errNone; i = next++) {
+            const int err = doc->savePageCopyAs(pages[i].second, pages[i].first, mode);
+            if (err != errNone) {
+                int expected = errNone;
+                firstError.compare_exchange_strong(expected, err);
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    threads.reserve(docs.size());
+    for (const std::unique_ptr<PDFDoc> &doc : docs) {
+        threads.emplace_back(worker, doc.get());
+    }
+    worker(this);
+    for (std::thread &t : threads) {
+        t.join();
+    }
+    return firstError;
+}
+
+int PDFDoc::savePageCopyAs(const std::string &name, int pageNo, PDFWriteMode mode)
+{
+    // savePageAs changes some objects (the page, its annotations, the
+    // AcroForm fields...) for the page it saves: keep these changes out of
+    // the XRef, so that the next page starts from the file again.  Objects
+    // read from object streams are shared with the XRef's cache, so the
+    // objects changed are copied first (see fetchPageObject)
+    std::unordered_map<int, Object> changes;
+    modifiedPageObjects = &changes;
+    const int result = savePageAs(name, pageNo, mode);
+    modifiedPageObjects = nullptr;
+    return result;
+}
+
+Object PDFDoc::fetchPageObject(Ref ref, bool forUpdate) const
+{
+    if (modifiedPageObjects) {
+        if (const auto it = modifiedPageObjects->find(ref.num); it != modifiedPageObjects->end()) {
+            return it->second.copy();
+        }
+        if (forUpdate) {
+            return getXRef()->fetch(ref).deepCopy();
+        }
+    }
+    return getXRef()->fetch(ref);
+}
+
+void PDFDoc::setModifiedPageObject(const Object *obj, Ref ref) const
+{
+    if (modifiedPageObjects) {
+        (*modifiedPageObjects)[ref.num] = obj->copy();
+    } else {
+        getXRef()->setModifiedObject(obj, ref);
+    }
+}
+
 int PDFDoc::saveAs(const std::string &name, PDFWriteMode mode)
 {
     FILE *f;
@@ -1015,8 +1115,8 @@ int PDFDoc::saveAs(OutStream *outStr, PDFWriteMode mode)
     if (!xref->isModified() && mode == writeStandard) {
         // simply copy the original file
         saveWithoutChangesAs(outStr);
-    } else if (mode == writeForceRewrite) {
-        saveCompleteRewrite(outStr);
+    } else if (mode == writeForceRewrite || mode == writeForceRewriteCompressed) {
+        saveCompleteRewrite(outStr, mode == writeForceRewriteCompressed);
     } else {
         saveIncrementalUpdate(outStr);
     }
@@ -1147,7 +1247,213 @@ void PDFDoc::saveIncrementalUpdate(OutStream *outStr)
     delete uxref;
 }
 
-void PDFDoc::saveCompleteRewrite(OutStream *outStr)
+//------------------------------------------------------------------------
+// ObjectWriteQueue
+//
+// Writes top-level objects to outStr in the order they are added.  Streams
+// that are recompressed or encrypted on save are first serialized into
+// per-object buffers by a pool of worker threads, a batch at a time; the
+// bytes written are the same as when writing every object directly.
+// The workers never fetch objects, so the caller may hold the XRef lock.
+//------------------------------------------------------------------------
+
+// Stream data serialized by the workers in one batch, at most
+static const Goffset objWriteMaxBatchBytes = 32 << 20;
+// Objects queued at most, whatever their kind
+static const size_t objWriteMaxQueued = 1024;
+
+class ObjectWriteQueue
+{
+public:
+    // Objects are recorded in uxref; objStms, if given, gets the objects
+    // added with allowPack that it can store.  replacedRefs is passed on to
+    // PDFDoc::writeObject.
+    ObjectWriteQueue(OutStream *outStrA, XRef *uxrefA, ObjectStreamWriter *objStmsA, const std::unordered_map<int, Ref> *replacedRefsA = nullptr);
+    ~ObjectWriteQueue();
+
+    ObjectWriteQueue(const ObjectWriteQueue &) = delete;
+    ObjectWriteQueue &operator=(const ObjectWriteQueue &) = delete;
+
+    // Queues obj as object ref.  The remaining arguments are passed on to
+    // PDFDoc::writeObject.
+    void add(Ref ref, Object &&obj, XRef *xRef, unsigned int numOffset, const unsigned char *fileKey, CryptAlgorithm encAlgorithm, int keyLength, Ref encRef, bool allowPack);
+
+    // Whether the queue should be flushed before adding more.
+    bool isFull() const { return nThreads > 1 && (parallelBytes >= objWriteMaxBatchBytes || entries.size() >= objWriteMaxQueued); }
+
+    // Serializes and writes everything queued.
+    void flush();
+
+private:
+    struct Entry
+    {
+        Ref ref;
+        Object obj;
+        XRef *xRef;
+        unsigned int numOffset;
+        const unsigned char *fileKey;
+        CryptAlgorithm encAlgorithm;
+        int keyLength;
+        Ref encRef;
+        bool pack;
+        std::unique_ptr<MemOutStream> data; // serialized object, for the parallel ones
+    };
+
+    static Goffset getParallelSize(const Entry &e);
+    void serialize(Entry *e);
+    void write(Entry *e);
+
+    OutStream *outStr;
+    XRef *uxref;
+    ObjectStreamWriter *objStms;
+    const std::unordered_map<int, Ref> *replacedRefs;
+    int nThreads;
+    std::vector<Entry> entries;
+    std::vector<Entry *> parallel; // the entries the workers serialize
+    Goffset parallelBytes; // size of the stream data they read
+};
+
+ObjectWriteQueue::ObjectWriteQueue(OutStream *outStrA, XRef *uxrefA, ObjectStreamWriter *objStmsA, const std::unordered_map<int, Ref> *replacedRefsA)
+    : outStr(outStrA), uxref(uxrefA), objStms(objStmsA), replacedRefs(replacedRefsA), parallelBytes(0)
+{
+    nThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+}
+
+ObjectWriteQueue::~ObjectWriteQueue()
+{
+    flush();
+}
+
+// Returns the size of the stream data e reads if it goes through the
+// re-encoding or encrypting paths of PDFDoc::writeObject and can be
+// serialized by a worker, 0 otherwise.  Raw and plain copies are cheap.
+// Streams with an indirect Filter are left to the writing thread, as
+// looking it up would fetch while the caller may hold the XRef lock, and
+// so are streams whose base stream does not support concurrent reads
+// (e.g. CachedFileStream).
+Goffset ObjectWriteQueue::getParallelSize(const Entry &e)
+{
+    if (!e.obj.isStream()) {
+        return 0;
+    }
+    Stream *stream = e.obj.getStream();
+    if (stream->getKind() == strWeird || stream->getKind() == strCrypt) {
+        // copied raw by PDFDoc::writeObject
+        auto *cryptStream = dynamic_cast<DecryptStream *>(stream);
+        if (cryptStream && e.fileKey && cryptStream->hasObjectKey(e.fileKey, e.encAlgorithm, e.keyLength, e.encRef)) {
+            return 0;
+        }
+    } else if (!e.fileKey || stream->getKind() != strFile || !static_cast<FileStream *>(stream)->getNeedsEncryptionOnSave()) {
+        return 0;
+    }
+    const Object &filter = stream->getDict()->lookupNF("Filter");
+    if (filter.isRef()) {
+        return 0;
+    }
+    if (filter.isArray()) {
+        for (int i = 0; i < filter.arrayGetLength(); i++) {
+            if (filter.getArray()->getNF(i).isRef()) {
+                return 0;
+            }
+        }
+    }
+    BaseStream *baseStr = stream->getBaseStream();
+    if (!baseStr || (!dynamic_cast<FileStream *>(baseStr) && !dynamic_cast<BaseMemStream<const char> *>(baseStr))) {
+        return 0;
+    }
+    return std::max<Goffset>(1, baseStr->getLength());
+}
+
+void ObjectWriteQueue::add(Ref ref, Object &&obj, XRef *xRef, unsigned int numOffset, const unsigned char *fileKey, CryptAlgorithm encAlgorithm, int keyLength, Ref encRef, bool allowPack)
+{
+    const bool pack = allowPack && objStms && ObjectStreamWriter::canStore(ref, obj);
+    Entry e { .ref = ref,
+              .obj = std::move(obj),
+              .xRef = xRef,
+              .numOffset = numOffset,
+              .fileKey = fileKey,
+              .encAlgorithm = encAlgorithm,
+              .keyLength = keyLength,
+              .encRef = encRef,
+              .pack = pack,
+              .data = nullptr };
+    if (nThreads <= 1) {
+        write(&e);
+        return;
+    }
+    if (const Goffset size = getParallelSize(e)) {
+        parallelBytes += size;
+        e.data = std::make_unique<MemOutStream>();
+    }
+    entries.push_back(std::move(e));
+}
+
+void ObjectWriteQueue::serialize(Entry *e)
+{
+    PDFDoc::writeObject(&e->obj, e->data.get(), e->xRef, e->numOffset, e->fileKey, e->encAlgorithm, e->keyLength, e->encRef, nullptr, replacedRefs);
+}
+
+void ObjectWriteQueue::write(Entry *e)
+{
+    if (e->pack) {
+        objStms->add(e->ref, &e->obj, e->xRef, e->numOffset, replacedRefs);
+        return;
+    }
+    Goffset offset = PDFDoc::writeObjectHeader(&e->ref, outStr);
+    if (e->data) {
+        const std::vector<char> &data = e->data->getData();
+        outStr->write(std::span(reinterpret_cast<const unsigned char *>(data.data()), data.size()));
+    } else {
+        PDFDoc::writeObject(&e->obj, outStr, e->xRef, e->numOffset, e->fileKey, e->encAlgorithm, e->keyLength, e->encRef, nullptr, replacedRefs);
+    }
+    PDFDoc::writeObjectFooter(outStr);
+    uxref->add(e->ref, offset, true);
+}
+
+void ObjectWriteQueue::flush()
+{
+    if (entries.empty()) {
+        return;
+    }
+
+    parallel.clear();
+    for (Entry &e : entries) {
+        if (e.data) {
+            parallel.push_back(&e);
+        }
+    }
+    const int nWorkers = std::min(nThreads, static_cast<int>(parallel.size()));
+    if (nWorkers > 1) {
+        std::atomic<size_t> next { 0 };
+        auto worker = [this, &next] {
+            for (size_t i = next++; i < parallel.size(); i = next++) {
+                serialize(parallel[i]);
+            }
+        };
+        std::vector<std::thread> threads;
+        threads.reserve(nWorkers - 1);
+        for (int i = 1; i < nWorkers; ++i) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (std::thread &t : threads) {
+            t.join();
+        }
+    } else {
+        for (Entry *e : parallel) {
+            serialize(e);
+        }
+    }
+
+    for (Entry &e : entries) {
+        write(&e);
+    }
+    entries.clear();
+    parallel.clear();
+    parallelBytes = 0;
+}
+
+void PDFDoc::saveCompleteRewrite(OutStream *outStr, bool useObjectStreams)
 {
     // Make sure that special flags are set, because we are going to read
     // all objects, including Unencrypted ones.
@@ -1158,9 +1464,18 @@ void PDFDoc::saveCompleteRewrite(OutStream *outStr)
     int keyLength;
     xref->getEncryptionParameters(&fileKey, &encAlgorithm, &keyLength);
 
-    writeHeader(outStr, getPDFMajorVersion(), getPDFMinorVersion());
+    int minorVersion = getPDFMinorVersion();
+    if (useObjectStreams && getPDFMajorVersion() == 1) {
+        minorVersion = std::max(minorVersion, 5); // object streams need PDF 1.5
+    }
+    writeHeader(outStr, getPDFMajorVersion(), minorVersion);
     XRef *uxref = new XRef();
     uxref->add(0, 65535, 0, false);
+    std::unique_ptr<ObjectStreamWriter> objStms;
+    if (useObjectStreams) {
+        objStms = std::make_unique<ObjectStreamWriter>(outStr, uxref, xref->getNumObjects(), fileKey, encAlgorithm, keyLength);
+    }
+    ObjectWriteQueue queue(outStr, uxref, objStms.get());
     xref->lock();
     for (int i = 0; i < xref->getNumObjects(); i++) {
         Ref ref;
@@ -1182,28 +1497,43 @@ void PDFDoc::saveCompleteRewrite(OutStream *outStr)
             ref.num = i;
             ref.gen = xref->getEntry(i)->gen;
             Object obj1 = xref->fetch(ref, 1 /* recursion */);
-            Goffset offset = writeObjectHeader(&ref, outStr);
+            // the original object and xref streams are superseded by the ones we write
+            if (objStms && obj1.isStream() && (obj1.getStream()->getDict()->is("ObjStm") || obj1.getStream()->getDict()->is("XRef"))) {
+                ref.gen++;
+                uxref->add(ref, 0, false);
+                continue;
+            }
             // Write unencrypted objects in unencrypted form
             if (xref->getEntry(i)->getFlag(XRefEntry::Unencrypted)) {
-                writeObject(&obj1, outStr, nullptr, cryptRC4, 0, 0, 0);
+                queue.add(ref, std::move(obj1), getXRef(), 0, nullptr, cryptRC4, 0, { .num = 0, .gen = 0 }, false);
             } else {
-                writeObject(&obj1, outStr, fileKey, encAlgorithm, keyLength, ref);
+                queue.add(ref, std::move(obj1), getXRef(), 0, fileKey, encAlgorithm, keyLength, ref, true);
             }
-            writeObjectFooter(outStr);
-            uxref->add(ref, offset, true);
         } else if (type == xrefEntryCompressed) {
             ref.num = i;
             ref.gen = 0; // compressed entries have gen == 0
             Object obj1 = xref->fetch(ref, 1 /* recursion */);
-            Goffset offset = writeObjectHeader(&ref, outStr);
-            writeObject(&obj1, outStr, fileKey, encAlgorithm, keyLength, ref);
-            writeObjectFooter(outStr);
-            uxref->add(ref, offset, true);
+            queue.add(ref, std::move(obj1), getXRef(), 0, fileKey, encAlgorithm, keyLength, ref, true);
+        }
+        if (queue.isFull()) {
+            queue.flush();
         }
     }
+    queue.flush();
+    if (objStms) {
+        objStms->flush();
+    }
     xref->unlock();
     Goffset uxrefOffset = outStr->getPos();
-    writeXRefTableTrailer(uxrefOffset, uxref, true /* write all entries */, uxref->getNumObjects(), outStr, false /* complete rewrite */);
+    if (objStms) {
+        Ref rootRef;
+        rootRef.num = getXRef()->getRootNum();
+        rootRef.gen = getXRef()->getRootGen();
+        Object trailerDict = createTrailerDict(uxref->getNumObjects(), false, 0, &rootRef, getXRef(), fileName ? fileName->c_str() : nullptr, str->getLength());
+        objStms->writeTrailer(std::move(trailerDict), getXRef());
+    } else {
+        writeXRefTableTrailer(uxrefOffset, uxref, true /* write all entries */, uxref->getNumObjects(), outStr, false /* complete rewrite */);
+    }
     delete uxref;
 }
 
@@ -1224,20 +1554,17 @@ std::string PDFDoc::sanitizedName(const std::string &name)
     return sanitizedName;
 }
 
-void PDFDoc::writeDictionary(Dict *dict, OutStream *outStr, XRef *xRef, unsigned int numOffset, const unsigned char *fileKey, CryptAlgorithm encAlgorithm, int keyLength, Ref ref, std::set<Dict *> *alreadyWrittenDicts)
+void PDFDoc::writeDictionary(Dict *dict, OutStream *outStr, XRef *xRef, unsigned int numOffset, const unsigned char *fileKey, CryptAlgorithm encAlgorithm, int keyLength, Ref ref, std::unordered_set<Dict *> *alreadyWrittenDicts,
+                             const std::unordered_map<int, Ref> *replacedRefs)
 {
-    bool deleteSet = false;
+    std::unordered_set<Dict *> writtenDicts;
     if (!alreadyWrittenDicts) {
-        alreadyWrittenDicts = new std::set<Dict *>;
-        deleteSet = true;
+        alreadyWrittenDicts = &writtenDicts;
     }
 
     const auto [_, inserted] = alreadyWrittenDicts->insert(dict);
     if (!inserted) {
         error(errSyntaxWarning, -1, "PDFDoc::writeDictionary: Found recursive dicts");
-        if (deleteSet) {
-            delete alreadyWrittenDicts;
-        }
         return;
     }
 
@@ -1246,40 +1573,71 @@ void PDFDoc::writeDictionary(Dict *dict, OutStream *outStr, XRef *xRef, unsigned
         const std::string &keyName = dict->getKey(i);
         outStr->printf("/%s ", sanitizedName(keyName).c_str());
         Object obj1 = dict->getValNF(i).copy();
-        writeObject(&obj1, outStr, xRef, numOffset, fileKey, encAlgorithm, keyLength, ref, alreadyWrittenDicts);
+        writeObject(&obj1, outStr, xRef, numOffset, fileKey, encAlgorithm, keyLength, ref, alreadyWrittenDicts, replacedRefs);
     }
     outStr->printf(">> ");
-
-    if (deleteSet) {
-        delete alreadyWrittenDicts;
-    }
 }
 
+// Size of the blocks stream data is copied in
+static const int streamCopyBlockSize = 65536;
+
 void PDFDoc::writeStream(Stream *str, OutStream *outStr)
 {
     if (!str->rewind()) {
         return;
     }
     outStr->printf("stream\r\n");
-    for (int c = str->getChar(); c != EOF; c = str->getChar()) {
-        outStr->printf("%c", c);
+    std::vector<unsigned char> buf(streamCopyBlockSize);
+    for (int n; (n = str->doGetChars(streamCopyBlockSize, buf.data())) > 0;) {
+        outStr->write(std::span(buf.data(), n));
     }
     outStr->printf("\r\nendstream\r\n");
 }
 
-void PDFDoc::writeRawStream(Stream *str, OutStream *outStr)
+// Reads the Length bytes of raw data of str, which unfilteredRewind()
+// must have rewound, passing them to f in blocks until it returns false.
+// Returns false on a premature EOF.
+static bool readRawStreamData(Stream *str, Goffset length, const std::function<bool(std::span<const unsigned char>)> &f)
 {
-    Object obj1 = str->getDict()->lookup("Length");
-    if (!obj1.isInt() && !obj1.isInt64()) {
-        error(errSyntaxError, -1, "PDFDoc::writeRawStream, no Length in stream dict");
-        return;
+    // The unfiltered data is that of the base stream, which
+    // unfilteredRewind() has rewound too
+    BaseStream *baseStr = str->getBaseStream();
+    if (unlikely(!baseStr)) {
+        return false;
+    }
+    std::vector<unsigned char> buf(static_cast<size_t>(std::clamp(length, Goffset(1), Goffset(streamCopyBlockSize))));
+    for (Goffset i = 0; i < length;) {
+        const int n = baseStr->doGetChars(static_cast<int>(std::min(length - i, static_cast<Goffset>(buf.size()))), buf.data());
+        if (unlikely(n <= 0)) {
+            return false;
+        }
+        if (!f(std::span<const unsigned char>(buf.data(), n))) {
+            break;
+        }
+        i += n;
     }
+    return true;
+}
 
-    Goffset length;
+static bool getStreamLength(Stream *str, Goffset *length)
+{
+    Object obj1 = str->getDict()->lookup("Length");
     if (obj1.isInt()) {
-        length = obj1.getInt();
+        *length = obj1.getInt();
+    } else if (obj1.isInt64()) {
+        *length = obj1.getInt64();
     } else {
-        length = obj1.getInt64();
+        return false;
+    }
+    return true;
+}
+
+void PDFDoc::writeRawStream(Stream *str, OutStream *outStr)
+{
+    Goffset length;
+    if (!getStreamLength(str, &length)) {
+        error(errSyntaxError, -1, "PDFDoc::writeRawStream, no Length in stream dict");
+        return;
     }
 
     outStr->printf("stream\r\n");
@@ -1287,13 +1645,12 @@ void PDFDoc::writeRawStream(Stream *str, OutStream *outStr)
         error(errSyntaxError, -1, "PDFDoc::writeRawStream, rewind failed");
         return;
     }
-    for (Goffset i = 0; i < length; i++) {
-        int c = str->getUnfilteredChar();
-        if (unlikely(c == EOF)) {
-            error(errSyntaxError, -1, "PDFDoc::writeRawStream: EOF reading stream");
-            break;
-        }
-        outStr->printf("%c", c);
+    const bool ok = readRawStreamData(str, length, [outStr](std::span<const unsigned char> data) {
+        outStr->write(data);
+        return true;
+    });
+    if (unlikely(!ok)) {
+        error(errSyntaxError, -1, "PDFDoc::writeRawStream: EOF reading stream");
     }
     (void)str->rewind();
     outStr->printf("\r\nendstream\r\n");
@@ -1358,12 +1715,14 @@ Goffset PDFDoc::writeObjectHeader(Ref *ref, OutStream *outStr)
     return offset;
 }
 
-void PDFDoc::writeObject(Object *obj, OutStream *outStr, XRef *xRef, unsigned int numOffset, const unsigned char *fileKey, CryptAlgorithm encAlgorithm, int keyLength, int objNum, int objGen, std::set<Dict *> *alreadyWrittenDicts)
+void PDFDoc::writeObject(Object *obj, OutStream *outStr, XRef *xRef, unsigned int numOffset, const unsigned char *fileKey, CryptAlgorithm encAlgorithm, int keyLength, int objNum, int objGen, std::unordered_set<Dict *> *alreadyWrittenDicts,
+                         const std::unordered_map<int, Ref> *replacedRefs)
 {
-    writeObject(obj, outStr, xRef, numOffset, fileKey, encAlgorithm, keyLength, { .num = objNum, .gen = objGen }, alreadyWrittenDicts);
+    writeObject(obj, outStr, xRef, numOffset, fileKey, encAlgorithm, keyLength, { .num = objNum, .gen = objGen }, alreadyWrittenDicts, replacedRefs);
 }
 
-void PDFDoc::writeObject(Object *obj, OutStream *outStr, XRef *xRef, unsigned int numOffset, const unsigned char *fileKey, CryptAlgorithm encAlgorithm, int keyLength, Ref ref, std::set<Dict *> *alreadyWrittenDicts)
+void PDFDoc::writeObject(Object *obj, OutStream *outStr, XRef *xRef, unsigned int numOffset, const unsigned char *fileKey, CryptAlgorithm encAlgorithm, int keyLength, Ref ref, std::unordered_set<Dict *> *alreadyWrittenDicts,
+                         const std::unordered_map<int, Ref> *replacedRefs)
 {
     Array *array;
 
@@ -1407,18 +1766,22 @@ void PDFDoc::writeObject(Object *obj, OutStream *outStr, XRef *xRef, unsigned in
         outStr->printf("[");
         for (int i = 0; i < array->getLength(); i++) {
             Object obj1 = array->getNF(i).copy();
-            writeObject(&obj1, outStr, xRef, numOffset, fileKey, encAlgorithm, keyLength, ref);
+            writeObject(&obj1, outStr, xRef, numOffset, fileKey, encAlgorithm, keyLength, ref, nullptr, replacedRefs);
         }
         outStr->printf("] ");
         break;
     case objDict:
-        writeDictionary(obj->getDict(), outStr, xRef, numOffset, fileKey, encAlgorithm, keyLength, ref, alreadyWrittenDicts);
+        writeDictionary(obj->getDict(), outStr, xRef, numOffset, fileKey, encAlgorithm, keyLength, ref, alreadyWrittenDicts, replacedRefs);
         break;
     case objStream: {
         // We can't modify stream with the current implementation (no write functions in Stream API)
         // => the only type of streams which that have been modified are internal streams (=strWeird)
         Stream *stream = obj->getStream();
-        if (stream->getKind() == strWeird || stream->getKind() == strCrypt) {
+        // An unfiltered encrypted stream that would be encrypted again with
+        // the same object key can be copied raw
+        auto *cryptStream = dynamic_cast<DecryptStream *>(stream);
+        const bool sameKey = cryptStream && fileKey && cryptStream->hasObjectKey(fileKey, encAlgorithm, keyLength, ref);
+        if ((stream->getKind() == strWeird || stream->getKind() == strCrypt) && !sameKey) {
             // we write the stream unencoded => TODO: write stream encoder
 
             // Encrypt stream
@@ -1481,11 +1844,11 @@ void PDFDoc::writeObject(Object *obj, OutStream *outStr, XRef *xRef, unsigned in
             }
             stream->getDict()->remove("DecodeParms");
 
-            writeDictionary(stream->getDict(), outStr, xRef, numOffset, fileKey, encAlgorithm, keyLength, ref, alreadyWrittenDicts);
+            writeDictionary(stream->getDict(), outStr, xRef, numOffset, fileKey, encAlgorithm, keyLength, ref, alreadyWrittenDicts, replacedRefs);
             writeStream(stream, outStr);
         } else if (fileKey != nullptr && stream->getKind() == strFile && static_cast<FileStream *>(stream)->getNeedsEncryptionOnSave()) {
             auto *encStream = new EncryptStream(*stream, fileKey, encAlgorithm, keyLength, ref);
-            writeDictionary(encStream->getDict(), outStr, xRef, numOffset, fileKey, encAlgorithm, keyLength, ref, alreadyWrittenDicts);
+            writeDictionary(encStream->getDict(), outStr, xRef, numOffset, fileKey, encAlgorithm, keyLength, ref, alreadyWrittenDicts, replacedRefs);
             writeStream(encStream, outStr);
             delete encStream;
         } else {
@@ -1501,14 +1864,21 @@ void PDFDoc::writeObject(Object *obj, OutStream *outStr, XRef *xRef, unsigned in
                     }
                 }
             }
-            writeDictionary(stream->getDict(), outStr, xRef, numOffset, fileKey, encAlgorithm, keyLength, ref, alreadyWrittenDicts);
+            writeDictionary(stream->getDict(), outStr, xRef, numOffset, fileKey, encAlgorithm, keyLength, ref, alreadyWrittenDicts, replacedRefs);
             writeRawStream(stream, outStr);
         }
         break;
     }
-    case objRef:
-        outStr->printf("%i %i R ", obj->getRef().num + numOffset, obj->getRef().gen);
+    case objRef: {
+        Ref r = { .num = obj->getRef().num + static_cast<int>(numOffset), .gen = obj->getRef().gen };
+        if (replacedRefs) {
+            if (auto it = replacedRefs->find(r.num); it != replacedRefs->end()) {
+                r = it->second;
+            }
+        }
+        outStr->printf("%i %i R ", r.num, r.gen);
         break;
+    }
     case objCmd:
         outStr->printf("%s\n", obj->getCmd());
         break;
@@ -1620,6 +1990,278 @@ Object PDFDoc::createTrailerDict(int uxrefSize, bool incrUpdate, Goffset startxR
     return Object(std::move(trailerDict));
 }
 
+//------------------------------------------------------------------------
+// ObjectStreamWriter
+//------------------------------------------------------------------------
+
+// Objects per object stream: enough for the dictionaries to compress well
+// without making a reader inflate too much to get at a single object.
+static const int objStmMaxObjects = 100;
+
+ObjectStreamWriter::ObjectStreamWriter(OutStream *outStrA, XRef *uxrefA, int firstNum, const unsigned char *fileKeyA, CryptAlgorithm encAlgorithmA, int keyLengthA)
+    : outStr(outStrA), uxref(uxrefA), nextNum(firstNum), fileKey(fileKeyA), encAlgorithm(encAlgorithmA), keyLength(keyLengthA), nStreams(0)
+{
+}
+
+ObjectStreamWriter::~ObjectStreamWriter() = default;
+
+bool ObjectStreamWriter::add(Ref ref, Object *obj, XRef *xRef, unsigned int numOffset, const std::unordered_map<int, Ref> *replacedRefs)
+{
+    if (!canStore(ref, *obj)) {
+        return false;
+    }
+    pending.emplace_back(ref.num, body.getPos());
+    // Strings inside an object stream are not encrypted on their own, the
+    // whole stream is
+    PDFDoc::writeObject(obj, &body, xRef, numOffset, nullptr, cryptRC4, 0, ref, nullptr, replacedRefs);
+    body.put('\n');
+    // the entry is completed by flush()
+    uxref->add(ref, 0, true);
+    if (static_cast<int>(pending.size()) >= objStmMaxObjects) {
+        flush();
+    }
+    return true;
+}
+
+void ObjectStreamWriter::flush()
+{
+    if (pending.empty()) {
+        return;
+    }
+    Ref ref;
+    ref.num = std::max(nextNum, uxref->getNumObjects());
+    ref.gen = 0;
+    nextNum = ref.num + 1;
+
+    std::string header;
+    for (const auto &[num, offset] : pending) {
+        header += std::to_string(num);
+        header += ' ';
+        header += std::to_string(offset);
+        header += ' ';
+    }
+    header.back() = '\n';
+    std::vector<char> data;
+    data.reserve(header.size() + body.getData().size());
+    data.insert(data.end(), header.begin(), header.end());
+    data.insert(data.end(), body.getData().begin(), body.getData().end());
+
+    auto dict = std::make_unique<Dict>(uxref);
+    dict->add("Type", Object::name("ObjStm"));
+    dict->add("N", Object(static_cast<int>(pending.size())));
+    dict->add("First", Object(static_cast<int>(header.size())));
+    dict->add("Filter", Object::name("FlateDecode"));
+    auto stream = std::make_unique<AutoFreeMemStream>(std::move(data), Object(std::move(dict)));
+    stream->setFilterRemovalForbidden(true);
+    Object obj(std::move(stream));
+
+    Goffset offset = PDFDoc::writeObjectHeader(&ref, outStr);
+    PDFDoc::writeObject(&obj, outStr, uxref, 0, fileKey, encAlgorithm, keyLength, ref);
+    PDFDoc::writeObjectFooter(outStr);
+    uxref->add(ref, offset, true);
+
+    for (size_t i = 0; i < pending.size(); ++i) {
+        XRefEntry *e = uxref->getEntry(pending[i].first);
+        e->type = xrefEntryCompressed;
+        e->offset = ref.num;
+        e->gen = static_cast<int>(i);
+    }
+    pending.clear();
+    body.clear();
+    ++nStreams;
+}
+
+void ObjectStreamWriter::writeTrailer(Object &&trailerDict, XRef *xRef)
+{
+    flush();
+    Ref ref;
+    ref.num = std::max(nextNum, uxref->getNumObjects());
+    ref.gen = 0;
+    Goffset offset = outStr->getPos();
+    uxref->add(ref, offset, true);
+    trailerDict.dictSet("Size", Object(uxref->getNumObjects()));
+    trailerDict.dictSet("Filter", Object::name("FlateDecode"));
+    PDFDoc::writeXRefStreamTrailer(std::move(trailerDict), uxref, &ref, offset, outStr, xRef);
+}
+
+//------------------------------------------------------------------------
+// ObjectDeduplicator
+//------------------------------------------------------------------------
+
+ObjectDeduplicator::ObjectDeduplicator(XRef *uxrefA) : uxref(uxrefA), bytesSaved(0) { }
+
+ObjectDeduplicator::~ObjectDeduplicator() = default;
+
+// Whether obj may be replaced by another object with the same content.
+// Objects that are pointed at for what they are, not for their content,
+// must stay distinct: pages, annotations (/Rect), form fields and other
+// tree nodes (/Parent, /Kids), optional content groups, ...
+static bool isMergeable(const Object &obj)
+{
+    const Dict *dict = obj.isDict() ? obj.getDict() : obj.isStream() ? obj.getStream()->getDict() : nullptr;
+    if (!dict) {
+        return true;
+    }
+    // StructParent(s) tie a form XObject, image or annotation to its own
+    // entry in the document's parent tree
+    for (const char *key : { "Parent", "Kids", "P", "Rect", "FT", "StructParent", "StructParents" }) {
+        if (dict->hasKey(key)) {
+            return false;
+        }
+    }
+    const Object &type = dict->lookupNF("Type");
+    if (type.isName()) {
+        for (const char *name : { "Catalog", "Pages", "Page", "Annot", "OCG", "OCMD", "StructTreeRoot", "StructElem", "MCR", "OBJR", "Outlines", "Sig" }) {
+            if (type.isName(name)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// 64 bit FNV-1a, the byte comparison made before merging guards against
+// collisions
+static void hashData(std::span<const unsigned char> data, uint64_t *h)
+{
+    for (unsigned char c : data) {
+        *h = (*h ^ c) * 0x100000001b3ULL;
+    }
+}
+
+static bool hashRawStreamData(Stream *str, Goffset *length, uint64_t *h)
+{
+    if (!getStreamLength(str, length) || *length < 0 || !str->unfilteredRewind()) {
+        return false;
+    }
+    *h = 0xcbf29ce484222325ULL;
+    const bool ok = readRawStreamData(str, *length, [h](std::span<const unsigned char> data) {
+        hashData(data, h);
+        return true;
+    });
+    (void)str->rewind();
+    return ok;
+}
+
+static bool sameRawStreamData(Stream *str1, Stream *str2, Goffset length)
+{
+    std::vector<unsigned char> data1;
+    if (!str1->unfilteredRewind()) {
+        return false;
+    }
+    bool ok = readRawStreamData(str1, length, [&data1](std::span<const unsigned char> data) {
+        data1.insert(data1.end(), data.begin(), data.end());
+        return true;
+    });
+    (void)str1->rewind();
+    if (!ok || !str2->unfilteredRewind()) {
+        return false;
+    }
+    size_t pos = 0;
+    bool same = true;
+    ok = readRawStreamData(str2, length, [&](std::span<const unsigned char> data) {
+        same = pos + data.size() <= data1.size() && std::equal(data.begin(), data.end(), data1.begin() + pos);
+        pos += data.size();
+        return same;
+    });
+    (void)str2->rewind();
+    return ok && same && pos == data1.size();
+}
+
+void ObjectDeduplicator::addDocument(PDFDoc *doc, unsigned int numOffset)
+{
+    struct Candidate
+    {
+        Ref ref; // in uxref
+        Object obj;
+        Goffset rawLength; // for streams
+        uint64_t rawHash;
+        std::string key;
+    };
+
+    XRef *xRef = doc->getXRef();
+    std::vector<Candidate> candidates;
+    const int numObjects = uxref->getNumObjects();
+    for (int n = numOffset; n < numObjects; n++) {
+        const XRefEntry *entry = uxref->getEntry(n);
+        if (entry->type == xrefEntryFree) {
+            continue;
+        }
+        Candidate c { .ref = { .num = n, .gen = entry->gen }, .obj = xRef->fetch(n - numOffset, entry->gen), .rawLength = 0, .rawHash = 0, .key = {} };
+        if (!isMergeable(c.obj)) {
+            continue;
+        }
+        if (c.obj.isStream() && !hashRawStreamData(c.obj.getStream(), &c.rawLength, &c.rawHash)) {
+            continue;
+        }
+        candidates.push_back(std::move(c));
+    }
+
+    // Merging objects changes the serialization of the objects referring
+    // to them, which may make those identical in turn: repeat until
+    // nothing merges.
+    MemOutStream out;
+    bool merged;
+    do {
+        merged = false;
+        std::unordered_map<std::string, size_t> local; // candidates of this pass, by content
+        for (size_t i = 0; i < candidates.size(); i++) {
+            Candidate &c = candidates[i];
+            if (replacedRefs.contains(c.ref.num)) {
+                continue;
+            }
+            out.clear();
+            if (c.obj.isStream()) {
+                out.printf("stream %lld %llx ", static_cast<long long>(c.rawLength), static_cast<unsigned long long>(c.rawHash));
+                PDFDoc::writeDictionary(c.obj.getStream()->getDict(), &out, xRef, numOffset, nullptr, cryptRC4, 0, { .num = 0, .gen = 0 }, nullptr, &replacedRefs);
+            } else {
+                PDFDoc::writeObject(&c.obj, &out, xRef, numOffset, nullptr, cryptRC4, 0, { .num = 0, .gen = 0 }, nullptr, &replacedRefs);
+            }
+            c.key.assign(out.getData().begin(), out.getData().end());
+
+            Ref target = Ref::INVALID();
+            if (auto it = kept.find(c.key); it != kept.end()) {
+                const KeptObject &k = it->second;
+                if (!c.obj.isStream()) {
+                    target = k.ref;
+                } else {
+                    Object keptObj = k.doc->getXRef()->fetch(k.srcRef);
+                    if (keptObj.isStream() && sameRawStreamData(keptObj.getStream(), c.obj.getStream(), c.rawLength)) {
+                        target = k.ref;
+                    }
+                }
+            } else if (auto [it2, inserted] = local.try_emplace(c.key, i); !inserted) {
+                const Candidate &k = candidates[it2->second];
+                if (!c.obj.isStream() || sameRawStreamData(k.obj.getStream(), c.obj.getStream(), c.rawLength)) {
+                    target = k.ref;
+                }
+            }
+            if (target != Ref::INVALID()) {
+                replacedRefs[c.ref.num] = target;
+                uxref->getEntry(c.ref.num)->type = xrefEntryFree;
+                bytesSaved += static_cast<Goffset>(c.key.size()) + c.rawLength;
+                merged = true;
+            }
+        }
+
+        // an object kept in this pass may have been replaced in a later one
+        for (const Candidate &c : candidates) {
+            auto it = replacedRefs.find(c.ref.num);
+            if (it != replacedRefs.end()) {
+                for (auto next = replacedRefs.find(it->second.num); next != replacedRefs.end(); next = replacedRefs.find(it->second.num)) {
+                    it->second = next->second;
+                }
+            }
+        }
+    } while (merged);
+
+    for (const Candidate &c : candidates) {
+        if (!replacedRefs.contains(c.ref.num)) {
+            kept.try_emplace(c.key, KeptObject { .doc = doc, .srcRef = { .num = c.ref.num - static_cast<int>(numOffset), .gen = c.ref.gen }, .ref = c.ref });
+        }
+    }
+}
+
 void PDFDoc::writeXRefTableTrailer(Object &&trailerDict, XRef *uxref, bool writeAllEntries, Goffset uxrefOffset, OutStream *outStr, XRef *xRef)
 {
     uxref->writeTableToFile(outStr, writeAllEntries);
@@ -1675,20 +2317,16 @@ void PDFDoc::writeHeader(OutStream *outStr, int major, int minor)
     outStr->printf("%%%c%c%c%c\n", 0xE2, 0xE3, 0xCF, 0xD3);
 }
 
-bool PDFDoc::markDictionary(Dict *dict, XRef *xRef, XRef *countRef, unsigned int numOffset, int oldRefNum, int newRefNum, std::set<Dict *> *alreadyMarkedDicts)
+bool PDFDoc::markDictionary(Dict *dict, XRef *xRef, XRef *countRef, unsigned int numOffset, int oldRefNum, int newRefNum, std::unordered_set<Dict *> *alreadyMarkedDicts)
 {
-    bool deleteSet = false;
+    std::unordered_set<Dict *> markedDicts;
     if (!alreadyMarkedDicts) {
-        alreadyMarkedDicts = new std::set<Dict *>;
-        deleteSet = true;
+        alreadyMarkedDicts = &markedDicts;
     }
 
     const auto [_, inserted] = alreadyMarkedDicts->insert(dict);
     if (!inserted) {
         error(errSyntaxWarning, -1, "PDFDoc::markDictionary: Found recursive dicts");
-        if (deleteSet) {
-            delete alreadyMarkedDicts;
-        }
         return true;
     }
 
@@ -1708,14 +2346,10 @@ bool PDFDoc::markDictionary(Dict *dict, XRef *xRef, XRef *countRef, unsigned int
         }
     }
 
-    if (deleteSet) {
-        delete alreadyMarkedDicts;
-    }
-
     return true;
 }
 
-bool PDFDoc::markObject(Object *obj, XRef *xRef, XRef *countRef, unsigned int numOffset, int oldRefNum, int newRefNum, std::set<Dict *> *alreadyMarkedDicts)
+bool PDFDoc::markObject(Object *obj, XRef *xRef, XRef *countRef, unsigned int numOffset, int oldRefNum, int newRefNum, std::unordered_set<Dict *> *alreadyMarkedDicts)
 {
     Array *array;
 
@@ -1765,7 +2399,7 @@ bool PDFDoc::markObject(Object *obj, XRef *xRef, XRef *countRef, unsigned int nu
                 break;
             }
         }
-        Object obj1 = getXRef()->fetch(obj->getRef());
+        Object obj1 = fetchPageObject(obj->getRef());
         const bool success = markObject(&obj1, xRef, countRef, numOffset, oldRefNum, newRefNum);
         if (unlikely(!success)) {
             return false;
@@ -1781,7 +2415,7 @@ bool PDFDoc::markObject(Object *obj, XRef *xRef, XRef *countRef, unsigned int nu
 bool PDFDoc::replacePageDict(int pageNo, int rotate, const PDFRectangle &mediaBox, const PDFRectangle *cropBox) const
 {
     Ref *refPage = getCatalog()->getPageRef(pageNo);
-    Object page = getXRef()->fetch(*refPage);
+    Object page = fetchPageObject(*refPage, true);
     if (!page.isDict()) {
         return false;
     }
@@ -1813,11 +2447,11 @@ bool PDFDoc::replacePageDict(int pageNo, int rotate, const PDFRectangle &mediaBo
     }
     pageDict->add("TrimBox", std::move(trimBoxObject));
     pageDict->add("Rotate", Object(rotate));
-    getXRef()->setModifiedObject(&page, *refPage);
+    setModifiedPageObject(&page, *refPage);
     return true;
 }
 
-bool PDFDoc::markPageObjects(Dict *pageDict, XRef *xRef, XRef *countRef, unsigned int numOffset, int oldRefNum, int newRefNum, std::set<Dict *> *alreadyMarkedDicts)
+bool PDFDoc::markPageObjects(Dict *pageDict, XRef *xRef, XRef *countRef, unsigned int numOffset, int oldRefNum, int newRefNum, std::unordered_set<Dict *> *alreadyMarkedDicts)
 {
     pageDict->remove("OpenAction");
     pageDict->remove("Outlines");
@@ -1836,14 +2470,14 @@ bool PDFDoc::markPageObjects(Dict *pageDict, XRef *xRef, XRef *countRef, unsigne
     return true;
 }
 
-bool PDFDoc::markAnnotations(Object *annotsObj, XRef *xRef, XRef *countRef, unsigned int numOffset, int oldPageNum, int newPageNum, std::set<Dict *> *alreadyMarkedDicts)
+bool PDFDoc::markAnnotations(Object *annotsObj, XRef *xRef, XRef *countRef, unsigned int numOffset, int oldPageNum, int newPageNum, std::unordered_set<Dict *> *alreadyMarkedDicts)
 {
     bool modified = false;
-    Object annots = annotsObj->fetch(getXRef());
+    Object annots = annotsObj->isRef() ? fetchPageObject(annotsObj->getRef(), true) : annotsObj->copy();
     if (annots.isArray()) {
         Array *array = annots.getArray();
         for (int i = array->getLength() - 1; i >= 0; i--) {
-            Object obj1 = array->get(i);
+            Object obj1 = array->getNF(i).isRef() ? fetchPageObject(array->getNF(i).getRef()) : array->get(i);
             if (obj1.isDict()) {
                 Dict *dict = obj1.getDict();
                 Object type = dict->lookup("Type");
@@ -1862,11 +2496,15 @@ bool PDFDoc::markAnnotations(Object *annotsObj, XRef *xRef, XRef *countRef, unsi
                         if (obj2.getRef().num == oldPageNum) {
                             const Object &obj3 = array->getNF(i);
                             if (obj3.isRef()) {
+                                if (modifiedPageObjects && !modifiedPageObjects->contains(obj3.getRef().num)) {
+                                    obj1 = obj1.deepCopy();
+                                    dict = obj1.getDict();
+                                }
                                 Ref r;
                                 r.num = newPageNum;
                                 r.gen = 0;
                                 dict->set("P", Object(r));
-                                getXRef()->setModifiedObject(&obj1, obj3.getRef());
+                                setModifiedPageObject(&obj1, obj3.getRef());
                             }
                         } else if (obj2.getRef().num == newPageNum) {
                             continue;
@@ -1923,7 +2561,7 @@ bool PDFDoc::markAnnotations(Object *annotsObj, XRef *xRef, XRef *countRef, unsi
             XRefEntry *entry = countRef->getEntry(annotsObj->getRef().num + numOffset);
             entry->gen++;
         }
-        getXRef()->setModifiedObject(&annots, annotsObj->getRef());
+        setModifiedPageObject(&annots, annotsObj->getRef());
     }
     return modified;
 }
@@ -1931,7 +2569,7 @@ bool PDFDoc::markAnnotations(Object *annotsObj, XRef *xRef, XRef *countRef, unsi
 void PDFDoc::markAcroForm(Object *afObj, XRef *xRef, XRef *countRef, unsigned int numOffset, int oldRefNum, int newRefNum)
 {
     bool modified = false;
-    Object acroform = afObj->fetch(getXRef());
+    Object acroform = afObj->isRef() ? fetchPageObject(afObj->getRef(), true) : afObj->copy();
     if (acroform.isDict()) {
         Dict *dict = acroform.getDict();
         for (int i = 0; i < dict->getLength(); i++) {
@@ -1961,12 +2599,13 @@ void PDFDoc::markAcroForm(Object *afObj, XRef *xRef, XRef *countRef, unsigned in
             entry->gen++;
         }
         if (modified) {
-            getXRef()->setModifiedObject(&acroform, afObj->getRef());
+            setModifiedPageObject(&acroform, afObj->getRef());
         }
     }
 }
 
-unsigned int PDFDoc::writePageObjects(OutStream *outStr, XRef *xRef, unsigned int numOffset, bool combine)
+unsigned int PDFDoc::writePageObjects(OutStream *outStr, XRef *xRef, unsigned int numOffset, bool combine, ObjectStreamWriter *objStms, const std::unordered_map<int, Ref> *replacedRefs,
+                                      const std::unordered_map<int, Object> *modifiedObjects)
 {
     unsigned int objectsCount = 0; // count the number of objects in the XRef(s)
     unsigned char *fileKey;
@@ -1974,25 +2613,35 @@ unsigned int PDFDoc::writePageObjects(OutStream *outStr, XRef *xRef, unsigned in
     int keyLength;
     xRef->getEncryptionParameters(&fileKey, &encAlgorithm, &keyLength);
 
-    for (int n = numOffset; n < xRef->getNumObjects(); n++) {
+    ObjectWriteQueue queue(outStr, xRef, objStms, replacedRefs);
+    // object streams written by objStms are appended to xRef while we loop
+    const int numObjects = xRef->getNumObjects();
+    for (int n = numOffset; n < numObjects; n++) {
         if (xRef->getEntry(n)->type != xrefEntryFree) {
             Ref ref;
             ref.num = n;
             ref.gen = xRef->getEntry(n)->gen;
             objectsCount++;
-            Object obj = getXRef()->fetch(ref.num - numOffset, ref.gen);
-            Goffset offset = writeObjectHeader(&ref, outStr);
+            Object obj;
+            if (modifiedObjects && modifiedObjects->contains(ref.num - numOffset)) {
+                obj = modifiedObjects->at(ref.num - numOffset).copy();
+            } else {
+                obj = getXRef()->fetch(ref.num - numOffset, ref.gen);
+            }
+            const bool unencrypted = xRef->getEntry(n)->getFlag(XRefEntry::Unencrypted);
             if (combine) {
-                writeObject(&obj, outStr, getXRef(), numOffset, nullptr, cryptRC4, 0, 0, 0);
-            } else if (xRef->getEntry(n)->getFlag(XRefEntry::Unencrypted)) {
-                writeObject(&obj, outStr, nullptr, cryptRC4, 0, 0, 0);
+                queue.add(ref, std::move(obj), getXRef(), numOffset, nullptr, cryptRC4, 0, { .num = 0, .gen = 0 }, !unencrypted);
+            } else if (unencrypted) {
+                queue.add(ref, std::move(obj), getXRef(), 0, nullptr, cryptRC4, 0, { .num = 0, .gen = 0 }, false);
             } else {
-                writeObject(&obj, outStr, fileKey, encAlgorithm, keyLength, ref);
+                queue.add(ref, std::move(obj), getXRef(), 0, fileKey, encAlgorithm, keyLength, ref, true);
+            }
+            if (queue.isFull()) {
+                queue.flush();
             }
-            writeObjectFooter(outStr);
-            xRef->add(ref, offset, true);
         }
     }
+    queue.flush();
     return objectsCount;
 }
 
@@ -2180,6 +2829,32 @@ Page *PDFDoc::getPage(int page)
     return catalog->getPage(page);
 }
 
+void PDFDoc::releasePage(int page)
+{
+    if ((page < 1) || page > getNumPages()) {
+        return;
+    }
+
+    {
+        pdfdocLocker();
+        if (!pageCache.empty()) {
+            pageCache[page - 1].reset();
+        }
+    }
+    catalog->releasePage(page);
+}
+
+bool PDFDoc::isPageLoaded(int page)
+{
+    if (isLinearized() && checkLinearization()) {
+        pdfdocLocker();
+        if (page >= 1 && static_cast<std::size_t>(page) <= pageCache.size() && pageCache[page - 1]) {
+            return true;
+        }
+    }
+    return catalog->isPageLoaded(page);
+}
+
 bool PDFDoc::hasJavascript()
 {
     JSInfo jsInfo(this);
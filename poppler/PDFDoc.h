@@ -53,6 +53,9 @@
 
 #include <algorithm>
 #include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include "CryptoSignBackend.h"
 
@@ -80,12 +83,117 @@ class Linearization;
 class SecurityHandler;
 class Hints;
 class StructTreeRoot;
+class PDFDoc;
 
 enum PDFWriteMode
 {
     writeStandard,
     writeForceRewrite,
-    writeForceIncremental
+    writeForceIncremental,
+    writeForceRewriteCompressed // complete rewrite using object streams and an xref stream
+};
+
+//------------------------------------------------------------------------
+// ObjectStreamWriter
+//
+// Packs non-stream objects into Flate compressed object streams (PDF 1.5)
+// while a document is written.  Each object stream is written to outStr as
+// soon as it is full; the entries of the packed objects are recorded in
+// uxref as compressed entries, so the file has to end with an xref stream.
+//------------------------------------------------------------------------
+
+class POPPLER_PRIVATE_EXPORT ObjectStreamWriter
+{
+public:
+    // Object streams are numbered from max(firstNum, uxref size) upwards.
+    // fileKey etc. are used to encrypt the object streams themselves.
+    ObjectStreamWriter(OutStream *outStrA, XRef *uxrefA, int firstNum, const unsigned char *fileKeyA, CryptAlgorithm encAlgorithmA, int keyLengthA);
+    ~ObjectStreamWriter();
+
+    ObjectStreamWriter(const ObjectStreamWriter &) = delete;
+    ObjectStreamWriter &operator=(const ObjectStreamWriter &) = delete;
+
+    // Packs obj as object ref.  References inside obj are resolved in xRef
+    // and renumbered by numOffset, as in PDFDoc::writeObject.  Returns false
+    // if obj can't be stored in an object stream (streams and objects with
+    // a non zero generation); the caller then writes it as usual.
+    bool add(Ref ref, Object *obj, XRef *xRef, unsigned int numOffset, const std::unordered_map<int, Ref> *replacedRefs = nullptr);
+
+    // Whether add() would accept obj as object ref.
+    static bool canStore(Ref ref, const Object &obj) { return !obj.isStream() && ref.gen == 0; }
+
+    // Writes the pending object stream, if any.
+    void flush();
+
+    // Flushes, then ends the file with an xref stream for uxref.
+    // trailerDict is as returned by PDFDoc::createTrailerDict; its Size is
+    // updated to cover the xref stream itself.
+    void writeTrailer(Object &&trailerDict, XRef *xRef);
+
+    // Number of object streams written so far.
+    int getNumStreams() const { return nStreams; }
+
+private:
+    OutStream *outStr;
+    XRef *uxref;
+    int nextNum;
+    const unsigned char *fileKey;
+    CryptAlgorithm encAlgorithm;
+    int keyLength;
+
+    MemOutStream body; // serialized objects of the pending stream
+    std::vector<std::pair<int, Goffset>> pending; // object number and offset in body
+    int nStreams;
+};
+
+//------------------------------------------------------------------------
+// ObjectDeduplicator
+//
+// Finds the objects that are marked in an output xref more than once
+// with the same content, typically the fonts and images shared by the
+// documents pdfunite merges, so that only one copy of them is written.
+// Streams are compared by their raw data and dictionary, other objects by
+// their serialization with the references to merged objects already
+// replaced, so that e.g. fonts whose descriptors were merged merge too.
+// Objects whose identity matters (pages, annotations, form fields, ...)
+// are never merged.
+//------------------------------------------------------------------------
+
+class POPPLER_PRIVATE_EXPORT ObjectDeduplicator
+{
+public:
+    explicit ObjectDeduplicator(XRef *uxrefA);
+    ~ObjectDeduplicator();
+
+    ObjectDeduplicator(const ObjectDeduplicator &) = delete;
+    ObjectDeduplicator &operator=(const ObjectDeduplicator &) = delete;
+
+    // Merges the objects of doc marked in uxref from numOffset on with
+    // each other and with the objects kept from the documents added
+    // before.  The duplicates are freed in uxref, see getReplacedRefs().
+    // The documents must stay alive while more are added.
+    void addDocument(PDFDoc *doc, unsigned int numOffset);
+
+    // The freed objects, by number in uxref, and the object written in
+    // their place.  To be passed to PDFDoc::writePageObjects/writeObject.
+    const std::unordered_map<int, Ref> *getReplacedRefs() const { return &replacedRefs; }
+
+    // Number of objects freed so far and about how many bytes they take.
+    int getNumReplaced() const { return static_cast<int>(replacedRefs.size()); }
+    Goffset getBytesSaved() const { return bytesSaved; }
+
+private:
+    struct KeptObject
+    {
+        PDFDoc *doc;
+        Ref srcRef; // in doc
+        Ref ref; // in uxref
+    };
+
+    XRef *uxref;
+    std::unordered_map<std::string, KeptObject> kept; // by content
+    std::unordered_map<int, Ref> replacedRefs;
+    Goffset bytesSaved;
 };
 
 enum PDFSubtype
@@ -199,6 +307,12 @@ public:
     // Get page. First page is page 1.
     Page *getPage(int page);
 
+    // Free a page and its annotations; see Catalog::releasePage.
+    void releasePage(int page);
+
+    // Is a page loaded?  See Catalog::isPageLoaded.
+    bool isPageLoaded(int page);
+
     // Display a page.
     void displayPage(OutputDev *out, int page, double hDPI, double vDPI, int rotate, bool useMediaBox, bool crop, bool printing, bool (*abortCheckCbk)(void *data) = nullptr, void *abortCheckCbkData = nullptr,
                      bool (*annotDisplayDecideCbk)(Annot *annot, void *user_data) = nullptr, void *annotDisplayDecideCbkData = nullptr, bool copyXRef = false);
@@ -304,8 +418,15 @@ public:
     // Return the PDF ID in the trailer dictionary (if any).
     bool getID(GooString *permanent_id, GooString *update_id) const;
 
-    // Save one page with another name.
-    int savePageAs(const std::string &name, int pageNo);
+    // Save one page with another name.  With writeForceRewriteCompressed
+    // the objects are packed into object streams.
+    int savePageAs(const std::string &name, int pageNo, PDFWriteMode mode = writeStandard);
+    // Save several pages to files of their own, page pages[i].first to
+    // pages[i].second, like savePageAs does.  The file is opened once per
+    // thread and the pages are written in parallel, by up to nThreads
+    // threads (0 for one per hardware thread).  Stops at the first error,
+    // which is returned.
+    int savePagesAs(const std::vector<std::pair<int, std::string>> &pages, PDFWriteMode mode = writeStandard, int nThreads = 0);
     // Save this file with another name.
     int saveAs(const std::string &name, PDFWriteMode mode = writeStandard);
     // Save this file in the given output stream.
@@ -317,14 +438,19 @@ public:
 
     // rewrite pageDict with MediaBox, CropBox and new page CTM
     bool replacePageDict(int pageNo, int rotate, const PDFRectangle &mediaBox, const PDFRectangle *cropBox) const;
-    bool markPageObjects(Dict *pageDict, XRef *xRef, XRef *countRef, unsigned int numOffset, int oldRefNum, int newRefNum, std::set<Dict *> *alreadyMarkedDicts = nullptr);
-    bool markAnnotations(Object *annots, XRef *xRef, XRef *countRef, unsigned int numOffset, int oldPageNum, int newPageNum, std::set<Dict *> *alreadyMarkedDicts = nullptr);
+    bool markPageObjects(Dict *pageDict, XRef *xRef, XRef *countRef, unsigned int numOffset, int oldRefNum, int newRefNum, std::unordered_set<Dict *> *alreadyMarkedDicts = nullptr);
+    bool markAnnotations(Object *annots, XRef *xRef, XRef *countRef, unsigned int numOffset, int oldPageNum, int newPageNum, std::unordered_set<Dict *> *alreadyMarkedDicts = nullptr);
     void markAcroForm(Object *afObj, XRef *xRef, XRef *countRef, unsigned int numOffset, int oldRefNum, int newRefNum);
     // write all objects used by pageDict to outStr
-    unsigned int writePageObjects(OutStream *outStr, XRef *xRef, unsigned int numOffset, bool combine = false);
+    // if objStms is given, the objects that can be are packed into object streams
+    // references to the objects in replacedRefs are written as references to their replacement
+    // the objects in modifiedObjects, by number in this document, are written instead of the document's
+    unsigned int writePageObjects(OutStream *outStr, XRef *xRef, unsigned int numOffset, bool combine = false, ObjectStreamWriter *objStms = nullptr, const std::unordered_map<int, Ref> *replacedRefs = nullptr,
+                                  const std::unordered_map<int, Object> *modifiedObjects = nullptr);
     static void writeObject(Object *obj, OutStream *outStr, XRef *xref, unsigned int numOffset, const unsigned char *fileKey, CryptAlgorithm encAlgorithm, int keyLength, int objNum, int objGen,
-                            std::set<Dict *> *alreadyWrittenDicts = nullptr);
-    static void writeObject(Object *obj, OutStream *outStr, XRef *xref, unsigned int numOffset, const unsigned char *fileKey, CryptAlgorithm encAlgorithm, int keyLength, Ref ref, std::set<Dict *> *alreadyWrittenDicts = nullptr);
+                            std::unordered_set<Dict *> *alreadyWrittenDicts = nullptr, const std::unordered_map<int, Ref> *replacedRefs = nullptr);
+    static void writeObject(Object *obj, OutStream *outStr, XRef *xref, unsigned int numOffset, const unsigned char *fileKey, CryptAlgorithm encAlgorithm, int keyLength, Ref ref, std::unordered_set<Dict *> *alreadyWrittenDicts = nullptr,
+                            const std::unordered_map<int, Ref> *replacedRefs = nullptr);
     static void writeHeader(OutStream *outStr, int major, int minor);
 
     static Object createTrailerDict(int uxrefSize, bool incrUpdate, Goffset startxRef, Ref *root, XRef *xRef, const char *fileName, Goffset fileSize);
@@ -355,15 +481,28 @@ public:
                                                                                  std::unique_ptr<AnnotColor> &&backgroundColor, const std::string &imagePath);
 
 private:
+    friend class ObjectStreamWriter;
+    friend class ObjectWriteQueue;
+    friend class ObjectDeduplicator;
+
+    // savePageAs() for savePagesAs()
+    int savePageCopyAs(const std::string &name, int pageNo, PDFWriteMode mode);
+    // Fetch and store the objects changed while marking the objects of a
+    // page.  With forUpdate, savePageCopyAs() gets a copy of the object
+    // that it may change.
+    Object fetchPageObject(Ref ref, bool forUpdate = false) const;
+    void setModifiedPageObject(const Object *obj, Ref ref) const;
+
     // insert referenced objects in XRef
-    bool markDictionary(Dict *dict, XRef *xRef, XRef *countRef, unsigned int numOffset, int oldRefNum, int newRefNum, std::set<Dict *> *alreadyMarkedDicts);
-    bool markObject(Object *obj, XRef *xRef, XRef *countRef, unsigned int numOffset, int oldRefNum, int newRefNum, std::set<Dict *> *alreadyMarkedDicts = nullptr);
+    bool markDictionary(Dict *dict, XRef *xRef, XRef *countRef, unsigned int numOffset, int oldRefNum, int newRefNum, std::unordered_set<Dict *> *alreadyMarkedDicts);
+    bool markObject(Object *obj, XRef *xRef, XRef *countRef, unsigned int numOffset, int oldRefNum, int newRefNum, std::unordered_set<Dict *> *alreadyMarkedDicts = nullptr);
 
     // Sanitizes the string so that it does
     // not contain any ( ) < > [ ] { } / %
     static std::string sanitizedName(const std::string &name);
 
-    static void writeDictionary(Dict *dict, OutStream *outStr, XRef *xRef, unsigned int numOffset, const unsigned char *fileKey, CryptAlgorithm encAlgorithm, int keyLength, Ref ref, std::set<Dict *> *alreadyWrittenDicts);
+    static void writeDictionary(Dict *dict, OutStream *outStr, XRef *xRef, unsigned int numOffset, const unsigned char *fileKey, CryptAlgorithm encAlgorithm, int keyLength, Ref ref, std::unordered_set<Dict *> *alreadyWrittenDicts,
+                                const std::unordered_map<int, Ref> *replacedRefs = nullptr);
 
     // Write object header to current file stream and return its offset
     static Goffset writeObjectHeader(Ref *ref, OutStream *outStr);
@@ -379,7 +518,7 @@ private:
     void writeXRefTableTrailer(Goffset uxrefOffset, XRef *uxref, bool writeAllEntries, int uxrefSize, OutStream *outStr, bool incrUpdate);
     static void writeString(const std::string &s, OutStream *outStr, const unsigned char *fileKey, CryptAlgorithm encAlgorithm, int keyLength, Ref ref);
     void saveIncrementalUpdate(OutStream *outStr);
-    void saveCompleteRewrite(OutStream *outStr);
+    void saveCompleteRewrite(OutStream *outStr, bool useObjectStreams);
 
     std::unique_ptr<Page> parsePage(int page);
 
@@ -422,6 +561,9 @@ private:
     Hints *hints = nullptr;
     Outline *outline = nullptr;
     std::vector<std::unique_ptr<Page>> pageCache;
+    // If set, setModifiedPageObject() stores the changes here instead of
+    // in the XRef, so that they don't leak into the next page saved
+    std::unordered_map<int, Object> *modifiedPageObjects = nullptr;
 
     bool ok = false;
     int errCode = errNone;
@@ -1297,6 +1297,7 @@ void PSOutputDev::postInit()
 
     paperSizes.clear();
     for (const int pg : pages) {
+        const bool pageLoaded = catalog->isPageLoaded(pg);
         Page *page = catalog->getPage(pg);
         if (page == nullptr) {
             paperMatch = false;
@@ -1324,6 +1325,10 @@ void PSOutputDev::postInit()
                 std::swap(w, h);
             }
         }
+        if (streamingResources() && !pageLoaded) {
+            // don't keep every page of a long document loaded
+            catalog->releasePage(pg);
+        }
         if (w > paperWidth) {
             paperWidth = w;
         }
@@ -1459,7 +1464,7 @@ void PSOutputDev::postInit()
             writePS("%%EndProlog\n");
             writePS("%%BeginSetup\n");
         }
-        writeDocSetup(catalog, pageList, duplex);
+        writeDocSetup(pageList, duplex);
         if (mode != psModeForm) {
             writePS("%%EndSetup\n");
         }
@@ -1646,12 +1651,8 @@ void PSOutputDev::writeXpdfProcset()
     }
 }
 
-void PSOutputDev::writeDocSetup(Catalog *catalog, const std::vector<int> &pageList, bool duplexA)
+void PSOutputDev::writeDocSetup(const std::vector<int> &pageList, bool duplexA)
 {
-    Page *page;
-    Dict *resDict;
-    Annots *annots;
-    Object *acroForm;
     GooString *s;
 
     if (mode == psModeForm) {
@@ -1660,40 +1661,33 @@ void PSOutputDev::writeDocSetup(Catalog *catalog, const std::vector<int> &pageLi
     } else {
         writePS("xpdf begin\n");
     }
-    for (const int pg : pageList) {
-        page = doc->getPage(pg);
-        if (!page) {
-            error(errSyntaxError, -1, "Failed writing resources for page {0:d}", pg);
-            continue;
-        }
-        if ((resDict = page->getResourceDict())) {
-            setupResources(resDict);
-        }
-        annots = page->getAnnots();
-        for (const std::shared_ptr<Annot> &annot : annots->getAnnots()) {
-            Object obj1 = annot->getAppearanceResDict();
-            if (obj1.isDict()) {
-                setupResources(obj1.getDict());
-            }
-        }
+    if (subsetFonts) {
+        scanFontCodes(pageList);
     }
-    if ((acroForm = catalog->getAcroForm()) && acroForm->isDict()) {
-        Object obj1 = acroForm->dictLookup("DR");
-        if (obj1.isDict()) {
-            setupResources(obj1.getDict());
-        }
-        obj1 = acroForm->dictLookup("Fields");
-        if (obj1.isArray()) {
-            for (int i = 0; i < obj1.arrayGetLength(); ++i) {
-                Object obj2 = obj1.arrayGet(i);
-                if (obj2.isDict()) {
-                    Object obj3 = obj2.dictLookup("DR");
-                    if (obj3.isDict()) {
-                        setupResources(obj3.getDict());
-                    }
-                }
+    if (streamingResources()) {
+        // the resources are set up by startPage, and released with
+        // "/name /name_sfnts pdfUndefFontFile" (font programs) or undef
+        if (level >= psLevel2) {
+            writePS("/pdfUndefFontFile {\n");
+            writePS("  currentdict 1 index known { currentdict exch undef } { pop } ifelse\n");
+            writePS("  FontDirectory 1 index known {\n");
+            writePS("    dup findfont dup /FDepVector known {\n");
+            writePS("      /FDepVector get {\n");
+            writePS("        dup /FontName known {\n");
+            writePS("          /FontName get FontDirectory 1 index known { undefinefont } { pop } ifelse\n");
+            writePS("        } { pop } ifelse\n");
+            writePS("      } forall\n");
+            writePS("    } { pop } ifelse\n");
+            writePS("    dup undefinefont\n");
+            writePS("  } if\n");
+            if (level >= psLevel3) {
+                writePS("  dup /CIDFont resourcestatus { pop pop dup /CIDFont undefineresource } if\n");
             }
+            writePS("  pop\n");
+            writePS("} def\n");
         }
+    } else {
+        setupPageResources(pageList);
     }
     if (mode != psModeForm) {
         if (mode != psModeEPS && !manualCtrl) {
@@ -1762,6 +1756,202 @@ void PSOutputDev::writeTrailer()
     }
 }
 
+// Set up the resources used by the pages, with their annotations, and
+// by the AcroForm.
+void PSOutputDev::setupPageResources(const std::vector<int> &pageList)
+{
+    Page *page;
+    Dict *resDict;
+    Annots *annots;
+    Object *acroForm;
+
+    for (const int pg : pageList) {
+        page = doc->getPage(pg);
+        if (!page) {
+            error(errSyntaxError, -1, "Failed writing resources for page {0:d}", pg);
+            continue;
+        }
+        if ((resDict = page->getResourceDict())) {
+            setupResources(resDict);
+        }
+        annots = page->getAnnots();
+        for (const std::shared_ptr<Annot> &annot : annots->getAnnots()) {
+            Object obj1 = annot->getAppearanceResDict();
+            if (obj1.isDict()) {
+                setupResources(obj1.getDict());
+            }
+        }
+    }
+    if ((acroForm = doc->getCatalog()->getAcroForm()) && acroForm->isDict()) {
+        Object obj1 = acroForm->dictLookup("DR");
+        if (obj1.isDict()) {
+            setupResources(obj1.getDict());
+        }
+        obj1 = acroForm->dictLookup("Fields");
+        if (obj1.isArray()) {
+            for (int i = 0; i < obj1.arrayGetLength(); ++i) {
+                Object obj2 = obj1.arrayGet(i);
+                if (obj2.isDict()) {
+                    Object obj3 = obj2.dictLookup("DR");
+                    if (obj3.isDict()) {
+                        setupResources(obj3.getDict());
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Find the chars drawn with each font on the pages, to embed only their
+// glyphs.
+void PSOutputDev::scanFontCodes(const std::vector<int> &pageList)
+{
+    PreScanOutputDev scan(level);
+    scan.setCollectFontCodes(true);
+    for (const int pg : pageList) {
+        const bool pageLoaded = doc->isPageLoaded(pg);
+        doc->displayPage(&scan, pg, 72, 72, 0, true, false, true);
+        if (streamingResources() && !pageLoaded) {
+            doc->releasePage(pg);
+        }
+    }
+    fontCodes = scan.takeFontCodes();
+}
+
+// Set up the resources of page <pageNum> that are not defined yet, then
+// release the least recently used resources beyond streamMaxResources.
+// A new group of pages starts unless <pageNum> is in the current one; the
+// resources of the earlier groups are released before it is set up, so
+// that with streamMaxResources == 0 each group defines all it uses.
+void PSOutputDev::setupStreamResources(int pageNum)
+{
+    ++streamPage;
+    streamPageResources.clear();
+    if (std::ranges::find(streamGroupPages, pageNum) == streamGroupPages.end()) {
+        // find the pages of the new group
+        size_t i = streamNextPage;
+        while (i < pages.size() && pages[i] != pageNum) {
+            ++i;
+        }
+        if (i == pages.size()) {
+            i = std::ranges::find(pages, pageNum) - pages.begin();
+        }
+        streamGroupPages.clear();
+        if (i < pages.size()) {
+            streamNextPage = std::min(pages.size(), i + streamPages);
+            streamGroupPages.assign(pages.begin() + i, pages.begin() + streamNextPage);
+        } else {
+            streamGroupPages.push_back(pageNum);
+        }
+        ++streamGroup;
+        releaseStreamResources();
+    }
+
+    resourceIDs.clear();
+    setupPageResources({ pageNum });
+    releaseStreamResources();
+}
+
+// Release the least recently used resources of the earlier groups while
+// more than streamMaxResources are defined.
+void PSOutputDev::releaseStreamResources()
+{
+    while (streamResources.size() > static_cast<size_t>(streamMaxResources) && streamResources.back().group != streamGroup) {
+        const PSStreamResource &res = streamResources.back();
+        releaseStreamResource(res);
+        streamResourceMap.erase({ res.type, res.name });
+        streamResources.pop_back();
+    }
+}
+
+// Mark a resource as used by the current page and group.  Returns nullptr
+// if not streaming resources.
+PSOutputDev::PSStreamResource *PSOutputDev::useStreamResource(PSStreamResourceType type, const std::string &name, Ref id)
+{
+    if (!streamingResources()) {
+        return nullptr;
+    }
+    const auto it = streamResourceMap.find({ type, name });
+    if (it != streamResourceMap.end()) {
+        streamResources.splice(streamResources.begin(), streamResources, it->second);
+    } else {
+        streamResources.push_front({ .type = type, .name = name, .id = id, .fontFile = {}, .group = 0, .page = 0 });
+        streamResourceMap.emplace(std::pair(type, name), streamResources.begin());
+    }
+    streamResources.front().group = streamGroup;
+    streamResources.front().page = streamPage;
+    streamPageResources.insert(std::string(type == psStreamForm ? "form " : type == psStreamImage ? "file " : "font ") + name);
+    return &streamResources.front();
+}
+
+// Write the resources used by the current page, in its trailer.
+void PSOutputDev::writeStreamPageResources()
+{
+    bool first = true;
+    for (const std::string &res : streamPageResources) {
+        writePSFmt("%%{0:s} {1:s}\n", first ? "PageResources:" : "+", res.c_str());
+        first = false;
+    }
+    if (first) {
+        writePS("%%PageResources:\n");
+    }
+}
+
+// Add a resource to the %%DocumentSuppliedResources list, once.
+void PSOutputDev::addSuppliedResource(const char *type, const std::string &name)
+{
+    std::string res = GooString::format("%%+ {0:s} {1:s}\n", type, name.c_str());
+    if (suppliedResources.insert(res).second) {
+        embFontList.append(res);
+    }
+}
+
+// Undefine a resource (at level 2 and up, level 1 can't free memory) and
+// forget about it, so it is set up again if a later page uses it.
+void PSOutputDev::releaseStreamResource(const PSStreamResource &res)
+{
+    switch (res.type) {
+    case psStreamFont:
+        if (level >= psLevel2) {
+            writePSFmt("FontDirectory /{0:s} known {{ /{0:s} undefinefont }} if\n", res.name.c_str());
+        }
+        std::erase(fontIDs, res.id);
+        std::erase_if(font8Info, [&res](const PSFont8Info &info) { return info.fontID == res.id; });
+        for (int i = 0; i < font16EncLen; ++i) {
+            if (font16Enc[i].fontID == res.id) {
+                delete font16Enc[i].enc;
+                font16Enc[i] = font16Enc[--font16EncLen];
+                break;
+            }
+        }
+        break;
+    case psStreamFontFile:
+        if (level >= psLevel2) {
+            writePSFmt("/{0:s} /{0:s}_sfnts pdfUndefFontFile\n", res.name.c_str());
+        }
+        std::erase_if(t1FontNames, [&res](const PST1FontName &t1FontName) { return t1FontName.psName->toStr() == res.name; });
+        break;
+    case psStreamForm:
+        if (level >= psLevel2) {
+            writePSFmt("currentdict /f_{0:d}_{1:d} undef\n", res.id.num, res.id.gen);
+        }
+        for (int i = 0; i < formIDLen; ++i) {
+            if (formIDs[i] == res.id) {
+                formIDs[i] = formIDs[--formIDLen];
+                break;
+            }
+        }
+        break;
+    case psStreamImage:
+        if (level >= psLevel2) {
+            writePSFmt("currentdict /ImData_{0:d}_{1:d} undef\n", res.id.num, res.id.gen);
+            writePSFmt("currentdict /MaskData_{0:d}_{1:d} undef\n", res.id.num, res.id.gen);
+        }
+        imgIDs.erase(res.id);
+        break;
+    }
+}
+
 void PSOutputDev::setupResources(Dict *resDict)
 {
 
@@ -1874,11 +2064,15 @@ void PSOutputDev::setupFont(GfxFont *font, Dict *parentResDict)
     // check if font is already set up
     for (Ref fontID : fontIDs) {
         if (fontID == *font->getID()) {
+            if (streamingResources()) {
+                reuseStreamFont(font);
+            }
             return;
         }
     }
 
     fontIDs.push_back(*font->getID());
+    std::string streamFontFile;
 
     xs = ys = 1;
     subst = false;
@@ -1886,6 +2080,10 @@ void PSOutputDev::setupFont(GfxFont *font, Dict *parentResDict)
     if (font->getType() == fontType3) {
         psName = std::make_unique<GooString>(GooString::format("T3_{0:d}_{1:d}", font->getID()->num, font->getID()->gen));
         setupType3Font(font, psName->toStr(), parentResDict);
+        if (streamingResources()) {
+            streamFontFile = psName->toStr();
+            useStreamResource(psStreamFontFile, streamFontFile);
+        }
     } else {
         std::optional<GfxFontLoc> fontLoc = font->locateFont(xref, this);
         if (fontLoc) {
@@ -1978,6 +2176,10 @@ void PSOutputDev::setupFont(GfxFont *font, Dict *parentResDict)
             }
             return;
         }
+        if (streamingResources() && fontLoc->locType != gfxFontLocResident) {
+            streamFontFile = psName->toStr();
+            useStreamResource(psStreamFontFile, streamFontFile);
+        }
 
         // scale substituted 8-bit fonts
         if (fontLoc && fontLoc->locType == gfxFontLocResident && fontLoc->substIdx >= 0) {
@@ -2001,6 +2203,12 @@ void PSOutputDev::setupFont(GfxFont *font, Dict *parentResDict)
     }
 
     // generate PostScript code to set up the font
+    if (streamingResources()) {
+        const std::string name = GooString::format("F{0:d}_{1:d}", font->getID()->num, font->getID()->gen);
+        useStreamResource(psStreamFont, name, *font->getID())->fontFile = streamFontFile;
+        writePSFmt("%%BeginResource: font {0:s}\n", name.c_str());
+        addSuppliedResource("font", name);
+    }
     if (font->isCIDFont()) {
         const int fontWMode = font->getWMode() == GfxFont::WritingMode::Horizontal ? 0 : 1;
         if (level == psLevel3 || level == psLevel3Sep) {
@@ -2032,6 +2240,32 @@ void PSOutputDev::setupFont(GfxFont *font, Dict *parentResDict)
         }
         writePS("pdfMakeFont\n");
     }
+    if (streamingResources()) {
+        writePS("%%EndResource\n");
+    }
+}
+
+// Mark a font that is already set up, and its font program, as used by the
+// current page.
+void PSOutputDev::reuseStreamFont(GfxFont *font)
+{
+    Dict *resDict;
+
+    const auto it = streamResourceMap.find({ psStreamFont, GooString::format("F{0:d}_{1:d}", font->getID()->num, font->getID()->gen) });
+    if (it == streamResourceMap.end() || it->second->page == streamPage) {
+        return;
+    }
+    PSStreamResource *res = useStreamResource(psStreamFont, it->second->name, *font->getID());
+    if (!res->fontFile.empty()) {
+        useStreamResource(psStreamFontFile, res->fontFile);
+    }
+
+    // Type 3 char procs may use other resources
+    if (font->getType() == fontType3 && (resDict = (static_cast<Gfx8BitFont *>(font))->getResources())) {
+        inType3Char = true;
+        setupResources(resDict);
+        inType3Char = false;
+    }
 }
 
 template<typename Function>
@@ -2096,9 +2330,7 @@ void PSOutputDev::setupEmbeddedType1Font(const Ref *id, const std::string &psNam
 
     // beginning comment
     writePSFmt("%%BeginResource: font {0:r}\n", &psName);
-    embFontList.append("%%+ font ");
-    embFontList.append(psName);
-    embFontList.append("\n");
+    addSuppliedResource("font", psName);
 
     if (stream->getChar() == 0x80 && stream->getChar() == 1) {
         // PFB format
@@ -2232,9 +2464,7 @@ void PSOutputDev::setupExternalType1Font(const std::string &fileName, const std:
 
     // beginning comment
     writePSFmt("%%BeginResource: font {0:r}\n", &psName);
-    embFontList.append("%%+ font ");
-    embFontList.append(psName);
-    embFontList.append("\n");
+    addSuppliedResource("font", psName);
 
     // copy the font file
     if (!(fontFile = openFile(fileName.c_str(), "rb"))) {
@@ -2308,9 +2538,7 @@ void PSOutputDev::setupEmbeddedType1CFont(GfxFont *font, const Ref *id, GooStrin
 
     // beginning comment
     writePSFmt("%%BeginResource: font {0:t}\n", psName);
-    embFontList.append("%%+ font ");
-    embFontList.append(psName->toStr());
-    embFontList.append("\n");
+    addSuppliedResource("font", psName->toStr());
 
     // convert it to a Type 1 font
     std::optional<std::vector<unsigned char>> fontBuf = font->readEmbFontFile(xref);
@@ -2338,9 +2566,7 @@ void PSOutputDev::setupEmbeddedOpenTypeT1CFont(GfxFont *font, const Ref *id, Goo
 
     // beginning comment
     writePSFmt("%%BeginResource: font {0:t}\n", psName);
-    embFontList.append("%%+ font ");
-    embFontList.append(psName->toStr());
-    embFontList.append("\n");
+    addSuppliedResource("font", psName->toStr());
 
     // convert it to a Type 1 font
     std::optional<std::vector<unsigned char>> fontBuf = font->readEmbFontFile(xref);
@@ -2360,16 +2586,14 @@ void PSOutputDev::setupEmbeddedTrueTypeFont(GfxFont *font, const std::string &ps
 {
     // beginning comment
     writePSFmt("%%BeginResource: font {0:r}\n", &psName);
-    embFontList.append("%%+ font ");
-    embFontList.append(psName);
-    embFontList.append("\n");
+    addSuppliedResource("font", psName);
 
     // convert it to a Type 42 font
     std::optional<std::vector<unsigned char>> fontBuf = font->readEmbFontFile(xref);
     if (fontBuf) {
         if (std::unique_ptr<FoFiTrueType> ffTT = FoFiTrueType::make(std::span(fontBuf.value()), faceIndex)) {
             std::vector<int> codeToGID = (static_cast<Gfx8BitFont *>(font))->getCodeToGIDMap(ffTT.get());
-            ffTT->convertToType42(psName, (static_cast<Gfx8BitFont *>(font))->getHasEncoding() ? &(static_cast<Gfx8BitFont *>(font))->getEncoding() : nullptr, codeToGID, outputFunc, outputStream);
+            ffTT->convertToType42(psName, (static_cast<Gfx8BitFont *>(font))->getHasEncoding() ? &(static_cast<Gfx8BitFont *>(font))->getEncoding() : nullptr, codeToGID, getUsedCodes(*font->getID()), outputFunc, outputStream);
             if (!codeToGID.empty()) {
                 font8Info.emplace_back(*font->getID(), std::move(codeToGID));
             }
@@ -2384,14 +2608,12 @@ void PSOutputDev::setupExternalTrueTypeFont(GfxFont *font, const std::string &fi
 {
     // beginning comment
     writePSFmt("%%BeginResource: font {0:r}\n", &psName);
-    embFontList.append("%%+ font ");
-    embFontList.append(psName);
-    embFontList.append("\n");
+    addSuppliedResource("font", psName);
 
     // convert it to a Type 42 font
     if (std::unique_ptr<FoFiTrueType> ffTT = FoFiTrueType::load(fileName.c_str(), faceIndex)) {
         std::vector<int> codeToGID = (static_cast<Gfx8BitFont *>(font))->getCodeToGIDMap(ffTT.get());
-        ffTT->convertToType42(psName, (static_cast<Gfx8BitFont *>(font))->getHasEncoding() ? &(static_cast<Gfx8BitFont *>(font))->getEncoding() : nullptr, codeToGID, outputFunc, outputStream);
+        ffTT->convertToType42(psName, (static_cast<Gfx8BitFont *>(font))->getHasEncoding() ? &(static_cast<Gfx8BitFont *>(font))->getEncoding() : nullptr, codeToGID, getUsedCodes(*font->getID()), outputFunc, outputStream);
         if (!codeToGID.empty()) {
             font8Info.emplace_back(*font->getID(), std::move(codeToGID));
         }
@@ -2418,9 +2640,7 @@ void PSOutputDev::setupExternalCIDTrueTypeFont(GfxFont *font, const std::string
 
     // beginning comment
     writePSFmt("%%BeginResource: font {0:r}\n", &psName);
-    embFontList.append("%%+ font ");
-    embFontList.append(psName);
-    embFontList.append("\n");
+    addSuppliedResource("font", psName);
 
     // convert it to a Type 0 font
     //~ this should use fontNum to load the correct font
@@ -2434,14 +2654,14 @@ void PSOutputDev::setupExternalCIDTrueTypeFont(GfxFont *font, const std::string
                 codeToGID = (static_cast<GfxCIDFont *>(font))->getCodeToGIDMap(ffTT.get());
             }
             if (ffTT->isOpenTypeCFF()) {
-                ffTT->convertToCIDType0(psName, codeToGID, outputFunc, outputStream);
+                ffTT->convertToCIDType0(psName, codeToGID, getUsedCodes(*font->getID()), outputFunc, outputStream);
             } else if (level >= psLevel3) {
                 // Level 3: use a CID font
-                ffTT->convertToCIDType2(psName, codeToGID, needVerticalMetrics, outputFunc, outputStream);
+                ffTT->convertToCIDType2(psName, codeToGID, getUsedCodes(*font->getID()), needVerticalMetrics, outputFunc, outputStream);
             } else {
                 // otherwise: use a non-CID composite font
                 int maxValidGlyph = -1;
-                ffTT->convertToType0(psName, codeToGID, needVerticalMetrics, &maxValidGlyph, outputFunc, outputStream);
+                ffTT->convertToType0(psName, codeToGID, getUsedCodes(*font->getID()), needVerticalMetrics, &maxValidGlyph, outputFunc, outputStream);
                 updateFontMaxValidGlyph(font, maxValidGlyph);
             }
         } else {
@@ -2468,9 +2688,7 @@ void PSOutputDev::setupEmbeddedCIDType0Font(GfxFont *font, const Ref *id, GooStr
 
     // beginning comment
     writePSFmt("%%BeginResource: font {0:t}\n", psName);
-    embFontList.append("%%+ font ");
-    embFontList.append(psName->toStr());
-    embFontList.append("\n");
+    addSuppliedResource("font", psName->toStr());
 
     // convert it to a Type 0 font
     std::optional<std::vector<unsigned char>> fontBuf = font->readEmbFontFile(xref);
@@ -2478,10 +2696,10 @@ void PSOutputDev::setupEmbeddedCIDType0Font(GfxFont *font, const Ref *id, GooStr
         if (auto ffT1C = FoFiType1C::make(std::move(fontBuf).value())) {
             if (level >= psLevel3) {
                 // Level 3: use a CID font
-                ffT1C->convertToCIDType0(psName->toStr(), {}, outputFunc, outputStream);
+                ffT1C->convertToCIDType0(psName->toStr(), {}, getUsedCodes(*id), outputFunc, outputStream);
             } else {
                 // otherwise: use a non-CID composite font
-                ffT1C->convertToType0(psName->toStr(), {}, outputFunc, outputStream);
+                ffT1C->convertToType0(psName->toStr(), {}, getUsedCodes(*id), outputFunc, outputStream);
             }
         }
     }
@@ -2494,9 +2712,7 @@ void PSOutputDev::setupEmbeddedCIDTrueTypeFont(GfxFont *font, const std::string
 {
     // beginning comment
     writePSFmt("%%BeginResource: font {0:r}\n", &psName);
-    embFontList.append("%%+ font ");
-    embFontList.append(psName);
-    embFontList.append("\n");
+    addSuppliedResource("font", psName);
 
     // convert it to a Type 0 font
     std::optional<std::vector<unsigned char>> fontBuf = font->readEmbFontFile(xref);
@@ -2504,11 +2720,11 @@ void PSOutputDev::setupEmbeddedCIDTrueTypeFont(GfxFont *font, const std::string
         if (std::unique_ptr<FoFiTrueType> ffTT = FoFiTrueType::make(std::span(fontBuf.value()), faceIndex)) {
             if (level >= psLevel3) {
                 // Level 3: use a CID font
-                ffTT->convertToCIDType2(psName, (static_cast<GfxCIDFont *>(font))->getCIDToGID(), needVerticalMetrics, outputFunc, outputStream);
+                ffTT->convertToCIDType2(psName, (static_cast<GfxCIDFont *>(font))->getCIDToGID(), getUsedCodes(*font->getID()), needVerticalMetrics, outputFunc, outputStream);
             } else {
                 // otherwise: use a non-CID composite font
                 int maxValidGlyph = -1;
-                ffTT->convertToType0(psName, (static_cast<GfxCIDFont *>(font))->getCIDToGID(), needVerticalMetrics, &maxValidGlyph, outputFunc, outputStream);
+                ffTT->convertToType0(psName, (static_cast<GfxCIDFont *>(font))->getCIDToGID(), getUsedCodes(*font->getID()), needVerticalMetrics, &maxValidGlyph, outputFunc, outputStream);
                 updateFontMaxValidGlyph(font, maxValidGlyph);
             }
         }
@@ -2532,9 +2748,7 @@ void PSOutputDev::setupEmbeddedOpenTypeCFFFont(GfxFont *font, const Ref *id, Goo
 
     // beginning comment
     writePSFmt("%%BeginResource: font {0:t}\n", psName);
-    embFontList.append("%%+ font ");
-    embFontList.append(psName->toStr());
-    embFontList.append("\n");
+    addSuppliedResource("font", psName->toStr());
 
     // convert it to a Type 0 font
     std::optional<std::vector<unsigned char>> fontBuf = font->readEmbFontFile(xref);
@@ -2543,10 +2757,10 @@ void PSOutputDev::setupEmbeddedOpenTypeCFFFont(GfxFont *font, const Ref *id, Goo
             if (ffTT->isOpenTypeCFF()) {
                 if (level >= psLevel3) {
                     // Level 3: use a CID font
-                    ffTT->convertToCIDType0(psName->toStr(), (static_cast<GfxCIDFont *>(font))->getCIDToGID(), outputFunc, outputStream);
+                    ffTT->convertToCIDType0(psName->toStr(), (static_cast<GfxCIDFont *>(font))->getCIDToGID(), getUsedCodes(*id), outputFunc, outputStream);
                 } else {
                     // otherwise: use a non-CID composite font
-                    ffTT->convertToType0(psName->toStr(), (static_cast<GfxCIDFont *>(font))->getCIDToGID(), outputFunc, outputStream);
+                    ffTT->convertToType0(psName->toStr(), (static_cast<GfxCIDFont *>(font))->getCIDToGID(), getUsedCodes(*id), outputFunc, outputStream);
                 }
             }
         }
@@ -2556,6 +2770,19 @@ void PSOutputDev::setupEmbeddedOpenTypeCFFFont(GfxFont *font, const Ref *id, Goo
     writePS("%%EndResource\n");
 }
 
+// Returns the codes drawn with the font (or font file) <id>, or NULL to
+// embed the whole font.
+const std::vector<bool> *PSOutputDev::getUsedCodes(Ref id) const
+{
+    static const std::vector<bool> noCodes;
+
+    if (!subsetFonts) {
+        return nullptr;
+    }
+    const auto it = fontCodes.find(id);
+    return it != fontCodes.end() ? &it->second : &noCodes;
+}
+
 void PSOutputDev::setupType3Font(GfxFont *font, const std::string &psName, Dict *parentResDict)
 {
     Dict *resDict;
@@ -2575,9 +2802,7 @@ void PSOutputDev::setupType3Font(GfxFont *font, const std::string &psName, Dict
 
     // beginning comment
     writePSFmt("%%BeginResource: font {0:r}\n", &psName);
-    embFontList.append("%%+ font ");
-    embFontList.append(psName);
-    embFontList.append("\n");
+    addSuppliedResource("font", psName);
 
     // font dictionary
     writePS("8 dict begin\n");
@@ -2649,9 +2874,23 @@ std::unique_ptr<GooString> PSOutputDev::makePSFontName(const GfxFont *font, cons
 {
     const GooString *s;
 
+    // when streaming resources, a font program keeps its name if it is
+    // released and set up again, and no other font program gets it
+    std::string *streamName = nullptr;
+    if (streamingResources()) {
+        const auto [it, inserted] = streamFontNames.try_emplace(*id);
+        if (!inserted) {
+            return std::make_unique<GooString>(it->second);
+        }
+        streamName = &it->second;
+    }
+
     if ((s = font->getEmbeddedFontName())) {
         std::string psName = filterPSName(s->toStr());
         if (fontNames.emplace(psName).second) {
+            if (streamName) {
+                *streamName = psName;
+            }
             return std::make_unique<GooString>(std::move(psName));
         }
     }
@@ -2659,6 +2898,9 @@ std::unique_ptr<GooString> PSOutputDev::makePSFontName(const GfxFont *font, cons
     if (fontName) {
         std::string psName = filterPSName(*fontName);
         if (fontNames.emplace(psName).second) {
+            if (streamName) {
+                *streamName = psName;
+            }
             return std::make_unique<GooString>(std::move(psName));
         }
     }
@@ -2673,6 +2915,9 @@ std::unique_ptr<GooString> PSOutputDev::makePSFontName(const GfxFont *font, cons
         psName->append(filteredName);
     }
     fontNames.emplace(psName->toStr());
+    if (streamName) {
+        *streamName = psName->toStr();
+    }
     return psName;
 }
 
@@ -2696,7 +2941,15 @@ void PSOutputDev::setupImages(Dict *resDict)
                     if (xObjRef.isRef()) {
                         const Ref imgID = xObjRef.getRef();
                         const auto [_, inserted] = imgIDs.insert(imgID);
+                        if (streamingResources()) {
+                            useStreamResource(psStreamImage, GooString::format("ImData_{0:d}_{1:d}", imgID.num, imgID.gen), imgID);
+                        }
                         if (inserted) {
+                            if (streamingResources()) {
+                                const std::string name = GooString::format("ImData_{0:d}_{1:d}", imgID.num, imgID.gen);
+                                writePSFmt("%%BeginResource: file {0:s}\n", name.c_str());
+                                addSuppliedResource("file", name);
+                            }
                             setupImage(imgID, xObjStream, false);
                             if (level >= psLevel3) {
                                 Object maskObj = xObjStream->getDict()->lookup("Mask");
@@ -2704,6 +2957,9 @@ void PSOutputDev::setupImages(Dict *resDict)
                                     setupImage(imgID, maskObj.getStream(), true);
                                 }
                             }
+                            if (streamingResources()) {
+                                writePS("%%EndResource\n");
+                            }
                         }
                     } else {
                         error(errSyntaxError, -1, "Image in resource dict is not an indirect reference");
@@ -2922,6 +3178,9 @@ void PSOutputDev::setupForm(Ref id, Object *strObj)
     Gfx *gfx;
 
     // check if form is already defined
+    if (streamingResources()) {
+        useStreamResource(psStreamForm, GooString::format("f_{0:d}_{1:d}", id.num, id.gen), id);
+    }
     for (int i = 0; i < formIDLen; ++i) {
         if (formIDs[i] == id) {
             return;
@@ -2972,6 +3231,11 @@ void PSOutputDev::setupForm(Ref id, Object *strObj)
     Object resObj = dict->lookup("Resources");
     resDict = resObj.isDict() ? resObj.getDict() : nullptr;
 
+    if (streamingResources()) {
+        const std::string name = GooString::format("f_{0:d}_{1:d}", id.num, id.gen);
+        writePSFmt("%%BeginResource: form {0:s}\n", name.c_str());
+        addSuppliedResource("form", name);
+    }
     writePSFmt("/f_{0:d}_{1:d} {{\n", id.num, id.gen);
     writePS("q\n");
     writePSFmt("[{0:.6gs} {1:.6gs} {2:.6gs} {3:.6gs} {4:.6gs} {5:.6gs}] cm\n", m[0], m[1], m[2], m[3], m[4], m[5]);
@@ -2986,6 +3250,9 @@ void PSOutputDev::setupForm(Ref id, Object *strObj)
 
     writePS("Q\n");
     writePS("} def\n");
+    if (streamingResources()) {
+        writePS("%%EndResource\n");
+    }
 }
 
 bool PSOutputDev::checkPageSlice(Page *page, double /*hDPI*/, double /*vDPI*/, int rotateA, bool useMediaBox, bool crop, int sliceX, int sliceY, int sliceW, int sliceH, bool printing, bool (*abortCheckCbk)(void *data),
@@ -3663,7 +3930,13 @@ void PSOutputDev::startPage(int pageNum, GfxState *state, XRef *xrefA)
         writePSFmt("%%PageBoundingBox: {0:g} {1:g} {2:g} {3:g}\n", floor(std::min(bboxX1, bboxX2)), floor(std::min(bboxY1, bboxY2)), ceil(std::max(bboxX1, bboxX2)), ceil(std::max(bboxY1, bboxY2)));
 
         writePSFmt("%%PageOrientation: {0:s}\n", landscape ? "Landscape" : "Portrait");
+        if (streamingResources()) {
+            writePS("%%PageResources: (atend)\n");
+        }
         writePS("%%BeginPageSetup\n");
+        if (streamingResources()) {
+            setupStreamResources(pageNum);
+        }
         if (paperMatch) {
             writePSFmt("{0:d} {1:d} pdfSetupPaper\n", imgURX, imgURY);
         }
@@ -3750,6 +4023,9 @@ void PSOutputDev::endPage()
             writePS("showpage\n");
         }
         writePS("%%PageTrailer\n");
+        if (streamingResources()) {
+            writeStreamPageResources();
+        }
         writePageTrailer();
     }
 }
@@ -47,6 +47,7 @@
 #include "OutputDev.h"
 #include "fofi/FoFiBase.h"
 #include "splash/SplashTypes.h"
+#include <list>
 #include <set>
 #include <map>
 #include <vector>
@@ -321,6 +322,7 @@ public:
     bool getEmbedCIDPostScript() const { return embedCIDPostScript; }
     bool getEmbedCIDTrueType() const { return embedCIDTrueType; }
     bool getFontPassthrough() const { return fontPassthrough; }
+    bool getSubsetFonts() const { return subsetFonts; }
     bool getOptimizeColorSpace() const { return optimizeColorSpace; }
     bool getPassLevel1CustomColor() const { return passLevel1CustomColor; }
     bool getEnableLZW() const { return enableLZW; };
@@ -330,6 +332,23 @@ public:
     void setEmbedCIDPostScript(bool b) { embedCIDPostScript = b; }
     void setEmbedCIDTrueType(bool b) { embedCIDTrueType = b; }
     void setFontPassthrough(bool b) { fontPassthrough = b; }
+    // Embed only the glyphs of the TrueType and CID fonts that are used
+    // in the pages, found by scanning the pages (as printed) before
+    // writing the document setup.
+    void setSubsetFonts(bool b) { subsetFonts = b; }
+    // Write the resources (fonts, and preloaded images and forms) used by
+    // each page in its page setup, instead of all of them in the document
+    // setup.  Pages declare the resources they use, including the ones
+    // written by earlier pages, with %%PageResources.  At most
+    // <maxResources> of them are kept from one group of <groupPages>
+    // pages to the next: the least recently used ones are released, and
+    // written again if a later page uses them.  Only used in psModePS; 0
+    // pages turns this off.
+    void setStreamResources(int groupPages, int maxResources)
+    {
+        streamPages = groupPages;
+        streamMaxResources = maxResources;
+    }
     void setOptimizeColorSpace(bool b) { optimizeColorSpace = b; }
     void setPassLevel1CustomColor(bool b) { passLevel1CustomColor = b; }
     void setPreloadImagesForms(bool b) { preloadImagesForms = b; }
@@ -356,10 +375,38 @@ private:
         int w, h;
     };
 
+    enum PSStreamResourceType
+    {
+        psStreamFont, // font set up with pdfMakeFont*
+        psStreamFontFile, // font program, or Type 3 font
+        psStreamForm, // preloaded form
+        psStreamImage // preloaded image
+    };
+
+    struct PSStreamResource
+    {
+        PSStreamResourceType type;
+        std::string name; // PostScript name
+        Ref id; // object ID of the font, form, or image
+        std::string fontFile; // font program used by a font
+        unsigned int group; // last group that used it
+        unsigned int page; // last page that used it
+    };
+
     void init(FoFiOutputFunc outputFuncA, void *outputStreamA, PSFileType fileTypeA, char *psTitleA, PDFDoc *doc, const std::vector<int> &pages, PSOutMode modeA, int imgLLXA, int imgLLYA, int imgURXA, int imgURYA, bool manualCtrlA,
               int paperWidthA, int paperHeightA, bool noCropA, bool duplexA, PSLevel levelA);
     void postInit();
     void setupResources(Dict *resDict);
+    void setupPageResources(const std::vector<int> &pageList);
+    void scanFontCodes(const std::vector<int> &pageList);
+    bool streamingResources() const { return mode == psModePS && streamPages > 0; }
+    void setupStreamResources(int pageNum);
+    void writeStreamPageResources();
+    PSStreamResource *useStreamResource(PSStreamResourceType type, const std::string &name, Ref id = Ref::INVALID());
+    void releaseStreamResource(const PSStreamResource &res);
+    void releaseStreamResources();
+    void reuseStreamFont(GfxFont *font);
+    void addSuppliedResource(const char *type, const std::string &name);
     void setupFonts(Dict *resDict);
     void setupFont(GfxFont *font, Dict *parentResDict);
     void setupEmbeddedType1Font(const Ref *id, const std::string &psName);
@@ -373,6 +420,7 @@ private:
     void setupEmbeddedCIDTrueTypeFont(GfxFont *font, const std::string &psName, bool needVerticalMetrics, int faceIndex);
     void setupExternalCIDTrueTypeFont(GfxFont *font, const std::string &fileName, const std::string &psName, bool needVerticalMetrics, int faceIndex);
     void setupEmbeddedOpenTypeCFFFont(GfxFont *font, const Ref *id, GooString *psName, int faceIndex);
+    const std::vector<bool> *getUsedCodes(Ref id) const;
     void setupType3Font(GfxFont *font, const std::string &psName, Dict *parentResDict);
     std::unique_ptr<GooString> makePSFontName(const GfxFont *font, const Ref *id);
     void setupImages(Dict *resDict);
@@ -400,7 +448,7 @@ private:
     static std::string filterPSName(const std::string &name);
 
     // Write the document-level setup.
-    void writeDocSetup(Catalog *catalog, const std::vector<int> &pageList, bool duplexA);
+    void writeDocSetup(const std::vector<int> &pageList, bool duplexA);
 
     void writePSChar(char c);
     void writePS(std::string_view s);
@@ -474,6 +522,7 @@ private:
             epsX2, epsY2;
 
     std::string embFontList; // resource comments for embedded fonts
+    std::unordered_set<std::string> suppliedResources; // resources in embFontList
 
     int processColors; // used process colors
     PSOutCustomColor // used custom colors
@@ -504,6 +553,20 @@ private:
     bool embedCIDPostScript; // embed CID PostScript fonts?
     bool embedCIDTrueType; // embed CID TrueType fonts?
     bool fontPassthrough; // pass all fonts through as-is?
+    bool subsetFonts = false; // embed only the glyphs used?
+    std::unordered_map<Ref, std::vector<bool>> fontCodes; // codes drawn with each font (by font
+                                                          //   and font file ID), when subsetting
+    int streamPages = 0; // pages per group when streaming resources (0 = off)
+    int streamMaxResources = 0; // resources kept from one group to the next
+    std::vector<int> streamGroupPages; // pages of the current group
+    size_t streamNextPage = 0; // index in pages of the page after the current group
+    unsigned int streamGroup = 0; // number of the current group
+    unsigned int streamPage = 0; // number of the current page
+    std::set<std::string> streamPageResources; // DSC resources used by the current page
+    std::unordered_map<Ref, std::string> streamFontNames; // names of the font programs set up, by font
+                                                          //   (file) ID
+    std::list<PSStreamResource> streamResources; // defined resources, most recently used first
+    std::map<std::pair<PSStreamResourceType, std::string>, std::list<PSStreamResource>::iterator> streamResourceMap;
     bool optimizeColorSpace; // false to keep gray RGB images in their original color space
                              // true to optimize gray images to DeviceGray color space
     bool passLevel1CustomColor; // false to convert all custom colors to CMYK
@@ -87,6 +87,9 @@ bool PreScanOutputDev::tilingPatternFill(GfxState *state, Gfx *gfx, Catalog * /*
         }
     } else {
         check(state->getFillColorSpace(), state->getFillColor(), state->getFillOpacity(), state->getBlendMode());
+        if (collectFontCodes) {
+            gfx->drawForm(tPat->getContentStream(), tPat->getResDict(), mat, tPat->getBBox());
+        }
     }
     return true;
 }
@@ -166,6 +169,33 @@ void PreScanOutputDev::beginStringOp(GfxState *state)
 
 void PreScanOutputDev::endStringOp(GfxState * /*state*/) { }
 
+void PreScanOutputDev::drawChar(GfxState *state, double /*x*/, double /*y*/, double /*dx*/, double /*dy*/, double /*originX*/, double /*originY*/, CharCode code, int /*nBytes*/, const Unicode * /*u*/, int /*uLen*/)
+{
+    if (!collectFontCodes) {
+        return;
+    }
+    const std::shared_ptr<GfxFont> &font = state->getFont();
+    if (!font) {
+        return;
+    }
+    const size_t nCodes = font->isCIDFont() ? 0x10000 : 0x100;
+    if (code >= nCodes) {
+        return;
+    }
+    auto addCode = [this, code, nCodes](Ref id) {
+        std::vector<bool> &codes = fontCodes[id];
+        if (codes.size() < nCodes) {
+            codes.resize(nCodes, false);
+        }
+        codes[code] = true;
+    };
+    addCode(*font->getID());
+    Ref embID;
+    if (font->getEmbeddedFontID(&embID)) {
+        addCode(embID);
+    }
+}
+
 bool PreScanOutputDev::beginType3Char(GfxState * /*state*/, double /*x*/, double /*y*/, double /*dx*/, double /*dy*/, CharCode /*code*/, const Unicode * /*u*/, int /*uLen*/)
 {
     // return false so all Type 3 chars get rendered (no caching)
@@ -27,6 +27,9 @@
 #ifndef PRESCANOUTPUTDEV_H
 #define PRESCANOUTPUTDEV_H
 
+#include <unordered_map>
+#include <vector>
+
 #include "Object.h"
 #include "GfxState.h"
 #include "OutputDev.h"
@@ -92,6 +95,7 @@ public:
     //----- text drawing
     void beginStringOp(GfxState *state) override;
     void endStringOp(GfxState *state) override;
+    void drawChar(GfxState *state, double x, double y, double dx, double dy, double originX, double originY, CharCode code, int nBytes, const Unicode *u, int uLen) override;
     bool beginType3Char(GfxState *state, double x, double y, double dx, double dy, CharCode code, const Unicode *u, int uLen) override;
     void endType3Char(GfxState *state) override;
 
@@ -133,6 +137,15 @@ public:
     // Clear the stats used by the above functions.
     void clearStats();
 
+    // Record the chars drawn with each font, see takeFontCodes().  This
+    // also scans the content of uncolored tiling patterns.
+    void setCollectFontCodes(bool collect) { collectFontCodes = collect; }
+
+    // Returns the codes drawn with each font (char codes for 8-bit
+    // fonts, CIDs for CID fonts), by font id and by the id of the
+    // embedded font file, which several fonts may share.
+    std::unordered_map<Ref, std::vector<bool>> takeFontCodes() { return std::move(fontCodes); }
+
 private:
     void check(GfxColorSpace *colorSpace, const GfxColor &color, double opacity, GfxBlendMode blendMode);
 
@@ -143,6 +156,8 @@ private:
     PSLevel level; // PostScript level (1, 2, separation)
     bool patternImgMask;
     int inTilingPatternFill;
+    bool collectFontCodes = false;
+    std::unordered_map<Ref, std::vector<bool>> fontCodes;
 };
 
 #endif
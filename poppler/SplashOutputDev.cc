@@ -58,6 +58,8 @@
 #include <climits>
 #include <cstring>
 #include <cmath>
+#include <list>
+#include <unordered_map>
 #include <vector>
 #include "Stream.h"
 #include "GlobalParams.h"
@@ -215,6 +217,149 @@ void SplashGouraudPattern::getParameterizedColor(double colorinterp, SplashColor
     }
 }
 
+//------------------------------------------------------------------------
+// SplashPatchMeshPattern
+//------------------------------------------------------------------------
+
+// max grid resolution used for the patches
+#define splashPatchMaxGridSize 64
+
+// approximate size, in device pixels, of a grid cell
+#define splashPatchGridCellSize 16
+
+// max number of triangles a patch mesh shading is split into; only
+// shadings covering a huge device area get near it
+#define splashPatchMaxTriangles (1 << 20)
+
+SplashPatchMeshPattern::SplashPatchMeshPattern(bool bDirectColorTranslationA, const std::array<double, 6> &ctmA, GfxPatchMeshShading *shadingA)
+{
+    bDirectColorTranslation = bDirectColorTranslationA;
+    ctm = ctmA;
+    shading = shadingA;
+
+    // all the patches use the grid resolution of the largest one: the
+    // grids of two patches must meet at the same points along a shared
+    // edge, or the triangles leave cracks where the edge is curved.  The
+    // control points bound each patch.
+    const int nPatches = shading->getNPatches();
+    double maxSize = 0;
+    for (int i = 0; i < nPatches; ++i) {
+        const GfxPatch *patch = shading->getPatch(i);
+        double xMin = 0, yMin = 0, xMax = 0, yMax = 0;
+        for (int j = 0; j < 4; ++j) {
+            for (int k = 0; k < 4; ++k) {
+                const double x = patch->x[j][k] * ctm[0] + patch->y[j][k] * ctm[2] + ctm[4];
+                const double y = patch->x[j][k] * ctm[1] + patch->y[j][k] * ctm[3] + ctm[5];
+                if (j == 0 && k == 0) {
+                    xMin = xMax = x;
+                    yMin = yMax = y;
+                } else {
+                    xMin = std::min(xMin, x);
+                    xMax = std::max(xMax, x);
+                    yMin = std::min(yMin, y);
+                    yMax = std::max(yMax, y);
+                }
+            }
+        }
+        maxSize = std::max({ maxSize, xMax - xMin, yMax - yMin });
+    }
+    double n = std::min(std::ceil(maxSize / splashPatchGridCellSize), static_cast<double>(splashPatchMaxGridSize));
+
+    // if the shading has many patches, coarsen the grid to stay within
+    // the triangle budget
+    if (nPatches > 0) {
+        n = std::min(n, std::floor(std::sqrt(splashPatchMaxTriangles / (2.0 * nPatches))));
+    }
+    gridSize = (n >= 1) ? static_cast<int>(n) : 1;
+    nTriangles = 2 * gridSize * gridSize * nPatches;
+}
+
+SplashPatchMeshPattern::~SplashPatchMeshPattern() = default;
+
+void SplashPatchMeshPattern::evalPatch(const GfxPatch *patch, double u, double v, double *x, double *y)
+{
+    const double bu[4] = { (1 - u) * (1 - u) * (1 - u), 3 * u * (1 - u) * (1 - u), 3 * u * u * (1 - u), u * u * u };
+    const double bv[4] = { (1 - v) * (1 - v) * (1 - v), 3 * v * (1 - v) * (1 - v), 3 * v * v * (1 - v), v * v * v };
+
+    *x = *y = 0;
+    for (int j = 0; j < 4; ++j) {
+        double xj = 0, yj = 0;
+        for (int k = 0; k < 4; ++k) {
+            xj += bu[k] * patch->x[j][k];
+            yj += bu[k] * patch->y[j][k];
+        }
+        *x += bv[j] * xj;
+        *y += bv[j] * yj;
+    }
+}
+
+const GfxPatch *SplashPatchMeshPattern::getTriangleVertices(int i, double u[3], double v[3]) const
+{
+    const int n = gridSize;
+    const int p = i / (2 * n * n);
+    const int cell = (i % (2 * n * n)) / 2;
+    const double u0 = static_cast<double>(cell % n) / n;
+    const double u1 = static_cast<double>(cell % n + 1) / n;
+    const double v0 = static_cast<double>(cell / n) / n;
+    const double v1 = static_cast<double>(cell / n + 1) / n;
+    if (i % 2 == 0) {
+        u[0] = u0;
+        v[0] = v0;
+        u[1] = u1;
+        v[1] = v0;
+        u[2] = u1;
+        v[2] = v1;
+    } else {
+        u[0] = u0;
+        v[0] = v0;
+        u[1] = u1;
+        v[1] = v1;
+        u[2] = u0;
+        v[2] = v1;
+    }
+    return shading->getPatch(p);
+}
+
+void SplashPatchMeshPattern::getParametrizedTriangle(int i, double *x0, double *y0, double *color0, double *x1, double *y1, double *color1, double *x2, double *y2, double *color2)
+{
+    double u[3], v[3];
+    const GfxPatch *patch = getTriangleVertices(i, u, v);
+    double *xs[3] = { x0, x1, x2 };
+    double *ys[3] = { y0, y1, y2 };
+    double *ts[3] = { color0, color1, color2 };
+    for (int m = 0; m < 3; ++m) {
+        evalPatch(patch, u[m], v[m], xs[m], ys[m]);
+        *ts[m] = (1 - v[m]) * ((1 - u[m]) * patch->color[0][0].c[0] + u[m] * patch->color[0][1].c[0]) + v[m] * ((1 - u[m]) * patch->color[1][0].c[0] + u[m] * patch->color[1][1].c[0]);
+    }
+}
+
+void SplashPatchMeshPattern::getNonParametrizedTriangle(int i, SplashColorMode mode, double *x0, double *y0, SplashColorPtr color0, double *x1, double *y1, SplashColorPtr color1, double *x2, double *y2, SplashColorPtr color2)
+{
+    double u[3], v[3];
+    const GfxPatch *patch = getTriangleVertices(i, u, v);
+    const GfxColorSpace *srcColorSpace = shading->getColorSpace();
+    const int nComps = srcColorSpace->getNComps();
+    double *xs[3] = { x0, x1, x2 };
+    double *ys[3] = { y0, y1, y2 };
+    SplashColorPtr colors[3] = { color0, color1, color2 };
+    for (int m = 0; m < 3; ++m) {
+        evalPatch(patch, u[m], v[m], xs[m], ys[m]);
+        GfxColor color;
+        for (int k = 0; k < nComps; ++k) {
+            const double c = (1 - v[m]) * ((1 - u[m]) * patch->color[0][0].c[k] + u[m] * patch->color[0][1].c[k]) + v[m] * ((1 - u[m]) * patch->color[1][0].c[k] + u[m] * patch->color[1][1].c[k]);
+            color.c[k] = static_cast<GfxColorComp>(c);
+        }
+        convertGfxColor(colors[m], mode, srcColorSpace, color);
+    }
+}
+
+void SplashPatchMeshPattern::getParameterizedColor(double t, SplashColorMode mode, SplashColorPtr dest)
+{
+    GfxColor src;
+    shading->getParameterizedColor(t, &src);
+    convertGfxShortColor(dest, mode, shading->getColorSpace(), src);
+}
+
 //------------------------------------------------------------------------
 // SplashFunctionPattern
 //------------------------------------------------------------------------
@@ -291,10 +436,80 @@ SplashUnivariatePattern::SplashUnivariatePattern(SplashColorMode colorModeA, Gfx
     stateA->getUserClipBBox(&xMin, &yMin, &xMax, &yMax);
     shadingA->setupCache(&ctm, xMin, yMin, xMax, yMax);
     gfxMode = shadingA->getColorSpace()->getMode();
+
+    rampSize = 0;
+    rampT0 = rampScale = 0;
 }
 
 SplashUnivariatePattern::~SplashUnivariatePattern() = default;
 
+void SplashUnivariatePattern::setupColorRamp()
+{
+    Matrix ctm;
+    double xMin, yMin, xMax, yMax, sMin, sMax;
+    GfxColor gfxColor;
+
+    ramp.reset();
+    rampSize = 0;
+
+    // only the part of the gradient inside the clip region is needed
+    state->getUserClipBBox(&xMin, &yMin, &xMax, &yMax);
+    shading->getParameterRange(&sMin, &sMax, xMin, yMin, xMax, yMax);
+    sMin = std::max(sMin, 0.0);
+    sMax = std::min(sMax, 1.0);
+    if (!(sMin < sMax)) {
+        sMin = 0;
+        sMax = 1;
+    }
+    state->getCTM(&ctm);
+    const double length = ctm.norm() * shading->getDistance(sMin, sMax);
+    const int size = std::clamp(static_cast<int>(std::min(ceil(length), static_cast<double>(splashOutColorRampMaxSize))) + 1, 2, splashOutColorRampMaxSize);
+
+    // don't bother for shadings covering fewer pixels than the ramp has
+    // entries
+    state->getClipBBox(&xMin, &yMin, &xMax, &yMax);
+    if (size > (xMax - xMin) * (yMax - yMin)) {
+        return;
+    }
+
+    ramp.reset(new SplashColor[size]);
+    rampSize = size;
+    rampT0 = t0 + sMin * dt;
+    const double step = (sMax - sMin) * dt / (size - 1);
+    rampScale = step != 0 ? 1 / step : 0;
+    const int nComps = shading->getColorSpace()->getNComps();
+    for (int i = 0; i < size; ++i) {
+        const int filled = shading->getColorUncached(rampT0 + i * step, &gfxColor);
+        for (int j = filled; j < nComps; ++j) {
+            gfxColor.c[j] = 0;
+        }
+        convertGfxColor(ramp[i], colorMode, shading->getColorSpace(), gfxColor);
+    }
+}
+
+inline void SplashUnivariatePattern::getRampColor(double t, SplashColorPtr c) const
+{
+    // linear interpolation between the two nearest entries, with 8 bits
+    // of fraction
+    double pos = (t - rampT0) * rampScale;
+    if (!(pos > 0)) {
+        pos = 0;
+    } else if (pos > rampSize - 1) {
+        pos = rampSize - 1;
+    }
+    int i = static_cast<int>(pos);
+    int f = static_cast<int>((pos - i) * 256);
+    if (i == rampSize - 1) {
+        --i;
+        f = 256;
+    }
+    const unsigned char *lo = ramp[i];
+    const unsigned char *hi = ramp[i + 1];
+    for (size_t k = 0; k < splashMaxColorComps; ++k) {
+        c[k] = static_cast<unsigned char>((lo[k] * (256 - f) + hi[k] * f + 128) >> 8);
+    }
+}
+
 bool SplashUnivariatePattern::getColor(int x, int y, SplashColorPtr c) const
 {
     GfxColor gfxColor;
@@ -305,6 +520,11 @@ bool SplashUnivariatePattern::getColor(int x, int y, SplashColorPtr c) const
         return false;
     }
 
+    if (ramp) {
+        getRampColor(t, c);
+        return true;
+    }
+
     const int filled = shading->getColor(t, &gfxColor);
     if (unlikely(filled < shading->getColorSpace()->getNComps())) {
         for (int i = filled; i < shading->getColorSpace()->getNComps(); ++i) {
@@ -315,6 +535,27 @@ bool SplashUnivariatePattern::getColor(int x, int y, SplashColorPtr c) const
     return true;
 }
 
+void SplashUnivariatePattern::getColorSpan(int x0, int x1, int y, SplashColor *c, unsigned char *inside) const
+{
+    if (!ramp) {
+        SplashPattern::getColorSpan(x0, x1, y, c, inside);
+        return;
+    }
+
+    // the user space coordinates change linearly along the span
+    const double xcY = ictm.m[2] * y + ictm.m[4];
+    const double ycY = ictm.m[3] * y + ictm.m[5];
+    double t;
+    for (int x = x0; x <= x1; ++x) {
+        if (getParameter(ictm.m[0] * x + xcY, ictm.m[1] * x + ycY, &t)) {
+            getRampColor(t, c[x - x0]);
+            inside[x - x0] = 1;
+        } else {
+            inside[x - x0] = 0;
+        }
+    }
+}
+
 bool SplashUnivariatePattern::testPosition(int x, int y) const
 {
     double xc, yc, t;
@@ -487,12 +728,6 @@ bool SplashAxialPattern::getParameter(double xc, double yc, double *t) const
     return true;
 }
 
-//------------------------------------------------------------------------
-// Type 3 font cache size parameters
-constexpr int type3FontCacheAssoc = 8;
-constexpr int type3FontCacheMaxSets = 8;
-constexpr int type3FontCacheSize = 128 * 1024;
-
 //------------------------------------------------------------------------
 // Divide a 16-bit value (in [0, 255*255]) by 255, returning an 8-bit result.
 static inline unsigned char div255(int x)
@@ -1089,17 +1324,19 @@ SplashOutFontFileID::~SplashOutFontFileID() = default;
 // T3FontCache
 //------------------------------------------------------------------------
 
-struct T3FontCacheTag
+struct T3CachedGlyph
 {
-    unsigned short code;
-    unsigned short mru; // valid bit (0x8000) and MRU index
+    T3FontCache *font;
+    CharCode code;
+    std::unique_ptr<unsigned char[]> data; // glyph pixmap
 };
 
+// A Type 3 font at one transform matrix: the placement and size of
+// its glyph bitmaps.  The bitmaps themselves are kept by T3GlyphCache.
 class T3FontCache
 {
 public:
     T3FontCache(const Ref *fontID, double m11A, double m12A, double m21A, double m22A, int glyphXA, int glyphYA, int glyphWA, int glyphHA, bool validBBoxA, bool aa);
-    ~T3FontCache();
     T3FontCache(const T3FontCache &) = delete;
     T3FontCache &operator=(const T3FontCache &) = delete;
     bool matches(const Ref *idA, double m11A, double m12A, double m21A, double m22A) const { return fontID == *idA && m11 == m11A && m12 == m12A && m21 == m21A && m22 == m22A; }
@@ -1110,10 +1347,9 @@ public:
     int glyphW, glyphH; // size of glyph bitmaps, in pixels
     bool validBBox; // false if the bbox was [0 0 0 0]
     int glyphSize; // size of glyph bitmaps, in bytes
-    int cacheSets; // number of sets in cache
-    int cacheAssoc; // cache associativity (glyphs per set)
-    unsigned char *cacheData; // glyph pixmap cache
-    T3FontCacheTag *cacheTags; // cache tags, i.e., char codes
+    std::unordered_map<CharCode, std::list<T3CachedGlyph>::iterator> // cached glyphs of this font
+            glyphs;
+    int refCnt; // number of T3GlyphStack entries using this font
 };
 
 T3FontCache::T3FontCache(const Ref *fontIDA, double m11A, double m12A, double m21A, double m22A, int glyphXA, int glyphYA, int glyphWA, int glyphHA, bool validBBoxA, bool aa)
@@ -1140,39 +1376,144 @@ T3FontCache::T3FontCache(const Ref *fontIDA, double m11A, double m12A, double m2
     } else {
         glyphSize = ((glyphW + 7) >> 3) * glyphH;
     }
-    cacheAssoc = type3FontCacheAssoc;
-    for (cacheSets = type3FontCacheMaxSets; cacheSets > 1 && cacheSets * cacheAssoc * glyphSize > type3FontCacheSize; cacheSets >>= 1) {
-        ;
-    }
-    if (glyphSize < 10485760 / cacheAssoc / cacheSets) {
-        cacheData = static_cast<unsigned char *>(gmallocn_checkoverflow(cacheSets * cacheAssoc, glyphSize));
-    } else {
-        error(errSyntaxWarning, -1,
-              "Not creating cacheData for T3FontCache, it asked for too much memory.\n"
-              "       This could teoretically result in wrong rendering,\n"
-              "       but most probably the document is bogus.\n"
-              "       Please report a bug if you think the rendering may be wrong because of this.");
-        cacheData = nullptr;
-    }
-    if (cacheData != nullptr) {
-        cacheTags = static_cast<T3FontCacheTag *>(gmallocn(cacheSets * cacheAssoc, sizeof(T3FontCacheTag)));
-        for (int i = 0; i < cacheSets * cacheAssoc; ++i) {
-            cacheTags[i].mru = i & (cacheAssoc - 1);
+    refCnt = 0;
+}
+
+//------------------------------------------------------------------------
+// T3GlyphCache
+//------------------------------------------------------------------------
+
+// Glyph bitmaps of all Type 3 fonts of a document, keyed on the font,
+// the transform matrix and the char code.  The least recently used
+// glyphs are dropped when the cache grows past its memory budget.
+class T3GlyphCache
+{
+public:
+    explicit T3GlyphCache(size_t maxBytesA);
+    T3GlyphCache(const T3GlyphCache &) = delete;
+    T3GlyphCache &operator=(const T3GlyphCache &) = delete;
+
+    // Return the font entry matching <fontID> and the matrix, or
+    // nullptr.
+    T3FontCache *findFont(const Ref *fontID, double m11, double m12, double m21, double m22);
+
+    // Add a font entry; the cache takes ownership.
+    T3FontCache *addFont(std::unique_ptr<T3FontCache> font);
+
+    // Return the cached bitmap of a glyph, or nullptr.
+    unsigned char *lookupGlyph(T3FontCache *font, CharCode code);
+
+    // Whether a glyph of <font> fits in the cache at all.
+    bool canCacheGlyph(const T3FontCache *font) const { return glyphBytes(font) <= maxBytes; }
+
+    // Copy a glyph bitmap into the cache.
+    void addGlyph(T3FontCache *font, CharCode code, const unsigned char *data);
+
+    void setMaxBytes(size_t maxBytesA);
+    void clear();
+
+    long long getHits() const { return hits; }
+    long long getMisses() const { return misses; }
+
+private:
+    static size_t glyphBytes(const T3FontCache *font) { return sizeof(T3CachedGlyph) + font->glyphSize; }
+    void shrink(size_t bytes);
+
+    std::vector<std::unique_ptr<T3FontCache>> fonts; // font entries, most recently used first
+    std::list<T3CachedGlyph> lru; // glyphs, most recently used first
+    size_t maxBytes; // memory budget
+    size_t usedBytes; // memory used by fonts and glyphs
+    long long hits, misses; // glyph lookup counters
+};
+
+T3GlyphCache::T3GlyphCache(size_t maxBytesA)
+{
+    maxBytes = maxBytesA;
+    usedBytes = 0;
+    hits = misses = 0;
+}
+
+T3FontCache *T3GlyphCache::findFont(const Ref *fontID, double m11, double m12, double m21, double m22)
+{
+    for (size_t i = 0; i < fonts.size(); ++i) {
+        if (fonts[i]->matches(fontID, m11, m12, m21, m22)) {
+            if (i > 0) {
+                std::rotate(fonts.begin(), fonts.begin() + i, fonts.begin() + i + 1);
+            }
+            return fonts[0].get();
         }
-    } else {
-        cacheTags = nullptr;
     }
+    return nullptr;
+}
+
+T3FontCache *T3GlyphCache::addFont(std::unique_ptr<T3FontCache> font)
+{
+    shrink(sizeof(T3FontCache));
+    usedBytes += sizeof(T3FontCache);
+    fonts.insert(fonts.begin(), std::move(font));
+    return fonts[0].get();
 }
 
-T3FontCache::~T3FontCache()
+unsigned char *T3GlyphCache::lookupGlyph(T3FontCache *font, CharCode code)
 {
-    gfree(cacheData);
-    gfree(cacheTags);
+    auto it = font->glyphs.find(code);
+    if (it == font->glyphs.end()) {
+        ++misses;
+        return nullptr;
+    }
+    ++hits;
+    lru.splice(lru.begin(), lru, it->second);
+    return it->second->data.get();
+}
+
+void T3GlyphCache::addGlyph(T3FontCache *font, CharCode code, const unsigned char *data)
+{
+    if (!canCacheGlyph(font) || font->glyphs.count(code)) {
+        return;
+    }
+    // the font is on the glyph stack, so shrink() keeps it
+    shrink(glyphBytes(font));
+    lru.push_front(T3CachedGlyph { font, code, std::make_unique<unsigned char[]>(font->glyphSize) });
+    memcpy(lru.front().data.get(), data, font->glyphSize);
+    font->glyphs[code] = lru.begin();
+    usedBytes += glyphBytes(font);
+}
+
+void T3GlyphCache::setMaxBytes(size_t maxBytesA)
+{
+    maxBytes = maxBytesA;
+    shrink(0);
+}
+
+void T3GlyphCache::clear()
+{
+    lru.clear();
+    fonts.clear();
+    usedBytes = 0;
+    hits = misses = 0;
+}
+
+// Drop glyphs, and then fonts without glyphs, until <bytes> more bytes
+// fit in the budget.  Fonts still used by a T3GlyphStack entry are kept.
+void T3GlyphCache::shrink(size_t bytes)
+{
+    while (!lru.empty() && usedBytes + bytes > maxBytes) {
+        T3FontCache *font = lru.back().font;
+        font->glyphs.erase(lru.back().code);
+        usedBytes -= glyphBytes(font);
+        lru.pop_back();
+    }
+    for (size_t i = fonts.size(); i > 0 && usedBytes + bytes > maxBytes; --i) {
+        if (fonts[i - 1]->glyphs.empty() && fonts[i - 1]->refCnt == 0) {
+            fonts.erase(fonts.begin() + (i - 1));
+            usedBytes -= sizeof(T3FontCache);
+        }
+    }
 }
 
 struct T3GlyphStack
 {
-    unsigned short code; // character code
+    CharCode code; // character code
 
     bool haveDx; // set after seeing a d0/d1 operator
     bool doNotCache; // set if we see a gsave/grestore before
@@ -1180,8 +1521,7 @@ struct T3GlyphStack
 
     //----- cache info
     T3FontCache *cache; // font cache for the current font
-    T3FontCacheTag *cacheTag; // pointer to cache tag for the glyph
-    unsigned char *cacheData; // pointer to cache data for the glyph
+    bool cacheGlyph; // set if the glyph is rendered for the cache
 
     //----- saved state
     SplashBitmap *origBitmap;
@@ -1205,6 +1545,7 @@ struct SplashTransparencyGroup
 
     //----- for knockout
     SplashBitmap *shape;
+    int shapeX, shapeY; // position of the group bitmap in shape
     bool knockout;
     double knockoutOpacity;
     bool fontAA;
@@ -1228,9 +1569,13 @@ SplashOutputDev::SplashOutputDev(SplashColorMode colorModeA, int bitmapRowPadA,
     bitmapTopDown = bitmapTopDownA;
     fontAntialias = true;
     vectorAntialias = true;
+    analyticAntialias = false;
+    shadingThreads = 1;
+    useGlyphRuns = false;
     overprintPreview = overprintPreviewA;
     enableFreeType = true;
     enableFreeTypeHinting = false;
+    reducedImageDecoding = true;
     enableSlightHinting = false;
     setupScreenParams(72.0, 72.0);
     if (paperColorA != nullptr) {
@@ -1248,17 +1593,21 @@ SplashOutputDev::SplashOutputDev(SplashColorMode colorModeA, int bitmapRowPadA,
     splash = new Splash(bitmap, vectorAntialias, &screenParams);
     splash->setMinLineWidth(s_minLineWidth);
     splash->setThinLineMode(thinLineMode);
+    splash->setAnalyticAntialias(analyticAntialias);
+    splash->setShadingThreads(shadingThreads);
     splash->clear(paperColor, 0);
 
     fontEngine = nullptr;
 
-    nT3Fonts = 0;
+    t3GlyphCache = new T3GlyphCache(splashOutT3GlyphCacheSize);
     t3GlyphStack = nullptr;
 
     font = nullptr;
     needFontUpdate = false;
     textClipPath = nullptr;
     transpGroupStack = nullptr;
+    groupBitmapPoolBytes = 0;
+    groupBitmapPoolLimit = 0;
     xref = nullptr;
 }
 
@@ -1287,11 +1636,7 @@ void SplashOutputDev::setupScreenParams(double hDPI, double vDPI)
 
 SplashOutputDev::~SplashOutputDev()
 {
-    int i;
-
-    for (i = 0; i < nT3Fonts; ++i) {
-        delete t3FontCache[i];
-    }
+    delete t3GlyphCache;
     delete fontEngine;
     delete splash;
     delete bitmap;
@@ -1300,15 +1645,25 @@ SplashOutputDev::~SplashOutputDev()
 
 void SplashOutputDev::startDoc(PDFDoc *docA)
 {
-    int i;
-
     doc = docA;
     delete fontEngine;
     fontEngine = new SplashFontEngine(enableFreeType, enableFreeTypeHinting, enableSlightHinting, getFontAntialias() && colorMode != splashModeMono1);
-    for (i = 0; i < nT3Fonts; ++i) {
-        delete t3FontCache[i];
-    }
-    nT3Fonts = 0;
+    t3GlyphCache->clear();
+}
+
+void SplashOutputDev::setType3GlyphCacheSize(size_t bytes)
+{
+    t3GlyphCache->setMaxBytes(bytes);
+}
+
+long long SplashOutputDev::getType3GlyphCacheHits() const
+{
+    return t3GlyphCache->getHits();
+}
+
+long long SplashOutputDev::getType3GlyphCacheMisses() const
+{
+    return t3GlyphCache->getMisses();
 }
 
 void SplashOutputDev::startPage(int /*pageNum*/, GfxState *state, XRef *xrefA)
@@ -1348,8 +1703,18 @@ void SplashOutputDev::startPage(int /*pageNum*/, GfxState *state, XRef *xrefA)
             bitmap = new SplashBitmap(w, h, bitmapRowPad, colorMode, colorMode != splashModeMono1, bitmapTopDown);
         }
     }
+    // bitmaps of finished transparency groups are kept for reuse, as long
+    // as together with the next one they don't take more memory than a
+    // quarter of the page
+    groupBitmapPoolLimit = static_cast<size_t>(std::abs(bitmap->getRowSize())) * bitmap->getHeight() / 4;
+    if (groupBitmapPoolBytes > groupBitmapPoolLimit) {
+        groupBitmapPool.clear();
+        groupBitmapPoolBytes = 0;
+    }
     splash = new Splash(bitmap, vectorAntialias, &screenParams);
     splash->setThinLineMode(thinLineMode);
+    splash->setAnalyticAntialias(analyticAntialias);
+    splash->setShadingThreads(shadingThreads);
     splash->setMinLineWidth(s_minLineWidth);
     if (state) {
         splash->setMatrix(state->getCTM());
@@ -2207,17 +2572,54 @@ void SplashOutputDev::drawChar(GfxState *state, double x, double y, double /*dx*
     delete path;
 }
 
+void SplashOutputDev::drawGlyphRun(GfxState *state, const OutputGlyphRun &run)
+{
+    int render;
+    double m[4];
+    bool horiz;
+
+    // only plain fills are drawn as a run; strokes and clips need the
+    // glyph paths
+    render = state->getRender();
+    if (render != 0) {
+        for (const OutputGlyph &glyph : run.glyphs) {
+            drawChar(state, glyph.x, glyph.y, glyph.dx, glyph.dy, glyph.originX, glyph.originY, glyph.code, glyph.nBytes, glyph.u, glyph.uLen);
+        }
+        return;
+    }
+
+    if (skipHorizText || skipRotatedText) {
+        state->getFontTransMat(&m[0], &m[1], &m[2], &m[3]);
+        horiz = m[0] > 0 && fabs(m[1]) < 0.001 && fabs(m[2]) < 0.001 && m[3] < 0;
+        if ((skipHorizText && horiz) || (skipRotatedText && !horiz)) {
+            return;
+        }
+    }
+
+    if (needFontUpdate) {
+        doUpdateFont(state);
+    }
+    if (!font || state->getFillColorSpace()->isNonMarking()) {
+        return;
+    }
+
+    setOverprintMask(state->getFillColorSpace(), state->getFillOverprint(), state->getOverprintMode(), &state->getFillColor());
+    for (const OutputGlyph &glyph : run.glyphs) {
+        splash->fillCharDevice(glyph.devX, glyph.devY, glyph.code, font);
+    }
+}
+
 bool SplashOutputDev::beginType3Char(GfxState *state, double /*x*/, double /*y*/, double /*dx*/, double /*dy*/, CharCode code, const Unicode * /*u*/, int /*uLen*/)
 {
     std::shared_ptr<const GfxFont> gfxFont;
     const Ref *fontID;
     T3FontCache *t3Font;
     T3GlyphStack *t3gs;
+    unsigned char *data;
     bool validBBox;
     double m[4];
     bool horiz;
     double x1, y1, xMin, yMin, xMax, yMax, xt, yt;
-    int i, j;
 
     // check for invisible text -- this is used by Acrobat Capture
     if (state->getRender() == 3) {
@@ -2241,101 +2643,64 @@ bool SplashOutputDev::beginType3Char(GfxState *state, double /*x*/, double /*y*/
     const std::array<double, 6> &ctm = state->getCTM();
     state->transform(0, 0, &xt, &yt);
 
-    // is it the first (MRU) font in the cache?
-    if (nT3Fonts <= 0 || !t3FontCache[0]->matches(fontID, ctm[0], ctm[1], ctm[2], ctm[3])) {
-
-        // is the font elsewhere in the cache?
-        for (i = 1; i < nT3Fonts; ++i) {
-            if (t3FontCache[i]->matches(fontID, ctm[0], ctm[1], ctm[2], ctm[3])) {
-                t3Font = t3FontCache[i];
-                for (j = i; j > 0; --j) {
-                    t3FontCache[j] = t3FontCache[j - 1];
-                }
-                t3FontCache[0] = t3Font;
-                break;
+    // is the font in the cache?
+    if (!(t3Font = t3GlyphCache->findFont(fontID, ctm[0], ctm[1], ctm[2], ctm[3]))) {
+        const std::array<double, 4> &bbox = gfxFont->getFontBBox();
+        if (bbox[0] == 0 && bbox[1] == 0 && bbox[2] == 0 && bbox[3] == 0) {
+            // unspecified bounding box -- just take a guess
+            xMin = xt - 5;
+            xMax = xMin + 30;
+            yMax = yt + 15;
+            yMin = yMax - 45;
+            validBBox = false;
+        } else {
+            state->transform(bbox[0], bbox[1], &x1, &y1);
+            xMin = xMax = x1;
+            yMin = yMax = y1;
+            state->transform(bbox[0], bbox[3], &x1, &y1);
+            if (x1 < xMin) {
+                xMin = x1;
+            } else if (x1 > xMax) {
+                xMax = x1;
             }
-        }
-        if (i >= nT3Fonts) {
-
-            // create new entry in the font cache
-            if (nT3Fonts == splashOutT3FontCacheSize) {
-                t3gs = t3GlyphStack;
-                while (t3gs != nullptr) {
-                    if (t3gs->cache == t3FontCache[nT3Fonts - 1]) {
-                        error(errSyntaxWarning, -1, "t3FontCache reaches limit but font still on stack in SplashOutputDev::beginType3Char");
-                        return true;
-                    }
-                    t3gs = t3gs->next;
-                }
-                delete t3FontCache[nT3Fonts - 1];
-                --nT3Fonts;
+            if (y1 < yMin) {
+                yMin = y1;
+            } else if (y1 > yMax) {
+                yMax = y1;
             }
-            for (j = nT3Fonts; j > 0; --j) {
-                t3FontCache[j] = t3FontCache[j - 1];
+            state->transform(bbox[2], bbox[1], &x1, &y1);
+            if (x1 < xMin) {
+                xMin = x1;
+            } else if (x1 > xMax) {
+                xMax = x1;
             }
-            ++nT3Fonts;
-            const std::array<double, 4> &bbox = gfxFont->getFontBBox();
-            if (bbox[0] == 0 && bbox[1] == 0 && bbox[2] == 0 && bbox[3] == 0) {
-                // unspecified bounding box -- just take a guess
-                xMin = xt - 5;
-                xMax = xMin + 30;
-                yMax = yt + 15;
-                yMin = yMax - 45;
-                validBBox = false;
-            } else {
-                state->transform(bbox[0], bbox[1], &x1, &y1);
-                xMin = xMax = x1;
-                yMin = yMax = y1;
-                state->transform(bbox[0], bbox[3], &x1, &y1);
-                if (x1 < xMin) {
-                    xMin = x1;
-                } else if (x1 > xMax) {
-                    xMax = x1;
-                }
-                if (y1 < yMin) {
-                    yMin = y1;
-                } else if (y1 > yMax) {
-                    yMax = y1;
-                }
-                state->transform(bbox[2], bbox[1], &x1, &y1);
-                if (x1 < xMin) {
-                    xMin = x1;
-                } else if (x1 > xMax) {
-                    xMax = x1;
-                }
-                if (y1 < yMin) {
-                    yMin = y1;
-                } else if (y1 > yMax) {
-                    yMax = y1;
-                }
-                state->transform(bbox[2], bbox[3], &x1, &y1);
-                if (x1 < xMin) {
-                    xMin = x1;
-                } else if (x1 > xMax) {
-                    xMax = x1;
-                }
-                if (y1 < yMin) {
-                    yMin = y1;
-                } else if (y1 > yMax) {
-                    yMax = y1;
-                }
-                validBBox = true;
+            if (y1 < yMin) {
+                yMin = y1;
+            } else if (y1 > yMax) {
+                yMax = y1;
             }
-            t3FontCache[0] = new T3FontCache(fontID, ctm[0], ctm[1], ctm[2], ctm[3], static_cast<int>(floor(xMin - xt)) - 2, static_cast<int>(floor(yMin - yt)) - 2, static_cast<int>(ceil(xMax)) - static_cast<int>(floor(xMin)) + 4,
-                                             static_cast<int>(ceil(yMax)) - static_cast<int>(floor(yMin)) + 4, validBBox, colorMode != splashModeMono1);
+            state->transform(bbox[2], bbox[3], &x1, &y1);
+            if (x1 < xMin) {
+                xMin = x1;
+            } else if (x1 > xMax) {
+                xMax = x1;
+            }
+            if (y1 < yMin) {
+                yMin = y1;
+            } else if (y1 > yMax) {
+                yMax = y1;
+            }
+            validBBox = true;
         }
+        t3Font = t3GlyphCache->addFont(std::make_unique<T3FontCache>(fontID, ctm[0], ctm[1], ctm[2], ctm[3], static_cast<int>(floor(xMin - xt)) - 2, static_cast<int>(floor(yMin - yt)) - 2,
+                                                                     static_cast<int>(ceil(xMax)) - static_cast<int>(floor(xMin)) + 4, static_cast<int>(ceil(yMax)) - static_cast<int>(floor(yMin)) + 4, validBBox,
+                                                                     colorMode != splashModeMono1));
     }
-    t3Font = t3FontCache[0];
 
     // is the glyph in the cache?
-    i = (code & (t3Font->cacheSets - 1)) * t3Font->cacheAssoc;
-    for (j = 0; j < t3Font->cacheAssoc; ++j) {
-        if (t3Font->cacheTags != nullptr) {
-            if ((t3Font->cacheTags[i + j].mru & 0x8000) && t3Font->cacheTags[i + j].code == code) {
-                drawType3Glyph(state, t3Font, &t3Font->cacheTags[i + j], t3Font->cacheData + (i + j) * t3Font->glyphSize);
-                return true;
-            }
-        }
+    if ((data = t3GlyphCache->lookupGlyph(t3Font, code))) {
+        drawType3Glyph(state, t3Font, data);
+        return true;
     }
 
     // push a new Type 3 glyph record
@@ -2344,10 +2709,10 @@ bool SplashOutputDev::beginType3Char(GfxState *state, double /*x*/, double /*y*/
     t3GlyphStack = t3gs;
     t3GlyphStack->code = code;
     t3GlyphStack->cache = t3Font;
-    t3GlyphStack->cacheTag = nullptr;
-    t3GlyphStack->cacheData = nullptr;
+    t3GlyphStack->cacheGlyph = false;
     t3GlyphStack->haveDx = false;
     t3GlyphStack->doNotCache = false;
+    ++t3Font->refCnt;
 
     return false;
 }
@@ -2356,19 +2721,21 @@ void SplashOutputDev::endType3Char(GfxState *state)
 {
     T3GlyphStack *t3gs;
 
-    if (t3GlyphStack->cacheTag) {
-        memcpy(t3GlyphStack->cacheData, bitmap->getDataPtr(), t3GlyphStack->cache->glyphSize);
-        delete bitmap;
+    if (t3GlyphStack->cacheGlyph) {
+        SplashBitmap *glyphBitmap = bitmap;
         delete splash;
         bitmap = t3GlyphStack->origBitmap;
         splash = t3GlyphStack->origSplash;
         const std::array<double, 6> &ctm = state->getCTM();
         state->setCTM(ctm[0], ctm[1], ctm[2], ctm[3], t3GlyphStack->origCTM4, t3GlyphStack->origCTM5);
         updateCTM(state, 0, 0, 0, 0, 0, 0);
-        drawType3Glyph(state, t3GlyphStack->cache, t3GlyphStack->cacheTag, t3GlyphStack->cacheData);
+        t3GlyphCache->addGlyph(t3GlyphStack->cache, t3GlyphStack->code, glyphBitmap->getDataPtr());
+        drawType3Glyph(state, t3GlyphStack->cache, glyphBitmap->getDataPtr());
+        delete glyphBitmap;
     }
     t3gs = t3GlyphStack;
     t3GlyphStack = t3gs->next;
+    --t3gs->cache->refCnt;
     delete t3gs;
 }
 
@@ -2386,7 +2753,6 @@ void SplashOutputDev::type3D1(GfxState *state, double /*wx*/, double /*wy*/, dou
     T3FontCache *t3Font;
     SplashColor color;
     double xt, yt, xMin, xMax, yMin, yMax, x1, y1;
-    int i, j;
 
     // ignore multiple d0/d1 operators
     if (!t3GlyphStack || t3GlyphStack->haveDx) {
@@ -2460,22 +2826,10 @@ void SplashOutputDev::type3D1(GfxState *state, double /*wx*/, double /*wy*/, dou
         return;
     }
 
-    if (t3Font->cacheTags == nullptr) {
+    if (!t3GlyphCache->canCacheGlyph(t3Font)) {
         return;
     }
-
-    // allocate a cache entry
-    i = (t3GlyphStack->code & (t3Font->cacheSets - 1)) * t3Font->cacheAssoc;
-    for (j = 0; j < t3Font->cacheAssoc; ++j) {
-        if ((t3Font->cacheTags[i + j].mru & 0x7fff) == t3Font->cacheAssoc - 1) {
-            t3Font->cacheTags[i + j].mru = 0x8000;
-            t3Font->cacheTags[i + j].code = t3GlyphStack->code;
-            t3GlyphStack->cacheTag = &t3Font->cacheTags[i + j];
-            t3GlyphStack->cacheData = t3Font->cacheData + (i + j) * t3Font->glyphSize;
-        } else {
-            ++t3Font->cacheTags[i + j].mru;
-        }
-    }
+    t3GlyphStack->cacheGlyph = true;
 
     // save state
     t3GlyphStack->origBitmap = bitmap;
@@ -2500,6 +2854,8 @@ void SplashOutputDev::type3D1(GfxState *state, double /*wx*/, double /*wy*/, dou
     }
     splash->setMinLineWidth(s_minLineWidth);
     splash->setThinLineMode(splashThinLineDefault);
+    splash->setAnalyticAntialias(analyticAntialias);
+    splash->setShadingThreads(shadingThreads);
     splash->setFillPattern(new SplashSolidColor(color));
     splash->setStrokePattern(new SplashSolidColor(color));
     //~ this should copy other state from t3GlyphStack->origSplash?
@@ -2507,7 +2863,7 @@ void SplashOutputDev::type3D1(GfxState *state, double /*wx*/, double /*wy*/, dou
     updateCTM(state, 0, 0, 0, 0, 0, 0);
 }
 
-void SplashOutputDev::drawType3Glyph(GfxState *state, T3FontCache *t3Font, T3FontCacheTag * /*tag*/, unsigned char *data)
+void SplashOutputDev::drawType3Glyph(GfxState *state, T3FontCache *t3Font, unsigned char *data)
 {
     SplashGlyphBitmap glyph;
 
@@ -3849,6 +4205,16 @@ void SplashOutputDev::beginTransparencyGroup(GfxState *state, const std::array<d
     } else if (y > yMax) {
         yMax = y;
     }
+
+    // nothing outside the current clip region is ever painted, neither
+    // when compositing the group nor through a soft mask made from it
+    int clipXMin, clipYMin, clipXMax, clipYMax;
+    splash->getClip().getBBoxI(&clipXMin, &clipYMin, &clipXMax, &clipYMax);
+    xMin = std::max(xMin, static_cast<double>(clipXMin));
+    yMin = std::max(yMin, static_cast<double>(clipYMin));
+    xMax = std::min(xMax, static_cast<double>(clipXMax + 1));
+    yMax = std::min(yMax, static_cast<double>(clipYMax + 1));
+
     tx = static_cast<int>(floor(xMin));
     if (tx < 0) {
         tx = 0;
@@ -3887,7 +4253,30 @@ void SplashOutputDev::beginTransparencyGroup(GfxState *state, const std::array<d
     transpGroup->ty = ty;
     transpGroup->blendingColorSpace = blendingColorSpace;
     transpGroup->isolated = isolated;
-    transpGroup->shape = (knockout && !isolated) ? SplashBitmap::copy(bitmap) : nullptr;
+    transpGroup->shape = nullptr;
+    transpGroup->shapeX = tx;
+    transpGroup->shapeY = ty;
+    if (knockout && !isolated) {
+        // keep the backdrop below the group
+        if (colorMode != splashModeMono1 && colorMode != splashModeDeviceN8 && bitmap->getAlphaPtr()) {
+            transpGroup->shape = takeGroupBitmap(w, h);
+            if (transpGroup->shape->getDataPtr() && transpGroup->shape->getAlphaPtr()) {
+                const int bytesPerPixel = splashColorModeNComps[colorMode];
+                for (int row = 0; row < h; ++row) {
+                    memcpy(transpGroup->shape->getDataPtr() + row * transpGroup->shape->getRowSize(), bitmap->getDataPtr() + (ty + row) * bitmap->getRowSize() + tx * bytesPerPixel, w * bytesPerPixel);
+                    memcpy(transpGroup->shape->getAlphaPtr() + row * w, bitmap->getAlphaPtr() + (ty + row) * bitmap->getWidth() + tx, w);
+                }
+                transpGroup->shapeX = 0;
+                transpGroup->shapeY = 0;
+            } else {
+                delete transpGroup->shape;
+                transpGroup->shape = nullptr;
+            }
+        }
+        if (!transpGroup->shape) {
+            transpGroup->shape = SplashBitmap::copy(bitmap);
+        }
+    }
     transpGroup->knockout = (knockout && isolated);
     transpGroup->knockoutOpacity = 1.0;
     transpGroup->backdropBitmap = nullptr;
@@ -3915,7 +4304,11 @@ void SplashOutputDev::beginTransparencyGroup(GfxState *state, const std::array<d
     }
 
     // create the temporary bitmap
-    bitmap = new SplashBitmap(w, h, bitmapRowPad, colorMode, true, bitmapTopDown, bitmap->getSeparationList());
+    if (colorMode == splashModeDeviceN8) {
+        bitmap = new SplashBitmap(w, h, bitmapRowPad, colorMode, true, bitmapTopDown, bitmap->getSeparationList());
+    } else {
+        bitmap = takeGroupBitmap(w, h);
+    }
     if (!bitmap->getDataPtr()) {
         delete bitmap;
         w = h = 1;
@@ -3923,6 +4316,8 @@ void SplashOutputDev::beginTransparencyGroup(GfxState *state, const std::array<d
     }
     splash = new Splash(bitmap, vectorAntialias, transpGroup->origSplash->getScreen());
     splash->setThinLineMode(transpGroup->origSplash->getThinLineMode());
+    splash->setAnalyticAntialias(analyticAntialias);
+    splash->setShadingThreads(shadingThreads);
     splash->setMinLineWidth(s_minLineWidth);
     //~ Acrobat apparently copies at least the fill and stroke colors, and
     //~ maybe other state(?) -- but not the clipping path (and not sure
@@ -3949,14 +4344,14 @@ void SplashOutputDev::beginTransparencyGroup(GfxState *state, const std::array<d
         if (!isolated && transpGroup->origBitmap->getAlphaPtr() && transpGroup->origSplash->getInNonIsolatedGroup()) {
             // when drawing a non-isolated group into another non-isolated group,
             // compute a backdrop bitmap with corrected alpha values
-            auto *backdropBitmap = new SplashBitmap(w, h, bitmapRowPad, colorMode, true, bitmapTopDown);
+            SplashBitmap *backdropBitmap = takeGroupBitmap(w, h);
             transpGroup->origSplash->blitCorrectedAlpha(backdropBitmap, tx, ty, 0, 0, w, h);
             transpGroup->backdropBitmap = backdropBitmap;
             splash->setInTransparencyGroup(backdropBitmap, 0, 0, true, knockout);
         } else {
             SplashBitmap *shape = knockout ? transpGroup->shape : (transpGroup->next != nullptr && transpGroup->next->shape != nullptr) ? transpGroup->next->shape : transpGroup->origBitmap;
-            int shapeTx = knockout ? tx : (transpGroup->next != nullptr && transpGroup->next->shape != nullptr) ? transpGroup->next->tx + tx : tx;
-            int shapeTy = knockout ? ty : (transpGroup->next != nullptr && transpGroup->next->shape != nullptr) ? transpGroup->next->ty + ty : ty;
+            int shapeTx = knockout ? transpGroup->shapeX : (transpGroup->next != nullptr && transpGroup->next->shape != nullptr) ? transpGroup->next->shapeX + tx : tx;
+            int shapeTy = knockout ? transpGroup->shapeY : (transpGroup->next != nullptr && transpGroup->next->shape != nullptr) ? transpGroup->next->shapeY + ty : ty;
             splash->setInTransparencyGroup(shape, shapeTx, shapeTy, true, knockout);
         }
     }
@@ -4006,11 +4401,11 @@ void SplashOutputDev::paintTransparencyGroup(GfxState * /*state*/, const std::ar
     if (transpGroupStack != nullptr && transpGroup->knockoutOpacity < transpGroupStack->knockoutOpacity) {
         transpGroupStack->knockoutOpacity = transpGroup->knockoutOpacity;
     }
-    delete transpGroup->shape;
-    delete transpGroup->backdropBitmap;
+    releaseGroupBitmap(transpGroup->shape);
+    releaseGroupBitmap(transpGroup->backdropBitmap);
     delete transpGroup;
 
-    delete tBitmap;
+    releaseGroupBitmap(tBitmap);
 }
 
 void SplashOutputDev::setSoftMask(GfxState * /*state*/, const std::array<double, 4> & /*bbox*/, bool alpha, Function *transferFunc, const GfxColor &backdropColor)
@@ -4143,10 +4538,11 @@ void SplashOutputDev::setSoftMask(GfxState * /*state*/, const std::array<double,
     // pop the stack
     transpGroup = transpGroupStack;
     transpGroupStack = transpGroup->next;
-    delete transpGroup->backdropBitmap;
+    releaseGroupBitmap(transpGroup->shape);
+    releaseGroupBitmap(transpGroup->backdropBitmap);
     delete transpGroup;
 
-    delete tBitmap;
+    releaseGroupBitmap(tBitmap);
 }
 
 void SplashOutputDev::clearSoftMask(GfxState * /*state*/)
@@ -4154,6 +4550,53 @@ void SplashOutputDev::clearSoftMask(GfxState * /*state*/)
     splash->setSoftMask(nullptr);
 }
 
+static size_t groupBitmapBytes(const SplashBitmap *groupBitmap)
+{
+    return static_cast<size_t>(std::abs(groupBitmap->getRowSize()) + groupBitmap->getWidth()) * groupBitmap->getHeight();
+}
+
+// Returns a bitmap with alpha channel in the current color mode for a
+// transparency group, reusing the bitmap of a finished group of the same
+// size if there is one.  Its contents are undefined.
+SplashBitmap *SplashOutputDev::takeGroupBitmap(int w, int h)
+{
+    for (auto it = groupBitmapPool.begin(); it != groupBitmapPool.end(); ++it) {
+        if ((*it)->getWidth() == w && (*it)->getHeight() == h && (*it)->getMode() == colorMode) {
+            SplashBitmap *groupBitmap = it->release();
+            groupBitmapPool.erase(it);
+            groupBitmapPoolBytes -= groupBitmapBytes(groupBitmap);
+            return groupBitmap;
+        }
+    }
+    const size_t bytes = static_cast<size_t>(w) * h * (splashColorModeNComps[colorMode] + 1);
+    while (!groupBitmapPool.empty() && groupBitmapPoolBytes + bytes > groupBitmapPoolLimit) {
+        groupBitmapPoolBytes -= groupBitmapBytes(groupBitmapPool.front().get());
+        groupBitmapPool.erase(groupBitmapPool.begin());
+    }
+    return new SplashBitmap(w, h, bitmapRowPad, colorMode, true, bitmapTopDown);
+}
+
+// Hands a bitmap of a finished transparency group over to the pool,
+// dropping the oldest ones when the pool gets too large.
+void SplashOutputDev::releaseGroupBitmap(SplashBitmap *groupBitmap)
+{
+    if (!groupBitmap || !groupBitmap->getDataPtr() || !groupBitmap->getAlphaPtr() || groupBitmap->getMode() == splashModeDeviceN8) {
+        delete groupBitmap;
+        return;
+    }
+    const size_t bytes = groupBitmapBytes(groupBitmap);
+    if (bytes > groupBitmapPoolLimit) {
+        delete groupBitmap;
+        return;
+    }
+    while (!groupBitmapPool.empty() && (groupBitmapPool.size() >= splashOutGroupBitmapPoolSize || groupBitmapPoolBytes + bytes > groupBitmapPoolLimit)) {
+        groupBitmapPoolBytes -= groupBitmapBytes(groupBitmapPool.front().get());
+        groupBitmapPool.erase(groupBitmapPool.begin());
+    }
+    groupBitmapPool.emplace_back(groupBitmap);
+    groupBitmapPoolBytes += bytes;
+}
+
 void SplashOutputDev::setPaperColor(SplashColorPtr paperColorA)
 {
     splashColorCopy(paperColor, paperColorA);
@@ -4192,6 +4635,18 @@ void SplashOutputDev::setVectorAntialias(bool vaa)
 }
 #endif
 
+void SplashOutputDev::setAnalyticAntialias(bool enable)
+{
+    analyticAntialias = enable;
+    splash->setAnalyticAntialias(enable);
+}
+
+void SplashOutputDev::setShadingThreads(int n)
+{
+    shadingThreads = std::max(1, n);
+    splash->setShadingThreads(shadingThreads);
+}
+
 void SplashOutputDev::setFreeTypeHinting(bool enable, bool enableSlightHintingA)
 {
     enableFreeTypeHinting = enable;
@@ -4379,6 +4834,8 @@ bool SplashOutputDev::tilingPatternFill(GfxState *state, Gfx *gfxA, Catalog * /*
         splash->clear(paperColor, 0);
     }
     splash->setThinLineMode(formerSplash->getThinLineMode());
+    splash->setAnalyticAntialias(analyticAntialias);
+    splash->setShadingThreads(shadingThreads);
     splash->setMinLineWidth(s_minLineWidth);
     if (doFastBlit) {
         // drawImage would colorize the greyscale pattern in tilingBitmapSrc buffer accessor while tiling.
@@ -4420,21 +4877,24 @@ bool SplashOutputDev::tilingPatternFill(GfxState *state, Gfx *gfxA, Catalog * /*
     return retValue;
 }
 
-bool SplashOutputDev::gouraudTriangleShadedFill(GfxState * /*state*/, GfxGouraudTriangleShading *shading)
+// Returns true if colors of <shadingMode> can be interpolated linearly in
+// the device colors of <colorMode>.  This triggers an optimization.
+static bool isDirectColorTranslation(SplashColorMode colorMode, GfxColorSpaceMode shadingMode)
 {
-    GfxColorSpaceMode shadingMode = shading->getColorSpace()->getMode();
-    bool bDirectColorTranslation = false; // triggers an optimization.
     switch (colorMode) {
     case splashModeRGB8:
-        bDirectColorTranslation = (shadingMode == csDeviceRGB);
-        break;
+        return shadingMode == csDeviceRGB;
     case splashModeCMYK8:
     case splashModeDeviceN8:
-        bDirectColorTranslation = (shadingMode == csDeviceCMYK);
-        break;
+        return shadingMode == csDeviceCMYK;
     default:
-        break;
+        return false;
     }
+}
+
+bool SplashOutputDev::gouraudTriangleShadedFill(GfxState * /*state*/, GfxGouraudTriangleShading *shading)
+{
+    const bool bDirectColorTranslation = isDirectColorTranslation(colorMode, shading->getColorSpace()->getMode());
     // restore vector antialias because we support it here
     SplashGouraudPattern splashShading(bDirectColorTranslation, shading);
     const bool vaa = getVectorAntialias();
@@ -4444,6 +4904,17 @@ bool SplashOutputDev::gouraudTriangleShadedFill(GfxState * /*state*/, GfxGouraud
     return retVal;
 }
 
+bool SplashOutputDev::patchMeshShadedFill(GfxState *state, GfxPatchMeshShading *shading)
+{
+    // restore vector antialias because we support it here
+    SplashPatchMeshPattern splashShading(isDirectColorTranslation(colorMode, shading->getColorSpace()->getMode()), state->getCTM(), shading);
+    const bool vaa = getVectorAntialias();
+    setVectorAntialias(true);
+    const bool retVal = splash->gouraudTriangleShadedFill(&splashShading);
+    setVectorAntialias(vaa);
+    return retVal;
+}
+
 bool SplashOutputDev::univariateShadedFill(GfxState *state, SplashUnivariatePattern *pattern)
 {
     double xMin, yMin, xMax, yMax;
@@ -4496,6 +4967,7 @@ bool SplashOutputDev::univariateShadedFill(GfxState *state, SplashUnivariatePatt
     const SplashPath path = convertPath(state->getPath(), true);
 
     pattern->getShading()->getColorSpace()->createMapping(bitmap->getSeparationList(), SPOT_NCOMPS);
+    pattern->setupColorRamp();
     setOverprintMask(pattern->getShading()->getColorSpace(), state->getFillOverprint(), state->getOverprintMode(), nullptr);
     // If state->getStrokePattern() is set, then the current clipping region
     // is a stroke path.
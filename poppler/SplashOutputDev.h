@@ -40,6 +40,9 @@
 #include "GfxState.h"
 #include "GlobalParams.h"
 
+#include <memory>
+#include <vector>
+
 class PDFDoc;
 class Gfx8BitFont;
 class SplashBitmap;
@@ -48,7 +51,7 @@ class SplashPath;
 class SplashFontEngine;
 class SplashFont;
 class T3FontCache;
-struct T3FontCacheTag;
+class T3GlyphCache;
 struct T3GlyphStack;
 struct SplashTransparencyGroup;
 
@@ -93,6 +96,10 @@ public:
 
     bool getColor(int x, int y, SplashColorPtr c) const override;
 
+    // the span path only pays off with the precomputed color ramp
+    bool hasColorSpan() const override { return ramp != nullptr; }
+    void getColorSpan(int x0, int x1, int y, SplashColor *c, unsigned char *inside) const override;
+
     bool testPosition(int x, int y) const override;
 
     bool isStatic() const override { return false; }
@@ -103,6 +110,11 @@ public:
 
     bool isCMYK() const override { return gfxMode == csDeviceCMYK; }
 
+    // Precompute the device colors of the pattern, with one entry per
+    // device pixel along the gradient.  This must be called after the
+    // color space mapping has been set up.
+    void setupColorRamp();
+
 protected:
     Matrix ictm;
     double t0, t1, dt;
@@ -110,6 +122,13 @@ protected:
     GfxState *state;
     SplashColorMode colorMode;
     GfxColorSpaceMode gfxMode;
+
+private:
+    void getRampColor(double t, SplashColorPtr c) const;
+
+    std::unique_ptr<SplashColor[]> ramp; // device colors for rampSize values
+    int rampSize; //   of t, from rampT0 in steps of 1 / rampScale
+    double rampT0, rampScale;
 };
 
 class SplashAxialPattern : public SplashUnivariatePattern
@@ -157,12 +176,59 @@ public:
 
     void getParameterizedColor(double colorinterp, SplashColorMode mode, SplashColorPtr dest) override;
 
+    bool canInterpolateDeviceColors() override { return bDirectColorTranslation; }
+
 private:
     GfxGouraudTriangleShading *shading;
     bool bDirectColorTranslation;
     GfxColorSpaceMode gfxMode;
 };
 
+// Presents the patches of a GfxPatchMeshShading as a triangle mesh: each
+// patch is evaluated on a grid, and each grid cell is split into two
+// triangles.  The grid resolution follows the device size of the largest
+// patch, so that large patches keep their curvature, and is the same for
+// all the patches, so that adjacent grids meet without cracks.
+class SplashPatchMeshPattern : public SplashGouraudColor
+{
+public:
+    SplashPatchMeshPattern(bool bDirectColorTranslationA, const std::array<double, 6> &ctmA, GfxPatchMeshShading *shadingA);
+
+    SplashPattern *copy() const override { return new SplashPatchMeshPattern(bDirectColorTranslation, ctm, shading); }
+
+    ~SplashPatchMeshPattern() override;
+
+    bool getColor(int /*x*/, int /*y*/, SplashColorPtr /*c*/) const override { return false; }
+
+    bool testPosition(int /*x*/, int /*y*/) const override { return false; }
+
+    bool isStatic() const override { return false; }
+
+    bool isCMYK() const override { return shading->getColorSpace()->getMode() == csDeviceCMYK; }
+
+    bool isParameterized() override { return shading->isParameterized(); }
+    int getNTriangles() override { return nTriangles; }
+    void getParametrizedTriangle(int i, double *x0, double *y0, double *color0, double *x1, double *y1, double *color1, double *x2, double *y2, double *color2) override;
+
+    void getNonParametrizedTriangle(int i, SplashColorMode mode, double *x0, double *y0, SplashColorPtr color0, double *x1, double *y1, SplashColorPtr color1, double *x2, double *y2, SplashColorPtr color2) override;
+
+    void getParameterizedColor(double t, SplashColorMode mode, SplashColorPtr dest) override;
+
+    bool canInterpolateDeviceColors() override { return bDirectColorTranslation; }
+
+private:
+    // Returns the patch and the grid coordinates (u, v) of the vertices
+    // of triangle <i>.
+    const GfxPatch *getTriangleVertices(int i, double u[3], double v[3]) const;
+    static void evalPatch(const GfxPatch *patch, double u, double v, double *x, double *y);
+
+    bool bDirectColorTranslation;
+    std::array<double, 6> ctm;
+    GfxPatchMeshShading *shading;
+    int gridSize; // number of grid cells along each side of a patch
+    int nTriangles;
+};
+
 // see GfxState.h, GfxRadialShading
 class SplashRadialPattern : public SplashUnivariatePattern
 {
@@ -182,8 +248,14 @@ private:
 
 //------------------------------------------------------------------------
 
-// number of Type 3 fonts to cache
-#define splashOutT3FontCacheSize 8
+// default memory budget of the Type 3 glyph cache, in bytes
+#define splashOutT3GlyphCacheSize (8 * 1024 * 1024)
+
+// max number of entries in the color ramp of an axial or radial shading
+#define splashOutColorRampMaxSize 16384
+
+// number of finished transparency group bitmaps kept for reuse
+#define splashOutGroupBitmapPoolSize 4
 
 //------------------------------------------------------------------------
 // SplashOutputDev
@@ -208,7 +280,7 @@ public:
     // Does this device use functionShadedFill(), axialShadedFill(), and
     // radialShadedFill()?  If this returns false, these shaded fills
     // will be reduced to a series of other drawing operations.
-    bool useShadedFills(int type) override { return type >= 1 && type <= 5; }
+    bool useShadedFills(int type) override { return type >= 1 && type <= 7; }
 
     // Does this device use upside-down coordinates?
     // (Upside-down means (0,0) is the top left corner of the page.)
@@ -217,10 +289,18 @@ public:
     // Does this device use drawChar() or drawString()?
     bool useDrawChar() override { return true; }
 
+    // Does this device use drawGlyphRun()?  This is off unless enabled
+    // with setUseDrawGlyphRun().
+    bool useDrawGlyphRun() override { return useGlyphRuns; }
+
     // Does this device use beginType3Char/endType3Char?  Otherwise,
     // text in Type 3 fonts will be drawn with drawChar/drawString.
     bool interpretType3Chars() override { return true; }
 
+    // Does this device want images to be decoded at a lower resolution
+    // when they are drawn much smaller than their size?
+    bool useReducedImageDecoding() override { return reducedImageDecoding; }
+
     //----- initialization and control
 
     // Start a page.
@@ -269,6 +349,7 @@ public:
     bool axialShadedFill(GfxState *state, GfxAxialShading *shading, double tMin, double tMax) override;
     bool radialShadedFill(GfxState *state, GfxRadialShading *shading, double tMin, double tMax) override;
     bool gouraudTriangleShadedFill(GfxState *state, GfxGouraudTriangleShading *shading) override;
+    bool patchMeshShadedFill(GfxState *state, GfxPatchMeshShading *shading) override;
 
     //----- path clipping
     void clip(GfxState *state) override;
@@ -277,6 +358,7 @@ public:
 
     //----- text drawing
     void drawChar(GfxState *state, double x, double y, double dx, double dy, double originX, double originY, CharCode code, int nBytes, const Unicode *u, int uLen) override;
+    void drawGlyphRun(GfxState *state, const OutputGlyphRun &run) override;
     bool beginType3Char(GfxState *state, double x, double y, double dx, double dy, CharCode code, const Unicode *u, int uLen) override;
     void endType3Char(GfxState *state) override;
     void beginTextObject(GfxState *state) override;
@@ -340,9 +422,38 @@ public:
     bool getFontAntialias() const { return fontAntialias; }
     void setFontAntialias(bool anti) { fontAntialias = anti; }
 
+    // If <enable> is true, anti-aliased vector fills use the exact area
+    // coverage of each pixel instead of 4x4 supersampling.  The default
+    // is false.
+    void setAnalyticAntialias(bool enable);
+
+    // If <use> is true, Gfx draws each string with one drawGlyphRun()
+    // call instead of one drawChar() call per glyph.  A subclass that
+    // overrides drawChar() must override drawGlyphRun() too before
+    // enabling this.  The default is false.
+    void setUseDrawGlyphRun(bool use) { useGlyphRuns = use; }
+
+    // Sets the max number of threads used to rasterize each Gouraud
+    // triangle or patch mesh shading.  The default is 1: callers that
+    // render pages in parallel shouldn't multiply their threads.
+    void setShadingThreads(int n);
+
     void setFreeTypeHinting(bool enable, bool enableSlightHinting);
     void setEnableFreeType(bool enable) { enableFreeType = enable; }
 
+    // If <enable> is true (the default), DCT and JPX images that are drawn
+    // at less than half their size are decoded at a lower resolution.
+    void setReducedImageDecoding(bool enable) { reducedImageDecoding = enable; }
+
+    // Set the memory budget of the Type 3 glyph cache, in bytes.  The
+    // default is splashOutT3GlyphCacheSize.
+    void setType3GlyphCacheSize(size_t bytes);
+
+    // Number of Type 3 glyphs found in, and missing from, the glyph
+    // cache since the last startDoc.
+    long long getType3GlyphCacheHits() const;
+    long long getType3GlyphCacheMisses() const;
+
 protected:
     void doUpdateFont(GfxState *state);
 
@@ -357,7 +468,9 @@ private:
     static void getMatteColor(SplashColorMode colorMode, GfxImageColorMap *colorMap, const GfxColor &matteColor, SplashColor splashMatteColor);
     void setOverprintMask(GfxColorSpace *colorSpace, bool overprintFlag, int overprintMode, const GfxColor *singleColor, bool grayIndexed = false);
     static SplashPath convertPath(const GfxPath *path, bool dropEmptySubpaths);
-    void drawType3Glyph(GfxState *state, T3FontCache *t3Font, T3FontCacheTag *tag, unsigned char *data);
+    void drawType3Glyph(GfxState *state, T3FontCache *t3Font, unsigned char *data);
+    SplashBitmap *takeGroupBitmap(int w, int h);
+    void releaseGroupBitmap(SplashBitmap *groupBitmap);
 #if USE_CMS
     static bool useIccImageSrc(void *data);
     static void iccTransform(void *data, SplashBitmap *bitmap);
@@ -376,9 +489,13 @@ private:
     bool bitmapTopDown;
     bool fontAntialias;
     bool vectorAntialias;
+    bool analyticAntialias;
+    int shadingThreads;
+    bool useGlyphRuns;
     bool overprintPreview;
     bool enableFreeType;
     bool enableFreeTypeHinting;
+    bool reducedImageDecoding;
     bool enableSlightHinting;
     SplashColor paperColor; // paper color
     SplashScreenParams screenParams;
@@ -392,9 +509,8 @@ private:
     Splash *splash;
     SplashFontEngine *fontEngine;
 
-    T3FontCache * // Type 3 font cache
-            t3FontCache[splashOutT3FontCacheSize];
-    int nT3Fonts; // number of valid entries in t3FontCache
+    T3GlyphCache *t3GlyphCache; // Type 3 glyph cache, shared by all
+                                //   fonts and pages of the document
     T3GlyphStack *t3GlyphStack; // Type 3 glyph context stack
 
     SplashFont *font; // current font
@@ -403,6 +519,10 @@ private:
 
     SplashTransparencyGroup * // transparency group stack
             transpGroupStack;
+    std::vector<std::unique_ptr<SplashBitmap>> // bitmaps of finished transparency
+            groupBitmapPool; //   groups, oldest first
+    size_t groupBitmapPoolBytes; // memory used by groupBitmapPool
+    size_t groupBitmapPoolLimit; // max memory used by groupBitmapPool
 };
 
 #endif
@@ -54,6 +54,7 @@
 
 #include <config.h>
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <cstddef>
@@ -449,6 +450,50 @@ void FileOutStream::printf(const char *format, ...)
     va_end(argptr);
 }
 
+//------------------------------------------------------------------------
+// MemOutStream
+//------------------------------------------------------------------------
+MemOutStream::MemOutStream() = default;
+
+MemOutStream::~MemOutStream() = default;
+
+void MemOutStream::close() { }
+
+Goffset MemOutStream::getPos()
+{
+    return data.size();
+}
+
+void MemOutStream::put(char c)
+{
+    data.push_back(c);
+}
+
+size_t MemOutStream::write(std::span<const unsigned char> span)
+{
+    data.insert(data.end(), span.begin(), span.end());
+    return span.size();
+}
+
+void MemOutStream::printf(const char *format, ...)
+{
+    char buf[256];
+    va_list argptr, argptr2;
+    va_start(argptr, format);
+    va_copy(argptr2, argptr);
+    const int n = vsnprintf(buf, sizeof(buf), format, argptr);
+    va_end(argptr);
+    if (n >= 0 && static_cast<size_t>(n) < sizeof(buf)) {
+        data.insert(data.end(), buf, buf + n);
+    } else if (n >= 0) {
+        const size_t pos = data.size();
+        data.resize(pos + n + 1);
+        vsnprintf(data.data() + pos, n + 1, format, argptr2);
+        data.resize(pos + n);
+    }
+    va_end(argptr2);
+}
+
 //------------------------------------------------------------------------
 // BaseStream
 //------------------------------------------------------------------------
@@ -988,6 +1033,26 @@ bool FileStream::fillBuf()
     return bufPtr < bufEnd;
 }
 
+int FileStream::readDirect(unsigned char *buffer, int nChars)
+{
+    bufPos += bufEnd - buf;
+    bufPtr = bufEnd = buf;
+    Goffset n = nChars;
+    if (limited) {
+        if (bufPos >= start + length) {
+            return 0;
+        }
+        n = std::min(n, start + length - bufPos);
+    }
+    const int m = file->read(reinterpret_cast<char *>(buffer), static_cast<int>(n), offset);
+    if (m <= 0) {
+        return 0;
+    }
+    offset += m;
+    bufPos += m;
+    return m;
+}
+
 void FileStream::setPos(Goffset pos, int dir)
 {
     Goffset size;
@@ -2348,90 +2413,80 @@ int CCITTFaxStream::lookChar()
     return buf;
 }
 
-short CCITTFaxStream::getTwoDimCode()
+int CCITTFaxStream::getChars(int nChars, unsigned char *buffer)
 {
-    int code;
-    const CCITTCode *p;
-    int n;
+    int n, m, c;
 
-    code = 0; // make gcc happy
-    if (endOfBlock) {
-        if ((code = lookBits(7)) != EOF) {
-            p = &twoDimTab1[code];
-            if (p->bits > 0) {
-                eatBits(p->bits);
-                return p->n;
+    n = 0;
+    while (n < nChars) {
+        // runs covering whole bytes are copied directly, everything
+        // else (row start, bytes with a color change) goes through
+        // lookChar
+        if (buf == EOF && outputBits >= 8) {
+            m = outputBits >> 3;
+            if (m > nChars - n) {
+                m = nChars - n;
+            }
+            c = (a0i & 1) ? 0x00 : 0xff;
+            if (black) {
+                c ^= 0xff;
+            }
+            memset(buffer + n, c, m);
+            n += m;
+            outputBits -= m << 3;
+            if (outputBits == 0 && codingLine[a0i] < columns) {
+                ++a0i;
+                outputBits = codingLine[a0i] - codingLine[a0i - 1];
             }
-        }
-    } else {
-        for (n = 1; n <= 7; ++n) {
-            if ((code = lookBits(n)) == EOF) {
+        } else {
+            if ((c = getChar()) == EOF) {
                 break;
             }
-            if (n < 7) {
-                code <<= 7 - n;
-            }
-            p = &twoDimTab1[code];
-            if (p->bits == n) {
-                eatBits(n);
-                return p->n;
-            }
+            buffer[n++] = static_cast<unsigned char>(c);
         }
     }
-    error(errSyntaxError, getPos(), "Bad two dim code ({0:04x}) in CCITTFax stream", code);
-    return EOF;
+    return n;
 }
 
-short CCITTFaxStream::getWhiteCode()
+// The code tables are filled for every bit pattern following a code,
+// so a single lookup of the longest code length decodes a code.  Near
+// the end of the stream lookBits pads the missing bits with zeros,
+// which still decodes any complete code that is left.
+
+short CCITTFaxStream::getTwoDimCode()
 {
-    short code;
+    int code;
     const CCITTCode *p;
-    int n;
 
     code = 0; // make gcc happy
-    if (endOfBlock) {
-        code = lookBits(12);
-        if (code == EOF) {
-            return 1;
-        }
-        if ((code >> 5) == 0) {
-            p = &whiteTab1[code];
-        } else {
-            p = &whiteTab2[code >> 3];
-        }
+    if ((code = lookBits(7)) != EOF) {
+        p = &twoDimTab1[code];
         if (p->bits > 0) {
             eatBits(p->bits);
             return p->n;
         }
+    }
+    error(errSyntaxError, getPos(), "Bad two dim code ({0:04x}) in CCITTFax stream", code);
+    return EOF;
+}
+
+short CCITTFaxStream::getWhiteCode()
+{
+    short code;
+    const CCITTCode *p;
+
+    code = lookBits(12);
+    if (code == EOF) {
+        return 1;
+    }
+    if ((code >> 5) == 0) {
+        p = &whiteTab1[code];
     } else {
-        for (n = 1; n <= 9; ++n) {
-            code = lookBits(n);
-            if (code == EOF) {
-                return 1;
-            }
-            if (n < 9) {
-                code <<= 9 - n;
-            }
-            p = &whiteTab2[code];
-            if (p->bits == n) {
-                eatBits(n);
-                return p->n;
-            }
-        }
-        for (n = 11; n <= 12; ++n) {
-            code = lookBits(n);
-            if (code == EOF) {
-                return 1;
-            }
-            if (n < 12) {
-                code <<= 12 - n;
-            }
-            p = &whiteTab1[code];
-            if (p->bits == n) {
-                eatBits(n);
-                return p->n;
-            }
-        }
+        p = &whiteTab2[code >> 3];
+    }
+    if (p->bits > 0) {
+        eatBits(p->bits);
+        return p->n;
     }
     error(errSyntaxError, getPos(), "Bad white code ({0:04x}) in CCITTFax stream", code);
     // eat a bit and return a positive number so that the caller doesn't
@@ -2444,70 +2499,21 @@ short CCITTFaxStream::getBlackCode()
 {
     short code;
     const CCITTCode *p;
-    int n;
 
-    code = 0; // make gcc happy
-    if (endOfBlock) {
-        code = lookBits(13);
-        if (code == EOF) {
-            return 1;
-        }
-        if ((code >> 7) == 0) {
-            p = &blackTab1[code];
-        } else if ((code >> 9) == 0 && (code >> 7) != 0) {
-            p = &blackTab2[(code >> 1) - 64];
-        } else {
-            p = &blackTab3[code >> 7];
-        }
-        if (p->bits > 0) {
-            eatBits(p->bits);
-            return p->n;
-        }
+    code = lookBits(13);
+    if (code == EOF) {
+        return 1;
+    }
+    if ((code >> 7) == 0) {
+        p = &blackTab1[code];
+    } else if ((code >> 9) == 0) {
+        p = &blackTab2[(code >> 1) - 64];
     } else {
-        for (n = 2; n <= 6; ++n) {
-            code = lookBits(n);
-            if (code == EOF) {
-                return 1;
-            }
-            if (n < 6) {
-                code <<= 6 - n;
-            }
-            p = &blackTab3[code];
-            if (p->bits == n) {
-                eatBits(n);
-                return p->n;
-            }
-        }
-        for (n = 7; n <= 12; ++n) {
-            code = lookBits(n);
-            if (code == EOF) {
-                return 1;
-            }
-            if (n < 12) {
-                code <<= 12 - n;
-            }
-            if (code >= 64) {
-                p = &blackTab2[code - 64];
-                if (p->bits == n) {
-                    eatBits(n);
-                    return p->n;
-                }
-            }
-        }
-        for (n = 10; n <= 13; ++n) {
-            code = lookBits(n);
-            if (code == EOF) {
-                return 1;
-            }
-            if (n < 13) {
-                code <<= 13 - n;
-            }
-            p = &blackTab1[code];
-            if (p->bits == n) {
-                eatBits(n);
-                return p->n;
-            }
-        }
+        p = &blackTab3[code >> 7];
+    }
+    if (p->bits > 0) {
+        eatBits(p->bits);
+        return p->n;
     }
     error(errSyntaxError, getPos(), "Bad black code ({0:04x}) in CCITTFax stream", code);
     // eat a bit and return a positive number so that the caller doesn't
@@ -47,6 +47,7 @@
 #ifndef STREAM_H
 #define STREAM_H
 
+#include <array>
 #include <cstdio>
 #include <cstring>
 #include <vector>
@@ -260,6 +261,17 @@ public:
     // Get image parameters which are defined by the stream contents.
     virtual void getImageParams(int * /*bitsPerComponent*/, StreamColorSpaceMode * /*csMode*/, bool * /*hasAlpha*/) { }
 
+    // Hint that the image in this stream will be drawn at about
+    // <targetWidth> x <targetHeight> device pixels, so decoders that can
+    // cheaply produce a lower resolution (DCT, JPX) may do so.  If
+    // <area> is not null only that part of the image (x0, y0, x1, y1 in
+    // pixels) is visible, and decoders that can (JPX) may skip the rest.
+    // Must be called before the stream is read.  <width> x <height> is
+    // the nominal image size; returns true if the stream will produce a
+    // smaller image, then <width> x <height> is its size and <area> the
+    // part of the nominal image it covers.
+    virtual bool setDecodeSize(int /*targetWidth*/, int /*targetHeight*/, int * /*width*/, int * /*height*/, std::array<int, 4> * /*area*/ = nullptr) { return false; }
+
     // Return the next stream in the "stack".
     virtual Stream *getNextStream() const { return nullptr; }
 
@@ -333,6 +345,36 @@ private:
     Goffset start;
 };
 
+//------------------------------------------------------------------------
+// MemOutStream
+//
+// OutStream that appends everything written to a memory buffer
+//------------------------------------------------------------------------
+class POPPLER_PRIVATE_EXPORT MemOutStream : public OutStream
+{
+public:
+    MemOutStream();
+
+    ~MemOutStream() override;
+
+    void close() override;
+
+    Goffset getPos() override;
+
+    void put(char c) override;
+
+    size_t write(std::span<const unsigned char> data) override;
+
+    void printf(const char *format, ...) override GCC_PRINTF_FORMAT(2, 3);
+
+    const std::vector<char> &getData() const { return data; }
+    std::vector<char> takeData() { return std::move(data); }
+    void clear() { data.clear(); }
+
+private:
+    std::vector<char> data;
+};
+
 //------------------------------------------------------------------------
 // BaseStream
 //
@@ -579,6 +621,15 @@ private:
         n = 0;
         while (n < nChars) {
             if (bufPtr >= bufEnd) {
+                // large reads go straight to the caller's buffer
+                if (nChars - n >= fileStreamBufSize) {
+                    m = readDirect(buffer + n, nChars - n);
+                    if (m <= 0) {
+                        break;
+                    }
+                    n += m;
+                    continue;
+                }
                 if (!fillBuf()) {
                     break;
                 }
@@ -593,6 +644,9 @@ private:
         }
         return n;
     }
+    // Reads up to nChars bytes from the file into buffer, bypassing buf,
+    // which must be empty.
+    int readDirect(unsigned char *buffer, int nChars);
 
     GooFile *file;
     Goffset offset;
@@ -1009,6 +1063,9 @@ public:
     int getDamagedRowsBeforeError() const { return damagedRowsBeforeError; }
 
 private:
+    bool hasGetChars() override { return true; }
+    int getChars(int nChars, unsigned char *buffer) override;
+
     [[nodiscard]] bool ccittRewind(bool unfiltered);
     int encoding; // 'K' parameter
     bool endOfLine; // 'EndOfLine' parameter
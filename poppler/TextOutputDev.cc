@@ -5642,6 +5642,13 @@ void TextOutputDev::drawChar(GfxState *state, double x, double y, double dx, dou
     actualText->addChar(state, x, y, dx, dy, c, nBytes, u, uLen);
 }
 
+void TextOutputDev::drawGlyphRun(GfxState *state, const OutputGlyphRun &run)
+{
+    for (const OutputGlyph &glyph : run.glyphs) {
+        actualText->addChar(state, glyph.x, glyph.y, glyph.dx, glyph.dy, glyph.code, glyph.nBytes, glyph.u, glyph.uLen);
+    }
+}
+
 void TextOutputDev::incCharCount(int nChars)
 {
     text->incCharCount(nChars);
@@ -784,6 +784,10 @@ public:
     // Does this device use drawChar() or drawString()?
     bool useDrawChar() override { return true; }
 
+    // Does this device use drawGlyphRun()?  Only if enabled with
+    // setUseDrawGlyphRun().
+    bool useDrawGlyphRun() override { return useGlyphRuns; }
+
     // Does this device use beginType3Char/endType3Char?  Otherwise,
     // text in Type 3 fonts will be drawn with drawChar/drawString.
     bool interpretType3Chars() override { return false; }
@@ -813,6 +817,7 @@ public:
     void beginString(GfxState *state, const std::string &s) override;
     void endString(GfxState *state) override;
     void drawChar(GfxState *state, double x, double y, double dx, double dy, double originX, double originY, CharCode c, int nBytes, const Unicode *u, int uLen) override;
+    void drawGlyphRun(GfxState *state, const OutputGlyphRun &run) override;
     void incCharCount(int nChars) override;
     void beginActualText(GfxState *state, const std::string &text) override;
     void endActualText(GfxState *state) override;
@@ -878,6 +883,11 @@ public:
     void setMinColSpacing1(double val) { minColSpacing1 = val; }
     void setEndOfLineHyphenMode(EndOfLineHyphenMode mode) { hyphenMode = mode; }
 
+    // Collect each string from one drawGlyphRun() call instead of one
+    // drawChar() call per glyph.  Off by default, since a subclass that
+    // overrides drawChar() would miss the glyphs of the runs.
+    void setUseDrawGlyphRun(bool use) { useGlyphRuns = use; }
+
 private:
     TextOutputFunc outputFunc; // output function
     void *outputStream; // output stream
@@ -899,6 +909,7 @@ private:
     bool textPageBreaks; // insert end-of-page markers?
     EndOfLineKind textEOL; // type of EOL marker to use
     EndOfLineHyphenMode hyphenMode = EndOfLineHyphenMode::RemoveAll;
+    bool useGlyphRuns = false; // use drawGlyphRun()?
 
     std::unique_ptr<ActualText> actualText;
 };
@@ -50,6 +50,7 @@
 
 #include <config.h>
 
+#include <algorithm>
 #include <array>
 #include <cstdlib>
 #include <cstddef>
@@ -1388,7 +1389,8 @@ Object XRef::fetch(int num, int gen, int recursion, Goffset *endPos)
 
         ObjectStream *objStr = nullptr;
         if (const auto it = objStrs.find(e->offset); it != objStrs.end()) {
-            objStr = it->second.get();
+            objStr = it->second.first.get();
+            it->second.second = ++objStrsUse;
         } else {
             objStr = new ObjectStream(this, static_cast<int>(e->offset), recursion + 1);
             if (!objStr->isOk()) {
@@ -1398,11 +1400,17 @@ Object XRef::fetch(int num, int gen, int recursion, Goffset *endPos)
             } else {
                 // XRef could be reconstructed in constructor of ObjectStream:
                 e = getEntry(num);
-                const auto [_, inserted] = objStrs.emplace(e->offset, std::unique_ptr<ObjectStream>(objStr));
+                const auto [cached, inserted] = objStrs.emplace(e->offset, std::pair(std::unique_ptr<ObjectStream>(objStr), ++objStrsUse));
                 if (!inserted) {
                     // this happens when indeed the xref was reconstructed, and the reconstuction ended up adding an ObjectStream
                     // for that offset, so fetch the good objStr because the one we had was just deleted by emplace failing
-                    objStr = objStrs.find(e->offset)->second.get();
+                    objStr = cached->second.first.get();
+                    cached->second.second = objStrsUse;
+                } else if (maxObjStrs > 0 && objStrs.size() > maxObjStrs) {
+                    // getObject returns copies, so the streams can be freed
+                    // once the object has been fetched
+                    const auto lru = std::ranges::min_element(objStrs, {}, [](const auto &entry) { return entry.second.second; });
+                    objStrs.erase(lru);
                 }
             }
         }
@@ -1754,7 +1762,9 @@ void XRef::XRefStreamWriter::writeEntry(Goffset offset, int gen, XRefEntryType t
 {
     const int entryTotalSize = 1 + offsetSize + 2; /* type + offset + gen */
     char data[16];
-    data[0] = (type == xrefEntryFree) ? 0 : 1;
+    // for compressed entries offset is the object stream number and gen the
+    // index of the object inside it
+    data[0] = (type == xrefEntryFree) ? 0 : (type == xrefEntryCompressed) ? 2 : 1;
     for (int i = offsetSize; i > 0; i--) {
         data[i] = offset & 0xff;
         offset >>= 8;
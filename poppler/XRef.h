@@ -201,6 +201,13 @@ public:
     // decryption is enabled, and therefore the Unencrypted flag is ignored.
     void scanSpecialFlags();
 
+    // Keep at most <n> parsed object streams, the least recently used
+    // ones being parsed again if needed (0, the default, keeps them all).
+    // Objects fetched from a freed stream stay valid, but fetching them
+    // again returns copies, so this is only worth it when the objects
+    // aren't kept, e.g. when the pages are released once processed.
+    void setMaxObjectStreams(size_t n) { maxObjStrs = n; }
+
     // Direct access.
     XRefEntry *getEntry(int i, bool complainIfMissing = true);
     Object *getTrailerDict() { return &trailerDict; }
@@ -250,7 +257,11 @@ private:
     Goffset *streamEnds; // 'endstream' positions - only used in
                          //   damaged files
     int streamEndsLen; // number of valid entries in streamEnds
-    std::unordered_map<Goffset, std::unique_ptr<ObjectStream>> objStrs; // object streams map
+    // parsed object streams by offset, with the last time they were used:
+    // the least recently used ones are freed beyond <maxObjStrs>
+    std::unordered_map<Goffset, std::pair<std::unique_ptr<ObjectStream>, unsigned long>> objStrs;
+    unsigned long objStrsUse = 0; // use counter for <objStrs>
+    size_t maxObjStrs = 0; // max size of <objStrs>, 0 if unbounded
     bool encrypted; // true if file is encrypted
     int encRevision;
     int encVersion; // encryption algorithm
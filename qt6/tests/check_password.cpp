@@ -1,4 +1,5 @@
 #include <QtTest/QTest>
+#include <QTemporaryFile>
 
 #include <poppler-qt6.h>
 
@@ -17,6 +18,8 @@ private Q_SLOTS:
     static void password4();
     static void password4b();
     static void password5();
+    static void saveAndReload_data();
+    static void saveAndReload();
 };
 
 // BUG:4557
@@ -97,5 +100,69 @@ void TestPassword::password5()
     QVERIFY(!doc->isLocked());
 }
 
+void TestPassword::saveAndReload_data()
+{
+    QTest::addColumn<QString>("fileName");
+    QTest::addColumn<QByteArray>("userPassword");
+
+    QTest::newRow("RC4") << QString::fromUtf8(TESTDATADIR "/unittestcases/Gday garçon - open.pdf") << QString::fromUtf8("garçon").toLatin1(); // clazy:exclude=qstring-allocations
+    QTest::newRow("AES-256") << QStringLiteral(TESTDATADIR "/unittestcases/encrypted-256.pdf") << QByteArray("user-secret");
+}
+
+// Saving an encrypted document must keep it encrypted with the same password
+void TestPassword::saveAndReload()
+{
+    QFETCH(QString, fileName);
+    QFETCH(QByteArray, userPassword);
+
+    const QString contents = QStringLiteral("encrypted annotation");
+
+    QTemporaryFile tempFile;
+    QVERIFY(tempFile.open());
+    tempFile.close();
+
+    int numPages;
+    QString text;
+    {
+        std::unique_ptr<Poppler::Document> doc = Poppler::Document::load(fileName, "", userPassword);
+        QVERIFY(doc);
+        QVERIFY(!doc->isLocked());
+        numPages = doc->numPages();
+
+        std::unique_ptr<Poppler::Page> page = doc->page(0);
+        QVERIFY(page);
+
+        // the annotation and its appearance stream are encrypted on save
+        auto annot = std::make_unique<Poppler::TextAnnotation>(Poppler::TextAnnotation::InPlace);
+        annot->setBoundary(QRectF(0.0, 0.0, 0.5, 0.5));
+        annot->setContents(contents);
+        page->addAnnotation(annot.get());
+        text = page->text(QRectF());
+
+        std::unique_ptr<Poppler::PDFConverter> conv = doc->pdfConverter();
+        QVERIFY(conv);
+        conv->setOutputFileName(tempFile.fileName());
+        conv->setPDFOptions(Poppler::PDFConverter::WithChanges);
+        QVERIFY(conv->convert());
+    }
+
+    std::unique_ptr<Poppler::Document> doc = Poppler::Document::load(tempFile.fileName());
+    QVERIFY(doc);
+    QVERIFY(doc->isLocked());
+    QVERIFY(!doc->unlock("", userPassword));
+    QVERIFY(!doc->isLocked());
+    QCOMPARE(doc->numPages(), numPages);
+
+    std::unique_ptr<Poppler::Page> page = doc->page(0);
+    QVERIFY(page);
+    QCOMPARE(page->text(QRectF()), text);
+
+    bool found = false;
+    for (const std::unique_ptr<Poppler::Annotation> &annot : page->annotations()) {
+        found = found || annot->contents() == contents;
+    }
+    QVERIFY(found);
+}
+
 QTEST_GUILESS_MAIN(TestPassword)
 #include "check_password.moc"
@@ -34,6 +34,7 @@
 
 #include <config.h>
 
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <climits>
@@ -57,6 +58,10 @@
 #include "SplashGlyphBitmap.h"
 #include "Splash.h"
 #include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
 
 //------------------------------------------------------------------------
 
@@ -155,6 +160,12 @@ struct SplashPipe
     // source pattern
     const SplashPattern *pattern;
 
+    // source colors of a dynamic pattern for the span starting at
+    // spanX0, if they have been computed in advance
+    SplashColor *spanColors;
+    unsigned char *spanInside;
+    int spanX0;
+
     // source alpha and color
     unsigned char aInput;
     bool usesShape;
@@ -207,6 +218,9 @@ inline void Splash::pipeInit(SplashPipe *pipe, int x, int y, const SplashPattern
 {
     pipeSetXY(pipe, x, y);
     pipe->pattern = nullptr;
+    pipe->spanColors = nullptr;
+    pipe->spanInside = nullptr;
+    pipe->spanX0 = 0;
 
     // source color
     if (pattern) {
@@ -300,23 +314,30 @@ void Splash::pipeRun(SplashPipe *pipe)
 
     // dynamic pattern
     if (pipe->pattern) {
-        if (!pipe->pattern->getColor(pipe->x, pipe->y, pipe->cSrcVal)) {
+        if (pipe->spanColors) {
+            const int i = pipe->x - pipe->spanX0;
+            if (!pipe->spanInside[i]) {
+                pipeIncX(pipe);
+                return;
+            }
+            pipe->cSrc = pipe->spanColors[i];
+        } else if (!pipe->pattern->getColor(pipe->x, pipe->y, pipe->cSrcVal)) {
             pipeIncX(pipe);
             return;
         }
         if (bitmap->mode == splashModeCMYK8 || bitmap->mode == splashModeDeviceN8) {
             if (state->fillOverprint && state->overprintMode && pipe->pattern->isCMYK()) {
                 unsigned int overprintMask = 15;
-                if (pipe->cSrcVal[0] == 0) {
+                if (pipe->cSrc[0] == 0) {
                     overprintMask &= ~1;
                 }
-                if (pipe->cSrcVal[1] == 0) {
+                if (pipe->cSrc[1] == 0) {
                     overprintMask &= ~2;
                 }
-                if (pipe->cSrcVal[2] == 0) {
+                if (pipe->cSrc[2] == 0) {
                     overprintMask &= ~4;
                 }
-                if (pipe->cSrcVal[3] == 0) {
+                if (pipe->cSrc[3] == 0) {
                     overprintMask &= ~8;
                 }
                 state->overprintMask = overprintMask;
@@ -1417,6 +1438,12 @@ inline void Splash::drawSpan(SplashPipe *pipe, int x0, int x1, int y, bool noCli
     int x;
 
     if (noClip) {
+        // solid color into a Mono1 bitmap: threshold the whole span
+        // against the screen at once
+        if (pipe->run == &Splash::pipeRunSimpleMono1) {
+            state->screen->fillSpan(x0, y, x1 - x0 + 1, state->grayTransfer[pipe->cSrc[0]], &bitmap->data[y * bitmap->rowSize]);
+            return;
+        }
         pipeSetXY(pipe, x0, y);
         for (x = x0; x <= x1; ++x) {
             (this->*pipe->run)(pipe);
@@ -1439,6 +1466,26 @@ inline void Splash::drawSpan(SplashPipe *pipe, int x0, int x1, int y, bool noCli
     }
 }
 
+// Halftone the <n> gray levels <values> into the Mono1 bitmap at (<x>,
+// <y>) .. (<x> + <n> - 1, <y>).  This is what pipeRunSimpleMono1 does
+// for each pixel.
+void Splash::halftoneSpan(int x, int y, int n, const unsigned char *values)
+{
+    unsigned char buf[256];
+    unsigned char *line = &bitmap->data[y * bitmap->rowSize];
+
+    while (n > 0) {
+        const int k = n < static_cast<int>(sizeof(buf)) ? n : static_cast<int>(sizeof(buf));
+        for (int i = 0; i < k; ++i) {
+            buf[i] = state->grayTransfer[values[i]];
+        }
+        state->screen->testSpan(x, y, k, buf, line);
+        x += k;
+        values += k;
+        n -= k;
+    }
+}
+
 inline void Splash::drawAALine(SplashPipe *pipe, int x0, int x1, int y, bool adjustLine, unsigned char lineOpacity)
 {
 #if splashAASize == 4
@@ -1521,6 +1568,8 @@ Splash::Splash(SplashBitmap *bitmapA, bool vectorAntialiasA, const SplashScreen
     }
     minLineWidth = 0;
     thinLineMode = splashThinLineDefault;
+    analyticAntialias = false;
+    shadingThreads = 1;
     debugMode = false;
     alpha0Bitmap = nullptr;
     groupBackBitmap = nullptr;
@@ -2081,7 +2130,6 @@ void Splash::strokeWide(const SplashPath &path, double w)
 
 std::unique_ptr<SplashPath> Splash::flattenPath(const SplashPath &path, const std::array<double, 6> &matrix, double flatness)
 {
-    double flatness2;
     unsigned char flag;
     int i;
 
@@ -2089,7 +2137,6 @@ std::unique_ptr<SplashPath> Splash::flattenPath(const SplashPath &path, const st
     // Estimate size, reserve
     fPath->reserve(path.length * 2 + 2);
 
-    flatness2 = flatness * flatness;
     i = 0;
     while (i < path.length) {
         flag = path.flags[i];
@@ -2098,7 +2145,7 @@ std::unique_ptr<SplashPath> Splash::flattenPath(const SplashPath &path, const st
             ++i;
         } else {
             if (flag & splashPathCurve) {
-                flattenCurve(path.pts[i - 1].x, path.pts[i - 1].y, path.pts[i].x, path.pts[i].y, path.pts[i + 1].x, path.pts[i + 1].y, path.pts[i + 2].x, path.pts[i + 2].y, matrix, flatness2, fPath.get());
+                flattenCurve(path.pts[i - 1].x, path.pts[i - 1].y, path.pts[i].x, path.pts[i].y, path.pts[i + 1].x, path.pts[i + 1].y, path.pts[i + 2].x, path.pts[i + 2].y, matrix, flatness, fPath.get());
                 i += 3;
             } else {
                 fPath->lineTo(path.pts[i].x, path.pts[i].y);
@@ -2112,90 +2159,24 @@ std::unique_ptr<SplashPath> Splash::flattenPath(const SplashPath &path, const st
     return fPath;
 }
 
-void Splash::flattenCurve(double x0, double y0, double x1, double y1, double x2, double y2, double x3, double y3, const std::array<double, 6> &matrix, double flatness2, SplashPath *fPath)
-{
-    double cx[splashMaxCurveSplits + 1][3];
-    double cy[splashMaxCurveSplits + 1][3];
-    int cNext[splashMaxCurveSplits + 1];
-    double xl0, xl1, xl2, xr0, xr1, xr2, xr3, xx1, xx2, xh;
-    double yl0, yl1, yl2, yr0, yr1, yr2, yr3, yy1, yy2, yh;
-    double dx, dy, mx, my, tx, ty, d1, d2;
-    int p1, p2, p3;
-
-    // initial segment
-    p1 = 0;
-    p2 = splashMaxCurveSplits;
-    cx[p1][0] = x0;
-    cy[p1][0] = y0;
-    cx[p1][1] = x1;
-    cy[p1][1] = y1;
-    cx[p1][2] = x2;
-    cy[p1][2] = y2;
-    cx[p2][0] = x3;
-    cy[p2][0] = y3;
-    cNext[p1] = p2;
-
-    while (p1 < splashMaxCurveSplits) {
-
-        // get the next segment
-        xl0 = cx[p1][0];
-        yl0 = cy[p1][0];
-        xx1 = cx[p1][1];
-        yy1 = cy[p1][1];
-        xx2 = cx[p1][2];
-        yy2 = cy[p1][2];
-        p2 = cNext[p1];
-        xr3 = cx[p2][0];
-        yr3 = cy[p2][0];
-
-        // compute the distances (in device space) from the control points
-        // to the midpoint of the straight line (this is a bit of a hack,
-        // but it's much faster than computing the actual distances to the
-        // line)
-        transform(matrix, (xl0 + xr3) * 0.5, (yl0 + yr3) * 0.5, &mx, &my);
-        transform(matrix, xx1, yy1, &tx, &ty);
-        dx = tx - mx;
-        dy = ty - my;
-        d1 = dx * dx + dy * dy;
-        transform(matrix, xx2, yy2, &tx, &ty);
-        dx = tx - mx;
-        dy = ty - my;
-        d2 = dx * dx + dy * dy;
-
-        // if the curve is flat enough, or no more subdivisions are
-        // allowed, add the straight line segment
-        if (p2 - p1 == 1 || (d1 <= flatness2 && d2 <= flatness2)) {
-            fPath->lineTo(xr3, yr3);
-            p1 = p2;
-
-            // otherwise, subdivide the curve
-        } else {
-            xl1 = splashAvg(xl0, xx1);
-            yl1 = splashAvg(yl0, yy1);
-            xh = splashAvg(xx1, xx2);
-            yh = splashAvg(yy1, yy2);
-            xl2 = splashAvg(xl1, xh);
-            yl2 = splashAvg(yl1, yh);
-            xr2 = splashAvg(xx2, xr3);
-            yr2 = splashAvg(yy2, yr3);
-            xr1 = splashAvg(xh, xr2);
-            yr1 = splashAvg(yh, yr2);
-            xr0 = splashAvg(xl2, xr1);
-            yr0 = splashAvg(yl2, yr1);
-            // add the new subdivision points
-            p3 = (p1 + p2) / 2;
-            cx[p1][1] = xl1;
-            cy[p1][1] = yl1;
-            cx[p1][2] = xl2;
-            cy[p1][2] = yl2;
-            cNext[p1] = p3;
-            cx[p3][0] = xr0;
-            cy[p3][0] = yr0;
-            cx[p3][1] = xr1;
-            cy[p3][1] = yr1;
-            cx[p3][2] = xr2;
-            cy[p3][2] = yr2;
-            cNext[p3] = p2;
+void Splash::flattenCurve(double x0, double y0, double x1, double y1, double x2, double y2, double x3, double y3, const std::array<double, 6> &matrix, double flatness, SplashPath *fPath)
+{
+    double xs[splashCurvePointsBlockSize], ys[splashCurvePointsBlockSize];
+    double tx0, ty0, tx1, ty1, tx2, ty2, tx3, ty3;
+    int n, i, j, count;
+
+    // the segment count is computed in device space
+    transform(matrix, x0, y0, &tx0, &ty0);
+    transform(matrix, x1, y1, &tx1, &ty1);
+    transform(matrix, x2, y2, &tx2, &ty2);
+    transform(matrix, x3, y3, &tx3, &ty3);
+    n = splashCurveSegments(tx0, ty0, tx1, ty1, tx2, ty2, tx3, ty3, splashCurveFlatnessScale * flatness, splashMaxCurveSplits);
+    fPath->grow(n);
+    for (i = 0; i < n; i += count) {
+        count = n - i < splashCurvePointsBlockSize ? n - i : splashCurvePointsBlockSize;
+        splashCurvePoints(x0, y0, x1, y1, x2, y2, x3, y3, n, i, count, xs, ys);
+        for (j = 0; j < count; ++j) {
+            fPath->lineTo(xs[j], ys[j]);
         }
     }
 }
@@ -2410,6 +2391,11 @@ SplashError Splash::fillWithPattern(SplashPath *path, bool eo, SplashPattern *pa
     }
 
     SplashXPath xPath(*path, state->matrix, state->flatness, true, adjustLine, linePosI);
+    if (vectorAntialias && !inShading && analyticAntialias && thinLineMode == splashThinLineDefault) {
+        if (fillWithCoverage(xPath, eo, pattern, alpha)) {
+            return SplashError::NoError;
+        }
+    }
     if (vectorAntialias && !inShading) {
         xPath.aaScale();
     }
@@ -2487,6 +2473,54 @@ SplashError Splash::fillWithPattern(SplashPath *path, bool eo, SplashPattern *pa
     return SplashError::NoError;
 }
 
+// Anti-aliased fill using the exact area coverage of each pixel as the
+// shape (no gamma is applied, the coverage doesn't overestimate thin
+// shapes like supersampling does).  This only handles paths which are
+// entirely inside the clip region, returns false if the caller has to
+// fall back to supersampling.
+bool Splash::fillWithCoverage(const SplashXPath &xPath, bool eo, SplashPattern *pattern, double alpha)
+{
+    SplashPipe pipe;
+    SplashClipResult clipRes;
+    int xMinI, yMinI, xMaxI, yMaxI, x0, x1;
+
+    SplashXPathCoverageScanner scanner(xPath, eo, state->clip->getYMinI(), state->clip->getYMaxI());
+    scanner.getBBox(&xMinI, &yMinI, &xMaxI, &yMaxI);
+    if (xMinI > xMaxI || yMinI > yMaxI) {
+        opClipRes = splashClipAllOutside;
+        return true;
+    }
+    clipRes = state->clip->testRect(xMinI, yMinI, xMaxI, yMaxI);
+    if (clipRes == splashClipAllOutside) {
+        opClipRes = clipRes;
+        return true;
+    }
+    if (clipRes != splashClipAllInside) {
+        return false;
+    }
+
+    scanner.computeCells();
+    std::vector<unsigned char> line(xMaxI - xMinI + 1);
+    pipeInit(&pipe, 0, yMinI, pattern, nullptr, static_cast<unsigned char>(splashRound(alpha * 255)), true, false);
+    for (int y = yMinI; y <= yMaxI; ++y) {
+        if (!scanner.renderLine(line.data(), &x0, &x1, y)) {
+            continue;
+        }
+        pipeSetXY(&pipe, x0, y);
+        for (int x = x0; x <= x1; ++x) {
+            const unsigned char t = line[x - xMinI];
+            if (t != 0) {
+                pipe.shape = t;
+                (this->*pipe.run)(&pipe);
+            } else {
+                pipeIncX(&pipe);
+            }
+        }
+    }
+    opClipRes = clipRes;
+    return true;
+}
+
 bool Splash::pathAllOutside(const SplashPath &path)
 {
     double xMin1, yMin1, xMax1, yMax1;
@@ -2581,15 +2615,21 @@ bool Splash::pathAllOutside(const SplashPath &path)
 
 SplashError Splash::fillChar(double x, double y, int c, SplashFont *font)
 {
-    SplashGlyphBitmap glyph;
     double xt, yt;
-    int x0, y0, xFrac, yFrac;
-    SplashClipResult clipRes;
 
     if (debugMode) {
         printf("fillChar: x=%.2f y=%.2f c=%3d=0x%02x='%c'\n", x, y, c, c, c);
     }
     transform(state->matrix, x, y, &xt, &yt);
+    return fillCharDevice(xt, yt, c, font);
+}
+
+SplashError Splash::fillCharDevice(double xt, double yt, int c, SplashFont *font)
+{
+    SplashGlyphBitmap glyph;
+    int x0, y0, xFrac, yFrac;
+    SplashClipResult clipRes;
+
     x0 = splashFloor(xt);
     xFrac = splashFloor((xt - x0) * splashFontFraction);
     y0 = splashFloor(yt);
@@ -3372,9 +3412,9 @@ void Splash::scaleMaskYupXup(SplashImageMaskSource src, void *srcData, int srcWi
 {
     unsigned char *lineBuf;
     unsigned int pix;
-    unsigned char *destPtr0, *destPtr;
+    unsigned char *destPtr0;
     int yp, yq, xp, xq, yt, y, yStep, xt, x, xStep, xx;
-    int i, j;
+    int i;
 
     destPtr0 = dest->data;
     if (destPtr0 == nullptr) {
@@ -3419,32 +3459,38 @@ void Splash::scaleMaskYupXup(SplashImageMaskSource src, void *srcData, int srcWi
         // read row from image
         (*src)(srcData, lineBuf);
 
-        // init x scale Bresenham
-        xt = 0;
-
-        xx = 0;
-        for (x = 0; x < srcWidth; ++x) {
-
-            // x scale Bresenham
-            if ((xt += xq) >= srcWidth) {
-                xt -= srcWidth;
-                xStep = xp + 1;
-            } else {
-                xStep = xp;
+        // compute the first destination row, the other yStep - 1 rows
+        // are copies of it
+        if (xp == 1 && xq == 0) {
+            for (x = 0; x < srcWidth; ++x) {
+                destPtr0[x] = lineBuf[x] ? 255 : 0;
             }
+        } else {
+            // init x scale Bresenham
+            xt = 0;
 
-            // compute the final pixel
-            pix = lineBuf[x] ? 255 : 0;
+            xx = 0;
+            for (x = 0; x < srcWidth; ++x) {
 
-            // store the pixel
-            for (i = 0; i < yStep; ++i) {
-                for (j = 0; j < xStep; ++j) {
-                    destPtr = destPtr0 + i * scaledWidth + xx + j;
-                    *destPtr++ = static_cast<unsigned char>(pix);
+                // x scale Bresenham
+                if ((xt += xq) >= srcWidth) {
+                    xt -= srcWidth;
+                    xStep = xp + 1;
+                } else {
+                    xStep = xp;
                 }
-            }
 
-            xx += xStep;
+                // compute the final pixel
+                pix = lineBuf[x] ? 255 : 0;
+
+                // store the pixel
+                memset(destPtr0 + xx, pix, xStep);
+
+                xx += xStep;
+            }
+        }
+        for (i = 1; i < yStep; ++i) {
+            memcpy(destPtr0 + i * scaledWidth, destPtr0, scaledWidth);
         }
 
         destPtr0 += yStep * scaledWidth;
@@ -3476,6 +3522,9 @@ void Splash::blitMask(const SplashBitmap &src, int xDest, int yDest, SplashClipR
         }
     } else {
         pipeInit(&pipe, xDest, yDest, state->fillPattern, nullptr, static_cast<unsigned char>(splashRound(state->fillAlpha * 255)), true, false);
+        if (clipRes == splashClipAllInside && blitMaskSolid(src, xDest, yDest, &pipe)) {
+            return;
+        }
         if (clipRes == splashClipAllInside) {
             for (y = 0; y < h; ++y) {
                 pipeSetXY(&pipe, xDest, yDest + y);
@@ -3506,6 +3555,98 @@ void Splash::blitMask(const SplashBitmap &src, int xDest, int yDest, SplashClipR
     }
 }
 
+// Fast path for blitMask with an opaque solid fill color and no clipping:
+// fully covered pixels are written directly (they get exactly the
+// source color, as pipeRunAA* would compute for shape 255), partially
+// covered ones still go through the pipe.  Returns false if the pipe
+// state does not allow this.
+bool Splash::blitMaskSolid(const SplashBitmap &src, int xDest, int yDest, SplashPipe *pipe)
+{
+    unsigned char color[4];
+    int nComps;
+
+    if (pipe->aInput != 255) {
+        return false;
+    }
+    if (pipe->run == &Splash::pipeRunAAMono1) {
+        color[0] = state->grayTransfer[pipe->cSrc[0]];
+        nComps = 0;
+    } else if (pipe->run == &Splash::pipeRunAAMono8) {
+        color[0] = state->grayTransfer[pipe->cSrc[0]];
+        nComps = 1;
+    } else if (pipe->run == &Splash::pipeRunAARGB8) {
+        color[0] = state->rgbTransferR[pipe->cSrc[0]];
+        color[1] = state->rgbTransferG[pipe->cSrc[1]];
+        color[2] = state->rgbTransferB[pipe->cSrc[2]];
+        nComps = 3;
+    } else if (pipe->run == &Splash::pipeRunAABGR8 || pipe->run == &Splash::pipeRunAAXBGR8) {
+        color[0] = state->rgbTransferB[pipe->cSrc[2]];
+        color[1] = state->rgbTransferG[pipe->cSrc[1]];
+        color[2] = state->rgbTransferR[pipe->cSrc[0]];
+        color[3] = 255;
+        nComps = pipe->run == &Splash::pipeRunAAXBGR8 ? 4 : 3;
+    } else {
+        return false;
+    }
+
+    const int w = src.getWidth();
+    const int h = src.getHeight();
+    const unsigned char *p = src.getDataPtr();
+    for (int y = 0; y < h; ++y, p += src.getRowSize()) {
+        const int yy = yDest + y;
+        int x = 0;
+        while (x < w) {
+            // skip uncovered pixels, eight at a time where possible
+            uint64_t word;
+            while (x + 8 <= w && (memcpy(&word, p + x, 8), word == 0)) {
+                x += 8;
+            }
+            while (x < w && p[x] == 0) {
+                ++x;
+            }
+            if (x == w) {
+                break;
+            }
+            if (p[x] != 255) {
+                pipeSetXY(pipe, xDest + x, yy);
+                pipe->shape = p[x];
+                (this->*pipe->run)(pipe);
+                ++x;
+                continue;
+            }
+
+            // find the end of the fully covered run
+            int x1 = x + 1;
+            while (x1 + 8 <= w && (memcpy(&word, p + x1, 8), word == ~static_cast<uint64_t>(0))) {
+                x1 += 8;
+            }
+            while (x1 < w && p[x1] == 255) {
+                ++x1;
+            }
+
+            const int x0 = xDest + x;
+            const int n = x1 - x;
+            if (nComps == 0) {
+                state->screen->fillSpan(x0, yy, n, color[0], &bitmap->data[yy * bitmap->rowSize]);
+            } else {
+                unsigned char *q = &bitmap->data[yy * bitmap->rowSize + nComps * x0];
+                if (nComps == 1) {
+                    memset(q, color[0], n);
+                } else {
+                    for (int i = 0; i < n; ++i) {
+                        for (int j = 0; j < nComps; ++j) {
+                            *q++ = color[j];
+                        }
+                    }
+                }
+                memset(&bitmap->alpha[yy * bitmap->width + x0], 255, n);
+            }
+            x = x1;
+        }
+    }
+    return true;
+}
+
 SplashError Splash::drawImage(SplashImageSource src, SplashICCTransform tf, void *srcData, SplashColorMode srcMode, bool srcAlpha, int w, int h, const std::array<double, 6> &mat, bool interpolate, bool tilingPattern)
 {
     bool ok;
@@ -5043,6 +5184,10 @@ void Splash::blitImage(const SplashBitmap &src, bool srcAlpha, int xDest, int yD
                     (this->*pipe.run)(&pipe);
                 }
             }
+        } else if (pipe.run == &Splash::pipeRunSimpleMono1 && src.getMode() == splashModeMono8) {
+            for (y = y0; y < y1; ++y) {
+                halftoneSpan(xDest + x0, yDest + y, x1 - x0, src.getDataPtr() + y * src.getRowSize() + x0);
+            }
         } else {
             for (y = y0; y < y1; ++y) {
                 pipeSetXY(&pipe, xDest + x0, yDest + y);
@@ -5363,25 +5508,189 @@ void Splash::compositeBackground(SplashColorConstPtr color)
     memset(bitmap->alpha, 255, bitmap->width * bitmap->height);
 }
 
-bool Splash::gouraudTriangleShadedFill(SplashGouraudColor *shading)
+//------------------------------------------------------------------------
+// mesh shadings
+//------------------------------------------------------------------------
+
+// max number of entries in the color table used for parameterized
+// mesh shadings
+#define splashMeshColorTableSize 4096
+
+// number of scanlines in a band; the bands of a mesh shading are
+// rasterized independently of each other
+#define splashMeshBandHeight 32
+
+// min number of pixels (summed over the triangle bounding boxes) which
+// each thread has to rasterize
+#define splashMeshMinPixelsPerThread (1 << 18)
+
+namespace {
+
+// A triangle of a mesh shading, in device space, with its vertices
+// sorted by y.  Parameterized shadings use t, the others color.
+struct SplashMeshTriangle
+{
+    int x[3], y[3];
+    double t[3];
+    unsigned char color[3][splashMaxColorComps];
+    bool flat; // all three vertices have the same color
+};
+
+// Rasterizes mesh triangles into a bitmap whose top left pixel is at
+// (xOff, yOff) in device space.
+struct SplashMeshRasterizer
 {
-    double xdbl[3] = { 0., 0., 0. };
-    double ydbl[3] = { 0., 0., 0. };
-    int x[3] = { 0, 0, 0 };
-    int y[3] = { 0, 0, 0 };
-    double xt = 0., xa = 0., yt = 0.;
+    SplashColorPtr data;
+    int rowSize;
+    unsigned char *alpha; // may be nullptr
+    int alphaRowSize;
+    int xOff, yOff;
+    int colorComps;
+    const SplashClip *clip;
+    bool parameterized;
+    const SplashColor *colorTable;
+    int colorTableSize;
+    double colorTableT0, colorTableScale;
+
+    void fillTriangle(const SplashMeshTriangle &tri, int yMinA, int yMaxA) const;
+    void getTableColor(double t, SplashColorPtr c) const;
+};
+
+}
 
-    const int bitmapWidth = bitmap->getWidth();
+void SplashMeshRasterizer::getTableColor(double t, SplashColorPtr c) const
+{
+    double pos = (t - colorTableT0) * colorTableScale;
+    if (!(pos > 0)) {
+        pos = 0;
+    } else if (pos > colorTableSize - 1) {
+        pos = colorTableSize - 1;
+    }
+    int i = static_cast<int>(pos);
+    if (i >= colorTableSize - 1) {
+        i = colorTableSize - 2;
+    }
+    const int f = static_cast<int>((pos - i) * 256);
+    const unsigned char *c0 = colorTable[i];
+    const unsigned char *c1 = colorTable[i + 1];
+    const int nComps = colorComps;
+    for (int k = 0; k < nComps; ++k) {
+        c[k] = static_cast<unsigned char>((c0[k] * (256 - f) + c1[k] * f + 128) >> 8);
+    }
+}
+
+void SplashMeshRasterizer::fillTriangle(const SplashMeshTriangle &tri, int yMinA, int yMaxA) const
+{
+    const int *x = tri.x;
+    const int *y = tri.y;
+    const int nComps = colorComps;
+    const int nValues = parameterized ? 1 : (tri.flat ? 0 : nComps);
+
+    // linear maps from the scanline y to the x coordinate and to the
+    // color values along an edge of the triangle
+    struct Edge
+    {
+        double x[2];
+        double c[splashMaxColorComps][2];
+    };
+    auto setupEdge = [&](int a, int b, Edge *e) {
+        e->x[0] = static_cast<double>(x[b] - x[a]) / (y[b] - y[a]);
+        e->x[1] = x[a] - y[a] * e->x[0];
+        for (int k = 0; k < nValues; ++k) {
+            const double ca = parameterized ? tri.t[a] : tri.color[a][k];
+            const double cb = parameterized ? tri.t[b] : tri.color[b][k];
+            e->c[k][0] = (cb - ca) / (y[b] - y[a]);
+            e->c[k][1] = ca - y[a] * e->c[k][0];
+        }
+    };
+    Edge longEdge, upperEdge, lowerEdge;
+    setupEdge(0, 2, &longEdge);
+    if (y[0] < y[1]) {
+        setupEdge(0, 1, &upperEdge);
+    }
+    if (y[1] < y[2]) {
+        setupEdge(1, 2, &lowerEdge);
+    }
+
+    // the short edges are on the left side if their common vertex is
+    // left of the long edge
+    const bool shortLeft = !(x[1] > y[1] * longEdge.x[0] + longEdge.x[1]);
+
+    const bool clipPaths = clip->getNumPaths() > 0;
+    const int yStart = std::max({ y[0], yMinA, clip->getYMinI() });
+    const int yEnd = std::min({ y[2], yMaxA, clip->getYMaxI() });
+    double scanMap[splashMaxColorComps][2];
+
+    for (int Y = yStart; Y <= yEnd; ++Y) {
+        const Edge &shortEdge = (y[0] < y[1] && (Y < y[1] || y[1] == y[2])) ? upperEdge : lowerEdge;
+        const Edge &edgeL = shortLeft ? shortEdge : longEdge;
+        const Edge &edgeR = shortLeft ? longEdge : shortEdge;
+        const double yt = Y;
+        const int scanLimitL = splashRound(yt * edgeL.x[0] + edgeL.x[1]);
+        const int scanLimitR = splashRound(yt * edgeR.x[0] + edgeR.x[1]);
+
+        // interpolate the color inside of the scanline
+        for (int k = 0; k < nValues; ++k) {
+            const double ca = yt * edgeL.c[k][0] + edgeL.c[k][1];
+            const double ct = yt * edgeR.c[k][0] + edgeR.c[k][1];
+            scanMap[k][0] = (scanLimitR == scanLimitL) ? 0. : ((ct - ca) / (scanLimitR - scanLimitL));
+            scanMap[k][1] = ca - scanLimitL * scanMap[k][0];
+        }
+
+        const int x0 = std::max(scanLimitL, clip->getXMinI());
+        const int x1 = std::min(scanLimitR, clip->getXMaxI());
+        if (x0 > x1) {
+            continue;
+        }
+        SplashColorPtr p = data + (Y - yOff) * static_cast<ptrdiff_t>(rowSize) + (x0 - xOff) * nComps;
+        if (parameterized) {
+            double t = scanMap[0][0] * x0 + scanMap[0][1];
+            for (int X = x0; X <= x1; ++X, p += nComps, t += scanMap[0][0]) {
+                if (!clipPaths || clip->test(X, Y)) {
+                    getTableColor(t, p);
+                }
+            }
+        } else if (tri.flat) {
+            for (int X = x0; X <= x1; ++X, p += nComps) {
+                if (!clipPaths || clip->test(X, Y)) {
+                    memcpy(p, tri.color[0], nComps);
+                }
+            }
+        } else {
+            double c[splashMaxColorComps], dc[splashMaxColorComps];
+            for (int k = 0; k < nComps; ++k) {
+                c[k] = scanMap[k][0] * x0 + scanMap[k][1] + 0.5;
+                dc[k] = scanMap[k][0];
+            }
+            for (int X = x0; X <= x1; ++X, p += nComps) {
+                if (!clipPaths || clip->test(X, Y)) {
+                    for (int k = 0; k < nComps; ++k) {
+                        p[k] = static_cast<unsigned char>(std::clamp(static_cast<int>(c[k]), 0, 255));
+                    }
+                }
+                for (int k = 0; k < nComps; ++k) {
+                    c[k] += dc[k];
+                }
+            }
+        }
+        if (alpha) {
+            unsigned char *q = alpha + (Y - yOff) * static_cast<ptrdiff_t>(alphaRowSize) + (x0 - xOff);
+            for (int X = x0; X <= x1; ++X, ++q) {
+                if (!clipPaths || clip->test(X, Y)) {
+                    *q = 255;
+                }
+            }
+        }
+    }
+}
+
+bool Splash::gouraudTriangleShadedFill(SplashGouraudColor *shading)
+{
     const SplashClip &clip = getClip();
-    SplashBitmap *blitTarget = bitmap;
-    SplashColorPtr bitmapData = bitmap->getDataPtr();
-    const int bitmapOffLimit = bitmap->getHeight() * bitmap->getRowSize();
-    SplashColorPtr bitmapAlpha = bitmap->getAlphaPtr();
     const std::array<double, 6> &userToCanvasMatrix = getMatrix();
     const SplashColorMode bitmapMode = bitmap->getMode();
-    bool hasAlpha = (bitmapAlpha != nullptr);
-    const int rowSize = bitmap->getRowSize();
     const int colorComps = splashColorModeNComps[bitmapMode];
+    const bool parameterized = shading->isParameterized();
 
     SplashPipe pipe;
     SplashColor cSrcVal;
@@ -5395,454 +5704,250 @@ bool Splash::gouraudTriangleShadedFill(SplashGouraudColor *shading)
         drawAAPixelInit();
     }
 
-    // idea:
-    // 1. If pipe->noTransparency && !state->blendFunc
-    //  -> blit directly into the drawing surface!
-    //  -> disable alpha manually.
-    // 2. Otherwise:
-    // - blit also directly, but into an intermediate surface.
-    // Afterwards, blit the intermediate surface using the drawing pipeline.
-    // This is necessary because triangle elements can be on top of each
-    // other, so the complete shading needs to be drawn before opacity is
-    // applied.
-    // - the final step, is performed using a SplashPipe:
-    // - assign the actual color into cSrcVal: pipe uses cSrcVal by reference
-    // - invoke drawPixel(&pipe,X,Y,bNoClip);
-    const bool bDirectBlit = vectorAntialias ? false : pipe.noTransparency && !state->blendFunc && !shading->isParameterized();
-    if (!bDirectBlit) {
-        blitTarget = new SplashBitmap(bitmap->getWidth(), bitmap->getHeight(), bitmap->getRowPad(), bitmap->getMode(), true, bitmap->getRowSize() >= 0);
-        bitmapData = blitTarget->getDataPtr();
-        bitmapAlpha = blitTarget->getAlphaPtr();
-
-        // initialisation seems to be necessary:
-        const int S = bitmap->getWidth() * bitmap->getHeight();
-        for (int i = 0; i < S; ++i) {
-            bitmapAlpha[i] = 0;
-        }
-        hasAlpha = true;
-    }
-
-    if (shading->isParameterized()) {
-        double color[3];
-        double scanLimitMapL[2] = { 0., 0. };
-        double scanLimitMapR[2] = { 0., 0. };
-        double scanColorMapL[2] = { 0., 0. };
-        double scanColorMapR[2] = { 0., 0. };
-        int scanEdgeL[2] = { 0, 0 };
-        int scanEdgeR[2] = { 0, 0 };
-
-        for (int i = 0; i < shading->getNTriangles(); ++i) {
-            shading->getParametrizedTriangle(i, xdbl + 0, ydbl + 0, color + 0, xdbl + 1, ydbl + 1, color + 1, xdbl + 2, ydbl + 2, color + 2);
-            for (int m = 0; m < 3; ++m) {
-                xt = xdbl[m] * userToCanvasMatrix[0] + ydbl[m] * userToCanvasMatrix[2] + userToCanvasMatrix[4];
-                yt = xdbl[m] * userToCanvasMatrix[1] + ydbl[m] * userToCanvasMatrix[3] + userToCanvasMatrix[5];
-                xdbl[m] = xt;
-                ydbl[m] = yt;
-                // we operate on scanlines which are integer offsets into the
-                // raster image. The double offsets are of no use here.
-                x[m] = splashRound(xt);
-                y[m] = splashRound(yt);
-            }
-            // sort according to y coordinate to simplify sweep through scanlines:
-            // INSERTION SORT.
-            if (y[0] > y[1]) {
-                Guswap(x[0], x[1]);
-                Guswap(y[0], y[1]);
-                Guswap(color[0], color[1]);
-            }
-            // first two are sorted.
-            assert(y[0] <= y[1]);
-            if (y[1] > y[2]) {
-                const int tmpX = x[2];
-                const int tmpY = y[2];
-                const double tmpC = color[2];
-                x[2] = x[1];
-                y[2] = y[1];
-                color[2] = color[1];
-
-                if (y[0] > tmpY) {
-                    x[1] = x[0];
-                    y[1] = y[0];
-                    color[1] = color[0];
-                    x[0] = tmpX;
-                    y[0] = tmpY;
-                    color[0] = tmpC;
-                } else {
-                    x[1] = tmpX;
-                    y[1] = tmpY;
-                    color[1] = tmpC;
-                }
+    // transform the triangles to device space
+    std::vector<SplashMeshTriangle> triangles;
+    triangles.reserve(shading->getNTriangles());
+    int xMin = INT_MAX, yMin = INT_MAX, xMax = INT_MIN, yMax = INT_MIN;
+    double tMin = 0, tMax = 0;
+    for (int i = 0; i < shading->getNTriangles(); ++i) {
+        double xdbl[3], ydbl[3], t[3] = { 0., 0., 0. };
+        SplashColor color[3];
+        bool flat = false;
+        if (parameterized) {
+            shading->getParametrizedTriangle(i, xdbl + 0, ydbl + 0, t + 0, xdbl + 1, ydbl + 1, t + 1, xdbl + 2, ydbl + 2, t + 2);
+        } else {
+            shading->getNonParametrizedTriangle(i, bitmapMode, xdbl + 0, ydbl + 0, color[0], xdbl + 1, ydbl + 1, color[1], xdbl + 2, ydbl + 2, color[2]);
+            flat = splashColorEqual(color[0], color[1]) && splashColorEqual(color[0], color[2]);
+            if (!flat && !shading->canInterpolateDeviceColors()) {
+                return false;
             }
-            // first three are sorted
-            assert(y[0] <= y[1]);
-            assert(y[1] <= y[2]);
-            /////
-
-            // this here is det( T ) == 0
-            // where T is the matrix to map to barycentric coordinates.
-            {
-                int x02diff;
-                if (checkedSubtraction(x[0], x[2], &x02diff)) {
-                    continue;
-                }
-                int y12diff;
-                if (checkedSubtraction(y[1], y[2], &y12diff)) {
-                    continue;
-                }
-                int x12diff;
-                if (checkedSubtraction(x[1], x[2], &x12diff)) {
-                    continue;
-                }
-                int y02diff;
-                if (checkedSubtraction(y[0], y[2], &y02diff)) {
-                    continue;
-                }
+        }
 
-                int x02diffY12diff;
-                if (checkedMultiply(x02diff, y12diff, &x02diffY12diff)) {
-                    continue;
-                }
-                int x12diffY02diff;
-                if (checkedMultiply(x12diff, y02diff, &x12diffY02diff)) {
-                    continue;
-                }
+        // we operate on scanlines which are integer offsets into the
+        // raster image. The double offsets are of no use here.
+        int x[3], y[3];
+        for (int m = 0; m < 3; ++m) {
+            x[m] = splashRound(xdbl[m] * userToCanvasMatrix[0] + ydbl[m] * userToCanvasMatrix[2] + userToCanvasMatrix[4]);
+            y[m] = splashRound(xdbl[m] * userToCanvasMatrix[1] + ydbl[m] * userToCanvasMatrix[3] + userToCanvasMatrix[5]);
+        }
 
-                if (x02diffY12diff - x12diffY02diff == 0) {
-                    continue; // degenerate triangle.
-                }
+        // sort according to y coordinate to simplify sweep through
+        // scanlines (stable insertion sort)
+        int order[3] = { 0, 1, 2 };
+        if (y[order[0]] > y[order[1]]) {
+            std::swap(order[0], order[1]);
+        }
+        if (y[order[1]] > y[order[2]]) {
+            std::swap(order[1], order[2]);
+            if (y[order[0]] > y[order[1]]) {
+                std::swap(order[0], order[1]);
             }
+        }
 
-            // this here initialises the scanline generation.
-            // We start with low Y coordinates and sweep up to the large Y
-            // coordinates.
-            //
-            // scanEdgeL[m] in {0,1,2} m=0,1
-            // scanEdgeR[m] in {0,1,2} m=0,1
-            //
-            // are the two edges between which scanlines are (currently)
-            // sweeped. The values {0,1,2} are indices into 'x' and 'y'.
-            // scanEdgeL[0] = 0 means: the left scan edge has (x[0],y[0]) as vertex.
-            //
-            scanEdgeL[0] = 0;
-            scanEdgeR[0] = 0;
-            if (y[0] == y[1]) {
-                scanEdgeL[0] = 1;
-                scanEdgeL[1] = scanEdgeR[1] = 2;
-
-            } else {
-                scanEdgeL[1] = 1;
-                scanEdgeR[1] = 2;
-            }
-            assert(y[scanEdgeL[0]] < y[scanEdgeL[1]]);
-            assert(y[scanEdgeR[0]] < y[scanEdgeR[1]]);
-
-            // Ok. Now prepare the linear maps which map the y coordinate of
-            // the current scanline to the corresponding LEFT and RIGHT x
-            // coordinate (which define the scanline).
-            scanLimitMapL[0] = static_cast<double>(x[scanEdgeL[1]] - x[scanEdgeL[0]]) / (y[scanEdgeL[1]] - y[scanEdgeL[0]]);
-            scanLimitMapL[1] = x[scanEdgeL[0]] - y[scanEdgeL[0]] * scanLimitMapL[0];
-            scanLimitMapR[0] = static_cast<double>(x[scanEdgeR[1]] - x[scanEdgeR[0]]) / (y[scanEdgeR[1]] - y[scanEdgeR[0]]);
-            scanLimitMapR[1] = x[scanEdgeR[0]] - y[scanEdgeR[0]] * scanLimitMapR[0];
-
-            xa = y[1] * scanLimitMapL[0] + scanLimitMapL[1];
-            xt = y[1] * scanLimitMapR[0] + scanLimitMapR[1];
-            if (xa > xt) {
-                // I have "left" is to the right of "right".
-                // Exchange sides!
-                Guswap(scanEdgeL[0], scanEdgeR[0]);
-                Guswap(scanEdgeL[1], scanEdgeR[1]);
-                Guswap(scanLimitMapL[0], scanLimitMapR[0]);
-                Guswap(scanLimitMapL[1], scanLimitMapR[1]);
-                // FIXME I'm sure there is a more efficient way to check this.
-            }
-
-            // Same game: we can linearly interpolate the color based on the
-            // current y coordinate (that's correct for triangle
-            // interpolation due to linearity. We could also have done it in
-            // barycentric coordinates, but that's slightly more involved)
-            scanColorMapL[0] = (color[scanEdgeL[1]] - color[scanEdgeL[0]]) / (y[scanEdgeL[1]] - y[scanEdgeL[0]]);
-            scanColorMapL[1] = color[scanEdgeL[0]] - y[scanEdgeL[0]] * scanColorMapL[0];
-            scanColorMapR[0] = (color[scanEdgeR[1]] - color[scanEdgeR[0]]) / (y[scanEdgeR[1]] - y[scanEdgeR[0]]);
-            scanColorMapR[1] = color[scanEdgeR[0]] - y[scanEdgeR[0]] * scanColorMapR[0];
-
-            bool hasFurtherSegment = (y[1] < y[2]);
-            int scanLineOff = y[0] * rowSize;
-
-            for (int Y = y[0]; Y <= y[2]; ++Y, scanLineOff += rowSize) {
-                if (hasFurtherSegment && Y == y[1]) {
-                    // SWEEP EVENT: we encountered the next segment.
-                    //
-                    // switch to next segment, either at left end or at right
-                    // end:
-                    if (scanEdgeL[1] == 1) {
-                        scanEdgeL[0] = 1;
-                        scanEdgeL[1] = 2;
-                        scanLimitMapL[0] = static_cast<double>(x[scanEdgeL[1]] - x[scanEdgeL[0]]) / (y[scanEdgeL[1]] - y[scanEdgeL[0]]);
-                        scanLimitMapL[1] = x[scanEdgeL[0]] - y[scanEdgeL[0]] * scanLimitMapL[0];
-
-                        scanColorMapL[0] = (color[scanEdgeL[1]] - color[scanEdgeL[0]]) / (y[scanEdgeL[1]] - y[scanEdgeL[0]]);
-                        scanColorMapL[1] = color[scanEdgeL[0]] - y[scanEdgeL[0]] * scanColorMapL[0];
-                    } else if (scanEdgeR[1] == 1) {
-                        scanEdgeR[0] = 1;
-                        scanEdgeR[1] = 2;
-                        scanLimitMapR[0] = static_cast<double>(x[scanEdgeR[1]] - x[scanEdgeR[0]]) / (y[scanEdgeR[1]] - y[scanEdgeR[0]]);
-                        scanLimitMapR[1] = x[scanEdgeR[0]] - y[scanEdgeR[0]] * scanLimitMapR[0];
-
-                        scanColorMapR[0] = (color[scanEdgeR[1]] - color[scanEdgeR[0]]) / (y[scanEdgeR[1]] - y[scanEdgeR[0]]);
-                        scanColorMapR[1] = color[scanEdgeR[0]] - y[scanEdgeR[0]] * scanColorMapR[0];
-                    }
-                    assert(y[scanEdgeL[0]] < y[scanEdgeL[1]]);
-                    assert(y[scanEdgeR[0]] < y[scanEdgeR[1]]);
-                    hasFurtherSegment = false;
-                }
-
-                yt = Y;
-
-                xa = yt * scanLimitMapL[0] + scanLimitMapL[1];
-                xt = yt * scanLimitMapR[0] + scanLimitMapR[1];
-
-                const double ca = yt * scanColorMapL[0] + scanColorMapL[1];
-                const double ct = yt * scanColorMapR[0] + scanColorMapR[1];
-
-                const int scanLimitL = splashRound(xa);
-                const int scanLimitR = splashRound(xt);
-
-                // Ok. Now: init the color interpolation depending on the X
-                // coordinate inside of the current scanline:
-                const double scanColorMap0 = (scanLimitR == scanLimitL) ? 0. : ((ct - ca) / (scanLimitR - scanLimitL));
-                const double scanColorMap1 = ca - scanLimitL * scanColorMap0;
-
-                // handled by clipping:
-                // assert( scanLimitL >= 0 && scanLimitR < bitmap->getWidth() );
-                assert(scanLimitL <= scanLimitR || abs(scanLimitL - scanLimitR) <= 2); // allow rounding inaccuracies
-                assert(scanLineOff == Y * rowSize);
-
-                double colorinterp = scanColorMap0 * scanLimitL + scanColorMap1;
-
-                int bitmapOff = scanLineOff + scanLimitL * colorComps;
-                if (likely(bitmapOff >= 0)) {
-                    for (int X = scanLimitL; X <= scanLimitR && bitmapOff + colorComps <= bitmapOffLimit; ++X, colorinterp += scanColorMap0, bitmapOff += colorComps) {
-                        // FIXME : standard rectangular clipping can be done for a
-                        // complete scanline which is faster
-                        // --> see SplashClip and its methods
-                        if (!clip.test(X, Y)) {
-                            continue;
-                        }
-
-                        assert(fabs(colorinterp - (scanColorMap0 * X + scanColorMap1)) < 1e-7);
-                        assert(bitmapOff == Y * rowSize + colorComps * X && scanLineOff == Y * rowSize);
-
-                        shading->getParameterizedColor(colorinterp, bitmapMode, &bitmapData[bitmapOff]);
-
-                        // make the shading visible.
-                        // Note that opacity is handled by the bDirectBlit stuff, see
-                        // above for comments and below for implementation.
-                        if (hasAlpha) {
-                            bitmapAlpha[Y * bitmapWidth + X] = 255;
-                        }
-                    }
+        SplashMeshTriangle tri;
+        tri.flat = flat;
+        for (int m = 0; m < 3; ++m) {
+            tri.x[m] = x[order[m]];
+            tri.y[m] = y[order[m]];
+            tri.t[m] = t[order[m]];
+            if (!parameterized) {
+                for (int k = 0; k < colorComps; ++k) {
+                    tri.color[m][k] = color[order[m]][k];
                 }
             }
         }
-    } else {
-        SplashColor color, auxColor1, auxColor2;
-        double scanLimitMapL[2] = { 0., 0. };
-        double scanLimitMapR[2] = { 0., 0. };
-        int scanEdgeL[2] = { 0, 0 };
-        int scanEdgeR[2] = { 0, 0 };
-
-        for (int i = 0; i < shading->getNTriangles(); ++i) {
-            // Sadly this current algorithm only supports shadings where the three triangle vertices have the same color
-            shading->getNonParametrizedTriangle(i, bitmapMode, xdbl + 0, ydbl + 0, reinterpret_cast<SplashColorPtr>(&color), xdbl + 1, ydbl + 1, reinterpret_cast<SplashColorPtr>(&auxColor1), xdbl + 2, ydbl + 2,
-                                                reinterpret_cast<SplashColorPtr>(&auxColor2));
-            if (!splashColorEqual(color, auxColor1) || !splashColorEqual(color, auxColor2)) {
-                if (!bDirectBlit) {
-                    delete blitTarget;
-                }
-                return false;
-            }
-            for (int m = 0; m < 3; ++m) {
-                xt = xdbl[m] * userToCanvasMatrix[0] + ydbl[m] * userToCanvasMatrix[2] + userToCanvasMatrix[4];
-                yt = xdbl[m] * userToCanvasMatrix[1] + ydbl[m] * userToCanvasMatrix[3] + userToCanvasMatrix[5];
-                xdbl[m] = xt;
-                ydbl[m] = yt;
-                // we operate on scanlines which are integer offsets into the
-                // raster image. The double offsets are of no use here.
-                x[m] = splashRound(xt);
-                y[m] = splashRound(yt);
-            }
-            // sort according to y coordinate to simplify sweep through scanlines:
-            // INSERTION SORT.
-            if (y[0] > y[1]) {
-                Guswap(x[0], x[1]);
-                Guswap(y[0], y[1]);
-            }
-            // first two are sorted.
-            assert(y[0] <= y[1]);
-            if (y[1] > y[2]) {
-                const int tmpX = x[2];
-                const int tmpY = y[2];
-                x[2] = x[1];
-                y[2] = y[1];
-
-                if (y[0] > tmpY) {
-                    x[1] = x[0];
-                    y[1] = y[0];
-                    x[0] = tmpX;
-                    y[0] = tmpY;
-                } else {
-                    x[1] = tmpX;
-                    y[1] = tmpY;
-                }
-            }
-            // first three are sorted
-            assert(y[0] <= y[1]);
-            assert(y[1] <= y[2]);
-            /////
 
-            // this here is det( T ) == 0
-            // where T is the matrix to map to barycentric coordinates.
-            if ((x[0] - x[2]) * (y[1] - y[2]) - (x[1] - x[2]) * (y[0] - y[2]) == 0) {
+        // this here is det( T ) == 0
+        // where T is the matrix to map to barycentric coordinates.
+        {
+            int x02diff, y12diff, x12diff, y02diff, x02diffY12diff, x12diffY02diff;
+            if (checkedSubtraction(tri.x[0], tri.x[2], &x02diff) || checkedSubtraction(tri.y[1], tri.y[2], &y12diff) || checkedSubtraction(tri.x[1], tri.x[2], &x12diff) || checkedSubtraction(tri.y[0], tri.y[2], &y02diff)
+                || checkedMultiply(x02diff, y12diff, &x02diffY12diff) || checkedMultiply(x12diff, y02diff, &x12diffY02diff)) {
+                continue;
+            }
+            if (x02diffY12diff - x12diffY02diff == 0) {
                 continue; // degenerate triangle.
             }
+        }
 
-            // this here initialises the scanline generation.
-            // We start with low Y coordinates and sweep up to the large Y
-            // coordinates.
-            //
-            // scanEdgeL[m] in {0,1,2} m=0,1
-            // scanEdgeR[m] in {0,1,2} m=0,1
-            //
-            // are the two edges between which scanlines are (currently)
-            // sweeped. The values {0,1,2} are indices into 'x' and 'y'.
-            // scanEdgeL[0] = 0 means: the left scan edge has (x[0],y[0]) as vertex.
-            //
-            scanEdgeL[0] = 0;
-            scanEdgeR[0] = 0;
-            if (y[0] == y[1]) {
-                scanEdgeL[0] = 1;
-                scanEdgeL[1] = scanEdgeR[1] = 2;
-
-            } else {
-                scanEdgeL[1] = 1;
-                scanEdgeR[1] = 2;
-            }
-            assert(y[scanEdgeL[0]] < y[scanEdgeL[1]]);
-            assert(y[scanEdgeR[0]] < y[scanEdgeR[1]]);
-
-            // Ok. Now prepare the linear maps which map the y coordinate of
-            // the current scanline to the corresponding LEFT and RIGHT x
-            // coordinate (which define the scanline).
-            scanLimitMapL[0] = static_cast<double>(x[scanEdgeL[1]] - x[scanEdgeL[0]]) / (y[scanEdgeL[1]] - y[scanEdgeL[0]]);
-            scanLimitMapL[1] = x[scanEdgeL[0]] - y[scanEdgeL[0]] * scanLimitMapL[0];
-            scanLimitMapR[0] = static_cast<double>(x[scanEdgeR[1]] - x[scanEdgeR[0]]) / (y[scanEdgeR[1]] - y[scanEdgeR[0]]);
-            scanLimitMapR[1] = x[scanEdgeR[0]] - y[scanEdgeR[0]] * scanLimitMapR[0];
-
-            xa = y[1] * scanLimitMapL[0] + scanLimitMapL[1];
-            xt = y[1] * scanLimitMapR[0] + scanLimitMapR[1];
-            if (xa > xt) {
-                // I have "left" is to the right of "right".
-                // Exchange sides!
-                Guswap(scanEdgeL[0], scanEdgeR[0]);
-                Guswap(scanEdgeL[1], scanEdgeR[1]);
-                Guswap(scanLimitMapL[0], scanLimitMapR[0]);
-                Guswap(scanLimitMapL[1], scanLimitMapR[1]);
-                // FIXME I'm sure there is a more efficient way to check this.
-            }
-
-            bool hasFurtherSegment = (y[1] < y[2]);
-            int scanLineOff = y[0] * rowSize;
-
-            for (int Y = y[0]; Y <= y[2]; ++Y, scanLineOff += rowSize) {
-                if (hasFurtherSegment && Y == y[1]) {
-                    // SWEEP EVENT: we encountered the next segment.
-                    //
-                    // switch to next segment, either at left end or at right
-                    // end:
-                    if (scanEdgeL[1] == 1) {
-                        scanEdgeL[0] = 1;
-                        scanEdgeL[1] = 2;
-                        scanLimitMapL[0] = static_cast<double>(x[scanEdgeL[1]] - x[scanEdgeL[0]]) / (y[scanEdgeL[1]] - y[scanEdgeL[0]]);
-                        scanLimitMapL[1] = x[scanEdgeL[0]] - y[scanEdgeL[0]] * scanLimitMapL[0];
-                    } else if (scanEdgeR[1] == 1) {
-                        scanEdgeR[0] = 1;
-                        scanEdgeR[1] = 2;
-                        scanLimitMapR[0] = static_cast<double>(x[scanEdgeR[1]] - x[scanEdgeR[0]]) / (y[scanEdgeR[1]] - y[scanEdgeR[0]]);
-                        scanLimitMapR[1] = x[scanEdgeR[0]] - y[scanEdgeR[0]] * scanLimitMapR[0];
-                    }
-                    assert(y[scanEdgeL[0]] < y[scanEdgeL[1]]);
-                    assert(y[scanEdgeR[0]] < y[scanEdgeR[1]]);
-                    hasFurtherSegment = false;
-                }
-
-                yt = Y;
-
-                xa = yt * scanLimitMapL[0] + scanLimitMapL[1];
-                xt = yt * scanLimitMapR[0] + scanLimitMapR[1];
-
-                const int scanLimitL = splashRound(xa);
-                const int scanLimitR = splashRound(xt);
-
-                // handled by clipping:
-                // assert( scanLimitL >= 0 && scanLimitR < bitmap->getWidth() );
-                assert(scanLimitL <= scanLimitR || abs(scanLimitL - scanLimitR) <= 2); // allow rounding inaccuracies
-                assert(scanLineOff == Y * rowSize);
-
-                int bitmapOff = scanLineOff + scanLimitL * colorComps;
-                if (likely(bitmapOff >= 0)) {
-                    for (int X = scanLimitL; X <= scanLimitR && bitmapOff + colorComps <= bitmapOffLimit; ++X, bitmapOff += colorComps) {
-                        // FIXME : standard rectangular clipping can be done for a
-                        // complete scanline which is faster
-                        // --> see SplashClip and its methods
-                        if (!clip.test(X, Y)) {
-                            continue;
-                        }
+        if (parameterized) {
+            if (triangles.empty()) {
+                tMin = tMax = tri.t[0];
+            }
+            tMin = std::min({ tMin, tri.t[0], tri.t[1], tri.t[2] });
+            tMax = std::max({ tMax, tri.t[0], tri.t[1], tri.t[2] });
+        }
+        xMin = std::min({ xMin, tri.x[0], tri.x[1], tri.x[2] });
+        xMax = std::max({ xMax, tri.x[0], tri.x[1], tri.x[2] });
+        yMin = std::min(yMin, tri.y[0]);
+        yMax = std::max(yMax, tri.y[2]);
+        triangles.push_back(tri);
+    }
 
-                        assert(bitmapOff == Y * rowSize + colorComps * X && scanLineOff == Y * rowSize);
+    xMin = std::max(xMin, clip.getXMinI());
+    yMin = std::max(yMin, clip.getYMinI());
+    xMax = std::min(xMax, clip.getXMaxI());
+    yMax = std::min(yMax, clip.getYMaxI());
+    if (triangles.empty() || xMin > xMax || yMin > yMax) {
+        return true;
+    }
+    const int w = xMax - xMin + 1;
+    const int h = yMax - yMin + 1;
 
-                        for (int k = 0; k < colorComps; ++k) {
-                            bitmapData[bitmapOff + k] = color[k];
-                        }
+    // idea:
+    // 1. If pipe->noTransparency && !state->blendFunc
+    //  -> blit directly into the drawing surface!
+    //  This also works with vector antialiasing as long as the clip has
+    //  no paths: the clip rectangle has already been applied, and the
+    //  pipe doesn't use the shape.
+    // 2. Otherwise:
+    // - blit into an intermediate surface covering the bounding box of
+    // the shading. Afterwards, blit the intermediate surface using the
+    // drawing pipeline.
+    // This is necessary because triangle elements can be on top of each
+    // other, so the complete shading needs to be drawn before opacity is
+    // applied.
+    // Mono1 bitmaps always use an intermediate Mono8 surface, so that the
+    // pipeline can do the halftoning.
+    const bool overprint = state->fillOverprint && (bitmapMode == splashModeCMYK8 || bitmapMode == splashModeDeviceN8);
+    const bool bDirectBlit = (!vectorAntialias || clip.getNumPaths() == 0) && pipe.noTransparency && !state->blendFunc && !overprint && bitmapMode != splashModeMono1;
+    SplashMeshRasterizer raster;
+    std::unique_ptr<SplashBitmap> blitTarget;
+    if (bDirectBlit) {
+        raster.data = bitmap->getDataPtr();
+        raster.rowSize = bitmap->getRowSize();
+        raster.alpha = bitmap->getAlphaPtr();
+        raster.alphaRowSize = bitmap->getWidth();
+        raster.xOff = raster.yOff = 0;
+    } else {
+        blitTarget = std::make_unique<SplashBitmap>(w, h, 1, bitmapMode == splashModeMono1 ? splashModeMono8 : bitmapMode, true);
+        if (!blitTarget->getDataPtr() || !blitTarget->getAlphaPtr()) {
+            return false;
+        }
+        memset(blitTarget->getAlphaPtr(), 0, static_cast<size_t>(w) * h);
+        raster.data = blitTarget->getDataPtr();
+        raster.rowSize = blitTarget->getRowSize();
+        raster.alpha = blitTarget->getAlphaPtr();
+        raster.alphaRowSize = w;
+        raster.xOff = xMin;
+        raster.yOff = yMin;
+    }
+    raster.colorComps = colorComps;
+    raster.clip = &clip;
+    raster.parameterized = parameterized;
+
+    // parameterized shadings look their colors up in a table covering
+    // the range of the parameter
+    std::unique_ptr<SplashColor[]> colorTable;
+    if (parameterized) {
+        const int tableSize = static_cast<int>(std::clamp(static_cast<double>(w) * h, 2., static_cast<double>(splashMeshColorTableSize)));
+        colorTable.reset(new SplashColor[tableSize]());
+        for (int i = 0; i < tableSize; ++i) {
+            shading->getParameterizedColor(tMin + (tMax - tMin) * i / (tableSize - 1), bitmapMode, colorTable[i]);
+        }
+        raster.colorTable = colorTable.get();
+        raster.colorTableSize = tableSize;
+        raster.colorTableT0 = tMin;
+        raster.colorTableScale = (tMax > tMin) ? (tableSize - 1) / (tMax - tMin) : 0;
+    } else {
+        raster.colorTable = nullptr;
+        raster.colorTableSize = 0;
+        raster.colorTableT0 = raster.colorTableScale = 0;
+    }
+
+    // sort the triangles into bands of scanlines
+    const int nBands = (h - 1) / splashMeshBandHeight + 1;
+    std::vector<std::vector<int>> bands(nBands);
+    double pixels = 0;
+    for (size_t i = 0; i < triangles.size(); ++i) {
+        const SplashMeshTriangle &tri = triangles[i];
+        const int ty0 = std::max(tri.y[0], yMin);
+        const int ty1 = std::min(tri.y[2], yMax);
+        if (ty0 > ty1) {
+            continue;
+        }
+        for (int b = (ty0 - yMin) / splashMeshBandHeight; b <= (ty1 - yMin) / splashMeshBandHeight; ++b) {
+            bands[b].push_back(static_cast<int>(i));
+        }
+        pixels += static_cast<double>(std::max({ tri.x[0], tri.x[1], tri.x[2] }) - std::min({ tri.x[0], tri.x[1], tri.x[2] }) + 1) * (ty1 - ty0 + 1);
+    }
 
-                        // make the shading visible.
-                        // Note that opacity is handled by the bDirectBlit stuff, see
-                        // above for comments and below for implementation.
-                        if (hasAlpha) {
-                            bitmapAlpha[Y * bitmapWidth + X] = 255;
-                        }
-                    }
-                }
+    // the bands don't overlap, so they can be rasterized in parallel;
+    // within a band the triangles are drawn in mesh order
+    std::atomic<int> nextBand = 0;
+    auto rasterizeBands = [&]() {
+        int b;
+        while ((b = nextBand++) < nBands) {
+            const int bandYMin = yMin + b * splashMeshBandHeight;
+            const int bandYMax = std::min(bandYMin + splashMeshBandHeight - 1, yMax);
+            for (int i : bands[b]) {
+                raster.fillTriangle(triangles[i], bandYMin, bandYMax);
             }
         }
+    };
+    const int nThreads = static_cast<int>(std::min({ static_cast<double>(shadingThreads), static_cast<double>(nBands), pixels / splashMeshMinPixelsPerThread }));
+    std::vector<std::thread> threads;
+    for (int i = 1; i < nThreads; ++i) {
+        threads.emplace_back(rasterizeBands);
+    }
+    rasterizeBands();
+    for (std::thread &thread : threads) {
+        thread.join();
     }
 
     if (!bDirectBlit) {
         // ok. Finalize the stuff by blitting the shading into the final
         // geometry, this time respecting the rendering pipe.
-        const int W = blitTarget->getWidth();
-        const int H = blitTarget->getHeight();
-        SplashColorPtr cur = cSrcVal;
-
-        for (int X = 0; X < W; ++X) {
-            for (int Y = 0; Y < H; ++Y) {
-                if (!bitmapAlpha[Y * bitmapWidth + X]) {
+        const SplashColorPtr blitData = blitTarget->getDataPtr();
+        const unsigned char *blitAlpha = blitTarget->getAlphaPtr();
+        const int blitRowSize = blitTarget->getRowSize();
+
+        // without clip paths, every pixel of the intermediate surface is
+        // inside of the clip rectangle, so the rows can be run through
+        // the pipe directly
+        const bool clipPaths = clip.getNumPaths() > 0;
+        for (int Y = yMin; Y <= yMax; ++Y) {
+            const unsigned char *alphaRow = blitAlpha + static_cast<size_t>(Y - yMin) * w;
+            const SplashColorPtr dataRow = blitData + static_cast<size_t>(Y - yMin) * blitRowSize;
+            if (!clipPaths && pipe.run == &Splash::pipeRunSimpleMono1) {
+                // halftone each run of covered pixels at once
+                int X = xMin;
+                while (X <= xMax) {
+                    while (X <= xMax && !alphaRow[X - xMin]) {
+                        ++X;
+                    }
+                    const int X0 = X;
+                    while (X <= xMax && alphaRow[X - xMin]) {
+                        ++X;
+                    }
+                    if (X > X0) {
+                        halftoneSpan(X0, Y, X - X0, dataRow + (X0 - xMin));
+                    }
+                }
+                continue;
+            }
+            if (!clipPaths) {
+                pipeSetXY(&pipe, xMin, Y);
+            }
+            for (int X = xMin; X <= xMax; ++X) {
+                if (!alphaRow[X - xMin]) {
+                    if (!clipPaths) {
+                        pipeIncX(&pipe);
+                    }
                     continue; // draw only parts of the shading!
                 }
-                const int bitmapOff = Y * rowSize + colorComps * X;
-
                 for (int m = 0; m < colorComps; ++m) {
-                    cur[m] = bitmapData[bitmapOff + m];
+                    cSrcVal[m] = dataRow[(X - xMin) * colorComps + m];
                 }
-                if (vectorAntialias) {
+                if (!clipPaths) {
+                    (this->*pipe.run)(&pipe);
+                } else if (vectorAntialias) {
                     drawAAPixel(&pipe, X, Y);
                 } else {
                     drawPixel(&pipe, X, Y, true); // no clipping - has already been done.
                 }
             }
         }
-
-        delete blitTarget;
-        blitTarget = nullptr;
     }
 
     return true;
@@ -6110,8 +6215,16 @@ std::unique_ptr<SplashPath> Splash::makeStrokePath(const SplashPath &path, doubl
         ;
     }
 
-    // Estimate size, reserve
-    pathOut->reserve(pathIn->length * 4 + 4);
+    // Reserve the output: each segment adds a rectangle (5 points) and
+    // a join (at most 5 points, or 9 for a round join), and with stroke
+    // adjustment up to 3 hints
+    const int ptsPerSeg = state->lineJoin == SplashLineJoin::Round ? 14 : 10;
+    if (pathIn->length < INT_MAX / ptsPerSeg - 1) {
+        pathOut->reserve((pathIn->length + 1) * ptsPerSeg);
+        if (state->strokeAdjust) {
+            pathOut->reserveHints((pathIn->length + 1) * 3);
+        }
+    }
 
     while (i1 < pathIn->length) {
         if ((first = pathIn->flags[i0] & splashPathFirst)) {
@@ -6513,6 +6626,26 @@ SplashError Splash::shadedFill(const SplashPath &path, bool hasBBox, const Splas
         unsigned char alpha = splashRound(clipToStrokePath ? state->strokeAlpha * 255 : state->fillAlpha * 255);
         pipeInit(&pipe, 0, yMinI, &pattern, nullptr, alpha, vectorAntialias && !hasBBox, false);
 
+        // the pattern colors are computed for a whole span at a time
+        // when the pattern can do that faster than pixel by pixel
+        std::unique_ptr<SplashColor[]> spanColors;
+        std::vector<unsigned char> spanInside;
+        if (!pattern.isStatic() && pattern.hasColorSpan()) {
+            spanColors.reset(new SplashColor[bitmap->width]);
+            spanInside.resize(bitmap->width);
+        }
+        auto setupSpan = [&](int spanX0, int spanX1, int spanY) {
+            if (spanColors && spanX0 >= 0 && spanX0 <= spanX1 && spanX1 < bitmap->width) {
+                pattern.getColorSpan(spanX0, spanX1, spanY, spanColors.get(), spanInside.data());
+                pipe.spanColors = spanColors.get();
+                pipe.spanInside = spanInside.data();
+                pipe.spanX0 = spanX0;
+            } else {
+                pipe.spanColors = nullptr;
+                pipe.cSrc = pipe.cSrcVal;
+            }
+        };
+
         // draw the spans
         if (vectorAntialias) {
             for (y = yMinI; y <= yMaxI; ++y) {
@@ -6575,6 +6708,7 @@ SplashError Splash::shadedFill(const SplashPath &path, bool hasBBox, const Splas
                     }
                 }
 #endif
+                setupSpan(x0, x1, y);
                 drawAALine(&pipe, x0, x1, y);
             }
         } else {
@@ -6583,6 +6717,7 @@ SplashError Splash::shadedFill(const SplashPath &path, bool hasBBox, const Splas
                 SplashXPathScanIterator iterator(scanner, y);
                 while (iterator.getNextSpan(&x0, &x1)) {
                     if (clipRes == splashClipAllInside) {
+                        setupSpan(x0, x1, y);
                         drawSpan(&pipe, x0, x1, y, true);
                     } else {
                         // limit the x range
@@ -6593,6 +6728,7 @@ SplashError Splash::shadedFill(const SplashPath &path, bool hasBBox, const Splas
                             x1 = state->clip->getXMaxI();
                         }
                         clipRes2 = state->clip->testSpan(x0, x1, y);
+                        setupSpan(x0, x1, y);
                         drawSpan(&pipe, x0, x1, y, clipRes2 == splashClipAllInside);
                     }
                 }
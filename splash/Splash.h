@@ -164,6 +164,9 @@ public:
     // Draw a character, using the current fill pattern.
     SplashError fillChar(double x, double y, int c, SplashFont *font);
 
+    // Same as fillChar, but (<xt>, <yt>) is already in device space.
+    SplashError fillCharDevice(double xt, double yt, int c, SplashFont *font);
+
     // Draw a glyph, using the current fill pattern.  This function does
     // not free any data, i.e., it ignores glyph->freeData.
     void fillGlyph(double x, double y, SplashGlyphBitmap *glyph);
@@ -237,6 +240,18 @@ public:
     void setThinLineMode(SplashThinLineMode thinLineModeA) { thinLineMode = thinLineModeA; }
     SplashThinLineMode getThinLineMode() { return thinLineMode; }
 
+    // Setter/Getter for exact area coverage anti-aliasing of vector
+    // fills (instead of 4x4 supersampling); only used if vector
+    // anti-aliasing is enabled
+    void setAnalyticAntialias(bool analyticAntialiasA) { analyticAntialias = analyticAntialiasA; }
+    bool getAnalyticAntialias() const { return analyticAntialias; }
+
+    // Setter/Getter for the max number of threads used to rasterize a
+    // Gouraud shaded mesh; the default is 1, which draws it in the
+    // calling thread
+    void setShadingThreads(int shadingThreadsA) { shadingThreads = shadingThreadsA > 1 ? shadingThreadsA : 1; }
+    int getShadingThreads() const { return shadingThreads; }
+
     // Get clipping status for the last drawing operation subject to
     // clipping.
     SplashClipResult getClipRes() { return opClipRes; }
@@ -281,15 +296,17 @@ private:
     void drawAAPixelInit();
     void drawAAPixel(SplashPipe *pipe, int x, int y);
     void drawSpan(SplashPipe *pipe, int x0, int x1, int y, bool noClip);
+    void halftoneSpan(int x, int y, int n, const unsigned char *values);
     void drawAALine(SplashPipe *pipe, int x0, int x1, int y, bool adjustLine = false, unsigned char lineOpacity = 0);
     static void transform(const std::array<double, 6> &matrix, double xi, double yi, double *xo, double *yo);
     void strokeNarrow(const SplashPath &path);
     void strokeWide(const SplashPath &path, double w);
     static std::unique_ptr<SplashPath> flattenPath(const SplashPath &path, const std::array<double, 6> &matrix, double flatness);
-    static void flattenCurve(double x0, double y0, double x1, double y1, double x2, double y2, double x3, double y3, const std::array<double, 6> &matrix, double flatness2, SplashPath *fPath);
+    static void flattenCurve(double x0, double y0, double x1, double y1, double x2, double y2, double x3, double y3, const std::array<double, 6> &matrix, double flatness, SplashPath *fPath);
     std::unique_ptr<SplashPath> makeDashedPath(const SplashPath &xPath);
     void getBBoxFP(const SplashPath &path, double *xMinA, double *yMinA, double *xMaxA, double *yMaxA);
     SplashError fillWithPattern(SplashPath *path, bool eo, SplashPattern *pattern, double alpha);
+    bool fillWithCoverage(const SplashXPath &xPath, bool eo, SplashPattern *pattern, double alpha);
     bool pathAllOutside(const SplashPath &path);
     void fillGlyph2(int x0, int y0, SplashGlyphBitmap *glyph, bool noclip);
     void arbitraryTransformMask(SplashImageMaskSource src, void *srcData, int srcWidth, int srcHeight, const std::array<double, 6> &mat, bool glyphMode);
@@ -299,6 +316,7 @@ private:
     static void scaleMaskYupXdown(SplashImageMaskSource src, void *srcData, int srcWidth, int srcHeight, int scaledWidth, int scaledHeight, SplashBitmap *dest);
     static void scaleMaskYupXup(SplashImageMaskSource src, void *srcData, int srcWidth, int srcHeight, int scaledWidth, int scaledHeight, SplashBitmap *dest);
     void blitMask(const SplashBitmap &src, int xDest, int yDest, SplashClipResult clipRes);
+    bool blitMaskSolid(const SplashBitmap &src, int xDest, int yDest, SplashPipe *pipe);
     SplashError arbitraryTransformImage(SplashImageSource src, SplashICCTransform tf, void *srcData, SplashColorMode srcMode, int nComps, bool srcAlpha, int srcWidth, int srcHeight, const std::array<double, 6> &mat, bool interpolate,
                                         bool tilingPattern = false);
     std::unique_ptr<SplashBitmap> scaleImage(SplashImageSource src, void *srcData, SplashColorMode srcMode, int nComps, bool srcAlpha, int srcWidth, int srcHeight, int scaledWidth, int scaledHeight, bool interpolate,
@@ -332,6 +350,8 @@ private:
     SplashBitmap *groupBackBitmap; // backdrop bitmap for knockout/non-isolated groups
     int groupBackX, groupBackY; // offset within groupBackBitmap
     bool vectorAntialias;
+    bool analyticAntialias;
+    int shadingThreads;
     bool inShading;
     bool debugMode;
 };
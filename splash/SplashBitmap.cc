@@ -39,6 +39,11 @@
 #include <cstring>
 #include <cstdlib>
 #include <climits>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
 #include "goo/gfile.h"
 #include "goo/gmem.h"
 #include "SplashErrorCodes.h"
@@ -180,6 +185,38 @@ SplashError SplashBitmap::writePNMFile(char *fileName)
 }
 
 SplashError SplashBitmap::writePNMFile(FILE *f)
+{
+    const SplashError e = writePNMHeader(f, mode, width, height);
+    if (e != SplashError::NoError) {
+        return e;
+    }
+    return writePNMRows(f);
+}
+
+SplashError SplashBitmap::writePNMHeader(FILE *f, SplashColorMode mode, int width, int height)
+{
+    switch (mode) {
+    case splashModeMono1:
+        fprintf(f, "P4\n%d %d\n", width, height);
+        break;
+    case splashModeMono8:
+        fprintf(f, "P5\n%d %d\n255\n", width, height);
+        break;
+    case splashModeRGB8:
+    case splashModeXBGR8:
+    case splashModeBGR8:
+        fprintf(f, "P6\n%d %d\n255\n", width, height);
+        break;
+    case splashModeCMYK8:
+    case splashModeDeviceN8:
+        // PNM doesn't support CMYK
+        error(errInternal, -1, "unsupported SplashBitmap mode");
+        return SplashError::Generic;
+    }
+    return SplashError::NoError;
+}
+
+SplashError SplashBitmap::writePNMRows(FILE *f)
 {
     SplashColorPtr row, p;
     int x, y;
@@ -187,7 +224,6 @@ SplashError SplashBitmap::writePNMFile(FILE *f)
     switch (mode) {
 
     case splashModeMono1:
-        fprintf(f, "P4\n%d %d\n", width, height);
         row = data;
         for (y = 0; y < height; ++y) {
             p = row;
@@ -200,7 +236,6 @@ SplashError SplashBitmap::writePNMFile(FILE *f)
         break;
 
     case splashModeMono8:
-        fprintf(f, "P5\n%d %d\n255\n", width, height);
         row = data;
         for (y = 0; y < height; ++y) {
             fwrite(row, 1, width, f);
@@ -209,7 +244,6 @@ SplashError SplashBitmap::writePNMFile(FILE *f)
         break;
 
     case splashModeRGB8:
-        fprintf(f, "P6\n%d %d\n255\n", width, height);
         row = data;
         for (y = 0; y < height; ++y) {
             fwrite(row, 1, 3 * width, f);
@@ -218,7 +252,6 @@ SplashError SplashBitmap::writePNMFile(FILE *f)
         break;
 
     case splashModeXBGR8:
-        fprintf(f, "P6\n%d %d\n255\n", width, height);
         row = data;
         for (y = 0; y < height; ++y) {
             p = row;
@@ -233,7 +266,6 @@ SplashError SplashBitmap::writePNMFile(FILE *f)
         break;
 
     case splashModeBGR8:
-        fprintf(f, "P6\n%d %d\n255\n", width, height);
         row = data;
         for (y = 0; y < height; ++y) {
             p = row;
@@ -352,7 +384,7 @@ SplashError SplashBitmap::writeImgFile(SplashImageFileFormat format, const char
     return e;
 }
 
-void SplashBitmap::setJpegParams(ImgWriter *writer, WriteImgParams *params)
+void SplashBitmap::setJpegParams(ImgWriter *writer, const WriteImgParams *params)
 {
 #if ENABLE_LIBJPEG
     if (params) {
@@ -369,15 +401,34 @@ void SplashBitmap::setJpegParams(ImgWriter *writer, WriteImgParams *params)
 }
 
 SplashError SplashBitmap::writeImgFile(SplashImageFileFormat format, FILE *f, double hDPI, double vDPI, WriteImgParams *params)
+{
+    SplashColorMode imageWriterFormat;
+    ImgWriter *writer = createImgWriter(format, mode, params, &imageWriterFormat);
+    if (!writer) {
+        return SplashError::Generic;
+    }
+
+    const SplashError e = writeImgFile(writer, f, hDPI, vDPI, imageWriterFormat);
+    delete writer;
+    return e;
+}
+
+ImgWriter *SplashBitmap::createImgWriter(SplashImageFileFormat format, SplashColorMode mode, const WriteImgParams *params, SplashColorMode *imageWriterFormat)
 {
     ImgWriter *writer;
 
-    SplashColorMode imageWriterFormat = splashModeRGB8;
+    *imageWriterFormat = splashModeRGB8;
 
     switch (format) {
 #if ENABLE_LIBPNG
     case splashFormatPng:
         writer = new PNGWriter();
+        if (params) {
+            if (params->pngCompressionLevel >= 0) {
+                static_cast<PNGWriter *>(writer)->setCompressionLevel(params->pngCompressionLevel);
+            }
+            static_cast<PNGWriter *>(writer)->setFilter(static_cast<PNGWriter::Filter>(params->pngFilter));
+        }
         break;
 #endif
 
@@ -399,11 +450,11 @@ SplashError SplashBitmap::writeImgFile(SplashImageFileFormat format, FILE *f, do
         switch (mode) {
         case splashModeMono1:
             writer = new TiffWriter(TiffWriter::MONOCHROME);
-            imageWriterFormat = splashModeMono1;
+            *imageWriterFormat = splashModeMono1;
             break;
         case splashModeMono8:
             writer = new TiffWriter(TiffWriter::GRAY);
-            imageWriterFormat = splashModeMono8;
+            *imageWriterFormat = splashModeMono8;
             break;
         case splashModeRGB8:
         case splashModeBGR8:
@@ -423,18 +474,17 @@ SplashError SplashBitmap::writeImgFile(SplashImageFileFormat format, FILE *f, do
         break;
 #else
         (void)params;
+        (void)mode;
 #endif
 
     default:
         // Not the greatest error message, but users of this function should
         // have already checked whether their desired format is compiled in.
         error(errInternal, -1, "Support for this image type not compiled in");
-        return SplashError::Generic;
+        return nullptr;
     }
 
-    const SplashError e = writeImgFile(writer, f, hDPI, vDPI, imageWriterFormat);
-    delete writer;
-    return e;
+    return writer;
 }
 
 #include "poppler/GfxState_helpers.h"
@@ -615,6 +665,109 @@ bool SplashBitmap::convertToXBGR(ConversionMode conversionMode)
     return newdata != nullptr;
 }
 
+// width of the pieces in which rows are dithered, in pixels (must be a
+// multiple of 8)
+static constexpr int ditherChunkWidth = 64;
+
+// minimum number of rows per dithering thread
+static constexpr int ditherMinRowsPerThread = 64;
+
+bool SplashBitmap::ditherToMono1(std::vector<int> *carry)
+{
+    if (mode != splashModeMono8 || (carry && carry->size() != static_cast<size_t>(width) + 2)) {
+        return false;
+    }
+
+    const int newRowSize = (width + 7) >> 3;
+    auto *newData = static_cast<SplashColorPtr>(gmallocn_checkoverflow(newRowSize, height));
+    if (newData == nullptr) {
+        return false;
+    }
+
+    // Row y can dither pixel x as soon as row y - 1 has diffused its
+    // error from pixels x - 1 .. x + 1, so the rows are processed by a
+    // pipeline of threads, each one following the row above it by a
+    // chunk.  The result is the same as dithering the rows in order.
+    // The errors (scaled by 16) diffused into the next row are kept in
+    // a ring of rows, one more than the number of rows in flight.
+    const int nThreads = std::clamp(static_cast<int>(std::thread::hardware_concurrency()), 1, std::max(1, height / ditherMinRowsPerThread));
+    const int nErrRows = nThreads + 1;
+    const int errRowSize = width + 2;
+    std::vector<int> errors(static_cast<size_t>(errRowSize) * nErrRows, 0);
+    if (carry) {
+        std::copy(carry->begin(), carry->end(), errors.begin());
+    }
+    std::unique_ptr<std::atomic<int>[]> progress(new std::atomic<int>[height]);
+    for (int y = 0; y < height; ++y) {
+        progress[y].store(0, std::memory_order_relaxed);
+    }
+
+    std::atomic<int> nextRow = 0;
+    auto ditherRows = [&]() {
+        int y;
+        while ((y = nextRow++) < height) {
+            const unsigned char *src = data + static_cast<ptrdiff_t>(y) * rowSize;
+            unsigned char *dest = newData + static_cast<size_t>(y) * newRowSize;
+            const int *errIn = &errors[static_cast<size_t>(y % nErrRows) * errRowSize + 1];
+            int *errOut = &errors[static_cast<size_t>((y + 1) % nErrRows) * errRowSize + 1];
+            std::fill(errOut - 1, errOut + width + 1, 0);
+            int errRight = 0;
+            for (int x0 = 0; x0 < width; x0 += ditherChunkWidth) {
+                const int x1 = std::min(x0 + ditherChunkWidth, width);
+                if (y > 0) {
+                    const int needed = std::min(x1 + 1, width);
+                    while (progress[y - 1].load(std::memory_order_acquire) < needed) {
+                        std::this_thread::yield();
+                    }
+                }
+                for (int x = x0; x < x1; x += 8) {
+                    const int n = std::min(8, x1 - x);
+                    unsigned char bits = 0;
+                    for (int i = 0; i < n; ++i) {
+                        const int xx = x + i;
+                        const int v = src[xx] + ((errIn[xx] + errRight + 8) >> 4);
+                        int err;
+                        if (v >= 128) {
+                            bits |= 0x80 >> i;
+                            err = v - 255;
+                        } else {
+                            err = v;
+                        }
+                        errRight = 7 * err;
+                        errOut[xx - 1] += 3 * err;
+                        errOut[xx] += 5 * err;
+                        errOut[xx + 1] += err;
+                    }
+                    dest[x >> 3] = bits;
+                }
+                progress[y].store(x1, std::memory_order_release);
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int i = 1; i < nThreads; ++i) {
+        threads.emplace_back(ditherRows);
+    }
+    ditherRows();
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    if (carry) {
+        const auto lastErrOut = errors.begin() + static_cast<ptrdiff_t>(height % nErrRows) * errRowSize;
+        std::copy(lastErrOut, lastErrOut + errRowSize, carry->begin());
+    }
+
+    if (rowSize < 0) {
+        gfree(data + (height - 1) * rowSize);
+    } else {
+        gfree(data);
+    }
+    data = newData;
+    rowSize = newRowSize;
+    mode = splashModeMono1;
+    return true;
+}
+
 void SplashBitmap::getCMYKLine(int yl, SplashColorPtr line)
 {
     SplashColor col;
@@ -657,201 +810,109 @@ void SplashBitmap::getCMYKLine(int yl, SplashColorPtr line)
 }
 
 SplashError SplashBitmap::writeImgFile(ImgWriter *writer, FILE *f, double hDPI, double vDPI, SplashColorMode imageWriterFormat)
+{
+    if (!writer->init(f, width, height, hDPI, vDPI)) {
+        return SplashError::Generic;
+    }
+
+    const SplashError e = writeImgRows(writer, imageWriterFormat);
+    if (e != SplashError::NoError) {
+        return e;
+    }
+
+    if (!writer->close()) {
+        return SplashError::Generic;
+    }
+
+    return SplashError::NoError;
+}
+
+SplashError SplashBitmap::writeImgRows(ImgWriter *writer, SplashColorMode imageWriterFormat)
 {
     if (mode != splashModeRGB8 && mode != splashModeMono8 && mode != splashModeMono1 && mode != splashModeXBGR8 && mode != splashModeBGR8 && mode != splashModeCMYK8 && mode != splashModeDeviceN8) {
         error(errInternal, -1, "unsupported SplashBitmap mode");
         return SplashError::Generic;
     }
-
-    if (!writer->init(f, width, height, hDPI, vDPI)) {
+    // grayscale bitmaps are written as they are or expanded to RGB
+    if ((mode == splashModeMono8 || mode == splashModeMono1) && imageWriterFormat != mode && imageWriterFormat != splashModeRGB8) {
         return SplashError::Generic;
     }
 
-    switch (mode) {
+    // the writer may modify the rows (JpegWriter inverts CMYK), so they
+    // are always copied
+    int rowBytes;
+    switch (imageWriterFormat) {
+    case splashModeMono1:
+        rowBytes = (width + 7) >> 3;
+        break;
+    case splashModeMono8:
+        rowBytes = width;
+        break;
     case splashModeCMYK8:
-        if (writer->supportCMYK()) {
-            SplashColorPtr row;
-            auto **row_pointers = new unsigned char *[height];
-            row = data;
-
-            for (int y = 0; y < height; ++y) {
-                row_pointers[y] = row;
-                row += rowSize;
-            }
-            if (!writer->writePointers(row_pointers, height)) {
-                delete[] row_pointers;
-                return SplashError::Generic;
-            }
-            delete[] row_pointers;
-        } else {
-            auto *row = new unsigned char[3 * width];
-            for (int y = 0; y < height; y++) {
-                getRGBLine(y, row);
-                if (!writer->writeRow(&row)) {
-                    delete[] row;
-                    return SplashError::Generic;
-                }
-            }
-            delete[] row;
-        }
+        rowBytes = 4 * width;
         break;
-    case splashModeDeviceN8:
-        if (writer->supportCMYK()) {
-            auto *row = new unsigned char[4 * width];
-            for (int y = 0; y < height; y++) {
-                getCMYKLine(y, row);
-                if (!writer->writeRow(&row)) {
-                    delete[] row;
-                    return SplashError::Generic;
-                }
-            }
-            delete[] row;
-        } else {
-            auto *row = new unsigned char[3 * width];
-            for (int y = 0; y < height; y++) {
-                getRGBLine(y, row);
-                if (!writer->writeRow(&row)) {
-                    delete[] row;
-                    return SplashError::Generic;
-                }
-            }
-            delete[] row;
-        }
+    default:
+        rowBytes = 3 * width;
         break;
-    case splashModeRGB8: {
-        SplashColorPtr row;
-        auto **row_pointers = new unsigned char *[height];
-        row = data;
-
-        for (int y = 0; y < height; ++y) {
-            row_pointers[y] = row;
-            row += rowSize;
-        }
-        if (!writer->writePointers(row_pointers, height)) {
-            delete[] row_pointers;
-            return SplashError::Generic;
-        }
-        delete[] row_pointers;
-    } break;
+    }
+    const bool cmyk = (mode == splashModeCMYK8 || mode == splashModeDeviceN8) && writer->supportCMYK();
+    if (cmyk) {
+        rowBytes = 4 * width;
+    }
+    std::vector<unsigned char> buf(rowBytes);
+    unsigned char *row = buf.data();
 
-    case splashModeBGR8: {
-        auto *row = new unsigned char[3 * width];
-        for (int y = 0; y < height; y++) {
-            // Convert into a PNG row
-            for (int x = 0; x < width; x++) {
-                row[3 * x] = data[y * rowSize + x * 3 + 2];
-                row[3 * x + 1] = data[y * rowSize + x * 3 + 1];
-                row[3 * x + 2] = data[y * rowSize + x * 3];
+    for (int y = 0; y < height; ++y) {
+        const unsigned char *p = data + static_cast<ptrdiff_t>(y) * rowSize;
+        switch (mode) {
+        case splashModeCMYK8:
+            if (cmyk) {
+                memcpy(row, p, rowBytes);
+            } else {
+                getRGBLine(y, row);
             }
-
-            if (!writer->writeRow(&row)) {
-                delete[] row;
-                return SplashError::Generic;
+            break;
+        case splashModeDeviceN8:
+            if (cmyk) {
+                getCMYKLine(y, row);
+            } else {
+                getRGBLine(y, row);
             }
-        }
-        delete[] row;
-    } break;
-
-    case splashModeXBGR8: {
-        auto *row = new unsigned char[3 * width];
-        for (int y = 0; y < height; y++) {
-            // Convert into a PNG row
+            break;
+        case splashModeRGB8:
+            memcpy(row, p, rowBytes);
+            break;
+        case splashModeBGR8:
+        case splashModeXBGR8: {
+            const int nComps = mode == splashModeBGR8 ? 3 : 4;
             for (int x = 0; x < width; x++) {
-                row[3 * x] = data[y * rowSize + x * 4 + 2];
-                row[3 * x + 1] = data[y * rowSize + x * 4 + 1];
-                row[3 * x + 2] = data[y * rowSize + x * 4];
-            }
-
-            if (!writer->writeRow(&row)) {
-                delete[] row;
-                return SplashError::Generic;
+                row[3 * x] = p[x * nComps + 2];
+                row[3 * x + 1] = p[x * nComps + 1];
+                row[3 * x + 2] = p[x * nComps];
             }
-        }
-        delete[] row;
-    } break;
-
-    case splashModeMono8: {
-        if (imageWriterFormat == splashModeMono8) {
-            SplashColorPtr row;
-            auto **row_pointers = new unsigned char *[height];
-            row = data;
-
-            for (int y = 0; y < height; ++y) {
-                row_pointers[y] = row;
-                row += rowSize;
-            }
-            if (!writer->writePointers(row_pointers, height)) {
-                delete[] row_pointers;
-                return SplashError::Generic;
-            }
-            delete[] row_pointers;
-        } else if (imageWriterFormat == splashModeRGB8) {
-            auto *row = new unsigned char[3 * width];
-            for (int y = 0; y < height; y++) {
-                // Convert into a PNG row
+        } break;
+        case splashModeMono8:
+            if (imageWriterFormat == splashModeMono8) {
+                memcpy(row, p, rowBytes);
+            } else {
                 for (int x = 0; x < width; x++) {
-                    row[3 * x] = data[y * rowSize + x];
-                    row[3 * x + 1] = data[y * rowSize + x];
-                    row[3 * x + 2] = data[y * rowSize + x];
-                }
-
-                if (!writer->writeRow(&row)) {
-                    delete[] row;
-                    return SplashError::Generic;
+                    row[3 * x] = row[3 * x + 1] = row[3 * x + 2] = p[x];
                 }
             }
-            delete[] row;
-        } else {
-            // only splashModeMono8 or splashModeRGB8
-            return SplashError::Generic;
-        }
-    } break;
-
-    case splashModeMono1: {
-        if (imageWriterFormat == splashModeMono1) {
-            SplashColorPtr row;
-            auto **row_pointers = new unsigned char *[height];
-            row = data;
-
-            for (int y = 0; y < height; ++y) {
-                row_pointers[y] = row;
-                row += rowSize;
-            }
-            if (!writer->writePointers(row_pointers, height)) {
-                delete[] row_pointers;
-                return SplashError::Generic;
-            }
-            delete[] row_pointers;
-        } else if (imageWriterFormat == splashModeRGB8) {
-            auto *row = new unsigned char[3 * width];
-            for (int y = 0; y < height; y++) {
-                // Convert into a PNG row
+            break;
+        case splashModeMono1:
+            if (imageWriterFormat == splashModeMono1) {
+                memcpy(row, p, rowBytes);
+            } else {
                 for (int x = 0; x < width; x++) {
-                    getPixel(x, y, &row[3 * x]);
-                    row[3 * x + 1] = row[3 * x];
-                    row[3 * x + 2] = row[3 * x];
-                }
-
-                if (!writer->writeRow(&row)) {
-                    delete[] row;
-                    return SplashError::Generic;
+                    row[3 * x] = row[3 * x + 1] = row[3 * x + 2] = (p[x >> 3] & (0x80 >> (x & 7))) ? 255 : 0;
                 }
             }
-            delete[] row;
-        } else {
-            // only splashModeMono1 or splashModeRGB8
+            break;
+        }
+        if (!writer->writeRow(&row)) {
             return SplashError::Generic;
         }
-    } break;
-
-    default:
-        // can't happen
-        break;
     }
-
-    if (!writer->close()) {
-        return SplashError::Generic;
-    }
-
     return SplashError::NoError;
 }
@@ -78,6 +78,10 @@ public:
 
     SplashError writePNMFile(char *fileName);
     SplashError writePNMFile(FILE *f);
+    // Write a PNM file in pieces: the header for a <width> x <height>
+    // image, then the rows of one or more bitmaps.
+    static SplashError writePNMHeader(FILE *f, SplashColorMode mode, int width, int height);
+    SplashError writePNMRows(FILE *f);
     SplashError writeAlphaPGMFile(char *fileName);
 
     struct WriteImgParams
@@ -86,12 +90,24 @@ public:
         bool jpegProgressive = false;
         std::string tiffCompression;
         bool jpegOptimize = false;
+        int pngCompressionLevel = -1; // -1 for the PNGWriter default
+        int pngFilter = 0; // a PNGWriter::Filter
     };
 
     SplashError writeImgFile(SplashImageFileFormat format, const char *fileName, double hDPI, double vDPI, WriteImgParams *params = nullptr);
     SplashError writeImgFile(SplashImageFileFormat format, FILE *f, double hDPI, double vDPI, WriteImgParams *params = nullptr);
     SplashError writeImgFile(ImgWriter *writer, FILE *f, double hDPI, double vDPI, SplashColorMode imageWriterFormat);
 
+    // Create the writer used by writeImgFile for <format> and bitmaps in
+    // <mode>, and return the row format it takes in <imageWriterFormat>.
+    // Returns nullptr if the format is not compiled in.
+    static ImgWriter *createImgWriter(SplashImageFileFormat format, SplashColorMode mode, const WriteImgParams *params, SplashColorMode *imageWriterFormat);
+
+    // Write the rows of this bitmap to <writer>, one at a time.  The
+    // writer is initialized and closed by the caller, so an image can be
+    // written from several bitmaps of the same width.
+    SplashError writeImgRows(ImgWriter *writer, SplashColorMode imageWriterFormat);
+
     enum ConversionMode
     {
         conversionOpaque,
@@ -101,6 +117,13 @@ public:
 
     bool convertToXBGR(ConversionMode conversionMode = conversionOpaque);
 
+    // Convert a Mono8 bitmap to Mono1, using Floyd-Steinberg error
+    // diffusion.  If <carry> is non-null, it holds width + 2 error
+    // terms diffused into the first row, and receives the ones diffused
+    // past the last row, so that a page can be dithered in bands.
+    // Returns false if the bitmap is not Mono8 or on allocation failure.
+    bool ditherToMono1(std::vector<int> *carry = nullptr);
+
     void getPixel(int x, int y, SplashColorPtr pixel) const;
     void getRGBLine(int y, SplashColorPtr line);
     void getXBGRLine(int y, SplashColorPtr line, ConversionMode conversionMode = conversionOpaque);
@@ -125,7 +148,7 @@ private:
 
     friend class Splash;
 
-    static void setJpegParams(ImgWriter *writer, WriteImgParams *params);
+    static void setJpegParams(ImgWriter *writer, const WriteImgParams *params);
 };
 
 #endif
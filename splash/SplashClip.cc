@@ -56,6 +56,7 @@ SplashClip::SplashClip(double x0, double y0, double x1, double y1, bool antialia
     yMinI = splashFloor(yMin);
     xMaxI = splashCeil(xMax) - 1;
     yMaxI = splashCeil(yMax) - 1;
+    numPaths = 0;
 }
 
 SplashClip::SplashClip(const SplashClip *clip, PrivateTag /*unused*/)
@@ -69,12 +70,14 @@ SplashClip::SplashClip(const SplashClip *clip, PrivateTag /*unused*/)
     yMinI = clip->yMinI;
     xMaxI = clip->xMaxI;
     yMaxI = clip->yMaxI;
-    scanners = clip->scanners;
+    numPaths = clip->numPaths;
+    pathSpans = clip->pathSpans;
 }
 
 void SplashClip::resetToRect(double x0, double y0, double x1, double y1)
 {
-    scanners = {};
+    numPaths = 0;
+    pathSpans = {};
 
     if (x0 < x1) {
         xMin = x0;
@@ -217,7 +220,8 @@ SplashError SplashClip::clipToPath(const SplashPath &path, const std::array<doub
             yMinAA = yMinI;
             yMaxAA = yMaxI;
         }
-        scanners.emplace_back(std::make_shared<SplashXPathScanner>(xPath, eo, yMinAA, yMaxAA));
+        intersectPathSpans(SplashXPathScanner(xPath, eo, yMinAA, yMaxAA));
+        ++numPaths;
     }
 
     return SplashError::NoError;
@@ -234,7 +238,39 @@ SplashClipResult SplashClip::testRect(int rectXMin, int rectYMin, int rectXMax,
     if (static_cast<double>(rectXMax + 1) <= xMin || static_cast<double>(rectXMin) >= xMax || static_cast<double>(rectYMax + 1) <= yMin || static_cast<double>(rectYMin) >= yMax) {
         return splashClipAllOutside;
     }
-    if (static_cast<double>(rectXMin) >= xMin && static_cast<double>(rectXMax + 1) <= xMax && static_cast<double>(rectYMin) >= yMin && static_cast<double>(rectYMax + 1) <= yMax && scanners.empty()) {
+    if (static_cast<double>(rectXMin) >= xMin && static_cast<double>(rectXMax + 1) <= xMax && static_cast<double>(rectYMin) >= yMin && static_cast<double>(rectYMax + 1) <= yMax) {
+        if (!pathSpans) {
+            return splashClipAllInside;
+        }
+        int x0 = rectXMin, y0 = rectYMin, x1 = rectXMax, y1 = rectYMax;
+        if (antialias) {
+            x0 *= splashAASize;
+            y0 *= splashAASize;
+            x1 = x1 * splashAASize + (splashAASize - 1);
+            y1 = y1 * splashAASize + (splashAASize - 1);
+        }
+        // the bounding box of the spans and the box inside them settle
+        // most rectangles without looking at the lines
+        const PathSpans &ps = *pathSpans;
+        if (x1 < ps.xMinSpans || x0 > ps.xMaxSpans || y1 < ps.yMinSpans || y0 > ps.yMaxSpans) {
+            return splashClipAllOutside;
+        }
+        if (x0 < ps.xMinSpans || x1 > ps.xMaxSpans || y0 < ps.yMinSpans || y1 > ps.yMaxSpans) {
+            return splashClipPartial;
+        }
+        if (x0 >= ps.xMinInner && x1 <= ps.xMaxInner && y0 >= ps.yMinInner && y1 <= ps.yMaxInner) {
+            return splashClipAllInside;
+        }
+        // one lookup per line, for the rectangles that reach the edges of
+        // the paths: the first and last lines are the most likely to fail
+        if (!testSpanPaths(x0, x1, y0) || !testSpanPaths(x0, x1, y1)) {
+            return splashClipPartial;
+        }
+        for (int y = y0 + 1; y < y1; ++y) {
+            if (!testSpanPaths(x0, x1, y)) {
+                return splashClipPartial;
+            }
+        }
         return splashClipAllInside;
     }
     return splashClipPartial;
@@ -254,17 +290,16 @@ SplashClipResult SplashClip::testSpan(int spanXMin, int spanXMax, int spanY)
     if (static_cast<double>(spanXMin) < xMin || static_cast<double>(spanXMax + 1) > xMax || static_cast<double>(spanY) < yMin || static_cast<double>(spanY + 1) > yMax) {
         return splashClipPartial;
     }
+    if (!pathSpans) {
+        return splashClipAllInside;
+    }
     if (antialias) {
-        for (const auto &scanner : scanners) {
-            if (!scanner->testSpan(spanXMin * splashAASize, spanXMax * splashAASize + (splashAASize - 1), spanY * splashAASize)) {
-                return splashClipPartial;
-            }
+        if (!testSpanPaths(spanXMin * splashAASize, spanXMax * splashAASize + (splashAASize - 1), spanY * splashAASize)) {
+            return splashClipPartial;
         }
     } else {
-        for (const auto &scanner : scanners) {
-            if (!scanner->testSpan(spanXMin, spanXMax, spanY)) {
-                return splashClipPartial;
-            }
+        if (!testSpanPaths(spanXMin, spanXMax, spanY)) {
+            return splashClipPartial;
         }
     }
     return splashClipAllInside;
@@ -318,8 +353,8 @@ void SplashClip::clipAALine(SplashBitmap *aaBuf, int *x0, int *x1, int y, bool a
     }
 
     // check the paths
-    for (const auto &scanner : scanners) {
-        scanner->clipAALine(aaBuf, x0, x1, y);
+    if (pathSpans) {
+        clipAALinePaths(aaBuf, *x0, *x1, y);
     }
     if (*x0 > *x1) {
         *x0 = *x1;
@@ -346,16 +381,237 @@ void SplashClip::clipAALine(SplashBitmap *aaBuf, int *x0, int *x1, int y, bool a
     }
 }
 
+const SplashClip::PathSpans::Span *SplashClip::PathSpans::find(int x, int y) const
+{
+    if (y < yMin || y > yMax) {
+        return nullptr;
+    }
+    const auto begin = spans.begin() + lineStart[y - yMin];
+    const auto end = spans.begin() + lineStart[y - yMin + 1];
+    // the first span that ends at or after x
+    const auto it = std::lower_bound(begin, end, x, [](const Span &span, int xx) { return span.x1 < xx; });
+    if (it == end || it->x0 > x) {
+        return nullptr;
+    }
+    return &*it;
+}
+
+void SplashClip::intersectPathSpans(const SplashXPathScanner &scanner)
+{
+    auto newSpans = std::make_shared<PathSpans>();
+    int scanXMin, scanYMin, scanXMax, scanYMax;
+    scanner.getBBox(&scanXMin, &scanYMin, &scanXMax, &scanYMax);
+    newSpans->yMin = scanYMin;
+    newSpans->yMax = scanYMax;
+    if (pathSpans) {
+        newSpans->yMin = std::max(newSpans->yMin, pathSpans->yMin);
+        newSpans->yMax = std::min(newSpans->yMax, pathSpans->yMax);
+    }
+    newSpans->xMinSpans = newSpans->yMinSpans = 1;
+    newSpans->xMaxSpans = newSpans->yMaxSpans = 0;
+    if (newSpans->yMin > newSpans->yMax) {
+        // nothing is left of the clip region
+        newSpans->yMin = 1;
+        newSpans->yMax = 0;
+        newSpans->lineStart.push_back(0);
+        newSpans->computeInnerBox();
+        pathSpans = std::move(newSpans);
+        return;
+    }
+
+    newSpans->lineStart.reserve(newSpans->yMax - newSpans->yMin + 2);
+    std::vector<PathSpans::Span> line;
+    for (int y = newSpans->yMin; y <= newSpans->yMax; ++y) {
+        newSpans->lineStart.push_back(newSpans->spans.size());
+
+        // the spans of the new path, with touching spans merged
+        line.clear();
+        SplashXPathScanIterator iter(scanner, y);
+        int sx0, sx1;
+        while (iter.getNextSpan(&sx0, &sx1)) {
+            if (!line.empty() && sx0 <= line.back().x1 + 1) {
+                line.back().x1 = std::max(line.back().x1, sx1);
+            } else {
+                line.push_back({ sx0, sx1 });
+            }
+        }
+
+        if (!pathSpans) {
+            newSpans->spans.insert(newSpans->spans.end(), line.begin(), line.end());
+            continue;
+        }
+
+        // intersect them with the spans of the previous paths
+        auto a = line.begin();
+        auto b = pathSpans->spans.begin() + pathSpans->lineStart[y - pathSpans->yMin];
+        const auto bEnd = pathSpans->spans.begin() + pathSpans->lineStart[y - pathSpans->yMin + 1];
+        while (a != line.end() && b != bEnd) {
+            const int ix0 = std::max(a->x0, b->x0);
+            const int ix1 = std::min(a->x1, b->x1);
+            if (ix0 <= ix1) {
+                newSpans->spans.push_back({ ix0, ix1 });
+            }
+            if (a->x1 < b->x1) {
+                ++a;
+            } else {
+                ++b;
+            }
+        }
+    }
+    newSpans->lineStart.push_back(newSpans->spans.size());
+
+    for (int y = newSpans->yMin; y <= newSpans->yMax; ++y) {
+        const int first = newSpans->lineStart[y - newSpans->yMin];
+        const int end = newSpans->lineStart[y - newSpans->yMin + 1];
+        if (first == end) {
+            continue;
+        }
+        if (newSpans->xMinSpans > newSpans->xMaxSpans) {
+            newSpans->xMinSpans = newSpans->spans[first].x0;
+            newSpans->xMaxSpans = newSpans->spans[end - 1].x1;
+            newSpans->yMinSpans = y;
+        } else {
+            newSpans->xMinSpans = std::min(newSpans->xMinSpans, newSpans->spans[first].x0);
+            newSpans->xMaxSpans = std::max(newSpans->xMaxSpans, newSpans->spans[end - 1].x1);
+        }
+        newSpans->yMaxSpans = y;
+    }
+    newSpans->computeInnerBox();
+    pathSpans = std::move(newSpans);
+}
+
+void SplashClip::PathSpans::computeInnerBox()
+{
+    xMinInner = yMinInner = 1;
+    xMaxInner = yMaxInner = 0;
+    if (xMinSpans > xMaxSpans) {
+        return;
+    }
+
+    // start from the widest span of the middle line
+    const int yMid = (yMinSpans + yMaxSpans) / 2;
+    const auto begin = spans.begin() + lineStart[yMid - yMin];
+    const auto end = spans.begin() + lineStart[yMid - yMin + 1];
+    if (begin == end) {
+        return;
+    }
+    const auto widest = std::max_element(begin, end, [](const Span &a, const Span &b) { return a.x1 - a.x0 < b.x1 - b.x0; });
+    int x0 = widest->x0, x1 = widest->x1, y0 = yMid, y1 = yMid;
+    long long bestArea = 0;
+
+    // add the line above or below, whichever keeps the box wider, and
+    // keep the box with the largest area
+    while (true) {
+        const long long area = static_cast<long long>(x1 - x0 + 1) * (y1 - y0 + 1);
+        if (area > bestArea) {
+            bestArea = area;
+            xMinInner = x0;
+            xMaxInner = x1;
+            yMinInner = y0;
+            yMaxInner = y1;
+        }
+        const int xMid = x0 + (x1 - x0) / 2;
+        const Span *above = y0 > yMinSpans ? find(xMid, y0 - 1) : nullptr;
+        const Span *below = y1 < yMaxSpans ? find(xMid, y1 + 1) : nullptr;
+        auto width = [&](const Span *span) { return span ? std::min(x1, span->x1) - std::max(x0, span->x0) : -1; };
+        const Span *next = width(above) >= width(below) ? above : below;
+        if (!next) {
+            break;
+        }
+        x0 = std::max(x0, next->x0);
+        x1 = std::min(x1, next->x1);
+        if (next == above) {
+            --y0;
+        } else {
+            ++y1;
+        }
+    }
+}
+
+void SplashClip::getBBoxI(int *xMinA, int *yMinA, int *xMaxA, int *yMaxA) const
+{
+    *xMinA = xMinI;
+    *yMinA = yMinI;
+    *xMaxA = xMaxI;
+    *yMaxA = yMaxI;
+    if (pathSpans) {
+        if (pathSpans->xMinSpans > pathSpans->xMaxSpans) {
+            *xMinA = *yMinA = 1;
+            *xMaxA = *yMaxA = 0;
+            return;
+        }
+        const int scale = antialias ? splashAASize : 1;
+        *xMinA = std::max(*xMinA, splashFloor(static_cast<double>(pathSpans->xMinSpans) / scale));
+        *yMinA = std::max(*yMinA, splashFloor(static_cast<double>(pathSpans->yMinSpans) / scale));
+        *xMaxA = std::min(*xMaxA, splashFloor(static_cast<double>(pathSpans->xMaxSpans) / scale));
+        *yMaxA = std::min(*yMaxA, splashFloor(static_cast<double>(pathSpans->yMaxSpans) / scale));
+    }
+}
+
+bool SplashClip::testSpanPaths(int x0, int x1, int y) const
+{
+    const PathSpans::Span *span = pathSpans->find(x0, y);
+    return span && span->x1 >= x1;
+}
+
+void SplashClip::clipAALinePaths(SplashBitmap *aaBuf, int x0, int x1, int y) const
+{
+    // set [xx0, xx1) of line yy to 0
+    auto clear = [aaBuf](int yy, int xx0, int xx1) {
+        if (xx1 > aaBuf->getWidth()) {
+            xx1 = aaBuf->getWidth();
+        }
+        if (xx0 < 0) {
+            xx0 = 0;
+        }
+        if (xx0 >= xx1) {
+            return;
+        }
+        SplashColorPtr p = aaBuf->getDataPtr() + yy * aaBuf->getRowSize() + (xx0 >> 3);
+        if (xx0 & 7) {
+            auto mask = static_cast<unsigned char>(0xff00 >> (xx0 & 7));
+            if ((xx0 & ~7) == (xx1 & ~7)) {
+                mask |= 0xff >> (xx1 & 7);
+            }
+            *p++ &= mask;
+            xx0 = (xx0 & ~7) + 8;
+        }
+        for (; xx0 + 7 < xx1; xx0 += 8) {
+            *p++ = 0x00;
+        }
+        if (xx0 < xx1) {
+            *p &= 0xff >> (xx1 & 7);
+        }
+    };
+
+    const int xxMin = x0 * splashAASize;
+    const int xxMax = (x1 + 1) * splashAASize;
+    for (int yy = 0; yy < splashAASize; ++yy) {
+        const int line = y * splashAASize + yy;
+        int xx = xxMin;
+        if (line >= pathSpans->yMin && line <= pathSpans->yMax) {
+            const int end = pathSpans->lineStart[line - pathSpans->yMin + 1];
+            for (int i = pathSpans->lineStart[line - pathSpans->yMin]; i < end && xx < xxMax; ++i) {
+                const PathSpans::Span &span = pathSpans->spans[i];
+                if (span.x1 < xx) {
+                    continue;
+                }
+                clear(yy, xx, std::min(span.x0, xxMax));
+                xx = span.x1 + 1;
+            }
+        }
+        clear(yy, xx, xxMax);
+    }
+}
+
 bool SplashClip::testClipPaths(int x, int y) const
 {
+    if (!pathSpans) {
+        return true;
+    }
     if (antialias) {
         x *= splashAASize;
         y *= splashAASize;
     }
-
-    auto testXY = [x, y](const auto &scanner) -> bool { //
-        return scanner->test(x, y);
-    };
-
-    return std::ranges::all_of(scanners, testXY);
+    return pathSpans->find(x, y) != nullptr;
 }
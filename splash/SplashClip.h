@@ -117,18 +117,54 @@ public:
     int getYMinI() const { return yMinI; }
     int getYMaxI() const { return yMaxI; }
 
+    // Get the bounding box of the whole clip region, including the
+    // paths, in integer coordinates.  The box is empty (<xMinA> > <xMaxA>)
+    // if nothing is left of the clip region.
+    void getBBoxI(int *xMinA, int *yMinA, int *xMaxA, int *yMaxA) const;
+
     // Get the number of arbitrary paths used by the clip region.
-    int getNumPaths() { return scanners.size(); }
+    int getNumPaths() const { return numPaths; }
 
     explicit SplashClip(const SplashClip *clip, PrivateTag /*unused*/ = {});
 
 protected:
+    // The intersection of all clip paths, as a sorted list of disjoint,
+    // non-touching spans [x0, x1] per scanline (in AA coordinates when
+    // antialiasing).  Lines outside [yMin, yMax] are empty.  This is
+    // immutable once built, so copies of the clip share it.
+    struct PathSpans
+    {
+        struct Span
+        {
+            int x0, x1;
+        };
+
+        int yMin, yMax;
+        int xMinSpans, yMinSpans, xMaxSpans, yMaxSpans; // bounding box of the spans
+        int xMinInner, yMinInner, xMaxInner, yMaxInner; // a box inside the spans (may be empty)
+        // spans of line y are spans[lineStart[y - yMin]] up to
+        // spans[lineStart[y - yMin + 1]]
+        std::vector<int> lineStart;
+        std::vector<Span> spans;
+
+        // Returns the span that contains <x> on line <y>, or nullptr.
+        const Span *find(int x, int y) const;
+
+        // Sets the inner box, grown from the widest span of the middle
+        // line.
+        void computeInnerBox();
+    };
+
+    void intersectPathSpans(const SplashXPathScanner &scanner);
     bool testClipPaths(int x, int y) const;
+    bool testSpanPaths(int x0, int x1, int y) const;
+    void clipAALinePaths(SplashBitmap *aaBuf, int x0, int x1, int y) const;
 
     bool antialias;
     double xMin, yMin, xMax, yMax;
     int xMinI, yMinI, xMaxI, yMaxI;
-    std::vector<std::shared_ptr<SplashXPathScanner>> scanners;
+    int numPaths;
+    std::shared_ptr<const PathSpans> pathSpans;
 };
 
 #endif
@@ -0,0 +1,173 @@
+//========================================================================
+//
+// SplashFTFacePool.cc
+//
+// Process-wide pool of FreeType faces shared by all SplashFTFontEngines.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#include <functional>
+#include <string_view>
+
+#include "goo/ft_utils.h"
+#include "poppler/GlobalParams.h"
+#include "SplashFontFile.h"
+#include "SplashFTFacePool.h"
+
+//------------------------------------------------------------------------
+// SplashFTLibrary
+//------------------------------------------------------------------------
+
+// FT_New_Face and FT_Done_Face modify the library, so they are
+// serialized with <mutex>.  The library lives until the pool and the
+// last face loaded from it are gone.
+struct SplashFTLibrary
+{
+    explicit SplashFTLibrary(FT_Library libA) : lib(libA) { }
+    ~SplashFTLibrary() { FT_Done_FreeType(lib); }
+
+    SplashFTLibrary(const SplashFTLibrary &) = delete;
+    SplashFTLibrary &operator=(const SplashFTLibrary &) = delete;
+
+    FT_Library lib;
+    std::mutex mutex;
+};
+
+//------------------------------------------------------------------------
+// SplashFTFace
+//------------------------------------------------------------------------
+
+SplashFTFace::SplashFTFace(std::shared_ptr<SplashFTLibrary> libA, FT_Face faceA, const SplashFontSrc &src, size_t hashA, int faceIndexA)
+    : face(faceA), lib(std::move(libA)), fileName(src.isFile() ? src.fileName() : std::string()), hash(hashA), faceIndex(faceIndexA), data(src.isFile() ? nullptr : src.sharedBuf())
+{
+}
+
+SplashFTFace::~SplashFTFace()
+{
+    std::scoped_lock locker(lib->mutex);
+    FT_Done_Face(face);
+}
+
+bool SplashFTFace::matches(const SplashFontSrc &src, size_t hashA, int faceIndexA) const
+{
+    if (faceIndex != faceIndexA) {
+        return false;
+    }
+    if (src.isFile()) {
+        return !data && fileName == src.fileName();
+    }
+    return data && hash == hashA && (data.get() == &src.buf() || *data == src.buf());
+}
+
+//------------------------------------------------------------------------
+// SplashFTFacePool
+//------------------------------------------------------------------------
+
+// Limits of the pool when there are no GlobalParams.
+static const size_t splashFTFacePoolSize = 64;
+static const size_t splashFTFacePoolDataSize = 32 * 1024 * 1024;
+
+SplashFTFacePool::SplashFTFacePool()
+{
+    FT_Library libA;
+
+    if (!FT_Init_FreeType(&libA)) {
+        lib = std::make_shared<SplashFTLibrary>(libA);
+    }
+}
+
+SplashFTFacePool::~SplashFTFacePool() = default;
+
+SplashFTFacePool *SplashFTFacePool::getInstance()
+{
+    static SplashFTFacePool pool;
+    return &pool;
+}
+
+std::unique_ptr<SplashFTFace> SplashFTFacePool::checkOut(const SplashFontSrc &src, int faceIndex)
+{
+    if (!lib) {
+        return nullptr;
+    }
+
+    size_t hash = 0;
+    if (!src.isFile()) {
+        const std::vector<unsigned char> &buf = src.buf();
+        hash = std::hash<std::string_view> {}(std::string_view(reinterpret_cast<const char *>(buf.data()), buf.size()));
+    }
+
+    {
+        std::scoped_lock locker(mutex);
+        for (auto it = idle.rbegin(); it != idle.rend(); ++it) {
+            if ((*it)->matches(src, hash, faceIndex)) {
+                std::unique_ptr<SplashFTFace> face = std::move(*it);
+                idle.erase(std::next(it).base());
+                dataSize -= face->data ? face->data->size() : 0;
+                return face;
+            }
+        }
+    }
+
+    // The face may outlive <src>, so it shares the embedded font data.
+    FT_Face faceA;
+    FT_Error err;
+    {
+        std::scoped_lock libLocker(lib->mutex);
+        if (src.isFile()) {
+            err = ft_new_face_from_file(lib->lib, src.fileName().c_str(), faceIndex, &faceA);
+        } else {
+            err = FT_New_Memory_Face(lib->lib, static_cast<const FT_Byte *>(src.buf().data()), src.buf().size(), faceIndex, &faceA);
+        }
+    }
+    if (err) {
+        return nullptr;
+    }
+    return std::unique_ptr<SplashFTFace>(new SplashFTFace(lib, faceA, src, hash, faceIndex));
+}
+
+void SplashFTFacePool::checkIn(std::unique_ptr<SplashFTFace> face)
+{
+    if (!face) {
+        return;
+    }
+    const size_t maxFaces = globalParams ? globalParams->getFontFaceCacheSize() : splashFTFacePoolSize;
+    const size_t maxDataSize = globalParams ? globalParams->getFontFaceCacheDataSize() : splashFTFacePoolDataSize;
+    const size_t size = face->data ? face->data->size() : 0;
+
+    std::scoped_lock locker(mutex);
+    if (maxFaces == 0 || size > maxDataSize) {
+        // not kept once unused
+        trim(maxFaces, maxDataSize);
+        return;
+    }
+    trim(maxFaces - 1, maxDataSize - size);
+    idle.push_back(std::move(face));
+    dataSize += size;
+}
+
+void SplashFTFacePool::clear()
+{
+    std::scoped_lock locker(mutex);
+    trim(0, 0);
+}
+
+int SplashFTFacePool::getNumIdleFaces()
+{
+    std::scoped_lock locker(mutex);
+    return static_cast<int>(idle.size());
+}
+
+void SplashFTFacePool::trim(size_t maxFaces, size_t maxDataSize)
+{
+    size_t nEvicted = 0;
+    while (nEvicted < idle.size() && (idle.size() - nEvicted > maxFaces || dataSize > maxDataSize)) {
+        const SplashFTFace *evicted = idle[nEvicted].get();
+        dataSize -= evicted->data ? evicted->data->size() : 0;
+        ++nEvicted;
+    }
+    idle.erase(idle.begin(), idle.begin() + nEvicted);
+}
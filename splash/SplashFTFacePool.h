@@ -0,0 +1,111 @@
+//========================================================================
+//
+// SplashFTFacePool.h
+//
+// Process-wide pool of FreeType faces shared by all SplashFTFontEngines.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef SPLASHFTFACEPOOL_H
+#define SPLASHFTFACEPOOL_H
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "poppler_private_export.h"
+
+class SplashFontSrc;
+struct SplashFTLibrary;
+
+//------------------------------------------------------------------------
+// SplashFTFace
+//------------------------------------------------------------------------
+
+// A FreeType face checked out of the SplashFTFacePool: it is used by one
+// font file at a time, so it needs no locking.
+class POPPLER_PRIVATE_EXPORT SplashFTFace
+{
+public:
+    ~SplashFTFace();
+
+    SplashFTFace(const SplashFTFace &) = delete;
+    SplashFTFace &operator=(const SplashFTFace &) = delete;
+
+    FT_Face face;
+
+private:
+    SplashFTFace(std::shared_ptr<SplashFTLibrary> libA, FT_Face faceA, const SplashFontSrc &src, size_t hashA, int faceIndexA);
+
+    bool matches(const SplashFontSrc &src, size_t hashA, int faceIndexA) const;
+
+    std::shared_ptr<SplashFTLibrary> lib;
+    // key: the file name for font files, a hash of the data for
+    // embedded fonts
+    std::string fileName;
+    size_t hash;
+    int faceIndex;
+    // font data for faces loaded from memory, shared with the font
+    // source it was loaded from (and with the other faces loaded from
+    // that source); FreeType reads it lazily
+    std::shared_ptr<const std::vector<unsigned char>> data;
+
+    friend class SplashFTFacePool;
+};
+
+//------------------------------------------------------------------------
+// SplashFTFacePool
+//------------------------------------------------------------------------
+
+// Faces are keyed by file name + face index for font files, and by a
+// hash of the font data + face index for embedded fonts.  A font file
+// checks a face out for its own use, so that documents rendered on
+// different threads never share a face, and gives it back when it is
+// destroyed.  The pool keeps the most recently given back faces, within
+// the limits set by GlobalParams::setFontFaceCacheLimits, so that
+// documents opened one after the other (e.g. in a long-running service)
+// find the substitute and embedded fonts already loaded.
+class POPPLER_PRIVATE_EXPORT SplashFTFacePool
+{
+public:
+    static SplashFTFacePool *getInstance();
+
+    SplashFTFacePool(const SplashFTFacePool &) = delete;
+    SplashFTFacePool &operator=(const SplashFTFacePool &) = delete;
+
+    bool isOk() const { return lib != nullptr; }
+
+    // Return a face for <src> for the sole use of the caller, taken from
+    // the idle faces or loaded.
+    std::unique_ptr<SplashFTFace> checkOut(const SplashFontSrc &src, int faceIndex);
+
+    // Give back a face checked out of the pool.
+    void checkIn(std::unique_ptr<SplashFTFace> face);
+
+    // Free the idle faces.
+    void clear();
+
+    int getNumIdleFaces();
+
+private:
+    SplashFTFacePool();
+    ~SplashFTFacePool();
+
+    // Free the least recently used idle faces until there are at most
+    // <maxFaces> of them, with at most <maxDataSize> bytes of embedded
+    // font data.
+    void trim(size_t maxFaces, size_t maxDataSize);
+
+    std::shared_ptr<SplashFTLibrary> lib;
+    std::mutex mutex;
+    std::vector<std::unique_ptr<SplashFTFace>> idle; // MRU order, most recent at the end
+    size_t dataSize = 0; // size of the embedded font data of <idle>
+};
+
+#endif
@@ -36,6 +36,7 @@
 #include "SplashMath.h"
 #include "SplashGlyphBitmap.h"
 #include "SplashPath.h"
+#include "SplashFTFacePool.h"
 #include "SplashFTFontEngine.h"
 #include "SplashFTFontFile.h"
 #include "SplashFTFont.h"
@@ -60,8 +61,9 @@ SplashFTFont::SplashFTFont(const std::shared_ptr<SplashFTFontFile> &fontFileA, c
     int div;
     int x, y;
 
-    face = fontFileA->face;
+    face = fontFileA->face->face;
     if (FT_New_Size(face, &sizeObj)) {
+        sizeObj = nullptr;
         return;
     }
     face->size = sizeObj;
@@ -148,7 +150,14 @@ SplashFTFont::SplashFTFont(const std::shared_ptr<SplashFTFontFile> &fontFileA, c
     isOk = true;
 }
 
-SplashFTFont::~SplashFTFont() = default;
+SplashFTFont::~SplashFTFont()
+{
+    // The face goes back to the SplashFTFacePool, to be used by other
+    // fonts, so release the size object now.
+    if (sizeObj) {
+        FT_Done_Size(sizeObj);
+    }
+}
 
 bool SplashFTFont::getGlyph(int c, int xFrac, int /*yFrac*/, SplashGlyphBitmap *bitmap, int x0, int y0, const SplashClip &clip, SplashClipResult *clipRes)
 {
@@ -200,12 +209,13 @@ bool SplashFTFont::makeGlyph(int c, int xFrac, int /*yFrac*/, SplashGlyphBitmap
     }
 
     ff = static_cast<SplashFTFontFile *>(fontFile.get());
+    FT_Face face = ff->face->face;
 
-    ff->face->size = sizeObj;
+    face->size = sizeObj;
     offset.x = static_cast<FT_Pos>(static_cast<int>(static_cast<double>(xFrac) * splashFontFractionMul * 64));
     offset.y = 0;
-    FT_Set_Transform(ff->face, &matrix, &offset);
-    slot = ff->face->glyph;
+    FT_Set_Transform(face, &matrix, &offset);
+    slot = face->glyph;
 
     if (c >= 0 && static_cast<size_t>(c) < ff->codeToGID.size()) {
         gid = static_cast<FT_UInt>(ff->codeToGID[c]);
@@ -213,14 +223,14 @@ bool SplashFTFont::makeGlyph(int c, int xFrac, int /*yFrac*/, SplashGlyphBitmap
         gid = static_cast<FT_UInt>(c);
     }
 
-    if (FT_Load_Glyph(ff->face, gid, getFTLoadFlags(ff->type1, ff->trueType, aa, enableFreeTypeHinting, enableSlightHinting))) {
+    if (FT_Load_Glyph(face, gid, getFTLoadFlags(ff->type1, ff->trueType, aa, enableFreeTypeHinting, enableSlightHinting))) {
         return false;
     }
 
     // prelimirary values based on FT_Outline_Get_CBox
     // we add two pixels to each side to be in the safe side
     FT_BBox cbox;
-    FT_Outline_Get_CBox(&ff->face->glyph->outline, &cbox);
+    FT_Outline_Get_CBox(&face->glyph->outline, &cbox);
     bitmap->x = -(cbox.xMin / 64) + 2;
     bitmap->y = (cbox.yMax / 64) + 2;
     bitmap->w = ((cbox.xMax - cbox.xMin) / 64) + 4;
@@ -290,8 +300,9 @@ double SplashFTFont::getGlyphAdvance(int c)
     offset.x = 0;
     offset.y = 0;
 
-    ff->face->size = sizeObj;
-    FT_Set_Transform(ff->face, &identityMatrix, &offset);
+    FT_Face face = ff->face->face;
+    face->size = sizeObj;
+    FT_Set_Transform(face, &identityMatrix, &offset);
 
     if (c >= 0 && static_cast<size_t>(c) < ff->codeToGID.size()) {
         gid = static_cast<FT_UInt>(ff->codeToGID[c]);
@@ -299,12 +310,12 @@ double SplashFTFont::getGlyphAdvance(int c)
         gid = static_cast<FT_UInt>(c);
     }
 
-    if (FT_Load_Glyph(ff->face, gid, getFTLoadFlags(ff->type1, ff->trueType, aa, enableFreeTypeHinting, enableSlightHinting))) {
+    if (FT_Load_Glyph(face, gid, getFTLoadFlags(ff->type1, ff->trueType, aa, enableFreeTypeHinting, enableSlightHinting))) {
         return -1;
     }
 
     // 64.0 is 1 in 26.6 format
-    return ff->face->glyph->metrics.horiAdvance / 64.0 / size;
+    return face->glyph->metrics.horiAdvance / 64.0 / size;
 }
 
 struct SplashFTFontPath
@@ -342,15 +353,16 @@ SplashPath *SplashFTFont::getGlyphPath(int c)
     }
 
     ff = static_cast<SplashFTFontFile *>(fontFile.get());
-    ff->face->size = sizeObj;
-    FT_Set_Transform(ff->face, &textMatrix, nullptr);
-    slot = ff->face->glyph;
+    FT_Face face = ff->face->face;
+    face->size = sizeObj;
+    FT_Set_Transform(face, &textMatrix, nullptr);
+    slot = face->glyph;
     if (c >= 0 && static_cast<size_t>(c) < ff->codeToGID.size()) {
         gid = ff->codeToGID[c];
     } else {
         gid = static_cast<FT_UInt>(c);
     }
-    if (FT_Load_Glyph(ff->face, gid, getFTLoadFlags(ff->type1, ff->trueType, aa, enableFreeTypeHinting, enableSlightHinting))) {
+    if (FT_Load_Glyph(face, gid, getFTLoadFlags(ff->type1, ff->trueType, aa, enableFreeTypeHinting, enableSlightHinting))) {
         return nullptr;
     }
     if (FT_Get_Glyph(slot, &glyph)) {
@@ -29,33 +29,30 @@
 #include "SplashFTFontFile.h"
 #include "SplashFontFileID.h"
 #include "SplashFTFontEngine.h"
+#include "SplashFTFacePool.h"
 
 //------------------------------------------------------------------------
 // SplashFTFontEngine
 //------------------------------------------------------------------------
 
-SplashFTFontEngine::SplashFTFontEngine(bool aaA, bool enableFreeTypeHintingA, bool enableSlightHintingA, FT_Library libA)
+SplashFTFontEngine::SplashFTFontEngine(bool aaA, bool enableFreeTypeHintingA, bool enableSlightHintingA)
 {
     aa = aaA;
     enableFreeTypeHinting = enableFreeTypeHintingA;
     enableSlightHinting = enableSlightHintingA;
-    lib = libA;
 }
 
 SplashFTFontEngine *SplashFTFontEngine::init(bool aaA, bool enableFreeTypeHintingA, bool enableSlightHintingA)
 {
-    FT_Library libA;
-
-    if (FT_Init_FreeType(&libA)) {
+    // Faces are loaded through the process-wide SplashFTFacePool, so
+    // that documents using the same font files share them.
+    if (!SplashFTFacePool::getInstance()->isOk()) {
         return nullptr;
     }
-    return new SplashFTFontEngine(aaA, enableFreeTypeHintingA, enableSlightHintingA, libA);
+    return new SplashFTFontEngine(aaA, enableFreeTypeHintingA, enableSlightHintingA);
 }
 
-SplashFTFontEngine::~SplashFTFontEngine()
-{
-    FT_Done_FreeType(lib);
-}
+SplashFTFontEngine::~SplashFTFontEngine() = default;
 
 std::shared_ptr<SplashFontFile> SplashFTFontEngine::loadType1Font(std::unique_ptr<SplashFontFileID> idA, std::unique_ptr<SplashFontSrc> src, const std::array<const char *, 256> &enc, int faceIndex)
 {
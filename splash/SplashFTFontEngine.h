@@ -61,12 +61,11 @@ public:
     void setAA(bool aaA) { aa = aaA; }
 
 private:
-    SplashFTFontEngine(bool aaA, bool enableFreeTypeHintingA, bool enableSlightHintingA, FT_Library libA);
+    SplashFTFontEngine(bool aaA, bool enableFreeTypeHintingA, bool enableSlightHintingA);
 
     bool aa;
     bool enableFreeTypeHinting;
     bool enableSlightHinting;
-    FT_Library lib;
 
     friend class SplashFTFontFile;
     friend class SplashFTFont;
@@ -35,6 +35,7 @@
 
 class SplashFontFileID;
 class SplashFTFontEngine;
+class SplashFTFace;
 
 //------------------------------------------------------------------------
 // SplashFTFontFile
@@ -57,11 +58,11 @@ public:
     // file.
     SplashFont *makeFont(const std::array<double, 4> &mat, const std::array<double, 4> &textMat) override;
 
-    SplashFTFontFile(SplashFTFontEngine *engineA, std::unique_ptr<SplashFontFileID> idA, std::unique_ptr<SplashFontSrc> src, FT_Face faceA, std::vector<int> &&codeToGIDA, bool trueTypeA, bool type1A, PrivateTag /*unused*/ = {});
+    SplashFTFontFile(SplashFTFontEngine *engineA, std::unique_ptr<SplashFontFileID> idA, std::unique_ptr<SplashFontSrc> src, std::unique_ptr<SplashFTFace> faceA, std::vector<int> &&codeToGIDA, bool trueTypeA, bool type1A, PrivateTag /*unused*/ = {});
 
 private:
     SplashFTFontEngine *engine;
-    FT_Face face;
+    std::unique_ptr<SplashFTFace> face; // checked out of the SplashFTFacePool
     std::vector<int> codeToGID;
     bool trueType;
     bool type1;
@@ -42,6 +42,6 @@ SplashFontFile::~SplashFontFile() = default;
 //
 
 SplashFontSrc::SplashFontSrc(const std::string &file) : m_data(file) { }
-SplashFontSrc::SplashFontSrc(std::vector<unsigned char> &&data) : m_data(std::move(data)) { }
+SplashFontSrc::SplashFontSrc(std::vector<unsigned char> &&data) : m_data(std::make_shared<const std::vector<unsigned char>>(std::move(data))) { }
 
 SplashFontSrc::~SplashFontSrc() = default;
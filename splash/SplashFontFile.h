@@ -49,14 +49,16 @@ public:
     SplashFontSrc(const SplashFontSrc &) = delete;
     SplashFontSrc &operator=(const SplashFontSrc &) = delete;
 
-    const std::vector<unsigned char> &buf() const { return std::get<std::vector<unsigned char>>(m_data); }
+    const std::vector<unsigned char> &buf() const { return *std::get<std::shared_ptr<const std::vector<unsigned char>>>(m_data); }
+    // The font data, for users that need it to outlive this source.
+    const std::shared_ptr<const std::vector<unsigned char>> &sharedBuf() const { return std::get<std::shared_ptr<const std::vector<unsigned char>>>(m_data); }
 
     const std::string &fileName() const { return std::get<std::string>(m_data); }
     bool isFile() const { return std::holds_alternative<std::string>(m_data); }
     ~SplashFontSrc();
 
 private:
-    const std::variant<std::string, std::vector<unsigned char>> m_data;
+    const std::variant<std::string, std::shared_ptr<const std::vector<unsigned char>>> m_data;
 };
 
 class POPPLER_PRIVATE_EXPORT SplashFontFile
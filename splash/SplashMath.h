@@ -196,4 +196,53 @@ static inline bool splashCheckDet(double m11, double m12, double m21, double m22
     return fabs(m11 * m22 - m12 * m21) >= epsilon;
 }
 
+// Number of line segments needed to approximate the cubic Bezier curve
+// (x0,y0) .. (x3,y3) to within <tolerance> (Wang's formula), clamped to
+// [1, <maxSegments>].
+static inline int splashCurveSegments(double x0, double y0, double x1, double y1, double x2, double y2, double x3, double y3, double tolerance, int maxSegments)
+{
+    double ddx, ddy, dd0, dd1, n2;
+
+    ddx = x0 - 2 * x1 + x2;
+    ddy = y0 - 2 * y1 + y2;
+    dd0 = ddx * ddx + ddy * ddy;
+    ddx = x1 - 2 * x2 + x3;
+    ddy = y1 - 2 * y2 + y3;
+    dd1 = ddx * ddx + ddy * ddy;
+    n2 = 0.75 * splashSqrt(dd0 > dd1 ? dd0 : dd1) / tolerance;
+    // this also catches NaN and infinite coordinates
+    if (!(n2 < static_cast<double>(maxSegments) * maxSegments)) {
+        return maxSegments;
+    }
+    if (n2 <= 1) {
+        return 1;
+    }
+    return static_cast<int>(ceil(splashSqrt(n2)));
+}
+
+// Evaluate the cubic Bezier curve (x0,y0) .. (x3,y3) at t = (i + 1) / n,
+// for i = <i0> .. <i0> + <count> - 1, into <xs> and <ys>.  The points are
+// independent of each other, so the loop vectorizes.  The last point of
+// the curve is stored exactly.
+static inline void splashCurvePoints(double x0, double y0, double x1, double y1, double x2, double y2, double x3, double y3, int n, int i0, int count, double *xs, double *ys)
+{
+    const double ax = x3 - x0 + 3 * (x1 - x2);
+    const double ay = y3 - y0 + 3 * (y1 - y2);
+    const double bx = 3 * (x0 - 2 * x1 + x2);
+    const double by = 3 * (y0 - 2 * y1 + y2);
+    const double cx = 3 * (x1 - x0);
+    const double cy = 3 * (y1 - y0);
+    const double dt = 1.0 / n;
+
+    for (int i = 0; i < count; ++i) {
+        const double t = (i0 + i + 1) * dt;
+        xs[i] = ((ax * t + bx) * t + cx) * t + x0;
+        ys[i] = ((ay * t + by) * t + cy) * t + y0;
+    }
+    if (i0 + count == n) {
+        xs[count - 1] = x3;
+        ys[count - 1] = y3;
+    }
+}
+
 #endif
@@ -191,6 +191,17 @@ SplashError SplashPath::close(bool force)
     return SplashError::NoError;
 }
 
+void SplashPath::reserveHints(int n)
+{
+    if (n > hintsSize) {
+        hintsSize = n;
+        hints = static_cast<SplashPathHint *>(greallocn_checkoverflow(hints, hintsSize, sizeof(SplashPathHint)));
+        if (unlikely(!hints)) {
+            hintsLength = hintsSize = 0;
+        }
+    }
+}
+
 void SplashPath::addStrokeAdjustHint(int ctrl0, int ctrl1, int firstPt, int lastPt)
 {
     if (hintsLength == hintsSize) {
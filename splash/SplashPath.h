@@ -118,6 +118,9 @@ public:
     // Reserve space for at least n points
     void reserve(int n);
 
+    // Reserve space for at least n stroke adjustment hints
+    void reserveHints(int n);
+
 protected:
     void grow(int nPts);
     bool noCurrentPoint() const { return curSubpath == length; }
@@ -31,6 +31,13 @@ SplashPattern::SplashPattern() = default;
 
 SplashPattern::~SplashPattern() = default;
 
+void SplashPattern::getColorSpan(int x0, int x1, int y, SplashColor *c, unsigned char *inside) const
+{
+    for (int x = x0; x <= x1; ++x) {
+        inside[x - x0] = getColor(x, y, c[x - x0]);
+    }
+}
+
 //------------------------------------------------------------------------
 // SplashSolidColor
 //------------------------------------------------------------------------
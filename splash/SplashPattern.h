@@ -46,6 +46,18 @@ public:
     // Return the color value for a specific pixel.
     virtual bool getColor(int x, int y, SplashColorPtr c) const = 0;
 
+    // Returns true if getColorSpan computes a span faster than calling
+    // getColor for each pixel.  Only then do the rasterizers fetch the
+    // colors a span at a time; otherwise getColor is called for the
+    // pixels that are actually drawn.
+    virtual bool hasColorSpan() const { return false; }
+
+    // Return the color values for the pixels x0..x1 on line y, one
+    // SplashColor per pixel, and set inside[x - x0] to whether getColor
+    // would have succeeded for pixel x.  The default implementation calls
+    // getColor for every pixel.
+    virtual void getColorSpan(int x0, int x1, int y, SplashColor *c, unsigned char *inside) const;
+
     // Test if x,y-position is inside pattern.
     virtual bool testPosition(int x, int y) const = 0;
 
@@ -102,6 +114,11 @@ public:
     virtual void getNonParametrizedTriangle(int i, SplashColorMode mode, double *x0, double *y0, SplashColorPtr color0, double *x1, double *y1, SplashColorPtr color1, double *x2, double *y2, SplashColorPtr color2) = 0;
 
     virtual void getParameterizedColor(double t, SplashColorMode mode, SplashColorPtr c) = 0;
+
+    // Returns true if the device colors of non-parameterized triangles
+    // can be interpolated linearly.  Otherwise only triangles with the
+    // same color at all three vertices are drawn.
+    virtual bool canInterpolateDeviceColors() { return false; }
 };
 
 #endif
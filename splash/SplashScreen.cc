@@ -66,6 +66,7 @@ SplashScreen::SplashScreen(const SplashScreenParams *params)
 
     screenParams = params;
     mat = nullptr;
+    spanMat = nullptr;
     size = 0;
 }
 
@@ -346,9 +347,133 @@ SplashScreen::SplashScreen(const SplashScreen *screen)
     if (likely(mat != nullptr)) {
         memcpy(mat, screen->mat, size * size * sizeof(unsigned char));
     }
+    spanMat = nullptr;
 }
 
 SplashScreen::~SplashScreen()
 {
     gfree(mat);
+    gfree(spanMat);
+}
+
+void SplashScreen::createSpanMatrix()
+{
+    const int rowSize = size + splashScreenSpanPad;
+
+    spanMat = static_cast<unsigned char *>(gmallocn(size, rowSize));
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < rowSize; ++x) {
+            spanMat[y * rowSize + x] = mat[(y << log2Size) + (x & sizeM1)];
+        }
+    }
+}
+
+// Threshold eight gray levels against eight consecutive screen entries,
+// returning the Mono1 byte (most significant bit first).
+static inline unsigned char thresholdByte(const unsigned char *values, const unsigned char *thresholds)
+{
+    unsigned char bits = 0;
+    for (int i = 0; i < 8; ++i) {
+        bits |= (values[i] >= thresholds[i]) << (7 - i);
+    }
+    return bits;
+}
+
+void SplashScreen::testSpan(int x, int y, int n, const unsigned char *values, unsigned char *line)
+{
+    if (mat == nullptr) {
+        createMatrix();
+    }
+    if (spanMat == nullptr) {
+        createSpanMatrix();
+    }
+    const unsigned char *row = spanMat + (y & sizeM1) * (size + splashScreenSpanPad);
+    unsigned char *p = line + (x >> 3);
+    int i = 0;
+
+    // leading partial byte
+    for (; i < n && ((x + i) & 7); ++i) {
+        const int mask = 0x80 >> ((x + i) & 7);
+        if (values[i] >= row[(x + i) & sizeM1]) {
+            *p |= mask;
+        } else {
+            *p &= ~mask;
+        }
+        if (mask == 1) {
+            ++p;
+        }
+    }
+
+    // whole bytes
+    for (; i + 8 <= n; i += 8) {
+        *p++ = thresholdByte(values + i, row + ((x + i) & sizeM1));
+    }
+
+    // trailing partial byte
+    for (; i < n; ++i) {
+        const int mask = 0x80 >> ((x + i) & 7);
+        if (values[i] >= row[(x + i) & sizeM1]) {
+            *p |= mask;
+        } else {
+            *p &= ~mask;
+        }
+    }
+}
+
+void SplashScreen::fillSpan(int x, int y, int n, unsigned char value, unsigned char *line)
+{
+    unsigned char values[8];
+
+    if (n <= 0) {
+        return;
+    }
+    if (mat == nullptr) {
+        createMatrix();
+    }
+    if (spanMat == nullptr) {
+        createSpanMatrix();
+    }
+
+    // the thresholds are in [1, 255]: black and white don't depend on
+    // the screen
+    if (value == 0 || value == 255) {
+        const unsigned char fill = value ? 0xff : 0x00;
+        unsigned char *p = line + (x >> 3);
+        const int x1 = x + n; // exclusive
+        if ((x >> 3) == (x1 >> 3)) {
+            const int mask = (0xff >> (x & 7)) & ~(0xff >> (x1 & 7));
+            *p = (*p & ~mask) | (fill & mask);
+            return;
+        }
+        if (x & 7) {
+            const int mask = 0xff >> (x & 7);
+            *p = (*p & ~mask) | (fill & mask);
+            ++p;
+        }
+        const int nBytes = (x1 >> 3) - ((x + 7) >> 3);
+        memset(p, fill, nBytes);
+        p += nBytes;
+        if (x1 & 7) {
+            const int mask = ~(0xff >> (x1 & 7)) & 0xff;
+            *p = (*p & ~mask) | (fill & mask);
+        }
+        return;
+    }
+
+    memset(values, value, sizeof(values));
+    const unsigned char *row = spanMat + (y & sizeM1) * (size + splashScreenSpanPad);
+    unsigned char *p = line + (x >> 3);
+    int i = 0;
+    if (x & 7) {
+        const int k = std::min(8 - (x & 7), n);
+        testSpan(x, y, k, values, line);
+        i = k;
+        ++p;
+    }
+    for (; i + 8 <= n; i += 8) {
+        *p++ = thresholdByte(values, row + ((x + i) & sizeM1));
+    }
+    if (i < n) {
+        testSpan(x + i, y, n - i, values, line);
+    }
 }
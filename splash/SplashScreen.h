@@ -23,6 +23,11 @@
 
 #include "SplashTypes.h"
 
+// number of entries each row of the span threshold matrix extends past
+// the screen size, so that any eight consecutive entries can be read
+// without wrapping
+static constexpr int splashScreenSpanPad = 8;
+
 //------------------------------------------------------------------------
 // SplashScreen
 //------------------------------------------------------------------------
@@ -52,8 +57,17 @@ public:
         return value < mat[(yy << log2Size) + xx] ? 0 : 1;
     }
 
+    // Compute the pixel values for the <n> gray levels <values> at
+    // (<x>, <y>) .. (<x> + <n> - 1, <y>), and store them into the Mono1
+    // row <line>.  Whole bytes are thresholded eight pixels at a time.
+    void testSpan(int x, int y, int n, const unsigned char *values, unsigned char *line);
+
+    // Same as testSpan, for the constant gray level <value>.
+    void fillSpan(int x, int y, int n, unsigned char value, unsigned char *line);
+
 private:
     void createMatrix();
+    void createSpanMatrix();
 
     void buildDispersedMatrix(int i, int j, int val, int delta, int offset);
     void buildClusteredMatrix();
@@ -62,6 +76,8 @@ private:
 
     const SplashScreenParams *screenParams; // params to create the other members
     unsigned char *mat; // threshold matrix
+    unsigned char *spanMat; // threshold matrix with the rows extended
+                            //   periodically by splashScreenSpanPad entries
     int size; // size of the threshold matrix
     int sizeM1; // size - 1
     int log2Size; // log2(size)
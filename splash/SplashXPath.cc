@@ -267,106 +267,23 @@ void SplashXPath::grow(int nSegs)
 
 void SplashXPath::addCurve(double x0, double y0, double x1, double y1, double x2, double y2, double x3, double y3, double flatness)
 {
-    if (!curveData) {
-        // allocate on first use
-        curveData = std::make_unique<CurveData>();
-    }
-    double *cx = curveData->cx.data();
-    double *cy = curveData->cy.data();
-    int *cNext = curveData->cNext.data();
-
-    double xl0, xl1, xl2, xr0, xr1, xr2, xr3, xx1, xx2, xh;
-    double yl0, yl1, yl2, yr0, yr1, yr2, yr3, yy1, yy2, yh;
-    double dx, dy, mx, my, d1, d2, flatness2;
-    int p1, p2, p3;
-
-    flatness2 = flatness * flatness;
-
-    // initial segment
-    p1 = 0;
-    p2 = splashMaxCurveSplits;
-
-    *(cx + p1 * 3 + 0) = x0;
-    *(cx + p1 * 3 + 1) = x1;
-    *(cx + p1 * 3 + 2) = x2;
-    *(cx + p2 * 3 + 0) = x3;
-
-    *(cy + p1 * 3 + 0) = y0;
-    *(cy + p1 * 3 + 1) = y1;
-    *(cy + p1 * 3 + 2) = y2;
-    *(cy + p2 * 3 + 0) = y3;
-
-    *(cNext + p1) = p2;
-
-    while (p1 < splashMaxCurveSplits) {
-
-        // get the next segment
-        xl0 = *(cx + p1 * 3 + 0);
-        xx1 = *(cx + p1 * 3 + 1);
-        xx2 = *(cx + p1 * 3 + 2);
-
-        yl0 = *(cy + p1 * 3 + 0);
-        yy1 = *(cy + p1 * 3 + 1);
-        yy2 = *(cy + p1 * 3 + 2);
-
-        p2 = *(cNext + p1);
-
-        xr3 = *(cx + p2 * 3 + 0);
-        yr3 = *(cy + p2 * 3 + 0);
-
-        // compute the distances from the control points to the
-        // midpoint of the straight line (this is a bit of a hack, but
-        // it's much faster than computing the actual distances to the
-        // line)
-        mx = (xl0 + xr3) * 0.5;
-        my = (yl0 + yr3) * 0.5;
-        dx = xx1 - mx;
-        dy = yy1 - my;
-        d1 = dx * dx + dy * dy;
-        dx = xx2 - mx;
-        dy = yy2 - my;
-        d2 = dx * dx + dy * dy;
-
-        // if the curve is flat enough, or no more subdivisions are
-        // allowed, add the straight line segment
-        if (p2 - p1 == 1 || (d1 <= flatness2 && d2 <= flatness2)) {
-            addSegment(xl0, yl0, xr3, yr3);
-            p1 = p2;
-
-            // otherwise, subdivide the curve
-        } else {
-            xl1 = (xl0 + xx1) * 0.5;
-            yl1 = (yl0 + yy1) * 0.5;
-            xh = (xx1 + xx2) * 0.5;
-            yh = (yy1 + yy2) * 0.5;
-            xl2 = (xl1 + xh) * 0.5;
-            yl2 = (yl1 + yh) * 0.5;
-            xr2 = (xx2 + xr3) * 0.5;
-            yr2 = (yy2 + yr3) * 0.5;
-            xr1 = (xh + xr2) * 0.5;
-            yr1 = (yh + yr2) * 0.5;
-            xr0 = (xl2 + xr1) * 0.5;
-            yr0 = (yl2 + yr1) * 0.5;
-            // add the new subdivision points
-            p3 = (p1 + p2) / 2;
-
-            *(cx + p1 * 3 + 1) = xl1;
-            *(cx + p1 * 3 + 2) = xl2;
-
-            *(cy + p1 * 3 + 1) = yl1;
-            *(cy + p1 * 3 + 2) = yl2;
-
-            *(cNext + p1) = p3;
-
-            *(cx + p3 * 3 + 0) = xr0;
-            *(cx + p3 * 3 + 1) = xr1;
-            *(cx + p3 * 3 + 2) = xr2;
-
-            *(cy + p3 * 3 + 0) = yr0;
-            *(cy + p3 * 3 + 1) = yr1;
-            *(cy + p3 * 3 + 2) = yr2;
-
-            *(cNext + p3) = p2;
+    double xs[splashCurvePointsBlockSize], ys[splashCurvePointsBlockSize];
+    double xPrev, yPrev;
+    int n, i, j, count;
+
+    // the segment count is known up front, so all segments are
+    // allocated at once
+    n = splashCurveSegments(x0, y0, x1, y1, x2, y2, x3, y3, splashCurveFlatnessScale * flatness, splashMaxCurveSplits);
+    grow(n);
+    xPrev = x0;
+    yPrev = y0;
+    for (i = 0; i < n; i += count) {
+        count = n - i < splashCurvePointsBlockSize ? n - i : splashCurvePointsBlockSize;
+        splashCurvePoints(x0, y0, x1, y1, x2, y2, x3, y3, n, i, count, xs, ys);
+        for (j = 0; j < count; ++j) {
+            addSegment(xPrev, yPrev, xs[j], ys[j]);
+            xPrev = xs[j];
+            yPrev = ys[j];
         }
     }
 }
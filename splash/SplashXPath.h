@@ -34,6 +34,12 @@ struct SplashXPathAdjust;
 
 static constexpr int splashMaxCurveSplits = 1 << 10;
 
+// curves are flattened to within this fraction of the flatness
+static constexpr double splashCurveFlatnessScale = 0.5;
+
+// number of curve points evaluated at a time
+static constexpr int splashCurvePointsBlockSize = 64;
+
 //------------------------------------------------------------------------
 // SplashXPathSeg
 //------------------------------------------------------------------------
@@ -84,15 +90,8 @@ protected:
     SplashXPathSeg *segs;
     int length, size; // length and size of segs array
 
-    struct CurveData
-    {
-        std::array<double, (splashMaxCurveSplits + 1) * 3> cx;
-        std::array<double, (splashMaxCurveSplits + 1) * 3> cy;
-        std::array<int, splashMaxCurveSplits + 1> cNext;
-    };
-    std::unique_ptr<CurveData> curveData;
-
     friend class SplashXPathScanner;
+    friend class SplashXPathCoverageScanner;
     friend class SplashClip;
     friend class Splash;
 };
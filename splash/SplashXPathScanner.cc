@@ -404,87 +404,171 @@ void SplashXPathScanner::renderAALine(SplashBitmap *aaBuf, int *x0, int *x1, int
     *x1 = (xxMax - 1) / splashAASize;
 }
 
-void SplashXPathScanner::clipAALine(SplashBitmap *aaBuf, const int *x0, const int *x1, int y) const
+//------------------------------------------------------------------------
+// SplashXPathCoverageScanner
+//------------------------------------------------------------------------
+
+SplashXPathCoverageScanner::SplashXPathCoverageScanner(const SplashXPath &xPathA, bool eoA, int clipYMin, int clipYMax) : xPath(xPathA), eo(eoA)
 {
-    int yyMin = 0;
-    int yyMax = splashAASize - 1;
-    // clamp start and end position
-    if (yMin > splashAASize * y) {
-        yyMin = yMin - splashAASize * y;
+    // compute the bbox
+    if (xPath.length == 0) {
+        return;
     }
-    if (yyMax + splashAASize * y > yMax) {
-        yyMax = yMax - splashAASize * y;
+    if (clipYMin > clipYMax) {
+        return;
     }
-    int eoMask = eo ? 0x1 : ~0;
-    for (int yy = 0; yy < splashAASize; ++yy) {
-        int xx = *x0 * splashAASize;
-        if (yy >= yyMin && yy <= yyMax) {
-            const int intersectionIndex = splashAASize * y + yy - yMin;
-            if (unlikely(intersectionIndex < 0 || (unsigned)intersectionIndex >= allIntersections.size())) {
-                break;
-            }
-            const auto &line = allIntersections[intersectionIndex];
-            size_t interIdx = 0;
-            int interCount = 0;
-            while (interIdx < line.size() && xx < (*x1 + 1) * splashAASize) {
-                int xx0 = line[interIdx].x0;
-                int xx1 = line[interIdx].x1;
-                interCount += line[interIdx].count;
-                ++interIdx;
-                while (interIdx < line.size() && (line[interIdx].x0 <= xx1 || (interCount & eoMask))) {
-                    if (line[interIdx].x1 > xx1) {
-                        xx1 = line[interIdx].x1;
-                    }
-                    interCount += line[interIdx].count;
-                    ++interIdx;
-                }
-                if (xx0 > aaBuf->getWidth()) {
-                    xx0 = aaBuf->getWidth();
-                }
-                // set [xx, xx0) to 0
-                if (xx < xx0) {
-                    SplashColorPtr p = aaBuf->getDataPtr() + yy * aaBuf->getRowSize() + (xx >> 3);
-                    if (xx & 7) {
-                        auto mask = static_cast<unsigned char>(0xff00 >> (xx & 7));
-                        if ((xx & ~7) == (xx0 & ~7)) {
-                            mask |= 0xff >> (xx0 & 7);
-                        }
-                        *p++ &= mask;
-                        xx = (xx & ~7) + 8;
-                    }
-                    for (; xx + 7 < xx0; xx += 8) {
-                        *p++ = 0x00;
-                    }
-                    if (xx < xx0) {
-                        *p &= 0xff >> (xx0 & 7);
-                    }
-                }
-                if (xx1 >= xx) {
-                    xx = xx1 + 1;
-                }
-            }
+
+    double xMaxFP = std::numeric_limits<double>::lowest();
+    double xMinFP = std::numeric_limits<double>::max();
+    double yMaxFP = std::numeric_limits<double>::lowest();
+    double yMinFP = std::numeric_limits<double>::max();
+
+    const double clipYMinFP = clipYMin;
+    const double clipYMaxFP = clipYMax + 1.0;
+
+    for (int i = 0; i < xPath.length; ++i) {
+        const SplashXPathSeg *seg = &xPath.segs[i];
+        if (unlikely(std::isnan(seg->x0) || std::isnan(seg->x1) || std::isnan(seg->y0) || std::isnan(seg->y1))) {
+            return;
         }
-        int xx0 = (*x1 + 1) * splashAASize;
-        if (xx0 > aaBuf->getWidth()) {
-            xx0 = aaBuf->getWidth();
+        // horizontal segments don't contribute any coverage
+        if (seg->flags & splashXPathHoriz) {
+            continue;
         }
-        // set [xx, xx0) to 0
-        if (xx < xx0 && xx >= 0) {
-            SplashColorPtr p = aaBuf->getDataPtr() + yy * aaBuf->getRowSize() + (xx >> 3);
-            if (xx & 7) {
-                auto mask = static_cast<unsigned char>(0xff00 >> (xx & 7));
-                if ((xx & ~7) == (xx0 & ~7)) {
-                    mask &= 0xff >> (xx0 & 7);
-                }
-                *p++ &= mask;
-                xx = (xx & ~7) + 8;
-            }
-            for (; xx + 7 < xx0; xx += 8) {
-                *p++ = 0x00;
+        if (seg->y0 >= clipYMaxFP || seg->y1 <= clipYMinFP) {
+            continue;
+        }
+        yMinFP = std::min(yMinFP, seg->y0);
+        yMaxFP = std::max(yMaxFP, seg->y1);
+        xMinFP = std::min({ xMinFP, seg->x0, seg->x1 });
+        xMaxFP = std::max({ xMaxFP, seg->x0, seg->x1 });
+    }
+    if (yMinFP >= yMaxFP) {
+        return;
+    }
+
+    xMin = splashFloor(xMinFP);
+    xMax = splashFloor(xMaxFP);
+    yMin = splashFloor(yMinFP);
+    yMax = splashCeil(yMaxFP) - 1;
+    if (clipYMin > yMin) {
+        yMin = clipYMin;
+    }
+    if (clipYMax < yMax) {
+        yMax = clipYMax;
+    }
+    if (yMin > yMax || xMin > xMax) {
+        // This means the splashFloors overflowed/underflowed
+        xMin = yMin = 1;
+        xMax = yMax = 0;
+    }
+}
+
+SplashXPathCoverageScanner::~SplashXPathCoverageScanner() = default;
+
+void SplashXPathCoverageScanner::computeCells()
+{
+    if (yMin > yMax) {
+        return;
+    }
+    allCells.resize(yMax - yMin + 1);
+
+    for (int i = 0; i < xPath.length; ++i) {
+        const SplashXPathSeg *seg = &xPath.segs[i];
+        if (seg->flags & splashXPathHoriz) {
+            continue;
+        }
+        // segments are stored with y0 < y1, the direction only matters
+        // for the sign of the winding number
+        const double dir = (seg->flags & splashXPathFlipped) ? 1 : -1;
+        const double dxdy = (seg->flags & splashXPathVert) ? 0 : seg->dxdy;
+        const int y0 = std::max(splashFloor(seg->y0), yMin);
+        const int y1 = std::min(splashCeil(seg->y1) - 1, yMax);
+        for (int y = y0; y <= y1; ++y) {
+            const double ya = std::max(seg->y0, static_cast<double>(y));
+            const double yb = std::min(seg->y1, static_cast<double>(y + 1));
+            if (yb <= ya) {
+                continue;
             }
-            if (xx < xx0) {
-                *p &= 0xff >> (xx0 & 7);
+            const double xa = seg->x0 + (ya - seg->y0) * dxdy;
+            const double xb = seg->x0 + (yb - seg->y0) * dxdy;
+            addCells(allCells[y - yMin], xa, xb, dir * (yb - ya));
+        }
+    }
+}
+
+// Add the contribution of an edge piece inside one row, going from <xa>
+// to <xb> with (signed) height <h>.
+void SplashXPathCoverageScanner::addCells(std::vector<SplashCoverageCell> &cells, double xa, double xb, double h)
+{
+    const double xl = std::min(xa, xb);
+    const double xr = std::max(xa, xb);
+    int cx = splashFloor(xl);
+
+    if (xr - xl < 1e-9 || splashFloor(xr) == cx) {
+        const double m = 0.5 * (xl + xr) - cx;
+        cells.push_back({ cx, static_cast<float>(h), static_cast<float>(h * (1 - m)) });
+        return;
+    }
+
+    // split the piece at the cell boundaries, the height is divided
+    // proportionally to the width in each cell
+    const double hPerX = h / (xr - xl);
+    for (double px0 = xl; px0 < xr; ++cx) {
+        const double px1 = std::min(xr, static_cast<double>(cx + 1));
+        const double hc = hPerX * (px1 - px0);
+        const double m = 0.5 * (px0 + px1) - cx;
+        cells.push_back({ cx, static_cast<float>(hc), static_cast<float>(hc * (1 - m)) });
+        px0 = px1;
+    }
+}
+
+bool SplashXPathCoverageScanner::renderLine(unsigned char *line, int *x0, int *x1, int y)
+{
+    if (y < yMin || y > yMax) {
+        return false;
+    }
+    auto &cells = allCells[y - yMin];
+    if (cells.empty()) {
+        return false;
+    }
+    std::ranges::sort(cells, [](const SplashCoverageCell &c0, const SplashCoverageCell &c1) { return c0.x < c1.x; });
+
+    auto toShape = [this](double c) {
+        c = std::abs(c);
+        if (eo) {
+            c -= 2 * std::floor(0.5 * c);
+            if (c > 1) {
+                c = 2 - c;
             }
+        } else if (c > 1) {
+            c = 1;
+        }
+        return static_cast<unsigned char>(c * 255 + 0.5);
+    };
+
+    // the accumulated cover of all cells to the left is the coverage
+    // of the pixels between two cells
+    double acc = 0;
+    size_t i = 0;
+    int x = cells[0].x;
+    *x0 = x;
+    while (i < cells.size()) {
+        x = cells[i].x;
+        double area = 0, cover = 0;
+        for (; i < cells.size() && cells[i].x == x; ++i) {
+            area += cells[i].area;
+            cover += cells[i].cover;
+        }
+        line[x - xMin] = toShape(acc + area);
+        acc += cover;
+        if (i < cells.size() && cells[i].x > x + 1) {
+            memset(line + (x + 1 - xMin), toShape(acc), cells[i].x - x - 1);
         }
     }
+    *x1 = std::min(x, xMax);
+    if (*x1 < *x0) {
+        return false;
+    }
+    return true;
 }
@@ -78,11 +78,6 @@ public:
     // max x coordinates with non-zero pixels in <x0> and <x1>.
     void renderAALine(SplashBitmap *aaBuf, int *x0, int *x1, int y, bool adjustVertLine = false) const;
 
-    // Clips an anti-aliased line by setting pixels to zero.  On entry,
-    // all non-zero pixels are between <x0> and <x1>.  This function
-    // will update <x0> and <x1>.
-    void clipAALine(SplashBitmap *aaBuf, const int *x0, const int *x1, int y) const;
-
 private:
     void computeIntersections(const SplashXPath &xPath);
     void addIntersection(double segYMin, int y, int x0, int x1, int count);
@@ -100,6 +95,62 @@ private:
     friend class SplashXPathScanIterator;
 };
 
+//------------------------------------------------------------------------
+// SplashXPathCoverageScanner
+//------------------------------------------------------------------------
+
+struct SplashCoverageCell
+{
+    int x;
+    float cover; // signed height of the edges crossing this cell
+    float area; // signed area covered to the right of those edges
+};
+
+// Computes the exact area of each pixel covered by a path, from signed
+// edge contributions accumulated per cell (only cells crossed by an
+// edge are stored).  This is an alternative to the 4x4 supersampling
+// done with SplashXPathScanner::renderAALine.
+class SplashXPathCoverageScanner
+{
+public:
+    // Create a new SplashXPathCoverageScanner object.  Unlike with
+    // SplashXPathScanner, <xPathA> must not be scaled by aaScale.  Only
+    // the bounding box is computed here, see computeCells.
+    SplashXPathCoverageScanner(const SplashXPath &xPathA, bool eoA, int clipYMin, int clipYMax);
+
+    ~SplashXPathCoverageScanner();
+
+    SplashXPathCoverageScanner(const SplashXPathCoverageScanner &) = delete;
+    SplashXPathCoverageScanner &operator=(const SplashXPathCoverageScanner &) = delete;
+
+    // Return the path's bounding box.
+    void getBBox(int *xMinA, int *yMinA, int *xMaxA, int *yMaxA) const
+    {
+        *xMinA = xMin;
+        *yMinA = yMin;
+        *xMaxA = xMax;
+        *yMaxA = yMax;
+    }
+
+    // Accumulate the edge cells.  Must be called before renderLine.
+    void computeCells();
+
+    // Renders the coverage (0 - 255) of line <y> into <line>, which is
+    // indexed from the bbox xMin.  Returns false if the line is empty,
+    // otherwise the min and max x coordinates of the rendered pixels in
+    // <x0> and <x1>.
+    bool renderLine(unsigned char *line, int *x0, int *x1, int y);
+
+private:
+    void addCells(std::vector<SplashCoverageCell> &cells, double xa, double xb, double h);
+
+    const SplashXPath &xPath;
+    const bool eo;
+    int xMin = 1, yMin = 1, xMax = 0, yMax = 0;
+
+    std::vector<std::vector<SplashCoverageCell>> allCells;
+};
+
 class SplashXPathScanIterator
 {
 public:
@@ -0,0 +1,1032 @@
+//========================================================================
+//
+// pdf-check.cc
+//
+// The checks run by the tests on the output of the utils and on
+// rendering.  The first argument is a command, which either writes a
+// test document, or checks what a util wrote or how a document renders.  The exit status is 1
+// if the check fails.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "GfxFont.h"
+#include "GfxState.h"
+#include "GlobalParams.h"
+#include "OutputDev.h"
+#include "PDFDoc.h"
+#include "SplashOutputDev.h"
+#include "XRef.h"
+#include "fofi/FoFiTrueType.h"
+#include "goo/GooString.h"
+#include "splash/SplashBitmap.h"
+#include "splash/SplashFTFacePool.h"
+#include "splash/SplashFontFile.h"
+#include "utils/parseargs.h"
+
+static double resolution = 36;
+static bool printHelp = false;
+
+static const ArgDesc argDesc[] = { { .arg = "-r", .kind = argFP, .val = &resolution, .size = 0, .usage = "resolution used to render pages, in DPI (default is 36)" },
+                                   { .arg = "-h", .kind = argFlag, .val = &printHelp, .size = 0, .usage = "print usage information" },
+                                   { .arg = "-help", .kind = argFlag, .val = &printHelp, .size = 0, .usage = "print usage information" },
+                                   { .arg = "--help", .kind = argFlag, .val = &printHelp, .size = 0, .usage = "print usage information" },
+                                   { .arg = "-?", .kind = argFlag, .val = &printHelp, .size = 0, .usage = "print usage information" },
+                                   {} };
+
+//------------------------------------------------------------------------
+// helpers
+//------------------------------------------------------------------------
+
+static std::optional<std::string> readFile(const std::string &fileName)
+{
+    std::ifstream in(fileName, std::ios::binary);
+    if (!in) {
+        return {};
+    }
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// Writes a PDF file made of <objs>, object i + 1 being objs[i], with
+// object 1 as the catalog.
+static bool writePDF(const char *fileName, const std::vector<std::string> &objs)
+{
+    std::string pdf = "%PDF-1.4\n";
+    std::vector<size_t> offsets;
+    for (size_t i = 0; i < objs.size(); ++i) {
+        offsets.push_back(pdf.size());
+        pdf += std::to_string(i + 1) + " 0 obj\n" + objs[i] + "\nendobj\n";
+    }
+    const size_t xrefOffset = pdf.size();
+    pdf += "xref\n0 " + std::to_string(objs.size() + 1) + "\n0000000000 65535 f \n";
+    for (const size_t offset : offsets) {
+        char entry[32];
+        snprintf(entry, sizeof(entry), "%010zu 00000 n \n", offset);
+        pdf += entry;
+    }
+    pdf += "trailer\n<< /Size " + std::to_string(objs.size() + 1) + " /Root 1 0 R >>\nstartxref\n" + std::to_string(xrefOffset) + "\n%%EOF\n";
+
+    std::ofstream out(fileName, std::ios::binary);
+    out << pdf;
+    if (!out) {
+        fprintf(stderr, "Couldn't write %s\n", fileName);
+        return false;
+    }
+    return true;
+}
+
+static std::string ref(int num)
+{
+    return std::to_string(num) + " 0 R";
+}
+
+static std::unique_ptr<PDFDoc> openDoc(const char *fileName)
+{
+    auto doc = std::make_unique<PDFDoc>(std::make_unique<GooString>(fileName));
+    if (!doc->isOk()) {
+        fprintf(stderr, "Error loading %s\n", fileName);
+        return nullptr;
+    }
+    return doc;
+}
+
+//------------------------------------------------------------------------
+// render-compare FILE-A FILE-B
+//
+// Renders every page of two documents and checks that they look the
+// same, e.g. a document and a copy of it written by a different path.
+//------------------------------------------------------------------------
+
+static bool sameBitmaps(SplashBitmap *bitmapA, SplashBitmap *bitmapB)
+{
+    if (bitmapA->getWidth() != bitmapB->getWidth() || bitmapA->getHeight() != bitmapB->getHeight()) {
+        return false;
+    }
+    // compare the pixels only, not the row padding
+    const size_t rowLength = static_cast<size_t>(bitmapA->getWidth()) * 3;
+    for (int y = 0; y < bitmapA->getHeight(); ++y) {
+        if (memcmp(bitmapA->getDataPtr() + static_cast<size_t>(y) * bitmapA->getRowSize(), bitmapB->getDataPtr() + static_cast<size_t>(y) * bitmapB->getRowSize(), rowLength) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool renderCompare(char *args[])
+{
+    const std::unique_ptr<PDFDoc> docA = openDoc(args[0]);
+    const std::unique_ptr<PDFDoc> docB = openDoc(args[1]);
+    if (!docA || !docB) {
+        return false;
+    }
+    if (docA->getNumPages() != docB->getNumPages()) {
+        fprintf(stderr, "Different number of pages (%d != %d)\n", docA->getNumPages(), docB->getNumPages());
+        return false;
+    }
+
+    SplashColor paperColor = { 0xff, 0xff, 0xff };
+    SplashOutputDev outA(splashModeRGB8, 4, paperColor);
+    SplashOutputDev outB(splashModeRGB8, 4, paperColor);
+    outA.startDoc(docA.get());
+    outB.startDoc(docB.get());
+
+    bool ok = true;
+    for (int page = 1; page <= docA->getNumPages(); ++page) {
+        docA->displayPage(&outA, page, resolution, resolution, 0, false, true, false);
+        docB->displayPage(&outB, page, resolution, resolution, 0, false, true, false);
+        if (!sameBitmaps(outA.getBitmap(), outB.getBitmap())) {
+            fprintf(stderr, "Page %d renders differently\n", page);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+//------------------------------------------------------------------------
+// dedup-compare MERGED DEDUPED
+//
+// Checks that a merge written with pdfunite -dedup has fewer objects
+// and is smaller than the same merge written without it.
+//------------------------------------------------------------------------
+
+static bool isInUse(const XRefEntry *entry)
+{
+    return entry->type == xrefEntryUncompressed || entry->type == xrefEntryCompressed;
+}
+
+static int countObjects(PDFDoc *doc)
+{
+    XRef *xref = doc->getXRef();
+    int n = 0;
+    for (int i = 1; i < xref->getNumObjects(); ++i) {
+        if (isInUse(xref->getEntry(i, false))) {
+            ++n;
+        }
+    }
+    return n;
+}
+
+static bool dedupCompare(char *args[])
+{
+    const std::unique_ptr<PDFDoc> merged = openDoc(args[0]);
+    const std::unique_ptr<PDFDoc> deduped = openDoc(args[1]);
+    if (!merged || !deduped) {
+        return false;
+    }
+    bool ok = true;
+    const int nMerged = countObjects(merged.get());
+    const int nDeduped = countObjects(deduped.get());
+    if (nDeduped >= nMerged) {
+        fprintf(stderr, "%s has %d objects, %s has %d\n", args[1], nDeduped, args[0], nMerged);
+        ok = false;
+    }
+    const Goffset sizeMerged = merged->getBaseStream()->getLength();
+    const Goffset sizeDeduped = deduped->getBaseStream()->getLength();
+    if (sizeDeduped >= sizeMerged) {
+        fprintf(stderr, "%s has %lld bytes, %s has %lld\n", args[1], static_cast<long long>(sizeDeduped), args[0], static_cast<long long>(sizeMerged));
+        ok = false;
+    }
+    return ok;
+}
+
+//------------------------------------------------------------------------
+// images-write PDF-FILE
+// images-compare SERIAL-ROOT PARALLEL-ROOT
+//
+// Checks the images written by pdfimages -parallel against the ones
+// written by a serial run: every entry of <parallel-root>.idx must be in
+// the same file as the serial image of the same rank.  The test
+// document has pages that share image objects, masks and soft masks,
+// and inline images.
+//------------------------------------------------------------------------
+
+static const int nImagesPages = 5;
+
+// Returns a w x h image with <comps> components, different for each <seed>.
+static std::string makePixels(int w, int h, int comps, int seed)
+{
+    std::string data;
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w * comps; ++x) {
+            data.push_back(static_cast<char>((x * 37 + y * 11 + seed * 53) & 0xff));
+        }
+    }
+    return data;
+}
+
+static std::string makeImage(int w, int h, const char *colorSpace, int seed, const std::string &extra = {})
+{
+    const int comps = strcmp(colorSpace, "DeviceRGB") == 0 ? 3 : 1;
+    const std::string data = makePixels(w, h, comps, seed);
+    return "<< /Type /XObject /Subtype /Image /Width " + std::to_string(w) + " /Height " + std::to_string(h) + " /ColorSpace /" + colorSpace + " /BitsPerComponent 8" + extra + " /Length " + std::to_string(data.size()) + " >>\nstream\n" + data
+            + "\nendstream";
+}
+
+// Writes a document where every page draws:
+// - an image object shared by all the pages,
+// - an image object of its own,
+// - an image with a soft mask and an image with a stencil mask, shared
+//   by the even pages,
+// - an inline image.
+static bool imagesWrite(char *args[])
+{
+    std::vector<std::string> objs;
+    auto add = [&](std::string obj) {
+        objs.push_back(std::move(obj));
+        return static_cast<int>(objs.size());
+    };
+
+    const int catalog = add({});
+    const int pagesNode = add({});
+    const int shared = add(makeImage(16, 12, "DeviceRGB", 1));
+    const int smask = add(makeImage(16, 12, "DeviceGray", 2));
+    const int softMasked = add(makeImage(16, 12, "DeviceRGB", 3, " /SMask " + ref(smask)));
+    const std::string stencilBits = makePixels(2, 12, 1, 4);
+    const int stencil = add("<< /Type /XObject /Subtype /Image /Width 16 /Height 12 /ImageMask true /BitsPerComponent 1 /Length " + std::to_string(stencilBits.size()) + " >>\nstream\n" + stencilBits + "\nendstream");
+    const int masked = add(makeImage(16, 12, "DeviceGray", 5, " /Mask " + ref(stencil)));
+
+    std::string kids;
+    for (int pg = 1; pg <= nImagesPages; ++pg) {
+        const int own = add(makeImage(8, 8, "DeviceGray", 10 + pg));
+        std::string content = "q 100 0 0 80 10 10 cm /Shared Do Q q 50 0 0 50 120 10 cm /Own Do Q ";
+        std::string xobjects = "/Shared " + ref(shared) + " /Own " + ref(own);
+        if (pg % 2 == 0) {
+            content += "q 60 0 0 40 10 100 cm /SoftMasked Do Q q 60 0 0 40 80 100 cm /Masked Do Q ";
+            xobjects += " /SoftMasked " + ref(softMasked) + " /Masked " + ref(masked);
+        }
+        content += "q 30 0 0 30 150 100 cm BI /W 4 /H 4 /CS /G /BPC 8 ID\n" + makePixels(4, 4, 1, 20 + pg) + "\nEI Q\n";
+        const int contents = add("<< /Length " + std::to_string(content.size()) + " >>\nstream\n" + content + "\nendstream");
+        const int page = add("<< /Type /Page /Parent " + ref(pagesNode) + " /MediaBox [0 0 200 160] /Resources << /XObject << " + xobjects + " >> >> /Contents " + ref(contents) + " >>");
+        kids += ref(page) + " ";
+    }
+    objs[catalog - 1] = "<< /Type /Catalog /Pages " + ref(pagesNode) + " >>";
+    objs[pagesNode - 1] = "<< /Type /Pages /Kids [" + kids + "] /Count " + std::to_string(nImagesPages) + " >>";
+    return writePDF(args[0], objs);
+}
+
+static std::string serialFileName(const std::string &root, size_t rank, const std::string &ext)
+{
+    char num[16];
+    snprintf(num, sizeof(num), "-%03zu.", rank);
+    return root + num + ext;
+}
+
+// Compares the files listed in <parallelRoot>.idx, in order, with the
+// files <serialRoot>-NNN.<ext> of the serial run.
+static bool imagesCompare(char *args[])
+{
+    const std::string serialRoot = args[0];
+    const std::string parallelRoot = args[1];
+    std::ifstream index(parallelRoot + ".idx");
+    std::string line;
+    if (!index || !std::getline(index, line)) {
+        fprintf(stderr, "Couldn't read %s.idx\n", parallelRoot.c_str());
+        return false;
+    }
+
+    bool ok = true;
+    size_t rank = 0;
+    for (; std::getline(index, line); ++rank) {
+        // the file name is the rest of the line, after the page, number,
+        // type, size and object (or "[inline]")
+        std::istringstream fields(line);
+        int page, num, width, height, gen;
+        std::string type, object, fileName;
+        fields >> page >> num >> type >> width >> height >> object;
+        if (object != "[inline]") {
+            fields >> gen;
+        }
+        std::getline(fields >> std::ws, fileName);
+        const size_t dot = fileName.rfind('.');
+        if (!fields || dot == std::string::npos) {
+            fprintf(stderr, "Image %zu has no file: %s\n", rank, line.c_str());
+            ok = false;
+            continue;
+        }
+        const std::string serialName = serialFileName(serialRoot, rank, fileName.substr(dot + 1));
+        const std::optional<std::string> parallelData = readFile(fileName);
+        const std::optional<std::string> serialData = readFile(serialName);
+        if (!parallelData || !serialData || parallelData.value() != serialData.value()) {
+            fprintf(stderr, "Image %zu: %s differs from %s\n", rank, fileName.c_str(), serialName.c_str());
+            ok = false;
+        }
+    }
+    if (rank == 0) {
+        fprintf(stderr, "No image in %s.idx\n", parallelRoot.c_str());
+        return false;
+    }
+    // the serial run mustn't have found more images
+    for (const char *ext : { "png", "ppm", "pgm", "pbm" }) {
+        if (readFile(serialFileName(serialRoot, rank, ext))) {
+            fprintf(stderr, "%s.idx has %zu images, the serial run found more\n", parallelRoot.c_str(), rank);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+//------------------------------------------------------------------------
+// separate-compare SERIAL-PATTERN PARALLEL-PATTERN
+//
+// Checks the pages written by a parallel pdfseparate run against the
+// ones written by a serial run: both runs must have written the same
+// pages, each to a one page file with the same objects.  Only the
+// trailers may differ, since the file IDs depend on the file names.  The
+// patterns are the pdfseparate destination patterns, with one %d.
+//------------------------------------------------------------------------
+
+static std::string pageFileName(const char *pattern, int page)
+{
+    char name[4096];
+    snprintf(name, sizeof(name), pattern, page);
+    return name;
+}
+
+// Compares two objects, the references themselves and not the objects
+// they refer to, and streams by their decoded data.
+static bool sameObject(const Object &objA, const Object &objB)
+{
+    if (objA.getType() != objB.getType()) {
+        return false;
+    }
+    switch (objA.getType()) {
+    case objBool:
+        return objA.getBool() == objB.getBool();
+    case objInt:
+    case objInt64:
+        return objA.getIntOrInt64() == objB.getIntOrInt64();
+    case objReal:
+        return objA.getReal() == objB.getReal();
+    case objString:
+    case objHexString:
+        return objA.getString() == objB.getString();
+    case objName:
+        return strcmp(objA.getName(), objB.getName()) == 0;
+    case objRef:
+        return objA.getRef() == objB.getRef();
+    case objArray:
+        if (objA.arrayGetLength() != objB.arrayGetLength()) {
+            return false;
+        }
+        for (int i = 0; i < objA.arrayGetLength(); ++i) {
+            if (!sameObject(objA.getArray()->getNF(i), objB.getArray()->getNF(i))) {
+                return false;
+            }
+        }
+        return true;
+    case objDict:
+    case objStream: {
+        const Dict *dictA = objA.isStream() ? objA.getStream()->getDict() : objA.getDict();
+        const Dict *dictB = objB.isStream() ? objB.getStream()->getDict() : objB.getDict();
+        if (dictA->getLength() != dictB->getLength()) {
+            return false;
+        }
+        for (int i = 0; i < dictA->getLength(); ++i) {
+            if (dictA->getKey(i) != dictB->getKey(i) || !sameObject(dictA->getValNF(i), dictB->getValNF(i))) {
+                return false;
+            }
+        }
+        return !objA.isStream() || objA.getStream()->toUnsignedChars() == objB.getStream()->toUnsignedChars();
+    }
+    default:
+        return true;
+    }
+}
+
+static bool sameObjects(PDFDoc *docA, PDFDoc *docB)
+{
+    XRef *xrefA = docA->getXRef();
+    XRef *xrefB = docB->getXRef();
+    if (xrefA->getNumObjects() != xrefB->getNumObjects() || xrefA->getRoot() != xrefB->getRoot()) {
+        return false;
+    }
+    for (int i = 1; i < xrefA->getNumObjects(); ++i) {
+        const XRefEntry *entryA = xrefA->getEntry(i, false);
+        const XRefEntry *entryB = xrefB->getEntry(i, false);
+        if (isInUse(entryA) != isInUse(entryB)) {
+            return false;
+        }
+        if (!isInUse(entryA)) {
+            continue;
+        }
+        const Object objA = xrefA->fetch(i, entryA->gen);
+        const Object objB = xrefB->fetch(i, entryB->gen);
+        // a cross-reference stream is the trailer
+        if (objA.isStream() && objA.getStream()->getDict()->is("XRef") && objB.isStream() && objB.getStream()->getDict()->is("XRef")) {
+            continue;
+        }
+        if (!sameObject(objA, objB)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool separateCompare(char *args[])
+{
+    bool ok = true;
+    int page = 1;
+    for (;; ++page) {
+        const std::string serialName = pageFileName(args[0], page);
+        const std::string parallelName = pageFileName(args[1], page);
+        const bool hasSerial = readFile(serialName).has_value();
+        const bool hasParallel = readFile(parallelName).has_value();
+        if (!hasSerial || !hasParallel) {
+            if (hasSerial || hasParallel) {
+                fprintf(stderr, "Page %d was only written to %s\n", page, hasSerial ? serialName.c_str() : parallelName.c_str());
+                ok = false;
+            }
+            break;
+        }
+        const std::unique_ptr<PDFDoc> serialDoc = openDoc(serialName.c_str());
+        const std::unique_ptr<PDFDoc> parallelDoc = openDoc(parallelName.c_str());
+        if (!serialDoc || !parallelDoc || parallelDoc->getNumPages() != 1) {
+            fprintf(stderr, "%s doesn't have exactly one page\n", parallelName.c_str());
+            ok = false;
+        } else if (!sameObjects(serialDoc.get(), parallelDoc.get())) {
+            fprintf(stderr, "Page %d: %s has different objects than %s\n", page, parallelName.c_str(), serialName.c_str());
+            ok = false;
+        }
+    }
+    if (page <= 2) {
+        fprintf(stderr, "Fewer than 2 pages found for %s\n", args[0]);
+        return false;
+    }
+    return ok;
+}
+
+//------------------------------------------------------------------------
+// subset-fonts PDF-FILE FULL-PS SUBSET-PS
+//
+// Checks the TrueType fonts that pdftops -subsetfonts subsets, given the
+// output of pdftops on PDF-FILE without (FULL-PS) and with (SUBSET-PS)
+// -subsetfonts.  The glyph descriptions are read back from the sfnts
+// arrays of both: the subset fonts must drop glyphs, must not change
+// those they keep, and must keep every glyph drawn on the pages.
+//------------------------------------------------------------------------
+
+// The glyph descriptions of a TrueType font, by GID.
+using Glyphs = std::vector<std::span<const unsigned char>>;
+
+// Records the codes drawn with each font.
+class FontCodesOutputDev : public OutputDev
+{
+public:
+    struct DrawnFont
+    {
+        std::shared_ptr<GfxFont> font;
+        std::vector<bool> codes;
+    };
+
+    bool upsideDown() override { return true; }
+    bool useDrawChar() override { return true; }
+    bool interpretType3Chars() override { return false; }
+
+    void drawChar(GfxState *state, double /*x*/, double /*y*/, double /*dx*/, double /*dy*/, double /*originX*/, double /*originY*/, CharCode code, int /*nBytes*/, const Unicode * /*u*/, int /*uLen*/) override
+    {
+        const std::shared_ptr<GfxFont> &font = state->getFont();
+        if (!font) {
+            return;
+        }
+        DrawnFont &drawn = fonts[*font->getID()];
+        drawn.font = font;
+        if (code >= drawn.codes.size()) {
+            drawn.codes.resize(code + 1, false);
+        }
+        drawn.codes[code] = true;
+    }
+
+    std::unordered_map<Ref, DrawnFont> fonts;
+};
+
+static int getU16(std::span<const unsigned char> data, size_t pos)
+{
+    return pos + 2 <= data.size() ? (data[pos] << 8) | data[pos + 1] : -1;
+}
+
+static long getU32(std::span<const unsigned char> data, size_t pos)
+{
+    return pos + 4 <= data.size() ? (static_cast<long>(data[pos]) << 24) | (data[pos + 1] << 16) | (data[pos + 2] << 8) | data[pos + 3] : -1;
+}
+
+// Rebuilds the sfnts of the Type 42 fonts and CIDFonts of <ps>, from
+// their /sfnts arrays, in order.  Every string written by FoFiTrueType
+// ends with an extra zero byte, except the strings a long table is split
+// into, which have an even length.
+static std::vector<std::vector<unsigned char>> readSfnts(const std::string &ps)
+{
+    std::vector<std::vector<unsigned char>> sfnts;
+    size_t pos = 0;
+    while ((pos = ps.find("/sfnts [", pos)) != std::string::npos) {
+        pos += 8;
+        std::vector<unsigned char> sfnt;
+        while (true) {
+            pos = ps.find_first_not_of(" \n", pos);
+            if (pos == std::string::npos || ps[pos] != '<') {
+                break;
+            }
+            const size_t end = ps.find('>', pos);
+            if (end == std::string::npos) {
+                return {};
+            }
+            std::vector<unsigned char> str;
+            int digits = 0, byte = 0;
+            for (size_t i = pos + 1; i < end; ++i) {
+                const char c = ps[i];
+                if (c == '\n') {
+                    continue;
+                }
+                const int value = c >= 'a' ? c - 'a' + 10 : c - '0';
+                byte = (byte << 4) | value;
+                if (++digits == 2) {
+                    str.push_back(static_cast<unsigned char>(byte));
+                    digits = byte = 0;
+                }
+            }
+            if (str.size() & 1) {
+                str.pop_back();
+            }
+            sfnt.insert(sfnt.end(), str.begin(), str.end());
+            pos = end + 1;
+        }
+        sfnts.push_back(std::move(sfnt));
+    }
+    return sfnts;
+}
+
+// Splits the glyf table of <sfnt> into the glyph descriptions.
+static std::optional<Glyphs> readGlyphs(std::span<const unsigned char> sfnt)
+{
+    long headPos = -1, locaPos = -1, glyfPos = -1, maxpPos = -1, glyfLen = 0;
+    const int nTables = getU16(sfnt, 4);
+    for (int i = 0; i < nTables; ++i) {
+        const size_t entry = 12 + 16 * i;
+        const std::string_view tag(reinterpret_cast<const char *>(sfnt.data()) + entry, entry + 4 <= sfnt.size() ? 4 : 0);
+        const long offset = getU32(sfnt, entry + 8);
+        if (tag == "head") {
+            headPos = offset;
+        } else if (tag == "loca") {
+            locaPos = offset;
+        } else if (tag == "glyf") {
+            glyfPos = offset;
+            glyfLen = getU32(sfnt, entry + 12);
+        } else if (tag == "maxp") {
+            maxpPos = offset;
+        }
+    }
+    if (headPos < 0 || locaPos < 0 || glyfPos < 0 || maxpPos < 0) {
+        return {};
+    }
+    const int locaFmt = getU16(sfnt, headPos + 50);
+    const int nGlyphs = getU16(sfnt, maxpPos + 4);
+    if (nGlyphs < 0 || locaFmt < 0) {
+        return {};
+    }
+    auto getLoca = [&](int gid) { return locaFmt ? getU32(sfnt, locaPos + 4 * gid) : 2 * static_cast<long>(getU16(sfnt, locaPos + 2 * gid)); };
+    Glyphs glyphs;
+    for (int gid = 0; gid < nGlyphs; ++gid) {
+        const long start = getLoca(gid);
+        const long end = getLoca(gid + 1);
+        if (start < 0 || end < start || end > glyfLen || static_cast<size_t>(glyfPos + end) > sfnt.size()) {
+            return {};
+        }
+        glyphs.push_back(sfnt.subspan(glyfPos + start, end - start));
+    }
+    return glyphs;
+}
+
+static size_t getGlyphsSize(const Glyphs &glyphs)
+{
+    size_t size = 0;
+    for (const std::span<const unsigned char> glyph : glyphs) {
+        size += glyph.size();
+    }
+    return size;
+}
+
+// Returns the GIDs of the components of a composite glyph.
+static std::vector<int> getComponents(std::span<const unsigned char> glyph)
+{
+    std::vector<int> components;
+    if (glyph.size() < 10 || getU16(glyph, 0) < 0x8000) {
+        return components;
+    }
+    size_t pos = 10;
+    while (pos + 4 <= glyph.size()) {
+        const int flags = getU16(glyph, pos);
+        components.push_back(getU16(glyph, pos + 2));
+        pos += (flags & 0x0001) ? 8 : 6;
+        if (flags & 0x0008) {
+            pos += 2;
+        } else if (flags & 0x0040) {
+            pos += 4;
+        } else if (flags & 0x0080) {
+            pos += 8;
+        }
+        if (!(flags & 0x0020)) {
+            break;
+        }
+    }
+    return components;
+}
+
+// Returns true if <subset> has the same description as <orig> for the
+// (non-empty) glyph <gid>.  The descriptions of the subset are padded
+// to a multiple of 4 bytes.
+static bool sameGlyph(const Glyphs &orig, const Glyphs &subset, int gid)
+{
+    const std::span<const unsigned char> glyph = orig[gid];
+    return gid < static_cast<int>(subset.size()) && subset[gid].size() >= glyph.size() && std::ranges::equal(glyph, subset[gid].first(glyph.size()));
+}
+
+// Returns true if <subset> keeps the glyph <gid> of <orig> and, for
+// composite glyphs, their components.
+static bool keepsGlyph(const Glyphs &orig, const Glyphs &subset, int gid, std::vector<bool> *checked)
+{
+    if (gid < 0 || gid >= static_cast<int>(orig.size()) || (*checked)[gid]) {
+        return true;
+    }
+    (*checked)[gid] = true;
+    if (!sameGlyph(orig, subset, gid)) {
+        return false;
+    }
+    return std::ranges::all_of(getComponents(orig[gid]), [&](int component) { return keepsGlyph(orig, subset, component, checked); });
+}
+
+// Returns the GIDs drawn with <drawn> if it is an embedded TrueType
+// font, and its glyph descriptions in <fontBuf>.
+static std::optional<std::vector<int>> getDrawnGlyphs(PDFDoc *doc, const FontCodesOutputDev::DrawnFont &drawn, std::optional<std::vector<unsigned char>> *fontBuf)
+{
+    GfxFont *font = drawn.font.get();
+    const GfxFontType type = font->getType();
+    if (type != fontTrueType && type != fontCIDType2) {
+        return {};
+    }
+    *fontBuf = font->readEmbFontFile(doc->getXRef());
+    if (!*fontBuf) {
+        return {};
+    }
+    const std::unique_ptr<FoFiTrueType> ffTT = FoFiTrueType::make(std::span(fontBuf->value()), 0);
+    if (!ffTT || ffTT->isOpenTypeCFF()) {
+        return {};
+    }
+    const std::vector<int> codeToGID = type == fontTrueType ? static_cast<Gfx8BitFont *>(font)->getCodeToGIDMap(ffTT.get()) : static_cast<GfxCIDFont *>(font)->getCIDToGID();
+    std::vector<int> gids;
+    for (size_t code = 0; code < drawn.codes.size(); ++code) {
+        if (drawn.codes[code]) {
+            gids.push_back(codeToGID.empty() ? static_cast<int>(code) : code < codeToGID.size() ? codeToGID[code] : -1);
+        }
+    }
+    return gids;
+}
+
+static bool subsetFonts(char *args[])
+{
+    const std::unique_ptr<PDFDoc> doc = openDoc(args[0]);
+    const std::optional<std::string> fullPs = readFile(args[1]);
+    const std::optional<std::string> subsetPs = readFile(args[2]);
+    if (!doc || !fullPs || !subsetPs) {
+        if (doc) {
+            fprintf(stderr, "Couldn't read %s\n", fullPs ? args[2] : args[1]);
+        }
+        return false;
+    }
+
+    // the fonts are written in the same order with and without
+    // -subsetfonts
+    const std::vector<std::vector<unsigned char>> fullSfnts = readSfnts(fullPs.value());
+    const std::vector<std::vector<unsigned char>> subsetSfnts = readSfnts(subsetPs.value());
+    if (fullSfnts.empty() || fullSfnts.size() != subsetSfnts.size()) {
+        fprintf(stderr, "Found %zu TrueType fonts in %s and %zu in %s\n", fullSfnts.size(), args[1], subsetSfnts.size(), args[2]);
+        return false;
+    }
+    std::vector<Glyphs> subsets;
+    bool ok = true;
+    for (size_t i = 0; i < fullSfnts.size(); ++i) {
+        const std::optional<Glyphs> full = readGlyphs(fullSfnts[i]);
+        std::optional<Glyphs> subset = readGlyphs(subsetSfnts[i]);
+        if (!full || !subset || full->size() != subset->size()) {
+            fprintf(stderr, "Font %zu: couldn't read the glyphs, or the glyph counts differ\n", i);
+            ok = false;
+            continue;
+        }
+        for (size_t gid = 0; gid < subset->size(); ++gid) {
+            if (!(*subset)[gid].empty() && !sameGlyph(full.value(), subset.value(), static_cast<int>(gid))) {
+                fprintf(stderr, "Font %zu: glyph %zu differs from the full font\n", i, gid);
+                ok = false;
+            }
+        }
+        const size_t fullSize = getGlyphsSize(full.value());
+        const size_t subsetSize = getGlyphsSize(subset.value());
+        if (subsetSize >= fullSize) {
+            fprintf(stderr, "Font %zu: the subset glyphs take %zu bytes, the full font %zu\n", i, subsetSize, fullSize);
+            ok = false;
+        }
+        subsets.push_back(std::move(subset.value()));
+    }
+
+    // every glyph drawn with an embedded TrueType font, and its
+    // components, must be kept by one of the subset fonts made from it
+    FontCodesOutputDev scan;
+    for (int page = 1; page <= doc->getNumPages(); ++page) {
+        doc->displayPage(&scan, page, 72, 72, 0, true, false, false);
+    }
+    int nFonts = 0;
+    for (const auto &[id, drawn] : scan.fonts) {
+        std::optional<std::vector<unsigned char>> fontBuf;
+        const std::optional<std::vector<int>> gids = getDrawnGlyphs(doc.get(), drawn, &fontBuf);
+        const std::optional<Glyphs> orig = gids ? readGlyphs(fontBuf.value()) : std::nullopt;
+        if (!orig) {
+            continue;
+        }
+        ++nFonts;
+        const bool kept = std::ranges::any_of(subsets, [&](const Glyphs &subset) {
+            if (subset.size() != orig->size()) {
+                return false;
+            }
+            std::vector<bool> checked(orig->size(), false);
+            return std::ranges::all_of(gids.value(), [&](int gid) { return keepsGlyph(orig.value(), subset, gid, &checked); });
+        });
+        if (!kept) {
+            fprintf(stderr, "%s: no subset font keeps the %zu glyphs drawn\n", drawn.font->getName() ? drawn.font->getName()->c_str() : "(unnamed)", gids->size());
+            ok = false;
+        }
+    }
+    if (nFonts == 0) {
+        fprintf(stderr, "No embedded TrueType font drawn in %s\n", args[0]);
+        return false;
+    }
+    return ok;
+}
+
+//------------------------------------------------------------------------
+// face-pool PDF-FILE
+//
+// Checks how SplashFTFacePool shares the faces of the first embedded
+// font drawn in PDF-FILE: each user checks out a face of its own, the
+// faces given back are reused for the same font data, and the idle
+// faces are evicted, least recently used first, to stay within the
+// limits set in GlobalParams.
+//------------------------------------------------------------------------
+
+static bool checkPool(bool cond, const char *what)
+{
+    if (!cond) {
+        fprintf(stderr, "Face pool: %s\n", what);
+    }
+    return cond;
+}
+
+static bool facePool(char *args[])
+{
+    const std::unique_ptr<PDFDoc> doc = openDoc(args[0]);
+    if (!doc) {
+        return false;
+    }
+    FontCodesOutputDev scan;
+    for (int page = 1; page <= doc->getNumPages(); ++page) {
+        doc->displayPage(&scan, page, 72, 72, 0, true, false, false);
+    }
+    std::optional<std::vector<unsigned char>> fontBuf;
+    for (const auto &[id, drawn] : scan.fonts) {
+        if (!fontBuf || fontBuf->empty()) {
+            fontBuf = drawn.font->readEmbFontFile(doc->getXRef());
+        }
+    }
+    if (!fontBuf || fontBuf->empty()) {
+        fprintf(stderr, "No embedded font drawn in %s\n", args[0]);
+        return false;
+    }
+    const size_t size = fontBuf->size();
+    SplashFontSrc src(std::vector<unsigned char>(fontBuf.value()));
+    SplashFontSrc copy(std::move(fontBuf.value()));
+
+    SplashFTFacePool *pool = SplashFTFacePool::getInstance();
+    pool->clear();
+    globalParams->setFontFaceCacheLimits(2, 2 * size);
+    bool ok = true;
+
+    // two users get faces of their own, reading the data of the source
+    std::unique_ptr<SplashFTFace> a = pool->checkOut(src, 0);
+    std::unique_ptr<SplashFTFace> b = pool->checkOut(src, 0);
+    if (!checkPool(a && b, "couldn't load the font")) {
+        return false;
+    }
+    ok = checkPool(a->face != b->face, "a face is checked out twice") && ok;
+    ok = checkPool(a->face->stream->base == src.buf().data() && b->face->stream->base == src.buf().data(), "the font data is copied") && ok;
+
+    // a face given back is reused, for any source of the same data
+    const FT_Face aFace = a->face;
+    pool->checkIn(std::move(a));
+    ok = checkPool(pool->getNumIdleFaces() == 1, "the face given back isn't kept") && ok;
+    a = pool->checkOut(copy, 0);
+    ok = checkPool(a && a->face == aFace && pool->getNumIdleFaces() == 0, "the face given back isn't reused") && ok;
+
+    // the least recently given back faces are evicted: the limits leave
+    // room for 2 faces
+    std::unique_ptr<SplashFTFace> c = pool->checkOut(copy, 0);
+    const FT_Face bFace = b->face, cFace = c->face;
+    pool->checkIn(std::move(a));
+    pool->checkIn(std::move(b));
+    pool->checkIn(std::move(c));
+    ok = checkPool(pool->getNumIdleFaces() == 2, "the number of idle faces isn't limited") && ok;
+    a = pool->checkOut(src, 0);
+    b = pool->checkOut(src, 0);
+    ok = checkPool(a && b && a->face == cFace && b->face == bFace && pool->getNumIdleFaces() == 0, "the faces aren't evicted in order") && ok;
+
+    // the data size of the idle faces is limited too
+    globalParams->setFontFaceCacheLimits(2, 2 * size - 1);
+    pool->checkIn(std::move(a));
+    pool->checkIn(std::move(b));
+    ok = checkPool(pool->getNumIdleFaces() == 1, "the data size of the idle faces isn't limited") && ok;
+
+    // the faces can be freed, and not kept at all
+    pool->clear();
+    ok = checkPool(pool->getNumIdleFaces() == 0, "the faces aren't freed") && ok;
+    globalParams->setFontFaceCacheLimits(0, 2 * size);
+    pool->checkIn(pool->checkOut(src, 0));
+    ok = checkPool(pool->getNumIdleFaces() == 0, "the faces are kept with the cache disabled") && ok;
+    return ok;
+}
+
+//------------------------------------------------------------------------
+// patch-mesh-write PDF-FILE
+// patch-mesh-check PDF-FILE
+//
+// Checks that a patch mesh shading is drawn without cracks between its
+// patches: the test document covers its page with a Coons patch mesh
+// of one color, made of patches of different sizes that share curved
+// edges, and every pixel of the rendered page must be painted.
+//------------------------------------------------------------------------
+
+// The lines the mesh is cut along, in default user space; the edges
+// along the inner lines are S-shaped.  The mesh overlaps the page.
+static const double meshXs[] = { -20, 40, 60, 220 };
+static const double meshYs[] = { -20, 40, 220 };
+static const double meshBulge = 15;
+
+struct MeshPoint
+{
+    double x, y;
+};
+
+// Returns the control points of the edge from (x0, y0) to (x1, y1),
+// bent away from the straight line by <bulge> on each side.
+static std::array<MeshPoint, 4> meshEdge(double x0, double y0, double x1, double y1, double bulge)
+{
+    const double dx = x1 - x0, dy = y1 - y0;
+    const double len = std::sqrt(dx * dx + dy * dy);
+    const double nx = -dy / len * bulge, ny = dx / len * bulge;
+    return { { { x0, y0 }, { x0 + dx / 3 + nx, y0 + dy / 3 + ny }, { x0 + 2 * dx / 3 - nx, y0 + 2 * dy / 3 - ny }, { x1, y1 } } };
+}
+
+// The edge along the vertical line <i>, from meshYs[j] to meshYs[j + 1].
+static std::array<MeshPoint, 4> meshVertEdge(int i, int j)
+{
+    const bool inner = i > 0 && i < static_cast<int>(std::size(meshXs)) - 1;
+    return meshEdge(meshXs[i], meshYs[j], meshXs[i], meshYs[j + 1], inner ? meshBulge : 0);
+}
+
+// The edge along the horizontal line <j>, from meshXs[i] to meshXs[i + 1].
+static std::array<MeshPoint, 4> meshHorizEdge(int i, int j)
+{
+    const bool inner = j > 0 && j < static_cast<int>(std::size(meshYs)) - 1;
+    return meshEdge(meshXs[i], meshYs[j], meshXs[i + 1], meshYs[j], inner ? meshBulge : 0);
+}
+
+static void putBits16(std::string *data, double value, double min, double max)
+{
+    const int bits = static_cast<int>(std::lround((value - min) / (max - min) * 0xffff));
+    data->push_back(static_cast<char>(bits >> 8));
+    data->push_back(static_cast<char>(bits & 0xff));
+}
+
+static bool patchMeshWrite(char *args[])
+{
+    static const unsigned char color[3] = { 51, 102, 204 };
+
+    // each patch goes up its left edge, right along its top edge, down
+    // its right edge and back along its bottom edge: the patches sharing
+    // an edge get the same control points
+    std::string data;
+    for (int j = 0; j + 1 < static_cast<int>(std::size(meshYs)); ++j) {
+        for (int i = 0; i + 1 < static_cast<int>(std::size(meshXs)); ++i) {
+            const std::array<MeshPoint, 4> left = meshVertEdge(i, j);
+            const std::array<MeshPoint, 4> top = meshHorizEdge(i, j + 1);
+            const std::array<MeshPoint, 4> right = meshVertEdge(i + 1, j);
+            const std::array<MeshPoint, 4> bottom = meshHorizEdge(i, j);
+            const MeshPoint points[12] = { left[0], left[1], left[2], left[3], top[1], top[2], top[3], right[2], right[1], right[0], bottom[2], bottom[1] };
+            data.push_back(0);
+            for (const MeshPoint &point : points) {
+                putBits16(&data, point.x, -100, 300);
+                putBits16(&data, point.y, -100, 300);
+            }
+            for (int corner = 0; corner < 4; ++corner) {
+                data.append(reinterpret_cast<const char *>(color), sizeof(color));
+            }
+        }
+    }
+
+    const std::string content = "/Sh0 sh\n";
+    return writePDF(args[0],
+                    { "<< /Type /Catalog /Pages 2 0 R >>", "<< /Type /Pages /Kids [3 0 R] /Count 1 >>",
+                      "<< /Type /Page /Parent 2 0 R /MediaBox [0 0 200 200] /Resources << /Shading << /Sh0 5 0 R >> >> /Contents 4 0 R >>",
+                      "<< /Length " + std::to_string(content.size()) + " >>\nstream\n" + content + "endstream",
+                      "<< /ShadingType 6 /ColorSpace /DeviceRGB /BitsPerCoordinate 16 /BitsPerComponent 8 /BitsPerFlag 8 /Decode [-100 300 -100 300 0 1 0 1 0 1] /Length " + std::to_string(data.size()) + " >>\nstream\n" + data
+                              + "\nendstream" });
+}
+
+static bool patchMeshCheck(char *args[])
+{
+    const std::unique_ptr<PDFDoc> doc = openDoc(args[0]);
+    if (!doc) {
+        return false;
+    }
+
+    SplashColor paperColor = { 0xff, 0xff, 0xff };
+    SplashOutputDev out(splashModeRGB8, 4, paperColor);
+    out.startDoc(doc.get());
+    doc->displayPage(&out, 1, resolution, resolution, 0, false, true, false);
+
+    // the mesh color has no 0xff component: a paper colored pixel is a crack
+    SplashBitmap *bitmap = out.getBitmap();
+    int nCracks = 0;
+    for (int y = 0; y < bitmap->getHeight(); ++y) {
+        const unsigned char *p = bitmap->getDataPtr() + static_cast<size_t>(y) * bitmap->getRowSize();
+        for (int x = 0; x < bitmap->getWidth(); ++x, p += 3) {
+            if (p[0] == 0xff && p[1] == 0xff && p[2] == 0xff) {
+                if (nCracks == 0) {
+                    fprintf(stderr, "Pixel (%d, %d) isn't painted\n", x, y);
+                }
+                ++nCracks;
+            }
+        }
+    }
+    if (nCracks > 0) {
+        fprintf(stderr, "%d pixels aren't painted\n", nCracks);
+        return false;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------
+
+struct Command
+{
+    const char *name;
+    const char *args;
+    int nArgs;
+    bool (*run)(char *args[]);
+};
+
+static const Command commands[] = { { .name = "render-compare", .args = "FILE-A FILE-B", .nArgs = 2, .run = renderCompare },
+                                    { .name = "dedup-compare", .args = "MERGED DEDUPED", .nArgs = 2, .run = dedupCompare },
+                                    { .name = "images-write", .args = "PDF-FILE", .nArgs = 1, .run = imagesWrite },
+                                    { .name = "images-compare", .args = "SERIAL-ROOT PARALLEL-ROOT", .nArgs = 2, .run = imagesCompare },
+                                    { .name = "separate-compare", .args = "SERIAL-PATTERN PARALLEL-PATTERN", .nArgs = 2, .run = separateCompare },
+                                    { .name = "subset-fonts", .args = "PDF-FILE FULL-PS SUBSET-PS", .nArgs = 3, .run = subsetFonts },
+                                    { .name = "face-pool", .args = "PDF-FILE", .nArgs = 1, .run = facePool },
+                                    { .name = "patch-mesh-write", .args = "PDF-FILE", .nArgs = 1, .run = patchMeshWrite },
+                                    { .name = "patch-mesh-check", .args = "PDF-FILE", .nArgs = 1, .run = patchMeshCheck } };
+
+int main(int argc, char *argv[])
+{
+    // parse args
+    const bool ok = parseArgs(argDesc, &argc, argv);
+    const Command *command = nullptr;
+    if (argc >= 2) {
+        for (const Command &c : commands) {
+            if (strcmp(argv[1], c.name) == 0 && argc == c.nArgs + 2) {
+                command = &c;
+            }
+        }
+    }
+    if (!ok || !command || printHelp) {
+        printUsage(argv[0], "COMMAND ARGS...", argDesc);
+        fprintf(stderr, "Commands:\n");
+        for (const Command &c : commands) {
+            fprintf(stderr, "  %s %s\n", c.name, c.args);
+        }
+        return printHelp ? 0 : 1;
+    }
+
+    globalParams = std::make_unique<GlobalParams>();
+    return command->run(argv + 2) ? 0 : 1;
+}
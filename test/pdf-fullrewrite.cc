@@ -10,26 +10,36 @@
 //
 //========================================================================
 
+#include <memory>
+#include <string>
+#include <vector>
+
 #include "GlobalParams.h"
 #include "Error.h"
 #include "Object.h"
 #include "PDFDoc.h"
+#include "Stream.h"
 #include "XRef.h"
 #include "goo/GooString.h"
 #include "utils/parseargs.h"
 
+static void modifyStreams(PDFDoc *doc, std::vector<std::vector<char>> *buffers);
 static bool compareDocuments(PDFDoc *origDoc, PDFDoc *newDoc);
 static bool compareObjects(const Object *objA, const Object *objB);
 
 static char ownerPassword[33] = "\001";
 static char userPassword[33] = "\001";
 static bool forceIncremental = false;
+static bool useObjectStreams = false;
+static bool modifyFlateStreams = false;
 static bool checkOutput = false;
 static bool printHelp = false;
 
 static const ArgDesc argDesc[] = { { .arg = "-opw", .kind = argString, .val = ownerPassword, .size = sizeof(ownerPassword), .usage = "owner password (for encrypted files)" },
                                    { .arg = "-upw", .kind = argString, .val = userPassword, .size = sizeof(userPassword), .usage = "user password (for encrypted files)" },
                                    { .arg = "-i", .kind = argFlag, .val = &forceIncremental, .size = 0, .usage = "incremental update mode" },
+                                   { .arg = "-objstm", .kind = argFlag, .val = &useObjectStreams, .size = 0, .usage = "pack objects into compressed object streams" },
+                                   { .arg = "-modify", .kind = argFlag, .val = &modifyFlateStreams, .size = 0, .usage = "replace Flate streams by modified in-memory copies before saving" },
                                    { .arg = "-check", .kind = argFlag, .val = &checkOutput, .size = 0, .usage = "verify the generated document" },
                                    { .arg = "-h", .kind = argFlag, .val = &printHelp, .size = 0, .usage = "print usage information" },
                                    { .arg = "-help", .kind = argFlag, .val = &printHelp, .size = 0, .usage = "print usage information" },
@@ -43,6 +53,7 @@ int main(int argc, char *argv[])
     PDFDoc *docOut = nullptr;
     std::optional<GooString> ownerPW;
     std::optional<GooString> userPW;
+    std::vector<std::vector<char>> buffers; // data of the modified streams
     int res = 0;
 
     // parse args
@@ -55,6 +66,12 @@ int main(int argc, char *argv[])
         goto done;
     }
 
+    if (forceIncremental && useObjectStreams) {
+        fprintf(stderr, "-i and -objstm are mutually exclusive\n");
+        res = 1;
+        goto done;
+    }
+
     if (ownerPassword[0] != '\001') {
         ownerPW = GooString(ownerPassword);
     }
@@ -71,8 +88,13 @@ int main(int argc, char *argv[])
         goto done;
     }
 
-    // save it back (in rewrite or incremental update mode)
-    if (doc->saveAs(argv[2], forceIncremental ? writeForceIncremental : writeForceRewrite) != 0) {
+    // replace the Flate streams, so that saving compresses them again
+    if (modifyFlateStreams) {
+        modifyStreams(doc, &buffers);
+    }
+
+    // save it back (in rewrite, compressed rewrite or incremental update mode)
+    if (doc->saveAs(argv[2], forceIncremental ? writeForceIncremental : (useObjectStreams ? writeForceRewriteCompressed : writeForceRewrite)) != 0) {
         fprintf(stderr, "Error saving document\n");
         res = 1;
         goto done;
@@ -96,6 +118,31 @@ done:
     return res;
 }
 
+static void modifyStreams(PDFDoc *doc, std::vector<std::vector<char>> *buffers)
+{
+    XRef *xref = doc->getXRef();
+    for (int i = 1; i < xref->getNumObjects(); ++i) {
+        const XRefEntry *entry = xref->getEntry(i);
+        if (entry->type != xrefEntryUncompressed) {
+            continue;
+        }
+        const Ref ref = { .num = i, .gen = entry->gen };
+        Object obj = xref->fetch(ref);
+        if (!obj.isStream() || !obj.getStream()->getDict()->lookup("Filter").isName("FlateDecode")) {
+            continue;
+        }
+        std::string data;
+        obj.getStream()->fillString(data);
+        obj.getStream()->close();
+        const std::vector<char> &buf = buffers->emplace_back(data.begin(), data.end());
+        // the data is stored decoded, so the predictor no longer applies
+        Object dict(obj.getStream()->getDict()->copy(xref));
+        dict.dictRemove("DecodeParms");
+        Object modified(std::make_unique<MemStream>(buf.data(), 0, buf.size(), std::move(dict)));
+        xref->setModifiedObject(&modified, ref);
+    }
+}
+
 static bool compareDictionaries(Dict *dictA, Dict *dictB)
 {
     const int length = dictA->getLength();
@@ -217,6 +264,18 @@ static bool compareObjects(const Object *objA, const Object *objB)
     }
 }
 
+// The flags set by XRef::scanSpecialFlags(); modified objects are also
+// flagged Updated in the original document
+static int getSpecialFlags(const XRefEntry *entry)
+{
+    return entry->flags & ((1 << XRefEntry::Unencrypted) | (1 << XRefEntry::DontRewrite));
+}
+
+static bool isObjectOrXRefStream(const Object *obj)
+{
+    return obj->isStream() && (obj->getStream()->getDict()->is("ObjStm") || obj->getStream()->getDict()->is("XRef"));
+}
+
 static bool compareDocuments(PDFDoc *origDoc, PDFDoc *newDoc)
 {
     bool result = true;
@@ -236,6 +295,22 @@ static bool compareDocuments(PDFDoc *origDoc, PDFDoc *newDoc)
             fprintf(stderr, "XRef table: Unexpected number of entries (%d+1 != %d)\n", origNumObjects, newNumObjects);
             result = false;
         }
+    } else if (useObjectStreams) {
+        // The object streams and the XRef stream are appended
+        if (origNumObjects > newNumObjects) {
+            fprintf(stderr, "XRef table: Unexpected number of entries (%d > %d)\n", origNumObjects, newNumObjects);
+            result = false;
+        }
+        for (int i = origNumObjects; i < newNumObjects; ++i) {
+            if (newXRef->getEntry(i)->type == xrefEntryFree) {
+                continue;
+            }
+            Object newObj = newXRef->fetch(i, newXRef->getEntry(i)->gen);
+            if (!isObjectOrXRefStream(&newObj)) {
+                fprintf(stderr, "XRef entry %u: appended object is neither an object stream nor an XRef stream\n", i);
+                result = false;
+            }
+        }
     } else {
         // In all other cases the number of entries must be the same
         if (origNumObjects != newNumObjects) {
@@ -261,6 +336,19 @@ static bool compareDocuments(PDFDoc *origDoc, PDFDoc *newDoc)
             continue; // There's nothing left to check for this entry
         }
 
+        // Check that the original object and XRef streams are freed when
+        // writing object streams, their contents are written anew
+        if (useObjectStreams && origType == xrefEntryUncompressed) {
+            Object origObj = origXRef->fetch(i, origGenNum);
+            if (isObjectOrXRefStream(&origObj)) {
+                if (newType != xrefEntryFree || origGenNum + 1 != newGenNum) {
+                    fprintf(stderr, "XRef entry %u: object or XRef stream was not freed correctly\n", i);
+                    result = false;
+                }
+                continue;
+            }
+        }
+
         // Compare generation numbers
         // Object num 0 should always have gen 65535 according to specs, but some
         // documents have it set to 0. We always write 65535 in output
@@ -279,8 +367,8 @@ static bool compareDocuments(PDFDoc *origDoc, PDFDoc *newDoc)
         }
 
         // Compare object flags. A failure shows that there's some error in XRef::scanSpecialFlags()
-        if (origXRef->getEntry(i)->flags != newXRef->getEntry(i)->flags) {
-            fprintf(stderr, "XRef entry %u: flags detected by scanSpecialFlags differ (%d != %d)\n", i, origXRef->getEntry(i)->flags, newXRef->getEntry(i)->flags);
+        if (getSpecialFlags(origXRef->getEntry(i)) != getSpecialFlags(newXRef->getEntry(i))) {
+            fprintf(stderr, "XRef entry %u: flags detected by scanSpecialFlags differ (%d != %d)\n", i, getSpecialFlags(origXRef->getEntry(i)), getSpecialFlags(newXRef->getEntry(i)));
             result = false;
         }
 
@@ -41,6 +41,12 @@
 #include <cstring>
 #include <cerrno>
 #include <ctime>
+#include <cmath>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+#    include <sys/resource.h>
+#endif
 
 #include "Error.h"
 #include "ErrorCodes.h"
@@ -78,6 +84,7 @@ public:
     int pageCount() const { return _pageCount; }
 
     bool load(const char *fileName);
+    bool load(std::unique_ptr<BaseStream> str, const char *name);
     SplashBitmap *renderBitmap(int pageNo, double zoomReal, int rotation);
 
     SplashOutputDev *outputDevice();
@@ -112,6 +119,7 @@ constexpr const char *OUT_ARG = "-out";
 constexpr const char *LOAD_ONLY_ARG = "-loadonly";
 constexpr const char *PAGE_ARG = "-page";
 constexpr const char *TEXT_ARG = "-text";
+constexpr const char *MESHES_ARG = "-meshes";
 
 /* Should we record timings? True if -timings command-line argument was given. */
 static bool gfTimings = false;
@@ -149,6 +157,9 @@ static int gPageNo = PAGE_NO_NOT_GIVEN;
 /* If true, will only load the file, not render any pages. Mostly for
    profiling load time */
 static bool gfLoadOnly = false;
+/* If true, render a generated document with one page for each of the
+   mesh shading types (4 to 7). Controlled by -meshes command-line argument */
+static bool gfMeshes = false;
 
 constexpr int PDF_FILE_DPI = 72;
 
@@ -332,6 +343,18 @@ bool PdfEnginePoppler::load(const char *fileName)
     return true;
 }
 
+bool PdfEnginePoppler::load(std::unique_ptr<BaseStream> str, const char *name)
+{
+    setFileName(name);
+
+    _pdfDoc = new PDFDoc(std::move(str));
+    if (!_pdfDoc->isOk()) {
+        return false;
+    }
+    _pageCount = _pdfDoc->getNumPages();
+    return true;
+}
+
 SplashOutputDev *PdfEnginePoppler::outputDevice()
 {
     if (!_outputDev) {
@@ -515,7 +538,7 @@ static void LogInfo(const char *fmt, ...)
 
 static void PrintUsageAndExit(int argc, char **argv)
 {
-    printf("Usage: pdftest [-preview|-slowpreview] [-loadonly] [-timings] [-text] [-resolution NxM] [-recursive] [-page N] [-out out.txt] pdf-files-to-process\n");
+    printf("Usage: pdftest [-preview|-slowpreview] [-loadonly] [-timings] [-text] [-resolution NxM] [-recursive] [-page N] [-meshes] [-out out.txt] pdf-files-to-process\n");
     for (int i = 0; i < argc; i++) {
         printf("i=%d, '%s'\n", i, argv[i]);
     }
@@ -587,11 +610,60 @@ Exit:
 #    define POPPLER_TMP_NAME "/tmp/poppler_tmp.pdf"
 #endif
 
+/* Peak resident memory of the whole process so far in kB, or -1 if it
+   can't be determined.  This is a running maximum over all pages rendered
+   until now, not the peak of the last page. */
+static long GetPeakMemoryKb()
+{
+#ifdef _WIN32
+    return -1;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return -1;
+    }
+#    ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#    else
+    return usage.ru_maxrss;
+#    endif
+#endif
+}
+
+static void RenderPages(PdfEnginePoppler *engineSplash)
+{
+    for (int curPage = 1; curPage <= engineSplash->pageCount(); curPage++) {
+        if ((gPageNo != PAGE_NO_NOT_GIVEN) && (gPageNo != curPage)) {
+            continue;
+        }
+
+        SplashBitmap *bmpSplash = nullptr;
+
+        GooTimer msRenderTimer;
+        bmpSplash = engineSplash->renderBitmap(curPage, 100.0, 0);
+        msRenderTimer.stop();
+        const double timeInMs = msRenderTimer.getElapsed();
+        if (gfTimings) {
+            if (!bmpSplash) {
+                LogInfo("page splash %d: failed to render\n", curPage);
+            } else {
+                const long peakMemoryKb = GetPeakMemoryKb();
+                if (peakMemoryKb < 0) {
+                    LogInfo("page splash %d (%dx%d): %.2f ms\n", curPage, bmpSplash->getWidth(), bmpSplash->getHeight(), timeInMs);
+                } else {
+                    LogInfo("page splash %d (%dx%d): %.2f ms, process peak memory so far %ld kB\n", curPage, bmpSplash->getWidth(), bmpSplash->getHeight(), timeInMs, peakMemoryKb);
+                }
+            }
+        }
+
+        delete bmpSplash;
+    }
+}
+
 static void RenderPdf(const char *fileName)
 {
     const char *fileNameSplash = nullptr;
     PdfEnginePoppler *engineSplash = nullptr;
-    int pageCount;
     double timeInMs;
 
 #ifdef COPY_FILE
@@ -613,37 +685,176 @@ static void RenderPdf(const char *fileName)
     msTimer.stop();
     timeInMs = msTimer.getElapsed();
     LogInfo("load splash: %.2f ms\n", timeInMs);
-    pageCount = engineSplash->pageCount();
 
-    LogInfo("page count: %d\n", pageCount);
+    LogInfo("page count: %d\n", engineSplash->pageCount());
     if (gfLoadOnly) {
         goto Error;
     }
 
-    for (int curPage = 1; curPage <= pageCount; curPage++) {
-        if ((gPageNo != PAGE_NO_NOT_GIVEN) && (gPageNo != curPage)) {
-            continue;
-        }
+    RenderPages(engineSplash);
+Error:
+    delete engineSplash;
+    LogInfo("finished: %s\n", fileName);
+}
 
-        SplashBitmap *bmpSplash = nullptr;
+/* Append 'value' as 'bytes' big-endian bytes in hex to 'data' */
+static void AppendHex(std::string *data, unsigned int value, int bytes)
+{
+    static const char hexDigits[] = "0123456789abcdef";
+    for (int i = bytes - 1; i >= 0; i--) {
+        data->push_back(hexDigits[(value >> (8 * i + 4)) & 0xf]);
+        data->push_back(hexDigits[(value >> (8 * i)) & 0xf]);
+    }
+}
 
-        GooTimer msRenderTimer;
-        bmpSplash = engineSplash->renderBitmap(curPage, 100.0, 0);
-        msRenderTimer.stop();
-        timeInMs = msRenderTimer.getElapsed();
-        if (gfTimings) {
-            if (!bmpSplash) {
-                LogInfo("page splash %d: failed to render\n", curPage);
-            } else {
-                LogInfo("page splash %d (%dx%d): %.2f ms\n", curPage, bmpSplash->getWidth(), bmpSplash->getHeight(), timeInMs);
+/* Append a point of a 612x792 page, using 16 bit coordinates */
+static void AppendMeshPoint(std::string *data, double x, double y)
+{
+    AppendHex(data, static_cast<unsigned int>(std::lround(std::fmin(std::fmax(x / 612, 0), 1) * 65535)), 2);
+    AppendHex(data, static_cast<unsigned int>(std::lround(std::fmin(std::fmax(y / 792, 0), 1) * 65535)), 2);
+}
+
+/* Append an 8 bit RGB color which varies smoothly over the page */
+static void AppendMeshColor(std::string *data, double x, double y)
+{
+    AppendHex(data, static_cast<unsigned int>(x / 612 * 255), 1);
+    AppendHex(data, static_cast<unsigned int>(y / 792 * 255), 1);
+    AppendHex(data, static_cast<unsigned int>((std::sin(x / 50) * std::cos(y / 70) + 1) * 127.5), 1);
+}
+
+/* Build a document with one page for each mesh shading type, each of
+   them covering the whole page with a fine mesh */
+static std::vector<char> BuildMeshShadingPdf()
+{
+    constexpr int triangleGrid = 64;
+    constexpr int latticeGrid = 96;
+    constexpr int patchGrid = 12;
+    std::vector<std::string> objects;
+
+    objects.emplace_back("<< /Type /Catalog /Pages 2 0 R >>");
+    objects.emplace_back("<< /Type /Pages /Kids [3 0 R 4 0 R 5 0 R 6 0 R] /Count 4 >>");
+    for (int i = 0; i < 4; i++) {
+        objects.push_back("<< /Type /Page /Parent 2 0 R /MediaBox [0 0 612 792] /Resources << /Shading << /Sh0 " + std::to_string(8 + i) + " 0 R >> >> /Contents 7 0 R >>");
+    }
+    std::string content = "/Sh0 sh\n";
+    objects.push_back("<< /Length " + std::to_string(content.size()) + " >>\nstream\n" + content + "\nendstream");
+
+    // type 4: free-form triangles with a color at each vertex
+    std::string data;
+    const double cellW = 612.0 / triangleGrid;
+    const double cellH = 792.0 / triangleGrid;
+    for (int j = 0; j < triangleGrid; j++) {
+        for (int i = 0; i < triangleGrid; i++) {
+            const double corners[4][2] = { { i * cellW, j * cellH }, { (i + 1) * cellW, j * cellH }, { (i + 1) * cellW, (j + 1) * cellH }, { i * cellW, (j + 1) * cellH } };
+            const int triangles[2][3] = { { 0, 1, 2 }, { 0, 2, 3 } };
+            for (const auto &triangle : triangles) {
+                for (int vertex : triangle) {
+                    AppendHex(&data, 0, 1);
+                    AppendMeshPoint(&data, corners[vertex][0], corners[vertex][1]);
+                    AppendMeshColor(&data, corners[vertex][0], corners[vertex][1]);
+                }
             }
         }
+    }
+    data += ">";
+    objects.push_back("<< /ShadingType 4 /ColorSpace /DeviceRGB /BitsPerCoordinate 16 /BitsPerComponent 8 /BitsPerFlag 8 /Decode [0 612 0 792 0 1 0 1 0 1] /Filter /ASCIIHexDecode /Length " + std::to_string(data.size())
+                      + " >>\nstream\n" + data + "\nendstream");
+
+    // type 5: lattice, parameterized by a function
+    data.clear();
+    for (int j = 0; j <= latticeGrid; j++) {
+        for (int i = 0; i <= latticeGrid; i++) {
+            const double x = i * 612.0 / latticeGrid;
+            const double y = j * 792.0 / latticeGrid;
+            AppendMeshPoint(&data, x, y);
+            AppendHex(&data, static_cast<unsigned int>((std::sin(x / 40) * std::sin(y / 60) + 1) * 127.5), 1);
+        }
+    }
+    data += ">";
+    objects.push_back("<< /ShadingType 5 /ColorSpace /DeviceRGB /BitsPerCoordinate 16 /BitsPerComponent 8 /VerticesPerRow " + std::to_string(latticeGrid + 1)
+                      + " /Decode [0 612 0 792 0 1] /Function << /FunctionType 2 /Domain [0 1] /C0 [0 0.2 1] /C1 [1 0.8 0] /N 1 >> /Filter /ASCIIHexDecode /Length " + std::to_string(data.size()) + " >>\nstream\n" + data
+                      + "\nendstream");
+
+    // types 6 and 7: curved Coons and tensor-product patches
+    for (int type = 6; type <= 7; type++) {
+        data.clear();
+        const double patchW = 612.0 / patchGrid;
+        const double patchH = 792.0 / patchGrid;
+        for (int j = 0; j < patchGrid; j++) {
+            for (int i = 0; i < patchGrid; i++) {
+                const double x0 = i * patchW;
+                const double y0 = j * patchH;
+                // the points of the boundary, starting at the lower left
+                // corner and going up the left edge
+                double points[16][2];
+                for (int k = 0; k < 12; k++) {
+                    const int side = k / 3;
+                    const double f = (k % 3) / 3.0;
+                    static const double sides[4][2][2] = { { { 0, 0 }, { 0, 1 } }, { { 0, 1 }, { 1, 1 } }, { { 1, 1 }, { 1, 0 } }, { { 1, 0 }, { 0, 0 } } };
+                    const double u = sides[side][0][0] + f * (sides[side][1][0] - sides[side][0][0]);
+                    const double v = sides[side][0][1] + f * (sides[side][1][1] - sides[side][0][1]);
+                    points[k][0] = x0 + u * patchW;
+                    points[k][1] = y0 + v * patchH;
+                    if (k % 3 != 0) {
+                        // bend the edges
+                        points[k][0] += 0.25 * patchW * std::sin(points[k][1] / 80);
+                        points[k][1] += 0.25 * patchH * std::cos(points[k][0] / 60);
+                    }
+                }
+                // the inner points of tensor-product patches
+                static const double inner[4][2] = { { 1. / 3, 1. / 3 }, { 1. / 3, 2. / 3 }, { 2. / 3, 2. / 3 }, { 2. / 3, 1. / 3 } };
+                for (int k = 0; k < 4; k++) {
+                    points[12 + k][0] = x0 + inner[k][0] * patchW + 0.3 * patchW * std::cos(y0 / 90 + k);
+                    points[12 + k][1] = y0 + inner[k][1] * patchH + 0.3 * patchH * std::sin(x0 / 70 + k);
+                }
 
-        delete bmpSplash;
+                AppendHex(&data, 0, 1);
+                for (int k = 0; k < (type == 6 ? 12 : 16); k++) {
+                    AppendMeshPoint(&data, points[k][0], points[k][1]);
+                }
+                AppendMeshColor(&data, x0, y0);
+                AppendMeshColor(&data, x0, y0 + patchH);
+                AppendMeshColor(&data, x0 + patchW, y0 + patchH);
+                AppendMeshColor(&data, x0 + patchW, y0);
+            }
+        }
+        data += ">";
+        objects.push_back("<< /ShadingType " + std::to_string(type)
+                          + " /ColorSpace /DeviceRGB /BitsPerCoordinate 16 /BitsPerComponent 8 /BitsPerFlag 8 /Decode [0 612 0 792 0 1 0 1 0 1] /Filter /ASCIIHexDecode /Length " + std::to_string(data.size()) + " >>\nstream\n" + data
+                          + "\nendstream");
+    }
+
+    std::string pdf = "%PDF-1.4\n";
+    std::vector<size_t> offsets;
+    for (size_t i = 0; i < objects.size(); i++) {
+        offsets.push_back(pdf.size());
+        pdf += std::to_string(i + 1) + " 0 obj\n" + objects[i] + "\nendobj\n";
+    }
+    const size_t xrefOffset = pdf.size();
+    pdf += "xref\n0 " + std::to_string(objects.size() + 1) + "\n0000000000 65535 f \n";
+    for (size_t offset : offsets) {
+        char entry[32];
+        snprintf(entry, sizeof(entry), "%010zu 00000 n \n", offset);
+        pdf += entry;
+    }
+    pdf += "trailer\n<< /Size " + std::to_string(objects.size() + 1) + " /Root 1 0 R >>\nstartxref\n" + std::to_string(xrefOffset) + "\n%%EOF\n";
+    return std::vector<char>(pdf.begin(), pdf.end());
+}
+
+static void RenderMeshShadings()
+{
+    LogInfo("started: mesh shadings\n");
+
+    const std::vector<char> pdf = BuildMeshShadingPdf();
+    PdfEnginePoppler engineSplash;
+    if (!engineSplash.load(std::make_unique<MemStream>(pdf.data(), 0, pdf.size(), Object::null()), "meshes.pdf")) {
+        LogInfo("failed to load splash\n");
+    } else {
+        // the pages are shading types 4, 5, 6 and 7
+        LogInfo("page count: %d\n", engineSplash.pageCount());
+        RenderPages(&engineSplash);
     }
-Error:
-    delete engineSplash;
-    LogInfo("finished: %s\n", fileName);
+    LogInfo("finished: mesh shadings\n");
 }
 
 static void RenderFile(const char *fileName)
@@ -759,6 +970,8 @@ static void ParseCommandLine(int argc, char **argv)
                 gOutFileName = str_dup(argv[i]);
             } else if (str_ieq(arg, TEXT_ARG)) {
                 gfTextOnly = true;
+            } else if (str_ieq(arg, MESHES_ARG)) {
+                gfMeshes = true;
             } else if (str_ieq(arg, LOAD_ONLY_ARG)) {
                 gfLoadOnly = true;
             } else if (str_ieq(arg, PAGE_ARG)) {
@@ -808,10 +1021,9 @@ int main(int argc, char **argv)
 {
     setErrorCallback(my_error);
     ParseCommandLine(argc, argv);
-    if (0 == StrList_Len(&gArgsListRoot)) {
+    if (0 == StrList_Len(&gArgsListRoot) && !gfMeshes) {
         PrintUsageAndExit(argc, argv);
     }
-    assert(gArgsListRoot);
 
     SplashColorsInit();
     globalParams = std::make_unique<GlobalParams>();
@@ -838,6 +1050,9 @@ int main(int argc, char **argv)
         gErrFile = stderr;
     }
 
+    if (gfMeshes) {
+        RenderMeshShadings();
+    }
     StrList *curr = gArgsListRoot;
     while (curr) {
         RenderCmdLineArg(curr->str);
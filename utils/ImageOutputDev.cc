@@ -40,9 +40,11 @@
 #include "config.h"
 #include <poppler-config.h>
 
+#include <algorithm>
 #include <cstdio>
 #include <cctype>
 #include <cmath>
+#include <set>
 #include "goo/gmem.h"
 #include "goo/NetPBMWriter.h"
 #include "goo/PNGWriter.h"
@@ -74,6 +76,9 @@ ImageOutputDev::ImageOutputDev(char *fileRootA, bool pageNamesA, bool listImages
     errorCode = 0;
     minHeight = 0;
     minWidth = 0;
+    index = nullptr;
+    indexRef = Ref::INVALID();
+    indexType = imgImage;
     if (listImages) {
         printf("page   num  type   width height color comp bpc  enc interp  object ID x-ppi y-ppi size ratio\n");
         printf("--------------------------------------------------------------------------------------------\n");
@@ -90,7 +95,10 @@ ImageOutputDev::~ImageOutputDev()
 
 void ImageOutputDev::setFilename(const char *fileExt)
 {
-    if (pageNames) {
+    if (index && indexRef != Ref::INVALID()) {
+        const char *suffix = indexType == imgMask ? "-mask" : indexType == imgSmask ? "-smask" : "";
+        sprintf(fileName, "%s-obj%d-%d%s.%s", fileRoot, indexRef.num, indexRef.gen, suffix, fileExt);
+    } else if (pageNames || index) {
         sprintf(fileName, "%s-%03d-%03d.%s", fileRoot, pageNum, imgNum, fileExt);
     } else {
         sprintf(fileName, "%s-%03d.%s", fileRoot, imgNum, fileExt);
@@ -124,30 +132,29 @@ static void printNumber(double d)
     }
 }
 
+static const char *imageTypeName(ImageOutputDev::ImageType imageType)
+{
+    switch (imageType) {
+    case ImageOutputDev::imgImage:
+        return "image";
+    case ImageOutputDev::imgStencil:
+        return "stencil";
+    case ImageOutputDev::imgMask:
+        return "mask";
+    case ImageOutputDev::imgSmask:
+        return "smask";
+    }
+    return "";
+}
+
 void ImageOutputDev::listImage(GfxState *state, Object *ref, Stream *str, int width, int height, GfxImageColorMap *colorMap, bool interpolate, bool inlineImg, ImageType imageType)
 {
-    const char *type;
     const char *colorspace;
     const char *enc;
     int components, bpc;
 
     printf("%4d %5d ", pageNum, imgNum);
-    type = "";
-    switch (imageType) {
-    case imgImage:
-        type = "image";
-        break;
-    case imgStencil:
-        type = "stencil";
-        break;
-    case imgMask:
-        type = "mask";
-        break;
-    case imgSmask:
-        type = "smask";
-        break;
-    }
-    printf("%-7s %5d %5d  ", type, width, height);
+    printf("%-7s %5d %5d  ", imageTypeName(imageType), width, height);
 
     colorspace = "-";
     /* masks and stencils default to ncomps = 1 and bpc = 1 */
@@ -550,15 +557,50 @@ void ImageOutputDev::writeImageFile(ImgWriter *writer, ImageFormat format, const
     }
 }
 
-void ImageOutputDev::writeImage(GfxState * /*state*/, Object * /*ref*/, Stream *str, int width, int height, GfxImageColorMap *colorMap, bool inlineImg)
+void ImageOutputDev::writeImage(GfxState * /*state*/, Object *ref, Stream *str, int width, int height, GfxImageColorMap *colorMap, bool inlineImg, ImageType imageType)
 {
-    ImageFormat format;
+    if (index) {
+        // an image object is written by the first device claiming it
+        indexRef = Ref::INVALID();
+        if (!inlineImg && ref->isRef() && ref->getRef().gen < 100000) {
+            indexRef = ref->getRef();
+        }
+        indexType = imageType;
+        if (indexRef != Ref::INVALID() && !index->claim(indexRef, imageType)) {
+            index->add({ .page = pageNum, .num = imgNum, .type = imageType, .width = width, .height = height, .ref = indexRef, .fileName = {}, .failed = false });
+            ++imgNum;
+            return;
+        }
+    }
+    const int num = imgNum;
 
     if (inlineImg) {
         // Record the stream. This determines the size.
         getInlineImageLength(str, width, height, colorMap);
     }
 
+    // an image is written if a file name was set and no error was
+    // reported while writing it
+    const int prevErrorCode = errorCode;
+    errorCode = 0;
+    fileName[0] = '\0';
+    writeImageStream(str, width, height, colorMap, inlineImg);
+    const bool written = errorCode == 0 && fileName[0] != '\0';
+    if (errorCode == 0) {
+        errorCode = prevErrorCode;
+    }
+
+    if (index) {
+        index->add({ .page = pageNum, .num = num, .type = imageType, .width = width, .height = height, .ref = indexRef, .fileName = written ? fileName : "", .failed = !written });
+    } else if (printFilenames && written) {
+        printf("%s\n", fileName);
+    }
+}
+
+void ImageOutputDev::writeImageStream(Stream *str, int width, int height, GfxImageColorMap *colorMap, bool inlineImg)
+{
+    ImageFormat format;
+
     if (dumpJPEG && str->getKind() == strDCT) {
         // dump JPEG file
         writeRawImage(str, "jpg");
@@ -702,10 +744,6 @@ void ImageOutputDev::writeImage(GfxState * /*state*/, Object * /*ref*/, Stream *
 
         delete writer;
     }
-
-    if (printFilenames) {
-        printf("%s\n", fileName);
-    }
 }
 
 bool ImageOutputDev::tilingPatternFill(GfxState * /*state*/, Gfx * /*gfx*/, Catalog * /*cat*/, GfxTilingPattern * /*tPat*/, const std::array<double, 6> & /*mat*/, int /*x0*/, int /*y0*/, int /*x1*/, int /*y1*/, double /*xStep*/,
@@ -723,7 +761,7 @@ void ImageOutputDev::drawImageMask(GfxState *state, Object *ref, Stream *str, in
     if (listImages) {
         listImage(state, ref, str, width, height, nullptr, interpolate, inlineImg, imgStencil);
     } else {
-        writeImage(state, ref, str, width, height, nullptr, inlineImg);
+        writeImage(state, ref, str, width, height, nullptr, inlineImg, imgStencil);
     }
 }
 
@@ -735,7 +773,7 @@ void ImageOutputDev::drawImage(GfxState *state, Object *ref, Stream *str, int wi
     if (listImages) {
         listImage(state, ref, str, width, height, colorMap, interpolate, inlineImg, imgImage);
     } else {
-        writeImage(state, ref, str, width, height, colorMap, inlineImg);
+        writeImage(state, ref, str, width, height, colorMap, inlineImg, imgImage);
     }
 }
 
@@ -748,8 +786,8 @@ void ImageOutputDev::drawMaskedImage(GfxState *state, Object *ref, Stream *str,
         listImage(state, ref, str, width, height, colorMap, interpolate, false, imgImage);
         listImage(state, ref, maskStr, maskWidth, maskHeight, nullptr, maskInterpolate, false, imgMask);
     } else {
-        writeImage(state, ref, str, width, height, colorMap, false);
-        writeImage(state, ref, maskStr, maskWidth, maskHeight, nullptr, false);
+        writeImage(state, ref, str, width, height, colorMap, false, imgImage);
+        writeImage(state, ref, maskStr, maskWidth, maskHeight, nullptr, false, imgMask);
     }
 }
 
@@ -763,8 +801,8 @@ void ImageOutputDev::drawSoftMaskedImage(GfxState *state, Object *ref, Stream *s
         listImage(state, ref, str, width, height, colorMap, interpolate, false, imgImage);
         listImage(state, ref, maskStr, maskWidth, maskHeight, maskColorMap, maskInterpolate, false, imgSmask);
     } else {
-        writeImage(state, ref, str, width, height, colorMap, false);
-        writeImage(state, ref, maskStr, maskWidth, maskHeight, maskColorMap, false);
+        writeImage(state, ref, str, width, height, colorMap, false, imgImage);
+        writeImage(state, ref, maskStr, maskWidth, maskHeight, maskColorMap, false, imgSmask);
     }
 }
 
@@ -772,3 +810,58 @@ bool ImageOutputDev::passesSizeFilter(int width, int height) const
 {
     return height >= minHeight && width >= minWidth;
 }
+
+//------------------------------------------------------------------------
+// ImageIndex
+//------------------------------------------------------------------------
+
+bool ImageIndex::claim(Ref ref, ImageOutputDev::ImageType type)
+{
+    const std::scoped_lock locker(mutex);
+    return claimed.emplace(std::pair(ref, type), Claim()).second;
+}
+
+void ImageIndex::add(Entry &&entry)
+{
+    const std::scoped_lock locker(mutex);
+    if (entry.ref != Ref::INVALID() && (!entry.fileName.empty() || entry.failed)) {
+        claimed[std::pair(entry.ref, entry.type)] = { .fileName = entry.fileName, .failed = entry.failed };
+    }
+    entries.push_back(std::move(entry));
+}
+
+bool ImageIndex::write(const char *fileName, bool printFilenames)
+{
+    const std::scoped_lock locker(mutex);
+    std::ranges::sort(entries, [](const Entry &a, const Entry &b) { return a.page != b.page ? a.page < b.page : a.num < b.num; });
+
+    FILE *f = fopen(fileName, "w");
+    if (!f) {
+        error(errIO, -1, "Couldn't open index file '{0:s}'", fileName);
+        return false;
+    }
+    fprintf(f, "page   num  type   width height  object ID file\n");
+    std::set<std::string> printed;
+    for (const Entry &entry : entries) {
+        fprintf(f, "%4d %5d %-7s %5d %5d  ", entry.page, entry.num, imageTypeName(entry.type), entry.width, entry.height);
+        if (entry.ref == Ref::INVALID()) {
+            fprintf(f, "[inline]   ");
+        } else {
+            fprintf(f, " %6d %2d ", entry.ref.num, entry.ref.gen);
+        }
+        // an entry written for another one shares its file, or failure
+        Claim written { .fileName = entry.fileName, .failed = entry.failed };
+        if (entry.ref != Ref::INVALID() && entry.fileName.empty() && !entry.failed) {
+            written = claimed[std::pair(entry.ref, entry.type)];
+        }
+        const std::string &file = written.fileName;
+        fprintf(f, "%s\n", written.failed ? "[failed]" : file.c_str());
+        // a file is printed where it first appears in the index, which
+        // need not be the page it was written for
+        if (printFilenames && !file.empty() && printed.insert(file).second) {
+            printf("%s\n", file.c_str());
+        }
+    }
+    fclose(f);
+    return true;
+}
@@ -32,10 +32,17 @@
 #ifndef IMAGEOUTPUTDEV_H
 #define IMAGEOUTPUTDEV_H
 
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include "goo/ImgWriter.h"
 #include "OutputDev.h"
 
 class GfxState;
+class ImageIndex;
 
 //------------------------------------------------------------------------
 // ImageOutputDev
@@ -92,6 +99,14 @@ public:
     // Print filenames to stdout after writing
     void enablePrintFilenames(bool filenames) { printFilenames = filenames; }
 
+    // Write the images to an index shared with other ImageOutputDevs
+    // extracting images from the same document.  Each image object is
+    // then written once, to <fileRoot>-obj<num>-<gen>.<type> (with a
+    // -mask or -smask suffix for masks), and inline images to
+    // <fileRoot>-PPP-NNN.<type>, NNN counting the images of the page.
+    // The images are added to the index rather than printed.
+    void setIndex(ImageIndex *indexA) { index = indexA; }
+
     void setMinHeight(int height) { minHeight = height; }
     void setMinWidth(int width) { minWidth = width; }
 
@@ -115,7 +130,13 @@ public:
     bool needNonText() override { return true; }
 
     // Start a page
-    void startPage(int pageNumA, GfxState * /*state*/, XRef * /*xref*/) override { pageNum = pageNumA; }
+    void startPage(int pageNumA, GfxState * /*state*/, XRef * /*xref*/) override
+    {
+        pageNum = pageNumA;
+        if (index) {
+            imgNum = 0;
+        }
+    }
 
     //---- get info about output device
 
@@ -140,7 +161,8 @@ private:
     // Sets the output filename with a given file extension
     void setFilename(const char *fileExt);
     void listImage(GfxState *state, Object *ref, Stream *str, int width, int height, GfxImageColorMap *colorMap, bool interpolate, bool inlineImg, ImageType imageType);
-    void writeImage(GfxState *state, Object *ref, Stream *str, int width, int height, GfxImageColorMap *colorMap, bool inlineImg);
+    void writeImage(GfxState *state, Object *ref, Stream *str, int width, int height, GfxImageColorMap *colorMap, bool inlineImg, ImageType imageType);
+    void writeImageStream(Stream *str, int width, int height, GfxImageColorMap *colorMap, bool inlineImg);
     void writeRawImage(Stream *str, const char *ext);
     void writeImageFile(ImgWriter *writer, ImageFormat format, const char *ext, Stream *str, int width, int height, GfxImageColorMap *colorMap);
     static long getInlineImageLength(Stream *str, int width, int height, GfxImageColorMap *colorMap);
@@ -162,6 +184,56 @@ private:
     int errorCode; // code for any error creating the output files
     int minWidth; // smallest width that will be output
     int minHeight; // smallest height that will be output
+    ImageIndex *index; // index the images are added to, or nullptr
+    Ref indexRef; // object of the image being written, in index mode
+    ImageType indexType; // type of the image being written, in index mode
+};
+
+//------------------------------------------------------------------------
+// ImageIndex
+//------------------------------------------------------------------------
+
+// The images extracted from a document by ImageOutputDevs working in
+// parallel, one for each thread.  The first device to claim an image
+// object writes it; the others only add it to the index.
+class ImageIndex
+{
+public:
+    struct Entry
+    {
+        int page;
+        int num; // number of the image on its page
+        ImageOutputDev::ImageType type;
+        int width, height;
+        Ref ref; // Ref::INVALID() for inline images
+        std::string fileName; // empty if written for another entry, or if it failed
+        bool failed; // the image couldn't be written
+    };
+
+    // Returns true the first time it is called for an image object and
+    // type, false afterwards.
+    bool claim(Ref ref, ImageOutputDev::ImageType type);
+
+    // Adds an image to the index.  A written image object is given its
+    // file name, or is marked as failed.
+    void add(Entry &&entry);
+
+    // Writes the index in page order to fileName, one line per image, and,
+    // if printFilenames is set, prints the names of the files written in
+    // the same order.  The images that couldn't be written, and the other
+    // uses of their objects, get "[failed]" instead of a file name.
+    bool write(const char *fileName, bool printFilenames);
+
+private:
+    struct Claim
+    {
+        std::string fileName;
+        bool failed = false;
+    };
+
+    std::mutex mutex;
+    std::map<std::pair<Ref, int>, Claim> claimed; // what became of the claimed image objects
+    std::vector<Entry> entries;
 };
 
 #endif
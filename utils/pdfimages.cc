@@ -35,7 +35,11 @@
 
 #include "config.h"
 #include <poppler-config.h>
+#include <algorithm>
+#include <atomic>
 #include <cstdio>
+#include <thread>
+#include <vector>
 #include "parseargs.h"
 #include "goo/GooString.h"
 #include "GlobalParams.h"
@@ -59,6 +63,7 @@ static bool dumpCCITT = false;
 static bool allFormats = false;
 static bool pageNames = false;
 static bool printFilenames = false;
+static bool parallel = false;
 static char ownerPassword[33] = "\001";
 static char userPassword[33] = "\001";
 static bool quiet = false;
@@ -85,6 +90,7 @@ static const ArgDesc argDesc[] = { { .arg = "-f", .kind = argInt, .val = &firstP
                                    { .arg = "-upw", .kind = argString, .val = userPassword, .size = sizeof(userPassword), .usage = "user password (for encrypted files)" },
                                    { .arg = "-p", .kind = argFlag, .val = &pageNames, .size = 0, .usage = "include page numbers in output file names" },
                                    { .arg = "-print-filenames", .kind = argFlag, .val = &printFilenames, .size = 0, .usage = "print image filenames to stdout" },
+                                   { .arg = "-parallel", .kind = argFlag, .val = &parallel, .size = 0, .usage = "extract on all CPUs, writing each image object once and an index to <image-root>.idx" },
                                    { .arg = "-min-height", .kind = argInt, .val = &minHeight, .size = 0, .usage = "images with smaller height will be ignored" },
                                    { .arg = "-min-width", .kind = argInt, .val = &minWidth, .size = 0, .usage = "images with smaller width will be ignored" },
                                    { .arg = "-q", .kind = argFlag, .val = &quiet, .size = 0, .usage = "don't print any messages or errors" },
@@ -95,6 +101,79 @@ static const ArgDesc argDesc[] = { { .arg = "-f", .kind = argInt, .val = &firstP
                                    { .arg = "-?", .kind = argFlag, .val = &printHelp, .size = 0, .usage = "print usage information" },
                                    {} };
 
+static void setupImageOutputDev(ImageOutputDev *imgOut)
+{
+    imgOut->setMinHeight(minHeight);
+    imgOut->setMinWidth(minWidth);
+    if (allFormats) {
+        imgOut->enablePNG(true);
+        imgOut->enableTiff(true);
+        imgOut->enableJpeg(true);
+        imgOut->enableJpeg2000(true);
+        imgOut->enableJBig2(true);
+        imgOut->enableCCITT(true);
+    } else {
+        imgOut->enablePNG(enablePNG);
+        imgOut->enableTiff(enableTiff);
+        imgOut->enableJpeg(dumpJPEG);
+        imgOut->enableJpeg2000(dumpJP2);
+        imgOut->enableJBig2(dumpJBIG2);
+        imgOut->enableCCITT(dumpCCITT);
+    }
+    imgOut->enablePrintFilenames(printFilenames);
+}
+
+// Extract the images of pages firstPage .. lastPage on one thread per
+// CPU, each one with a PDFDoc and an ImageOutputDev of its own.  The
+// devices share an ImageIndex, so that an image object used on several
+// pages is written once, and the index is written to <imgRoot>.idx.
+static int extractImagesParallel(PDFDoc *doc, const GooString &fileName, const std::optional<GooString> &ownerPW, const std::optional<GooString> &userPW, char *imgRoot)
+{
+    // the other threads open the file again; stdin can only be read once
+    std::vector<std::unique_ptr<PDFDoc>> docs;
+    if (fileName.compare("fd://0") != 0) {
+        const int nThreads = std::min(static_cast<int>(std::max(1U, std::thread::hardware_concurrency())), lastPage - firstPage + 1);
+        for (int i = 1; i < nThreads; i++) {
+            std::unique_ptr<PDFDoc> threadDoc = PDFDocFactory().createPDFDoc(fileName, ownerPW, userPW);
+            if (!threadDoc->isOk()) {
+                break;
+            }
+            docs.push_back(std::move(threadDoc));
+        }
+    }
+
+    ImageIndex index;
+    std::atomic<int> nextPage = firstPage;
+    std::atomic<int> firstError = 0;
+    auto worker = [&](PDFDoc *threadDoc) {
+        ImageOutputDev imgOut(imgRoot, pageNames, false);
+        setupImageOutputDev(&imgOut);
+        imgOut.setIndex(&index);
+        for (int pg = nextPage++; pg <= lastPage; pg = nextPage++) {
+            threadDoc->displayPage(&imgOut, pg, 72, 72, 0, true, false, false);
+        }
+        if (!imgOut.isOk()) {
+            int expected = 0;
+            firstError.compare_exchange_strong(expected, imgOut.getErrorCode());
+        }
+    };
+    std::vector<std::thread> threads;
+    threads.reserve(docs.size());
+    for (const std::unique_ptr<PDFDoc> &threadDoc : docs) {
+        threads.emplace_back(worker, threadDoc.get());
+    }
+    worker(doc);
+    for (std::thread &t : threads) {
+        t.join();
+    }
+
+    const std::string indexName = std::string(imgRoot) + ".idx";
+    if (!index.write(indexName.c_str(), printFilenames)) {
+        return 2;
+    }
+    return firstError;
+}
+
 int main(int argc, char *argv[])
 {
     char *imgRoot = nullptr;
@@ -116,6 +195,10 @@ int main(int argc, char *argv[])
         }
         return 99;
     }
+    if (parallel && listImages) {
+        fprintf(stderr, "-parallel can't be used with -list\n");
+        return 99;
+    }
     auto *fileName = new GooString(argv[1]);
     if (!listImages) {
         imgRoot = argv[2];
@@ -140,6 +223,7 @@ int main(int argc, char *argv[])
     }
 
     std::unique_ptr<PDFDoc> doc = PDFDocFactory().createPDFDoc(*fileName, ownerPW, userPW);
+    const std::string docFileName = fileName->toStr();
     delete fileName;
 
     if (!doc->isOk()) {
@@ -170,27 +254,14 @@ int main(int argc, char *argv[])
         return 99;
     }
 
+    if (parallel) {
+        return extractImagesParallel(doc.get(), GooString(docFileName), ownerPW, userPW, imgRoot);
+    }
+
     // write image files
     auto *imgOut = new ImageOutputDev(imgRoot, pageNames, listImages);
-    imgOut->setMinHeight(minHeight);
-    imgOut->setMinWidth(minWidth);
     if (imgOut->isOk()) {
-        if (allFormats) {
-            imgOut->enablePNG(true);
-            imgOut->enableTiff(true);
-            imgOut->enableJpeg(true);
-            imgOut->enableJpeg2000(true);
-            imgOut->enableJBig2(true);
-            imgOut->enableCCITT(true);
-        } else {
-            imgOut->enablePNG(enablePNG);
-            imgOut->enableTiff(enableTiff);
-            imgOut->enableJpeg(dumpJPEG);
-            imgOut->enableJpeg2000(dumpJP2);
-            imgOut->enableJBig2(dumpJBIG2);
-            imgOut->enableCCITT(dumpCCITT);
-        }
-        imgOut->enablePrintFilenames(printFilenames);
+        setupImageOutputDev(imgOut);
         doc->displayPages(imgOut, firstPage, lastPage, 72, 72, 0, true, false, false);
     }
     const int exitCode = imgOut->isOk() ? 0 : imgOut->getErrorCode();
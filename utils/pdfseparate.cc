@@ -20,6 +20,9 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
 #include "parseargs.h"
 #include "goo/GooString.h"
 #include "PDFDoc.h"
@@ -29,11 +32,15 @@
 
 static int firstPage = 0;
 static int lastPage = 0;
+static bool useObjectStreams = false;
+static int numberOfJobs = 0;
 static bool printVersion = false;
 static bool printHelp = false;
 
 static const ArgDesc argDesc[] = { { .arg = "-f", .kind = argInt, .val = &firstPage, .size = 0, .usage = "first page to extract" },
                                    { .arg = "-l", .kind = argInt, .val = &lastPage, .size = 0, .usage = "last page to extract" },
+                                   { .arg = "-objstm", .kind = argFlag, .val = &useObjectStreams, .size = 0, .usage = "pack objects into compressed object streams (PDF 1.5)" },
+                                   { .arg = "-j", .kind = argInt, .val = &numberOfJobs, .size = 0, .usage = "number of pages to write concurrently (default is one per CPU)" },
                                    { .arg = "-v", .kind = argFlag, .val = &printVersion, .size = 0, .usage = "print copyright and version info" },
                                    { .arg = "-h", .kind = argFlag, .val = &printHelp, .size = 0, .usage = "print usage information" },
                                    { .arg = "-help", .kind = argFlag, .val = &printHelp, .size = 0, .usage = "print usage information" },
@@ -115,19 +122,14 @@ static bool extractPages(const char *srcFileName, const char *destFileName)
     }
     free(auxDestFileName);
 
+    std::vector<std::pair<int, std::string>> pages;
     for (int pageNo = firstPage; pageNo <= lastPage; pageNo++) {
         snprintf(pathName, sizeof(pathName) - 1, destFileName, pageNo);
-        auto *pagedoc = new PDFDoc(std::make_unique<GooString>(srcFileName));
-        int errCode = pagedoc->savePageAs(pathName, pageNo);
-        if (errCode != errNone) {
-            delete doc;
-            delete pagedoc;
-            return false;
-        }
-        delete pagedoc;
+        pages.emplace_back(pageNo, pathName);
     }
+    int errCode = doc->savePagesAs(pages, useObjectStreams ? writeForceRewriteCompressed : writeStandard, numberOfJobs);
     delete doc;
-    return true;
+    return errCode == errNone;
 }
 
 static constexpr int kOtherError = 99;
@@ -141,6 +141,12 @@ static bool quiet = false;
 static bool printVersion = false;
 static bool printHelp = false;
 
+#if ENABLE_LIBPNG
+static GooString pngOpt;
+static int pngCompressionLevel = -1;
+static int pngFilter = 0;
+#endif
+
 static GooString jpegOpt;
 static int jpegQuality = -1;
 static bool jpegProgressive = false;
@@ -155,6 +161,7 @@ static bool setupdlg = false;
 static const ArgDesc argDesc[] = {
 #if ENABLE_LIBPNG
     { .arg = "-png", .kind = argFlag, .val = &png, .size = 0, .usage = "generate a PNG file" },
+    { .arg = "-pngopt", .kind = argGooString, .val = &pngOpt, .size = 0, .usage = "png options, with format <opt1>=<val1>[,<optN>=<valN>]*" },
 #endif
 #if ENABLE_LIBJPEG
     { .arg = "-jpeg", .kind = argFlag, .val = &jpeg, .size = 0, .usage = "generate a JPEG file" },
@@ -280,6 +287,68 @@ static bool parseAntialiasOption()
     return false;
 }
 
+#if ENABLE_LIBPNG
+static bool parsePngOptions()
+{
+    // pngOpt format is: <opt1>=<val1>,<opt2>=<val2>,...
+    const char *nextOpt = pngOpt.c_str();
+    while (nextOpt && *nextOpt) {
+        const char *comma = strchr(nextOpt, ',');
+        GooString opt;
+        if (comma) {
+            opt.assign(nextOpt, static_cast<int>(comma - nextOpt));
+            nextOpt = comma + 1;
+        } else {
+            opt.assign(nextOpt);
+            nextOpt = nullptr;
+        }
+        // here opt is "<optN>=<valN> "
+        const char *equal = strchr(opt.c_str(), '=');
+        if (!equal) {
+            fprintf(stderr, "Unknown png option \"%s\"\n", opt.c_str());
+            return false;
+        }
+        const int iequal = static_cast<int>(equal - opt.c_str());
+        GooString value(&opt, iequal + 1, opt.size() - iequal - 1);
+        opt.erase(iequal, opt.size() - iequal);
+        // here opt is "<optN>" and value is "<valN>"
+
+        if (opt.compare("level") == 0) {
+            if (!isInt(value.c_str())) {
+                fprintf(stderr, "Invalid png compression level\n");
+                return false;
+            }
+            pngCompressionLevel = atoi(value.c_str());
+            if (pngCompressionLevel < 0 || pngCompressionLevel > 9) {
+                fprintf(stderr, "png compression level must be between 0 and 9\n");
+                return false;
+            }
+        } else if (opt.compare("filter") == 0) {
+            if (value.compare("none") == 0) {
+                pngFilter = PNGWriter::FILTER_NONE;
+            } else if (value.compare("sub") == 0) {
+                pngFilter = PNGWriter::FILTER_SUB;
+            } else if (value.compare("up") == 0) {
+                pngFilter = PNGWriter::FILTER_UP;
+            } else if (value.compare("average") == 0) {
+                pngFilter = PNGWriter::FILTER_AVERAGE;
+            } else if (value.compare("paeth") == 0) {
+                pngFilter = PNGWriter::FILTER_PAETH;
+            } else if (value.compare("adaptive") == 0) {
+                pngFilter = PNGWriter::FILTER_ADAPTIVE;
+            } else {
+                fprintf(stderr, "png filter option must be \"none\", \"sub\", \"up\", \"average\", \"paeth\" or \"adaptive\"\n");
+                return false;
+            }
+        } else {
+            fprintf(stderr, "Unknown png option \"%s\"\n", opt.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+#endif
+
 static bool parseJpegOptions()
 {
     // jpegOpt format is: <opt1>=<val1>,<opt2>=<val2>,...
@@ -369,6 +438,10 @@ static void writePageImage(GooString *filename)
             static_cast<PNGWriter *>(writer)->setSRGBProfile();
         }
 #    endif
+        if (pngCompressionLevel >= 0) {
+            static_cast<PNGWriter *>(writer)->setCompressionLevel(pngCompressionLevel);
+        }
+        static_cast<PNGWriter *>(writer)->setFilter(static_cast<PNGWriter::Filter>(pngFilter));
 #endif
 
     } else if (jpeg) {
@@ -1026,6 +1099,18 @@ int main(int argc, char *argv[])
         }
     }
 
+#if ENABLE_LIBPNG
+    if (!pngOpt.empty()) {
+        if (!png) {
+            fprintf(stderr, "Error: -pngopt may only be used with png output.\n");
+            exit(99);
+        }
+        if (!parsePngOptions()) {
+            exit(99);
+        }
+    }
+#endif
+
     if (strlen(tiffCompressionStr) > 0 && !tiff) {
         fprintf(stderr, "Error: -tiffcompression may only be used with tiff output.\n");
         exit(99);
@@ -1195,6 +1280,7 @@ int main(int argc, char *argv[])
 
     cairoOut = new CairoOutputDev();
     cairoOut->setLogicalStructure(docStruct);
+    cairoOut->setUseDrawGlyphRun(true);
 
 #if USE_CMS
     cairoOut->setDisplayProfile(profile);
@@ -140,6 +140,7 @@ public:
     ~SplashOutputDevNoText() override;
 
     void drawChar(GfxState * /*state*/, double /*x*/, double /*y*/, double /*dx*/, double /*dy*/, double /*originX*/, double /*originY*/, CharCode /*code*/, int /*nBytes*/, const Unicode * /*u*/, int /*uLen*/) override { }
+    void drawGlyphRun(GfxState * /*state*/, const OutputGlyphRun & /*run*/) override { }
     bool beginType3Char(GfxState * /*state*/, double /*x*/, double /*y*/, double /*dx*/, double /*dy*/, CharCode /*code*/, const Unicode * /*u*/, int /*uLen*/) override { return false; }
     void endType3Char(GfxState * /*state*/) override { }
     void beginTextObject(GfxState * /*state*/) override { }
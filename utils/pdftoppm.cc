@@ -53,8 +53,16 @@
 #endif
 #include <cstdio>
 #include <cmath>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "parseargs.h"
 #include "goo/GooString.h"
+#include "goo/gfile.h"
+#include "goo/ImgWriter.h"
+#include "goo/PNGWriter.h"
 #include "GlobalParams.h"
 #include "PDFDoc.h"
 #include "PDFDocFactory.h"
@@ -99,9 +107,12 @@ static int param_y = 0;
 static int param_w = 0;
 static int param_h = 0;
 static int sz = 0;
+static int bandHeight = 0;
 static bool hideAnnotations = false;
 static bool useCropBox = false;
 static bool mono = false;
+static char ditherStr[16] = "";
+static bool ditherFS = false;
 static bool gray = false;
 #if USE_CMS
 static GooString displayprofilename;
@@ -119,6 +130,11 @@ static bool png = false;
 static bool jpeg = false;
 static bool jpegcmyk = false;
 static bool tiff = false;
+#if ENABLE_LIBPNG
+static GooString pngOpt;
+static int pngCompressionLevel = -1;
+static int pngFilter = 0;
+#endif
 static GooString jpegOpt;
 static int jpegQuality = -1;
 static bool jpegProgressive = false;
@@ -131,6 +147,8 @@ static char antialiasStr[16] = "";
 static char vectorAntialiasStr[16] = "";
 static bool fontAntialias = true;
 static bool vectorAntialias = true;
+static bool analyticAntialias = false;
+static int shadingThreads = 1;
 static char ownerPassword[33] = "";
 static char userPassword[33] = "";
 static char TiffCompressionStr[16] = "";
@@ -163,10 +181,12 @@ static const ArgDesc argDesc[] = { { .arg = "-f", .kind = argInt, .val = &firstP
                                    { .arg = "-W", .kind = argInt, .val = &param_w, .size = 0, .usage = "width of crop area in pixels (default is 0)" },
                                    { .arg = "-H", .kind = argInt, .val = &param_h, .size = 0, .usage = "height of crop area in pixels (default is 0)" },
                                    { .arg = "-sz", .kind = argInt, .val = &sz, .size = 0, .usage = "size of crop square in pixels (sets W and H)" },
+                                   { .arg = "-band", .kind = argInt, .val = &bandHeight, .size = 0, .usage = "render and write each page in bands of this many rows" },
                                    { .arg = "-cropbox", .kind = argFlag, .val = &useCropBox, .size = 0, .usage = "use the crop box rather than media box" },
                                    { .arg = "-hide-annotations", .kind = argFlag, .val = &hideAnnotations, .size = 0, .usage = "do not show annotations" },
 
                                    { .arg = "-mono", .kind = argFlag, .val = &mono, .size = 0, .usage = "generate a monochrome PBM file" },
+                                   { .arg = "-dither", .kind = argString, .val = ditherStr, .size = sizeof(ditherStr), .usage = "set halftoning for -mono: ordered, fs. Default: ordered" },
                                    { .arg = "-gray", .kind = argFlag, .val = &gray, .size = 0, .usage = "generate a grayscale PGM file" },
 #if USE_CMS
                                    { .arg = "-displayprofile", .kind = argGooString, .val = &displayprofilename, .size = 0, .usage = "ICC color profile to use as the display profile" },
@@ -178,6 +198,7 @@ static const ArgDesc argDesc[] = { { .arg = "-f", .kind = argInt, .val = &firstP
                                    { .arg = "-forcenum", .kind = argFlag, .val = &forceNum, .size = 0, .usage = "force page number even if there is only one page " },
 #if ENABLE_LIBPNG
                                    { .arg = "-png", .kind = argFlag, .val = &png, .size = 0, .usage = "generate a PNG file" },
+                                   { .arg = "-pngopt", .kind = argGooString, .val = &pngOpt, .size = 0, .usage = "png options, with format <opt1>=<val1>[,<optN>=<valN>]*" },
 #endif
 #if ENABLE_LIBJPEG
                                    { .arg = "-jpeg", .kind = argFlag, .val = &jpeg, .size = 0, .usage = "generate a JPEG file" },
@@ -194,6 +215,8 @@ static const ArgDesc argDesc[] = { { .arg = "-f", .kind = argInt, .val = &firstP
 
                                    { .arg = "-aa", .kind = argString, .val = antialiasStr, .size = sizeof(antialiasStr), .usage = "enable font anti-aliasing: yes, no" },
                                    { .arg = "-aaVector", .kind = argString, .val = vectorAntialiasStr, .size = sizeof(vectorAntialiasStr), .usage = "enable vector anti-aliasing: yes, no" },
+                                   { .arg = "-aaExact", .kind = argFlag, .val = &analyticAntialias, .size = 0, .usage = "use exact pixel coverage for vector anti-aliasing" },
+                                   { .arg = "-shadingthreads", .kind = argInt, .val = &shadingThreads, .size = 0, .usage = "number of threads used to rasterize smooth shadings (default is 1)" },
 
                                    { .arg = "-opw", .kind = argString, .val = ownerPassword, .size = sizeof(ownerPassword), .usage = "owner password (for encrypted files)" },
                                    { .arg = "-upw", .kind = argString, .val = userPassword, .size = sizeof(userPassword), .usage = "user password (for encrypted files)" },
@@ -277,8 +300,199 @@ static bool parseJpegOptions()
     return true;
 }
 
+#if ENABLE_LIBPNG
+static bool parsePngOptions()
+{
+    // pngOpt format is: <opt1>=<val1>,<opt2>=<val2>,...
+    const char *nextOpt = pngOpt.c_str();
+    while (nextOpt && *nextOpt) {
+        const char *comma = strchr(nextOpt, ',');
+        GooString opt;
+        if (comma) {
+            opt.assign(nextOpt, static_cast<int>(comma - nextOpt));
+            nextOpt = comma + 1;
+        } else {
+            opt.assign(nextOpt);
+            nextOpt = nullptr;
+        }
+        // here opt is "<optN>=<valN> "
+        const char *equal = strchr(opt.c_str(), '=');
+        if (!equal) {
+            fprintf(stderr, "Unknown png option \"%s\"\n", opt.c_str());
+            return false;
+        }
+        const int iequal = static_cast<int>(equal - opt.c_str());
+        GooString value(&opt, iequal + 1, opt.size() - iequal - 1);
+        opt.erase(iequal, opt.size() - iequal);
+        // here opt is "<optN>" and value is "<valN>"
+
+        if (opt.compare("level") == 0) {
+            if (!isInt(value.c_str())) {
+                fprintf(stderr, "Invalid png compression level\n");
+                return false;
+            }
+            pngCompressionLevel = atoi(value.c_str());
+            if (pngCompressionLevel < 0 || pngCompressionLevel > 9) {
+                fprintf(stderr, "png compression level must be between 0 and 9\n");
+                return false;
+            }
+        } else if (opt.compare("filter") == 0) {
+            if (value.compare("none") == 0) {
+                pngFilter = PNGWriter::FILTER_NONE;
+            } else if (value.compare("sub") == 0) {
+                pngFilter = PNGWriter::FILTER_SUB;
+            } else if (value.compare("up") == 0) {
+                pngFilter = PNGWriter::FILTER_UP;
+            } else if (value.compare("average") == 0) {
+                pngFilter = PNGWriter::FILTER_AVERAGE;
+            } else if (value.compare("paeth") == 0) {
+                pngFilter = PNGWriter::FILTER_PAETH;
+            } else if (value.compare("adaptive") == 0) {
+                pngFilter = PNGWriter::FILTER_ADAPTIVE;
+            } else {
+                fprintf(stderr, "png filter option must be \"none\", \"sub\", \"up\", \"average\", \"paeth\" or \"adaptive\"\n");
+                return false;
+            }
+        } else {
+            fprintf(stderr, "Unknown png option \"%s\"\n", opt.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+#endif
+
 static auto annotDisplayDecideCbk = [](Annot * /*annot*/, void * /*user_data*/) { return !hideAnnotations; };
 
+// Render the slice in bands of bandHeight rows.  Each finished band is
+// handed to a second thread, which encodes it while the next band is
+// rendered, so at most three bands are in memory at any time.
+static void savePageBands(PDFDoc *doc, SplashOutputDev *splashOut, int pg, int x, int y, int w, int h, char *ppmFile)
+{
+    FILE *f;
+    if (ppmFile != nullptr) {
+        if (!(f = openFile(ppmFile, "wb"))) {
+            fprintf(stderr, "Could not write image to %s; exiting\n", ppmFile);
+            exit(EXIT_FAILURE);
+        }
+    } else {
+#if defined(_WIN32) || defined(__CYGWIN__)
+        _setmode(fileno(stdout), O_BINARY);
+#endif
+        f = stdout;
+    }
+
+    bool pnm = false;
+    SplashImageFileFormat format = splashFormatPng;
+    if (png) {
+        format = splashFormatPng;
+    } else if (jpeg) {
+        format = splashFormatJpeg;
+    } else if (jpegcmyk && ppmFile != nullptr) {
+        format = splashFormatJpegCMYK;
+    } else if (tiff) {
+        format = splashFormatTiff;
+    } else {
+        pnm = true;
+    }
+
+    SplashBitmap::WriteImgParams params;
+    params.jpegQuality = jpegQuality;
+    params.jpegProgressive = jpegProgressive;
+    params.jpegOptimize = jpegOptimize;
+#if ENABLE_LIBPNG
+    params.pngCompressionLevel = pngCompressionLevel;
+    params.pngFilter = pngFilter;
+#endif
+    params.tiffCompression = TiffCompressionStr;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::unique_ptr<SplashBitmap> nextBand;
+    bool done = false;
+    bool failed = false;
+
+    std::thread encoder([&]() {
+        std::unique_ptr<ImgWriter> writer;
+        SplashColorMode imageWriterFormat = splashModeRGB8;
+        std::vector<int> ditherCarry(w + 2, 0);
+        bool first = true;
+        bool ok = true;
+        while (true) {
+            std::unique_ptr<SplashBitmap> band;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cond.wait(lock, [&] { return nextBand || done; });
+                if (!nextBand) {
+                    break;
+                }
+                band = std::move(nextBand);
+            }
+            cond.notify_all();
+            if (!ok) {
+                continue;
+            }
+            if (mono && ditherFS) {
+                ok = band->ditherToMono1(&ditherCarry);
+            }
+            if (ok && first) {
+                first = false;
+                if (pnm) {
+                    ok = SplashBitmap::writePNMHeader(f, band->getMode(), w, h) == SplashError::NoError;
+                } else {
+                    writer.reset(SplashBitmap::createImgWriter(format, band->getMode(), &params, &imageWriterFormat));
+                    ok = writer && writer->init(f, w, h, x_resolution, y_resolution);
+                }
+            }
+            if (ok) {
+                if (pnm) {
+                    ok = band->writePNMRows(f) == SplashError::NoError;
+                } else {
+                    ok = band->writeImgRows(writer.get(), imageWriterFormat) == SplashError::NoError;
+                }
+            }
+            if (!ok) {
+                std::lock_guard<std::mutex> lock(mutex);
+                failed = true;
+            }
+        }
+        if (ok && writer && !writer->close()) {
+            ok = false;
+        }
+        if (!ok) {
+            std::lock_guard<std::mutex> lock(mutex);
+            failed = true;
+        }
+    });
+
+    for (int bandY = y; bandY < y + h; bandY += bandHeight) {
+        doc->displayPageSlice(splashOut, pg, x_resolution, y_resolution, 0, !useCropBox, false, false, x, bandY, w, std::min(bandHeight, y + h - bandY), nullptr, nullptr, annotDisplayDecideCbk, nullptr);
+        std::unique_ptr<SplashBitmap> band(splashOut->takeBitmap());
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [&] { return !nextBand || failed; });
+        if (failed) {
+            break;
+        }
+        nextBand = std::move(band);
+        lock.unlock();
+        cond.notify_all();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+    }
+    cond.notify_all();
+    encoder.join();
+
+    if (ppmFile != nullptr) {
+        fclose(f);
+    }
+    if (failed) {
+        fprintf(stderr, "Could not write image to %s; exiting\n", ppmFile != nullptr ? ppmFile : "stdout");
+        exit(EXIT_FAILURE);
+    }
+}
+
 static void savePageSlice(PDFDoc *doc, SplashOutputDev *splashOut, int pg, int x, int y, int w, int h, double pg_w, double pg_h, char *ppmFile)
 {
     if (w == 0) {
@@ -289,21 +503,44 @@ static void savePageSlice(PDFDoc *doc, SplashOutputDev *splashOut, int pg, int x
     }
     w = (x + w > pg_w ? static_cast<int>(ceil(pg_w - x)) : w);
     h = (y + h > pg_h ? static_cast<int>(ceil(pg_h - y)) : h);
+    if (bandHeight > 0 && h > bandHeight) {
+        savePageBands(doc, splashOut, pg, x, y, w, h, ppmFile);
+        if (progress) {
+            fprintf(stderr, "%d %d %s\n", pg, lastPage, ppmFile != nullptr ? ppmFile : "");
+        }
+        return;
+    }
     doc->displayPageSlice(splashOut, pg, x_resolution, y_resolution, 0, !useCropBox, false, false, x, y, w, h, nullptr, nullptr, annotDisplayDecideCbk, nullptr);
 
     SplashBitmap *bitmap = splashOut->getBitmap();
 
+    // with error diffusion, the page is rendered in gray and dithered
+    // afterwards
+    std::unique_ptr<SplashBitmap> ditheredBitmap;
+    if (mono && ditherFS) {
+        ditheredBitmap.reset(splashOut->takeBitmap());
+        if (!ditheredBitmap->ditherToMono1()) {
+            fprintf(stderr, "Could not dither page %d; exiting\n", pg);
+            exit(EXIT_FAILURE);
+        }
+        bitmap = ditheredBitmap.get();
+    }
+
     SplashBitmap::WriteImgParams params;
     params.jpegQuality = jpegQuality;
     params.jpegProgressive = jpegProgressive;
     params.jpegOptimize = jpegOptimize;
+#if ENABLE_LIBPNG
+    params.pngCompressionLevel = pngCompressionLevel;
+    params.pngFilter = pngFilter;
+#endif
     params.tiffCompression = TiffCompressionStr;
 
     if (ppmFile != nullptr) {
         SplashError e;
 
         if (png) {
-            e = bitmap->writeImgFile(splashFormatPng, ppmFile, x_resolution, y_resolution);
+            e = bitmap->writeImgFile(splashFormatPng, ppmFile, x_resolution, y_resolution, &params);
         } else if (jpeg) {
             e = bitmap->writeImgFile(splashFormatJpeg, ppmFile, x_resolution, y_resolution, &params);
         } else if (jpegcmyk) {
@@ -323,7 +560,7 @@ static void savePageSlice(PDFDoc *doc, SplashOutputDev *splashOut, int pg, int x
 #endif
 
         if (png) {
-            bitmap->writeImgFile(splashFormatPng, stdout, x_resolution, y_resolution);
+            bitmap->writeImgFile(splashFormatPng, stdout, x_resolution, y_resolution, &params);
         } else if (jpeg) {
             bitmap->writeImgFile(splashFormatJpeg, stdout, x_resolution, y_resolution, &params);
         } else if (tiff) {
@@ -371,13 +608,16 @@ static void processPageJobs()
         pthread_mutex_unlock(&pageJobMutex);
 
         // process the job
-        SplashOutputDev *splashOut = new SplashOutputDev(mono                              ? splashModeMono1
-                                                                 : gray                    ? splashModeMono8
+        SplashOutputDev *splashOut = new SplashOutputDev(mono && !ditherFS                 ? splashModeMono1
+                                                                 : mono || gray            ? splashModeMono8
                                                                  : (jpegcmyk || overprint) ? splashModeDeviceN8
                                                                                            : splashModeRGB8,
                                                          4, false, *pageJob.paperColor, true, thinLineMode, splashOverprintPreview);
         splashOut->setFontAntialias(fontAntialias);
         splashOut->setVectorAntialias(vectorAntialias);
+        splashOut->setAnalyticAntialias(analyticAntialias);
+        splashOut->setShadingThreads(shadingThreads);
+        splashOut->setUseDrawGlyphRun(true);
         splashOut->setEnableFreeType(enableFreeType);
 #    if USE_CMS
         splashOut->setDisplayProfile(displayprofile);
@@ -463,6 +703,15 @@ int main(int argc, char *argv[])
         parseJpegOptions();
     }
 
+#if ENABLE_LIBPNG
+    if (!pngOpt.empty()) {
+        if (!png) {
+            fprintf(stderr, "Warning: -pngopt only valid with png output.\n");
+        }
+        parsePngOptions();
+    }
+#endif
+
     // read config file
     globalParams = std::make_unique<GlobalParams>();
     if (enableFreeTypeStr[0]) {
@@ -479,6 +728,13 @@ int main(int argc, char *argv[])
             fprintf(stderr, "Bad '-thinlinemode' value on command line\n");
         }
     }
+    if (ditherStr[0]) {
+        if (strcmp(ditherStr, "fs") == 0) {
+            ditherFS = true;
+        } else if (strcmp(ditherStr, "ordered") != 0) {
+            fprintf(stderr, "Bad '-dither' value on command line\n");
+        }
+    }
     if (quiet) {
         globalParams->setErrQuiet(quiet);
     }
@@ -596,10 +852,13 @@ int main(int argc, char *argv[])
 
 #ifndef UTILS_USE_PTHREADS
 
-    splashOut = new SplashOutputDev(mono ? splashModeMono1 : gray ? splashModeMono8 : (jpegcmyk || overprint) ? splashModeDeviceN8 : splashModeRGB8, 4, paperColor, true, thinLineMode, splashOverprintPreview);
+    splashOut = new SplashOutputDev(mono && !ditherFS ? splashModeMono1 : mono || gray ? splashModeMono8 : (jpegcmyk || overprint) ? splashModeDeviceN8 : splashModeRGB8, 4, paperColor, true, thinLineMode, splashOverprintPreview);
 
     splashOut->setFontAntialias(fontAntialias);
     splashOut->setVectorAntialias(vectorAntialias);
+    splashOut->setAnalyticAntialias(analyticAntialias);
+    splashOut->setShadingThreads(shadingThreads);
+    splashOut->setUseDrawGlyphRun(true);
     splashOut->setEnableFreeType(enableFreeType);
 #    if USE_CMS
     splashOut->setDisplayProfile(displayprofile);
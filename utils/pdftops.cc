@@ -97,11 +97,16 @@ static bool noEmbedTTFonts = false;
 static bool noEmbedCIDPSFonts = false;
 static bool noEmbedCIDTTFonts = false;
 static bool fontPassthrough = false;
+static bool subsetFonts = false;
 static bool optimizeColorSpace = false;
 static bool passLevel1CustomColor = false;
 static char rasterAntialiasStr[16] = "";
 static char forceRasterizeStr[16] = "";
 static bool preload = false;
+static int streamResPages = 0;
+static int maxResources = 256;
+// Number of parsed object streams kept with -streamres.
+static const size_t streamMaxObjectStreams = 32;
 static char paperSize[15] = "";
 static int paperWidth = -1;
 static int paperHeight = -1;
@@ -150,6 +155,7 @@ static const ArgDesc argDesc[] = {
     { .arg = "-noembcidps", .kind = argFlag, .val = &noEmbedCIDPSFonts, .size = 0, .usage = "don't embed CID PostScript fonts" },
     { .arg = "-noembcidtt", .kind = argFlag, .val = &noEmbedCIDTTFonts, .size = 0, .usage = "don't embed CID TrueType fonts" },
     { .arg = "-passfonts", .kind = argFlag, .val = &fontPassthrough, .size = 0, .usage = "don't substitute missing fonts" },
+    { .arg = "-subsetfonts", .kind = argFlag, .val = &subsetFonts, .size = 0, .usage = "embed only the glyphs used of TrueType and CID fonts" },
     { .arg = "-aaRaster", .kind = argString, .val = rasterAntialiasStr, .size = sizeof(rasterAntialiasStr), .usage = "enable anti-aliasing on rasterization: yes, no" },
     { .arg = "-rasterize", .kind = argString, .val = forceRasterizeStr, .size = sizeof(forceRasterizeStr), .usage = "control rasterization: always, never, whenneeded" },
     { .arg = "-processcolorformat", .kind = argGooString, .val = &processcolorformatname, .size = 0, .usage = "color format that is used during rasterization and transparency reduction: MONO8, RGB8, CMYK8" },
@@ -162,6 +168,8 @@ static const ArgDesc argDesc[] = {
     { .arg = "-optimizecolorspace", .kind = argFlag, .val = &optimizeColorSpace, .size = 0, .usage = "convert gray RGB images to gray color space" },
     { .arg = "-passlevel1customcolor", .kind = argFlag, .val = &passLevel1CustomColor, .size = 0, .usage = "pass custom color in level1sep" },
     { .arg = "-preload", .kind = argFlag, .val = &preload, .size = 0, .usage = "preload images and forms" },
+    { .arg = "-streamres", .kind = argInt, .val = &streamResPages, .size = 0, .usage = "write the fonts and preloaded images and forms with the pages, releasing them after groups of this many pages" },
+    { .arg = "-maxres", .kind = argInt, .val = &maxResources, .size = 0, .usage = "with -streamres, max number of resources kept between groups (default is 256)" },
     { .arg = "-paper", .kind = argString, .val = paperSize, .size = sizeof(paperSize), .usage = "paper size (letter, legal, A4, A3, match)" },
     { .arg = "-paperw", .kind = argInt, .val = &paperWidth, .size = 0, .usage = "paper width, in points" },
     { .arg = "-paperh", .kind = argInt, .val = &paperHeight, .size = 0, .usage = "paper height, in points" },
@@ -473,7 +481,14 @@ int main(int argc, char *argv[])
     psOut->setEmbedCIDPostScript(!noEmbedCIDPSFonts);
     psOut->setEmbedCIDTrueType(!noEmbedCIDTTFonts);
     psOut->setFontPassthrough(fontPassthrough);
+    psOut->setSubsetFonts(subsetFonts);
     psOut->setPreloadImagesForms(preload);
+    psOut->setStreamResources(streamResPages, maxResources);
+    if (streamResPages > 0) {
+        // the pages are released once written (see below), so the object
+        // streams they were read from needn't all be kept either
+        doc->getXRef()->setMaxObjectStreams(streamMaxObjectStreams);
+    }
     psOut->setOptimizeColorSpace(optimizeColorSpace);
     psOut->setPassLevel1CustomColor(passLevel1CustomColor);
     psOut->setGenerateOPI(doOPI);
@@ -481,8 +496,11 @@ int main(int argc, char *argv[])
 
     psOut->setRasterAntialias(rasterAntialias);
     if (psOut->isOk()) {
+        // each page is written once: free it afterwards so that the
+        // memory used doesn't grow with the length of the document
         for (int i = firstPage; i <= lastPage; ++i) {
             doc->displayPage(psOut, i, 72, 72, 0, noCrop, !noCrop, true);
+            doc->releasePage(i);
         }
     } else {
         delete psOut;
@@ -367,6 +367,7 @@ int main(int argc, char *argv[])
             textOut.setTextEOL(textEOL);
             textOut.setMinColSpacing1(colspacing);
             textOut.setEndOfLineHyphenMode(hyphenMode);
+            textOut.setUseDrawGlyphRun(true);
             if (noPageBreaks) {
                 textOut.setTextPageBreaks(false);
             }
@@ -384,6 +385,7 @@ int main(int argc, char *argv[])
         if (tsvMode) {
             TextOutputDev textOut(nullptr, physLayout, fixedPitch, rawOrder, htmlMeta, discardDiag);
             textOut.setEndOfLineHyphenMode(hyphenMode);
+            textOut.setUseDrawGlyphRun(true);
             if (!textFileName->compare("-")) {
                 f = stdout;
             } else {
@@ -402,6 +404,7 @@ int main(int argc, char *argv[])
                 textOut.setTextEOL(textEOL);
                 textOut.setMinColSpacing1(colspacing);
                 textOut.setEndOfLineHyphenMode(hyphenMode);
+                textOut.setUseDrawGlyphRun(true);
                 if (noPageBreaks) {
                     textOut.setTextPageBreaks(false);
                 }
@@ -28,10 +28,16 @@
 #include <poppler-config.h>
 #include <vector>
 
+static bool useObjectStreams = false;
+static bool deduplicate = false;
+static bool printDedupStats = false;
 static bool printVersion = false;
 static bool printHelp = false;
 
-static const ArgDesc argDesc[] = { { .arg = "-v", .kind = argFlag, .val = &printVersion, .size = 0, .usage = "print copyright and version info" },
+static const ArgDesc argDesc[] = { { .arg = "-objstm", .kind = argFlag, .val = &useObjectStreams, .size = 0, .usage = "pack objects into compressed object streams (PDF 1.5)" },
+                                   { .arg = "-dedup", .kind = argFlag, .val = &deduplicate, .size = 0, .usage = "write objects found with the same content in several places (e.g. fonts) only once" },
+                                   { .arg = "-dedupstats", .kind = argFlag, .val = &printDedupStats, .size = 0, .usage = "with -dedup, print the number of duplicates removed and the bytes saved" },
+                                   { .arg = "-v", .kind = argFlag, .val = &printVersion, .size = 0, .usage = "print copyright and version info" },
                                    { .arg = "-h", .kind = argFlag, .val = &printHelp, .size = 0, .usage = "print usage information" },
                                    { .arg = "-help", .kind = argFlag, .val = &printHelp, .size = 0, .usage = "print usage information" },
                                    { .arg = "--help", .kind = argFlag, .val = &printHelp, .size = 0, .usage = "print usage information" },
@@ -205,6 +211,19 @@ int main(int argc, char *argv[])
     yRef = new XRef();
     countRef = new XRef();
     yRef->add(0, 65535, 0, false);
+    std::unique_ptr<ObjectStreamWriter> objStms;
+    if (useObjectStreams) {
+        if (majorVersion == 1 && minorVersion < 5) {
+            minorVersion = 5; // object streams need PDF 1.5
+        }
+        objStms = std::make_unique<ObjectStreamWriter>(outStr, yRef, 0, nullptr, cryptRC4, 0);
+    }
+    std::unique_ptr<ObjectDeduplicator> dedup;
+    const std::unordered_map<int, Ref> *replacedRefs = nullptr;
+    if (deduplicate) {
+        dedup = std::make_unique<ObjectDeduplicator>(yRef);
+        replacedRefs = dedup->getReplacedRefs();
+    }
     PDFDoc::writeHeader(outStr, majorVersion, minorVersion);
 
     // handle OutputIntents, AcroForm, OCProperties & Names
@@ -360,7 +379,10 @@ int main(int argc, char *argv[])
                 }
             }
         }
-        objectsCount += docs[i]->writePageObjects(outStr, yRef, numOffset, true);
+        if (dedup) {
+            dedup->addDocument(docs[i].get(), numOffset);
+        }
+        objectsCount += docs[i]->writePageObjects(outStr, yRef, numOffset, true, objStms.get(), replacedRefs);
         numOffset = yRef->getNumObjects() + 1;
     }
 
@@ -374,7 +396,7 @@ int main(int argc, char *argv[])
         for (int j = 0; j < intentsObj.arrayGetLength(); j++) {
             Object intent = intentsObj.arrayGet(j, 0);
             if (intent.isDict()) {
-                PDFDoc::writeObject(&intent, outStr, yRef, 0, nullptr, cryptRC4, 0, 0, 0);
+                PDFDoc::writeObject(&intent, outStr, yRef, 0, nullptr, cryptRC4, 0, 0, 0, nullptr, replacedRefs);
             }
         }
         outStr->printf("]");
@@ -382,17 +404,17 @@ int main(int argc, char *argv[])
     // insert AcroForm
     if (!afObj.isNull()) {
         outStr->printf(" /AcroForm ");
-        PDFDoc::writeObject(&afObj, outStr, yRef, 0, nullptr, cryptRC4, 0, 0, 0);
+        PDFDoc::writeObject(&afObj, outStr, yRef, 0, nullptr, cryptRC4, 0, 0, 0, nullptr, replacedRefs);
     }
     // insert OCProperties
     if (!ocObj.isNull() && ocObj.isDict()) {
         outStr->printf(" /OCProperties ");
-        PDFDoc::writeObject(&ocObj, outStr, yRef, 0, nullptr, cryptRC4, 0, 0, 0);
+        PDFDoc::writeObject(&ocObj, outStr, yRef, 0, nullptr, cryptRC4, 0, 0, 0, nullptr, replacedRefs);
     }
     // insert Names
     if (!names.isNull() && names.isDict()) {
         outStr->printf(" /Names ");
-        PDFDoc::writeObject(&names, outStr, yRef, 0, nullptr, cryptRC4, 0, 0, 0);
+        PDFDoc::writeObject(&names, outStr, yRef, 0, nullptr, cryptRC4, 0, 0, 0, nullptr, replacedRefs);
     }
     outStr->printf(">>\nendobj\n");
     objectsCount++;
@@ -421,7 +443,7 @@ int main(int argc, char *argv[])
                 outStr->printf("/Parent %d 0 R", rootNum + 1);
             } else {
                 outStr->printf("/%s ", key.c_str());
-                PDFDoc::writeObject(&value, outStr, yRef, offsets[i], nullptr, cryptRC4, 0, 0, 0);
+                PDFDoc::writeObject(&value, outStr, yRef, offsets[i], nullptr, cryptRC4, 0, 0, 0, nullptr, replacedRefs);
             }
         }
         outStr->printf(" >>\nendobj\n");
@@ -432,13 +454,20 @@ int main(int argc, char *argv[])
     ref.num = rootNum;
     ref.gen = 0;
     Object trailerDict = PDFDoc::createTrailerDict(objectsCount, false, 0, &ref, yRef, fileName, outStr->getPos());
-    PDFDoc::writeXRefTableTrailer(std::move(trailerDict), yRef, true, // write all entries according to ISO 32000-1, 7.5.4 Cross-Reference Table: "For a file that has never been incrementally updated, the cross-reference section shall
-                                                                      // contain only one subsection, whose object numbering begins at 0."
-                                  uxrefOffset, outStr, yRef);
+    if (objStms) {
+        objStms->writeTrailer(std::move(trailerDict), yRef);
+    } else {
+        PDFDoc::writeXRefTableTrailer(std::move(trailerDict), yRef, true, // write all entries according to ISO 32000-1, 7.5.4 Cross-Reference Table: "For a file that has never been incrementally updated, the cross-reference section shall
+                                                                          // contain only one subsection, whose object numbering begins at 0."
+                                      uxrefOffset, outStr, yRef);
+    }
 
     outStr->close();
     delete outStr;
     fclose(f);
+    if (dedup && printDedupStats) {
+        fprintf(stderr, "Merged %d duplicate objects, saving about %lld bytes\n", dedup->getNumReplaced(), static_cast<long long>(dedup->getBytesSaved()));
+    }
     delete yRef;
     delete countRef;
     return 0;